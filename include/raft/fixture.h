@@ -10,7 +10,7 @@
 
 #include <stdint.h>
 
-#define RAFT_FIXTURE_MAX_SERVERS 8
+#define RAFT_FIXTURE_MAX_SERVERS 32
 
 /**
  * Fixture step event types.
@@ -32,6 +32,11 @@ struct raft_fixture_server;
  */
 struct raft_fixture_event;
 
+/**
+ * Pending I/O requests of all servers, ordered by completion time.
+ */
+struct raft_fixture_schedule;
+
 /**
  * Returns the type of the event.
  */
@@ -72,6 +77,8 @@ struct raft_fixture
     struct raft_fixture_event *event; /* Last event occurred. */
     raft_fixture_event_cb hook;       /* Event callback. */
     struct raft_fixture_server *servers[RAFT_FIXTURE_MAX_SERVERS];
+    /* Pending I/O requests of all servers, by completion time. */
+    struct raft_fixture_schedule *schedule;
     uint64_t reserved[16]; /* For future expansion of struct. */
 };
 
@@ -351,6 +358,37 @@ RAFT_API void raft_fixture_desaturate(struct raft_fixture *f,
                                       unsigned i,
                                       unsigned j);
 
+/**
+ * Limit the bandwidth of the link from the @i'th to the @j'th server to @bytes
+ * per millisecond. Messages sent through the link are queued in FIFO order and
+ * each one takes a time proportional to its size to be sent, after which the
+ * network latency starts to elapse. The default value is 0, meaning unlimited
+ * bandwidth.
+ */
+RAFT_API void raft_fixture_set_bandwidth(struct raft_fixture *f,
+                                         unsigned i,
+                                         unsigned j,
+                                         unsigned bytes);
+
+/**
+ * Add a random delay of up to @msecs milliseconds to the network latency of
+ * each message sent from the @i'th to the @j'th server. Messages sent through
+ * the same link are still delivered in order. The default value is 0.
+ */
+RAFT_API void raft_fixture_set_jitter(struct raft_fixture *f,
+                                      unsigned i,
+                                      unsigned j,
+                                      unsigned msecs);
+
+/**
+ * Silently drop the given percentage of the messages sent from the @i'th to the
+ * @j'th server, chosen at random. The default value is 0.
+ */
+RAFT_API void raft_fixture_set_loss(struct raft_fixture *f,
+                                    unsigned i,
+                                    unsigned j,
+                                    unsigned percent);
+
 /**
  * Kill the server with the given index. The server won't receive any message
  * and its tick callback won't be invoked.
@@ -370,8 +408,10 @@ RAFT_API int raft_fixture_grow(struct raft_fixture *f, struct raft_fsm *fsm);
 /**
  * Set the value that will be returned to the @i'th raft instance when it asks
  * the underlying #raft_io implementation for a randomized election timeout
- * value. The default value is 1000 + @i * 100, meaning that the election timer
- * of server 0 will expire first.
+ * value. The default value is 1000 + @i * 100 for the first ten servers,
+ * meaning that the election timer of server 0 will expire first. Servers with
+ * a higher index are interleaved, 10 milliseconds after the server whose index
+ * is lower by ten.
  */
 RAFT_API void raft_fixture_set_randomized_election_timeout(
     struct raft_fixture *f,
@@ -11,6 +11,30 @@
 #define RAFT_UV_TRACER_WRITE_SUBMIT (1 << 8)
 #define RAFT_UV_TRACER_WRITE_COMPLETE (2 << 8)
 
+/**
+ * Trace event fired when raft_io->load() completes successfully. The info
+ * argument points to a #raft_uv_load_stats object.
+ */
+#define RAFT_UV_TRACER_LOAD_COMPLETE (3 << 8)
+
+/**
+ * Breakdown of the time spent by raft_io->load(), in nanoseconds.
+ *
+ * Closed segments might be loaded by several threads at once, see
+ * raft_uv_set_segment_load_threads(). In that case the segment_* counters are
+ * summed across threads, and can add up to more than @total.
+ */
+struct raft_uv_load_stats
+{
+    uint64_t total;               /* Whole load() call */
+    uint64_t list;                /* Listing the data directory */
+    uint64_t segment_read;        /* Reading segment files */
+    uint64_t segment_crc;         /* Checking batch checksums */
+    uint64_t segment_decode;      /* Decoding batch headers and entries */
+    uint64_t snapshot_read;       /* Reading snapshot files */
+    uint64_t snapshot_decompress; /* Decompressing snapshot data */
+};
+
 struct raft_uv_transport;
 
 /**
@@ -148,6 +172,109 @@ RAFT_API void raft_uv_set_tracer(struct raft_io *io,
  */
 RAFT_API void raft_uv_set_auto_recovery(struct raft_io *io, bool flag);
 
+/**
+ * Set the maximum number of threads used to read, checksum and decode closed
+ * segments concurrently when loading the log at startup.
+ *
+ * The default is 4. Setting it to 0 or 1 loads segments sequentially. With
+ * more than one thread, the functions of a custom #raft_heap get called
+ * concurrently, see raft_heap_set().
+ */
+RAFT_API void raft_uv_set_segment_load_threads(struct raft_io *io, unsigned n);
+
+/**
+ * Set the number of entries behind the last snapshot that are loaded at
+ * startup.
+ *
+ * Entries older than that are already covered by the snapshot, so closed
+ * segments holding only such entries are not read at all, and the index file
+ * written next to each closed segment is used to seek past them in the segment
+ * straddling the boundary. This is typically set to the same value passed to
+ * raft_set_snapshot_trailing().
+ *
+ * The default is to load all entries found on disk.
+ */
+RAFT_API void raft_uv_set_load_trailing(struct raft_io *io, unsigned n);
+
+/**
+ * Set the minimum size of InstallSnapshot payloads that are streamed straight
+ * from the socket to a temporary file in the data directory, in fixed-size
+ * chunks, instead of being buffered in memory.
+ *
+ * Streamed messages are passed to the recv callback with a NULL data buffer.
+ * Passing a snapshot with a NULL data buffer to raft_io->snapshot_put() then
+ * persists the streamed file, without copying it.
+ *
+ * This only avoids holding the payload in memory while it's received and
+ * persisted. Restoring the FSM still needs the whole snapshot in memory, since
+ * raft_fsm->restore() takes a single buffer: the v0.x API reads the persisted
+ * file back with raft_io->snapshot_get() before restoring, so the peak memory
+ * usage of installing a snapshot is still its size.
+ *
+ * The default is 8 megabytes. Setting the threshold to 0 disables streaming.
+ */
+RAFT_API void raft_uv_set_snapshot_stream_threshold(struct raft_io *io,
+                                                    size_t size);
+
+/**
+ * Set the minimum size of the entries payload of AppendEntries requests that
+ * are compressed with LZ4 before being sent.
+ *
+ * The payload of a request is compressed only if the receiving server has
+ * advertised that it supports LZ4-compressed payloads, and it is sent as is if
+ * compression doesn't make it any smaller. The receiver decompresses it before
+ * passing the message to the recv callback.
+ *
+ * The default is 0, which disables compression.
+ */
+RAFT_API void raft_uv_set_append_compression_threshold(struct raft_io *io,
+                                                       size_t size);
+
+/**
+ * Set the maximum number of bytes of outgoing messages that can be queued for
+ * a single peer connection, counting both messages waiting for the connection
+ * to be established and messages being written out.
+ *
+ * When the queue is full, AppendEntries requests carrying entries are rejected
+ * with #RAFT_BUSY, so the leader can stop pipelining entries to a follower
+ * whose connection is congested. Other messages are always accepted, but while
+ * a peer is unreachable the oldest queued messages are failed with
+ * #RAFT_NOCONNECTION to keep the queue within the limit. A message is always
+ * accepted if the queue is empty, regardless of its size.
+ *
+ * The default is 16 megabytes.
+ */
+RAFT_API void raft_uv_set_send_queue_size(struct raft_io *io, size_t size);
+
+/**
+ * Set the interval in milliseconds of the keepalive frames that are written on
+ * idle connections to peers that were asked to quiesce, see
+ * raft_set_quiescence().
+ *
+ * A connection from a peer that sends keepalives is dropped after receiving
+ * nothing for 3 of the peer's intervals, and the peer is reported as
+ * unreachable, which lets a quiescent follower notice a leader that lost power
+ * or that sits behind a partition dropping packets silently. The check runs
+ * every interval of this instance.
+ *
+ * The default is 1000. Setting it to 0 disables both sending keepalives and
+ * dropping silent connections. It has no effect on the groups of a
+ * #raft_uv_host, see raft_uv_host_set_keepalive().
+ */
+RAFT_API void raft_uv_set_keepalive(struct raft_io *io, unsigned msecs);
+
+/**
+ * Set the maximum amount of entries data read back from disk by
+ * raft_io->read() that is kept in memory, so that followers catching up from
+ * the same point don't need to read the same segments again.
+ *
+ * Only closed segments are read back, since open ones might be written at the
+ * same time. Segments are read and cached whole, and the least recently used
+ * ones are evicted first. The default is 8 megabytes. Setting it to 0 disables
+ * caching.
+ */
+RAFT_API void raft_uv_set_read_cache_size(struct raft_io *io, size_t size);
+
 /**
  * Callback invoked by the transport implementation when a new incoming
  * connection has been established.
@@ -267,11 +394,48 @@ struct raft_uv_transport
 RAFT_API int raft_uv_tcp_init(struct raft_uv_transport *t,
                               struct uv_loop_s *loop);
 
+/**
+ * Init a transport interface that uses Unix domain stream sockets, for servers
+ * running on the same host.
+ *
+ * Server addresses are socket paths, which must not exist already when the
+ * transport starts listening and are removed when it is closed. Addresses
+ * starting with '@' are names in the Linux abstract namespace, and require
+ * libuv 1.46 or later.
+ *
+ * The connection handshake and the wire format of messages are the same as the
+ * TCP transport. Release the transport with raft_uv_tcp_close().
+ */
+RAFT_API int raft_uv_unix_init(struct raft_uv_transport *t,
+                               struct uv_loop_s *loop);
+
 /**
  * Release any memory allocated internally.
  */
 RAFT_API void raft_uv_tcp_close(struct raft_uv_transport *t);
 
+/**
+ * Init a transport interface for servers running in the same process and on
+ * the same event loop, such as embedded clusters or test harnesses.
+ *
+ * Messages sent by a @raft_io instance using this transport are not encoded:
+ * they are passed directly to the recv callback of the instance which is
+ * listening on the target address, in a later loop iteration, after which the
+ * send callback fires. Entries and snapshot payloads are copied into a single
+ * buffer owned by the receiver. Sending to an address that nobody is listening
+ * on fails with #RAFT_NOCONNECTION.
+ *
+ * Addresses are arbitrary strings, which must be unique among the instances
+ * sharing the same loop.
+ */
+RAFT_API int raft_uv_inproc_init(struct raft_uv_transport *t,
+                                 struct uv_loop_s *loop);
+
+/**
+ * Release any memory allocated internally by an in-process transport.
+ */
+RAFT_API void raft_uv_inproc_close(struct raft_uv_transport *t);
+
 /**
  * Set the IP address and port that the listening socket will bind to.
  *
@@ -283,9 +447,262 @@ RAFT_API void raft_uv_tcp_close(struct raft_uv_transport *t);
  * "0.0.0.0:8080". If you do not provide a port, the default of 8080 will be
  * used. The port given here *must* match the port given to raft_init().
  *
+ * For transports created with raft_uv_unix_init() the @address argument is a
+ * socket path, which other servers must be able to connect to.
+ *
  * Must be called before raft_init().
  */
 RAFT_API int raft_uv_tcp_set_bind_address(struct raft_uv_transport *t,
                                           const char *address);
 
+/**
+ * Network transport and tick timer shared by several libuv-based @raft_io
+ * instances running on the same event loop, each one being a server of a
+ * different raft group.
+ *
+ * The groups of a host share only:
+ *
+ * - The transport: the host listens on a single address and keeps at most one
+ *   control and one bulk connection to each peer host, whatever the number of
+ *   groups. Messages carry the group ID in their preamble and are passed to the
+ *   recv callback of the group with the same ID on the receiving host, or
+ *   dropped if there's no such group.
+ *
+ * - The tick timer, which fires at the shortest interval requested by the
+ *   started groups and ticks each group as often as it asked for.
+ *
+ * All groups of a host must be initialized with the same server ID and
+ * address, which are the ones of the host, and peer hosts must be addressed
+ * using their own ID and address.
+ *
+ * Disk I/O is not shared yet: each group keeps its own data directory, open
+ * segments and pool of prepared segments, so the disk space, file descriptors
+ * and fsync calls needed by the groups grow with their number just like for
+ * standalone instances. A write-ahead segment stream shared by all the groups
+ * of a host is not implemented.
+ *
+ * InstallSnapshot payloads received over host connections are never streamed
+ * to disk, see raft_uv_set_snapshot_stream_threshold().
+ */
+struct raft_uv_host
+{
+    /**
+     * User defined data.
+     */
+    void *data;
+
+    /**
+     * Implementation-defined state.
+     */
+    void *impl;
+
+    /**
+     * Human-readable message providing diagnostic information about the last
+     * error occurred.
+     */
+    char errmsg[RAFT_ERRMSG_BUF_SIZE];
+};
+
+/**
+ * Callback invoked once a host has been closed and its memory released.
+ */
+typedef void (*raft_uv_host_close_cb)(struct raft_uv_host *h);
+
+/**
+ * Init a host for raft groups sharing the given transport, which must be a TCP
+ * or Unix socket one, initialized but not yet used. The transport must be
+ * released only after the host has been closed.
+ */
+RAFT_API int raft_uv_host_init(struct raft_uv_host *h,
+                               struct uv_loop_s *loop,
+                               struct raft_uv_transport *transport);
+
+/**
+ * Close the host, stopping listening and closing all its connections. All
+ * @raft_io instances of the host must have been released already with
+ * raft_uv_close(). The @cb callback is invoked once the host's memory has been
+ * released.
+ */
+RAFT_API void raft_uv_host_close(struct raft_uv_host *h,
+                                 raft_uv_host_close_cb cb);
+
+/**
+ * Set the keepalive interval of the host's connections, which are shared by all
+ * its groups, like raft_uv_set_keepalive() does for a standalone instance.
+ */
+RAFT_API void raft_uv_host_set_keepalive(struct raft_uv_host *h,
+                                         unsigned msecs);
+
+/**
+ * Configure the given @raft_io instance like raft_uv_init() does, as the server
+ * of the raft group with ID @group running on the given host.
+ *
+ * Return #RAFT_DUPLICATEID if the host already has a @raft_io instance for
+ * that group.
+ *
+ * Release the instance with raft_uv_close().
+ */
+RAFT_API int raft_uv_init_group(struct raft_io *io,
+                                struct raft_uv_host *h,
+                                const char *dir,
+                                uint32_t group);
+
+/**
+ * Thread-safe entry point for submitting entries to a @raft instance driven by
+ * a libuv loop.
+ *
+ * Any thread can submit requests. They get pushed onto a lock-free queue and
+ * the loop thread is woken up with a @uv_async_t handle. Upon each wakeup the
+ * loop thread drains the queue and appends all the entries it found with a
+ * single #RAFT_SUBMIT event, so submissions from several threads get batched
+ * together.
+ *
+ * Completion callbacks are invoked on the loop thread, unless a
+ * #raft_uv_completion object is passed along with the request, in which case
+ * they are invoked by the thread that runs it, see raft_uv_completion_run().
+ */
+struct raft_uv_queue
+{
+    /**
+     * User defined data.
+     */
+    void *data;
+
+    /**
+     * Implementation-defined state.
+     */
+    void *impl;
+
+    /**
+     * Human-readable message providing diagnostic information about the last
+     * error occurred.
+     */
+    char errmsg[RAFT_ERRMSG_BUF_SIZE];
+};
+
+/**
+ * Queue of completed requests whose callbacks are invoked by the thread running
+ * raft_uv_completion_run(), typically the one that submitted them.
+ */
+struct raft_uv_completion
+{
+    /**
+     * User defined data.
+     */
+    void *data;
+
+    /**
+     * Implementation-defined state.
+     */
+    void *impl;
+};
+
+struct raft_uv_submit;
+
+/**
+ * Callback invoked once a submitted entry has been applied, or has failed. The
+ * @result argument is the one set by the FSM for #RAFT_COMMAND entries, and
+ * NULL for barriers.
+ */
+typedef void (*raft_uv_submit_cb)(struct raft_uv_submit *req,
+                                  int status,
+                                  void *result);
+
+/**
+ * Request submitted to a #raft_uv_queue.
+ */
+struct raft_uv_submit
+{
+    /**
+     * User defined data.
+     */
+    void *data;
+
+    /* Private fields, set by raft_uv_queue_apply() and friends. */
+    union {
+        struct raft_apply apply;
+        struct raft_barrier barrier;
+    } req;
+    struct raft_buffer buf;
+    raft_uv_submit_cb cb;
+    struct raft_uv_completion *completion;
+    struct raft_uv_queue *queue;
+    struct raft_uv_submit *next;
+    int status;
+    void *result;
+};
+
+/**
+ * Callback invoked once a queue has been closed and its memory released.
+ */
+typedef void (*raft_uv_queue_close_cb)(struct raft_uv_queue *q);
+
+/**
+ * Init a submission queue for the given raft instance, running on @loop. Must
+ * be called from the loop thread.
+ */
+RAFT_API int raft_uv_queue_init(struct raft_uv_queue *q,
+                                struct uv_loop_s *loop,
+                                struct raft *r);
+
+/**
+ * Close the queue. Must be called from the loop thread, once no other thread
+ * submits requests anymore and the raft instance has been closed. Requests
+ * still in the queue fail with #RAFT_CANCELED.
+ *
+ * The queue memory is released asynchronously, so the application must make
+ * sure that all submitting threads have returned from their last
+ * raft_uv_queue_apply() or raft_uv_queue_barrier() call before invoking this
+ * function, for example by joining them: no submission may race with it or
+ * follow it.
+ */
+RAFT_API void raft_uv_queue_close(struct raft_uv_queue *q,
+                                  raft_uv_queue_close_cb cb);
+
+/**
+ * Submit a #RAFT_COMMAND entry with the given payload. Can be called from any
+ * thread, until raft_uv_queue_close() is invoked.
+ *
+ * The buffer is owned by raft as soon as this function returns: if the entry
+ * can't be appended, because this server is not the leader or for any other
+ * reason, the buffer is released and @cb invoked with the error code.
+ *
+ * If @completion is not NULL, @cb is invoked by the thread that runs it.
+ */
+RAFT_API void raft_uv_queue_apply(struct raft_uv_queue *q,
+                                  struct raft_uv_submit *req,
+                                  const struct raft_buffer *buf,
+                                  struct raft_uv_completion *completion,
+                                  raft_uv_submit_cb cb);
+
+/**
+ * Submit a #RAFT_BARRIER entry, like raft_uv_queue_apply(). Its payload is
+ * allocated by the loop thread, so an out-of-memory error is reported to @cb
+ * like any other failure.
+ */
+RAFT_API void raft_uv_queue_barrier(struct raft_uv_queue *q,
+                                    struct raft_uv_submit *req,
+                                    struct raft_uv_completion *completion,
+                                    raft_uv_submit_cb cb);
+
+/**
+ * Init a completion queue. It can be used with any number of submission
+ * queues, but only one thread at a time should run it.
+ */
+RAFT_API int raft_uv_completion_init(struct raft_uv_completion *c);
+
+/**
+ * Release the memory used by a completion queue. No request using it must be
+ * in flight.
+ */
+RAFT_API void raft_uv_completion_close(struct raft_uv_completion *c);
+
+/**
+ * Invoke the callbacks of all requests completed so far, in completion order,
+ * and return their number. If @wait is true and no request is completed yet,
+ * block until at least one is.
+ */
+RAFT_API unsigned raft_uv_completion_run(struct raft_uv_completion *c,
+                                         bool wait);
+
 #endif /* RAFT_UV_H */
@@ -244,6 +244,10 @@ int ClientTransfer(struct raft *r, raft_id server_id)
     r->leader_state.transferee = server_id;
     r->leader_state.transfer_start = r->now;
 
+    /* The transfer might not involve any AppendEntries request, make sure that
+     * we'll notice if it expires. */
+    replicationUnquiesce(r);
+
     if (progressMatchIndex(r, i) == TrailLastIndex(&r->trail)) {
         rv = membershipLeadershipTransferStart(r);
         if (rv != 0) {
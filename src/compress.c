@@ -13,12 +13,117 @@
 #define min(a, b) ((a) < (b) ? (a) : (b))
 #define max(a, b) ((a) > (b) ? (a) : (b))
 
-int Decompress(struct raft_buffer buf,
-               struct raft_buffer *decompressed,
-               char *errmsg)
+#if defined(LZ4_AVAILABLE) && !defined(LZ4F_HEADER_SIZE_MAX)
+#define LZ4F_HEADER_SIZE_MAX 19
+#endif
+
+int Compress(const struct raft_buffer bufs[],
+             unsigned n_bufs,
+             struct raft_buffer *compressed,
+             char *errmsg)
+{
+#ifndef LZ4_AVAILABLE
+    (void)bufs;
+    (void)n_bufs;
+    (void)compressed;
+    ErrMsgPrintf(errmsg, "LZ4 not available");
+    return RAFT_INVALID;
+#else
+    assert(bufs != NULL);
+    assert(n_bufs > 0);
+    assert(compressed != NULL);
+
+    int rv = RAFT_IOERR;
+    size_t src_size = 0;
+    size_t dst_size = 0;
+    size_t offset = 0;
+    size_t ret = 0;
+    unsigned i;
+
+    for (i = 0; i < n_bufs; i++) {
+        src_size += bufs[i].len;
+    }
+
+    /* Record the content size, so the receiver can allocate the
+     * decompression buffer upfront. */
+    LZ4F_preferences_t lz4_pref;
+    memset(&lz4_pref, 0, sizeof(lz4_pref));
+    lz4_pref.frameInfo.contentSize = (unsigned long long)src_size;
+    lz4_pref.frameInfo.blockSizeID = LZ4F_max4MB;
+
+    /* Upper bound of the frame size, including header and footer. */
+    dst_size = LZ4F_compressBound(src_size, &lz4_pref) + LZ4F_HEADER_SIZE_MAX;
+    compressed->base = raft_malloc(dst_size);
+    compressed->len = 0;
+    if (compressed->base == NULL) {
+        rv = RAFT_NOMEM;
+        goto err;
+    }
+
+    LZ4F_compressionContext_t ctx;
+    ret = LZ4F_createCompressionContext(&ctx, LZ4F_VERSION);
+    if (LZ4F_isError(ret)) {
+        ErrMsgPrintf(errmsg, "LZ4F_createCompressionContext %s",
+                     LZ4F_getErrorName(ret));
+        rv = RAFT_NOMEM;
+        goto err_after_buff_alloc;
+    }
+
+    ret = LZ4F_compressBegin(ctx, compressed->base, dst_size, &lz4_pref);
+    if (LZ4F_isError(ret)) {
+        ErrMsgPrintf(errmsg, "LZ4F_compressBegin %s", LZ4F_getErrorName(ret));
+        goto err_after_ctx_alloc;
+    }
+    offset += ret;
+
+    for (i = 0; i < n_bufs; i++) {
+        if (bufs[i].len == 0) {
+            continue;
+        }
+        ret = LZ4F_compressUpdate(ctx, (char *)compressed->base + offset,
+                                  dst_size - offset, bufs[i].base, bufs[i].len,
+                                  NULL);
+        if (LZ4F_isError(ret)) {
+            ErrMsgPrintf(errmsg, "LZ4F_compressUpdate %s",
+                         LZ4F_getErrorName(ret));
+            goto err_after_ctx_alloc;
+        }
+        offset += ret;
+    }
+
+    ret = LZ4F_compressEnd(ctx, (char *)compressed->base + offset,
+                           dst_size - offset, NULL);
+    if (LZ4F_isError(ret)) {
+        ErrMsgPrintf(errmsg, "LZ4F_compressEnd %s", LZ4F_getErrorName(ret));
+        goto err_after_ctx_alloc;
+    }
+    offset += ret;
+
+    LZ4F_freeCompressionContext(ctx);
+    compressed->len = offset;
+    return 0;
+
+err_after_ctx_alloc:
+    LZ4F_freeCompressionContext(ctx);
+err_after_buff_alloc:
+    raft_free(compressed->base);
+    compressed->base = NULL;
+err:
+    return rv;
+#endif /* LZ4_AVAILABLE */
+}
+
+/* Decompress the frame in `buf`. If `expected` is not NULL, the frame must
+ * declare a content size matching it, which is checked before allocating the
+ * output buffer. */
+static int decompressFrame(struct raft_buffer buf,
+                           const size_t *expected,
+                           struct raft_buffer *decompressed,
+                           char *errmsg)
 {
 #ifndef LZ4_AVAILABLE
     (void)buf;
+    (void)expected;
     (void)decompressed;
     ErrMsgPrintf(errmsg, "LZ4 not available");
     return RAFT_INVALID;
@@ -51,6 +156,14 @@ int Decompress(struct raft_buffer buf,
     }
     src_offset = src_size;
 
+    if (expected != NULL && (frameInfo.contentSize == 0 ||
+                             frameInfo.contentSize != *expected)) {
+        ErrMsgPrintf(errmsg, "LZ4 frame content size is %llu, expected %zu",
+                     (unsigned long long)frameInfo.contentSize, *expected);
+        rv = RAFT_MALFORMED;
+        goto err_after_ctx_alloc;
+    }
+
     decompressed->base = raft_malloc((size_t)frameInfo.contentSize);
     decompressed->len = (size_t)frameInfo.contentSize;
     if (decompressed->base == NULL) {
@@ -77,6 +190,12 @@ int Decompress(struct raft_buffer buf,
             rv = RAFT_IOERR;
             goto err_after_buff_alloc;
         }
+        /* A truncated frame leaves nothing to consume nor to produce. */
+        if (ret != 0 && src_size == 0 && dst_size == 0) {
+            ErrMsgPrintf(errmsg, "LZ4 frame is truncated");
+            rv = RAFT_IOERR;
+            goto err_after_buff_alloc;
+        }
         src_offset += src_size;
         dst_offset += dst_size;
     }
@@ -99,6 +218,21 @@ err:
 #endif /* LZ4_AVAILABLE */
 }
 
+int Decompress(struct raft_buffer buf,
+               struct raft_buffer *decompressed,
+               char *errmsg)
+{
+    return decompressFrame(buf, NULL, decompressed, errmsg);
+}
+
+int DecompressExact(struct raft_buffer buf,
+                    size_t len,
+                    struct raft_buffer *decompressed,
+                    char *errmsg)
+{
+    return decompressFrame(buf, &len, decompressed, errmsg);
+}
+
 bool IsCompressed(const void *data, size_t sz)
 {
     if (data == NULL || sz < 4) {
@@ -3,6 +3,17 @@
 
 #include "../include/raft.h"
 
+/*
+ * Compresses the content of `bufs` into a single LZ4 frame, stored in a newly
+ * allocated buffer that is returned to the caller through `compressed`. The
+ * size of the uncompressed content is recorded in the frame header. Returns a
+ * non-0 value upon failure.
+ */
+int Compress(const struct raft_buffer bufs[],
+             unsigned n_bufs,
+             struct raft_buffer *compressed,
+             char *errmsg);
+
 /*
  * Decompresses the content of `buf` into a newly allocated buffer that is
  * returned to the caller through `decompressed`. Returns a non-0 value upon
@@ -12,6 +23,16 @@ int Decompress(struct raft_buffer buf,
                struct raft_buffer *decompressed,
                char *errmsg);
 
+/*
+ * Like Decompress(), but the frame header must record a content size of
+ * exactly `len` bytes, otherwise RAFT_MALFORMED is returned before allocating
+ * anything. Use it for frames received from untrusted sources.
+ */
+int DecompressExact(struct raft_buffer buf,
+                    size_t len,
+                    struct raft_buffer *decompressed,
+                    char *errmsg);
+
 /* Returns `true` if `data` is compressed, `false` otherwise. */
 bool IsCompressed(const void *data, size_t sz);
 
@@ -96,6 +96,9 @@ void convertToFollower(struct raft *r)
      * contain indexes that were never checked against the log matching
      * property. */
     r->follower_state.match = 0;
+    r->follower_state.result_sent = false;
+    r->follower_state.result_pending = false;
+    r->follower_state.quiescent = false;
 }
 
 int convertToCandidate(struct raft *r, const bool disrupt_leader)
@@ -194,6 +197,7 @@ int convertToLeader(struct raft *r)
     /* Reset leadership transfer. */
     r->leader_state.transferee = 0;
     r->leader_state.transferring = false;
+    r->leader_state.quiescent = false;
 
     /* If there is only one voter, by definition all entries until the
      * last_stored can be considered committed (and the voter must be us, since
@@ -152,7 +152,7 @@ void electionStart(struct raft *r)
     for (i = 0; i < n_voters; i++) {
         if (i == voting_index) {
             r->candidate_state.votes[i].grant = true; /* Vote for self */
-            r->candidate_state.votes[i].features = MESSAGE__FEATURE_CAPACITY;
+            r->candidate_state.votes[i].features = MessageFeatures(r);
             r->candidate_state.votes[i].capacity = r->capacity;
         } else {
             r->candidate_state.votes[i].grant = false;
@@ -26,12 +26,15 @@
 #define DISK_LATENCY 10
 #define WORK_DURATION 200
 
+/* Size of the fixed part of every message, used for bandwidth accounting. */
+#define MESSAGE_HEADER_SIZE 64
+
 /* To keep in sync with raft.h */
 #define N_MESSAGE_TYPES 6
 
 /* Maximum number of peer stub instances connected to a certain stub
- * instance. This should be enough for testing purposes. */
-#define MAX_PEERS 8
+ * instance. Each stub is also connected to itself. */
+#define MAX_PEERS RAFT_FIXTURE_MAX_SERVERS
 
 struct raft_fixture_server
 {
@@ -69,7 +72,15 @@ RAFT_API unsigned raft_fixture_event_server_index(
     queue queue                /* Link the I/O pending requests queue. */
 
 /* Request type codes. */
-enum { APPEND = 1, SEND, TRANSMIT, SNAPSHOT_PUT, SNAPSHOT_GET, ASYNC_WORK };
+enum {
+    APPEND = 1,
+    SEND,
+    TRANSMIT,
+    SNAPSHOT_PUT,
+    SNAPSHOT_GET,
+    ASYNC_WORK,
+    READ
+};
 
 /* Abstract base type for an asynchronous request submitted to the stub I/o
  * implementation. */
@@ -112,6 +123,15 @@ struct snapshot_get
     struct raft_io_snapshot_get *req;
 };
 
+/* Pending request to read persisted entries. */
+struct read
+{
+    REQUEST;
+    struct raft_io_read *req;
+    raft_index index;
+    unsigned n;
+};
+
 /* Message that has been written to the network and is waiting to be delivered
  * (or discarded). */
 struct transmit
@@ -121,12 +141,122 @@ struct transmit
     int timer;                   /* Deliver after this n of msecs. */
 };
 
-/* Information about a peer server. */
+/* Entry of the fixture schedule. */
+struct scheduled
+{
+    raft_time time;            /* Completion time of the request. */
+    unsigned index;            /* Index of the server owning the request. */
+    unsigned long long seq;    /* Submission order, to break ties. */
+    struct ioRequest *request; /* The pending request. */
+};
+
+/* Binary min-heap holding the pending requests of all servers. Requests are
+ * ordered by completion time, then by server index, then by submission
+ * order, which is the order in which scanning each server's queue in turn
+ * would pick them. */
+struct raft_fixture_schedule
+{
+    struct scheduled *items; /* Heap array. */
+    size_t n;                /* Number of pending requests. */
+    size_t size;             /* Capacity of the heap array. */
+    unsigned long long seq;  /* Submission counter. */
+};
+
+/* Return true if @a should complete before @b. */
+static bool scheduledBefore(const struct scheduled *a,
+                            const struct scheduled *b)
+{
+    if (a->time != b->time) {
+        return a->time < b->time;
+    }
+    if (a->index != b->index) {
+        return a->index < b->index;
+    }
+    return a->seq < b->seq;
+}
+
+static void scheduleSwap(struct raft_fixture_schedule *s, size_t i, size_t j)
+{
+    struct scheduled tmp = s->items[i];
+    s->items[i] = s->items[j];
+    s->items[j] = tmp;
+}
+
+/* Add a request submitted by the @index'th server to the schedule. */
+static void schedulePush(struct raft_fixture_schedule *s,
+                         unsigned index,
+                         struct ioRequest *request)
+{
+    size_t i;
+
+    if (s->n == s->size) {
+        size_t size = s->size == 0 ? 64 : s->size * 2;
+        struct scheduled *items;
+        items = raft_realloc(s->items, size * sizeof *items);
+        assert(items != NULL);
+        s->items = items;
+        s->size = size;
+    }
+
+    i = s->n;
+    s->items[i].time = request->completion_time;
+    s->items[i].index = index;
+    s->items[i].seq = s->seq++;
+    s->items[i].request = request;
+    s->n++;
+
+    while (i > 0 && scheduledBefore(&s->items[i], &s->items[(i - 1) / 2])) {
+        scheduleSwap(s, i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+}
+
+/* Return the request that completes first, or NULL if there is none. */
+static const struct scheduled *scheduleTop(struct raft_fixture_schedule *s)
+{
+    return s->n > 0 ? &s->items[0] : NULL;
+}
+
+/* Remove the request that completes first. */
+static void schedulePop(struct raft_fixture_schedule *s)
+{
+    size_t i = 0;
+
+    assert(s->n > 0);
+    s->n--;
+    s->items[0] = s->items[s->n];
+
+    while (1) {
+        size_t left = 2 * i + 1;
+        size_t right = left + 1;
+        size_t min = i;
+        if (left < s->n && scheduledBefore(&s->items[left], &s->items[min])) {
+            min = left;
+        }
+        if (right < s->n &&
+            scheduledBefore(&s->items[right], &s->items[min])) {
+            min = right;
+        }
+        if (min == i) {
+            break;
+        }
+        scheduleSwap(s, i, min);
+        i = min;
+    }
+}
+
+/* Information about a peer server, and about the link used to send messages
+ * to it. */
 struct peer
 {
-    struct io *io;  /* The peer's I/O backend. */
-    bool connected; /* Whether a connection is established. */
-    bool saturated; /* Whether the established connection is saturated. */
+    struct io *io;           /* The peer's I/O backend. */
+    bool connected;          /* Whether a connection is established. */
+    bool saturated;          /* Whether the connection is saturated. */
+    unsigned bandwidth;      /* Bytes per millisecond, 0 for unlimited. */
+    unsigned jitter;         /* Maximum random delay added to the latency. */
+    unsigned loss;           /* Percentage of messages silently dropped. */
+    raft_time busy_until;    /* When all queued messages are sent. */
+    raft_time last_delivery; /* Delivery time of the last message sent. */
 };
 
 /* Stub I/O implementation implementing all operations in-memory. */
@@ -137,6 +267,9 @@ struct io
     raft_time *time;     /* Global cluster time. */
     raft_time next_tick; /* Time the next tick should occurs. */
 
+    /* Fixture-wide schedule of pending requests. */
+    struct raft_fixture_schedule *schedule;
+
     /* Term and vote */
     raft_term term;
     raft_id voted_for;
@@ -179,6 +312,7 @@ struct io
     unsigned seed;
 
     unsigned network_latency; /* Milliseconds to deliver RPCs */
+    unsigned random;          /* State for the network jitter and loss. */
     unsigned disk_latency;    /* Milliseconds to perform disk I/O */
     unsigned work_duration;   /* Milliseconds to run async work */
 
@@ -197,6 +331,13 @@ struct io
     unsigned n_append;
 };
 
+/* Queue a new pending request, to be completed at its completion time. */
+static void ioEnqueue(struct io *io, struct ioRequest *r)
+{
+    QUEUE_PUSH(&io->requests, &r->queue);
+    schedulePush(io->schedule, io->index, r);
+}
+
 /* Advance the fault counters and return @true if an error should occur. */
 static bool ioFaultTick(struct io *io)
 {
@@ -336,6 +477,38 @@ static void ioFlushSnapshotGet(struct io *s, struct snapshot_get *r)
     raft_free(r);
 }
 
+/* Flush a read request, returning to the client a copy of the persisted
+ * entries starting at the requested index. */
+static void ioFlushRead(struct io *s, struct read *r)
+{
+    struct raft_entry *entries = NULL;
+    raft_index first_index = s->start_index + 1;
+    size_t n = 0;
+    int status = 0;
+    int rv;
+
+    if (ioFaultTick(s)) {
+        status = RAFT_IOERR;
+        goto done;
+    }
+
+    if (r->index < first_index || r->index >= first_index + s->n) {
+        status = RAFT_NOTFOUND;
+        goto done;
+    }
+
+    n = (size_t)(first_index + s->n - r->index);
+    if (n > r->n) {
+        n = r->n;
+    }
+    rv = entryBatchCopy(&s->entries[r->index - first_index], &entries, n);
+    assert(rv == 0);
+
+done:
+    r->req->cb(r->req, entries, (unsigned)n, status);
+    raft_free(r);
+}
+
 /* Search for the peer with the given ID. */
 static struct peer *ioGetPeer(struct io *io, raft_id id)
 {
@@ -371,6 +544,69 @@ static void copyInstallSnapshot(const struct raft_install_snapshot *src,
     memcpy(dst->data.base, src->data.base, src->data.len);
 }
 
+/* Approximate size of the given message on the wire. */
+static size_t messageSize(const struct raft_message *message)
+{
+    size_t size = MESSAGE_HEADER_SIZE;
+    unsigned i;
+
+    switch (message->type) {
+        case RAFT_APPEND_ENTRIES:
+            for (i = 0; i < message->append_entries.n_entries; i++) {
+                const struct raft_entry *entry =
+                    &message->append_entries.entries[i];
+                size += sizeof(uint64_t) * 2 /* Entry header */ +
+                        entry->buf.len;
+            }
+            break;
+        case RAFT_INSTALL_SNAPSHOT:
+            size += configurationEncodedSize(&message->install_snapshot.conf);
+            size += message->install_snapshot.data.len;
+            break;
+        default:
+            break;
+    }
+
+    return size;
+}
+
+/* Return the time at which a message sent now through the link to the given
+ * peer should be delivered.
+ *
+ * If the link has a limited bandwidth, the message is queued behind the ones
+ * that are still being sent, and takes a time proportional to its size to be
+ * sent itself. The network latency starts to elapse after that. Random jitter
+ * is added on top, without reordering the messages sent through the link. */
+static raft_time ioDeliveryTime(struct io *io,
+                                struct peer *peer,
+                                const struct raft_message *message)
+{
+    raft_time sent = *io->time;
+    raft_time time;
+
+    if (peer->bandwidth > 0) {
+        size_t size = messageSize(message);
+        if (peer->busy_until > sent) {
+            sent = peer->busy_until;
+        }
+        sent += (size + peer->bandwidth - 1) / peer->bandwidth;
+        peer->busy_until = sent;
+    }
+
+    time = sent + io->network_latency;
+
+    if (peer->jitter > 0) {
+        time += RandomWithinRange(&io->random, 0, peer->jitter);
+        if (time < peer->last_delivery) {
+            time = peer->last_delivery;
+        }
+    }
+
+    peer->last_delivery = time;
+
+    return time;
+}
+
 /* Flush a raft_io_send request, copying the message content into a new struct
  * transmit object and invoking the user callback. */
 static void ioFlushSend(struct io *io, struct send *send)
@@ -392,12 +628,12 @@ static void ioFlushSend(struct io *io, struct send *send)
     assert(transmit != NULL);
 
     transmit->type = TRANSMIT;
-    transmit->completion_time = *io->time + io->network_latency;
+    transmit->completion_time = ioDeliveryTime(io, peer, &send->message);
 
     src = &send->message;
     dst = &transmit->message;
 
-    QUEUE_PUSH(&io->requests, &transmit->queue);
+    ioEnqueue(io, (struct ioRequest *)transmit);
 
     *dst = *src;
     switch (dst->type) {
@@ -473,6 +709,9 @@ static void ioFlushAll(struct io *io)
             case SNAPSHOT_GET:
                 ioFlushSnapshotGet(io, (struct snapshot_get *)r);
                 break;
+            case READ:
+                ioFlushRead(io, (struct read *)r);
+                break;
             default:
                 assert(0);
         }
@@ -633,7 +872,7 @@ static int ioMethodAppend(struct raft_io *raft_io,
 
     req->cb = cb;
 
-    QUEUE_PUSH(&io->requests, &r->queue);
+    ioEnqueue(io, (struct ioRequest *)r);
 
     return 0;
 }
@@ -710,7 +949,7 @@ static int ioMethodSnapshotPut(struct raft_io *raft_io,
     r->completion_time = *io->time + io->disk_latency;
     r->trailing = trailing;
 
-    QUEUE_PUSH(&io->requests, &r->queue);
+    ioEnqueue(io, (struct ioRequest *)r);
 
     return 0;
 }
@@ -730,7 +969,31 @@ static int ioMethodSnapshotGet(struct raft_io *raft_io,
     r->req->cb = cb;
     r->completion_time = *io->time + io->disk_latency;
 
-    QUEUE_PUSH(&io->requests, &r->queue);
+    ioEnqueue(io, (struct ioRequest *)r);
+
+    return 0;
+}
+
+static int ioMethodRead(struct raft_io *raft_io,
+                        struct raft_io_read *req,
+                        raft_index index,
+                        unsigned n,
+                        raft_io_read_cb cb)
+{
+    struct io *io = raft_io->impl;
+    struct read *r;
+
+    r = raft_malloc(sizeof *r);
+    assert(r != NULL);
+
+    r->type = READ;
+    r->req = req;
+    r->req->cb = cb;
+    r->index = index;
+    r->n = n;
+    r->completion_time = *io->time + io->disk_latency;
+
+    ioEnqueue(io, (struct ioRequest *)r);
 
     return 0;
 }
@@ -782,7 +1045,7 @@ static int ioMethodSend(struct raft_io *raft_io,
      * might delay the completion of send requests */
     r->completion_time = *io->time;
 
-    QUEUE_PUSH(&io->requests, &r->queue);
+    ioEnqueue(io, (struct ioRequest *)r);
 
     return 0;
 }
@@ -815,6 +1078,13 @@ static void ioDeliverTransmit(struct io *io, struct transmit *transmit)
         return;
     }
 
+    /* Simulate packet loss on the link. */
+    if (peer->loss > 0 &&
+        RandomWithinRange(&io->random, 1, 100) <= peer->loss) {
+        ioDestroyTransmit(transmit);
+        return;
+    }
+
     /* Update the message object with our details. */
     message->server_id = io->id;
     message->server_address = io->address;
@@ -834,6 +1104,11 @@ static void ioConnect(struct raft_io *raft_io, struct raft_io *other)
     io->peers[io->n_peers].io = io_other;
     io->peers[io->n_peers].connected = true;
     io->peers[io->n_peers].saturated = false;
+    io->peers[io->n_peers].bandwidth = 0;
+    io->peers[io->n_peers].jitter = 0;
+    io->peers[io->n_peers].loss = 0;
+    io->peers[io->n_peers].busy_until = 0;
+    io->peers[io->n_peers].last_delivery = 0;
     io->n_peers++;
 }
 
@@ -902,7 +1177,10 @@ void ioDrop(struct io *io, int type, bool flag)
     io->drop[type - 1] = flag;
 }
 
-static int ioInit(struct raft_io *raft_io, unsigned index, raft_time *time)
+static int ioInit(struct raft_io *raft_io,
+                  unsigned index,
+                  raft_time *time,
+                  struct raft_fixture_schedule *schedule)
 {
     struct io *io;
     io = raft_malloc(sizeof *io);
@@ -910,6 +1188,7 @@ static int ioInit(struct raft_io *raft_io, unsigned index, raft_time *time)
     io->io = raft_io;
     io->index = index;
     io->time = time;
+    io->schedule = schedule;
     io->term = 0;
     io->voted_for = 0;
     io->snapshot = NULL;
@@ -918,9 +1197,13 @@ static int ioInit(struct raft_io *raft_io, unsigned index, raft_time *time)
     io->start_index = 0;
     QUEUE_INIT(&io->requests);
     io->n_peers = 0;
-    io->randomized_election_timeout = ELECTION_TIMEOUT + index * 100;
+    /* Space the first ten servers 100 milliseconds apart, and interleave the
+     * following ones so that the value stays within the allowed range. */
+    io->randomized_election_timeout =
+        ELECTION_TIMEOUT + (index % 10) * 100 + (index / 10) * 10;
     io->randomized_election_timeout_prev = 0;
     io->network_latency = NETWORK_LATENCY;
+    io->random = index;
     io->disk_latency = DISK_LATENCY;
     io->work_duration = WORK_DURATION;
     io->fault.countdown = -1;
@@ -931,7 +1214,7 @@ static int ioInit(struct raft_io *raft_io, unsigned index, raft_time *time)
     io->n_append = 0;
 
     raft_io->impl = io;
-    raft_io->version = 2;
+    raft_io->version = 3;
     raft_io->capacity = 4096;
     raft_io->init = ioMethodInit;
     raft_io->close = ioMethodClose;
@@ -946,6 +1229,7 @@ static int ioInit(struct raft_io *raft_io, unsigned index, raft_time *time)
     raft_io->send = ioMethodSend;
     raft_io->snapshot_put = ioMethodSnapshotPut;
     raft_io->snapshot_get = ioMethodSnapshotGet;
+    raft_io->read = ioMethodRead;
     raft_io->time = ioMethodTime;
     raft_io->random = ioMethodRandom;
 
@@ -1001,7 +1285,7 @@ static int serverInit(struct raft_fixture *f, unsigned i, struct raft_fsm *fsm)
     s->alive = true;
     s->id = i + 1;
     sprintf(s->address, "%llu", s->id);
-    rv = ioInit(&s->io, i, &f->time);
+    rv = ioInit(&s->io, i, &f->time, f->schedule);
     if (rv != 0) {
         return rv;
     }
@@ -1082,6 +1366,10 @@ int raft_fixture_init(struct raft_fixture *f)
     if (f->event == NULL) {
         return RAFT_NOMEM;
     }
+    f->schedule = raft_calloc(1, sizeof *f->schedule);
+    if (f->schedule == NULL) {
+        return RAFT_NOMEM;
+    }
     return 0;
 }
 
@@ -1100,6 +1388,8 @@ void raft_fixture_close(struct raft_fixture *f)
     for (i = 0; i < f->n; i++) {
         serverClose(f->servers[i]);
     }
+    raft_free(f->schedule->items);
+    raft_free(f->schedule);
     raft_free(f->event);
     logClose(f->log);
 }
@@ -1320,15 +1610,21 @@ static bool updateLeaderAndCheckElectionSafety(struct raft_fixture *f)
  *
  *   Leader Append-Only -> A leader never overwrites or deletes entries in its
  *   own log; it only appends new entries.
+ *
+ * The copy of the leader log is kept in sync at every step, so it's enough to
+ * check its last entry: overwriting or deleting any entry would also delete
+ * that one.
  */
 static void checkLeaderAppendOnly(struct raft_fixture *f)
 {
     struct raft *raft;
-    raft_index index;
+    const struct raft_entry *entry1;
+    const struct raft_entry *entry2;
     raft_index last = logLastIndex(f->log);
+    size_t i;
 
     /* If the cached log is empty it means there was no leader before. */
-    if (last == 0) {
+    if (logNumEntries(f->log) == 0) {
         return;
     }
 
@@ -1338,55 +1634,72 @@ static void checkLeaderAppendOnly(struct raft_fixture *f)
     }
 
     raft = raft_fixture_get(f, (unsigned)f->leader_id - 1);
-    last = logLastIndex(f->log);
 
-    for (index = 1; index <= last; index++) {
-        const struct raft_entry *entry1;
-        const struct raft_entry *entry2;
-        size_t i;
+    entry1 = logGet(f->log, last);
+    entry2 = logGet(raft->legacy.log, last);
 
-        entry1 = logGet(f->log, index);
-        entry2 = logGet(raft->legacy.log, index);
+    assert(entry1 != NULL);
 
-        assert(entry1 != NULL);
-
-        /* Check if the entry was snapshotted. */
-        if (entry2 == NULL) {
-            assert(raft->legacy.log->snapshot.last_index >= index);
-            continue;
-        }
+    /* Check if the entry was snapshotted. */
+    if (entry2 == NULL) {
+        assert(raft->legacy.log->snapshot.last_index >= last);
+        return;
+    }
 
-        /* Entry was not overwritten. */
-        assert(entry1->type == entry2->type);
-        assert(entry1->term == entry2->term);
-        for (i = 0; i < entry1->buf.len; i++) {
-            assert(((uint8_t *)entry1->buf.base)[i] ==
-                   ((uint8_t *)entry2->buf.base)[i]);
-        }
+    /* Entry was not overwritten. */
+    assert(entry1->type == entry2->type);
+    assert(entry1->term == entry2->term);
+    for (i = 0; i < entry1->buf.len; i++) {
+        assert(((uint8_t *)entry1->buf.base)[i] ==
+               ((uint8_t *)entry2->buf.base)[i]);
     }
 }
 
-/* Make a copy of the the current leader log, in order to perform the Leader
- * Append-Only check at the next iteration. */
+/* Discard the copy of the leader log, for example because the leader changed.
+ */
+static void resetLeaderLog(struct raft_fixture *f)
+{
+    logClose(f->log);
+    f->log = logInit();
+    assert(f->log != NULL);
+}
+
+/* Update the copy of the current leader log, in order to perform the Leader
+ * Append-Only check at the next iteration. Only entries appended since the
+ * last update are copied, and entries that the leader has compacted away are
+ * dropped from the copy too. */
 static void copyLeaderLog(struct raft_fixture *f)
 {
     struct raft *raft = raft_fixture_get(f, (unsigned)f->leader_id - 1);
-    struct raft_entry *entries;
-    unsigned n;
-    size_t i;
+    struct raft_log *log = raft->legacy.log;
+    raft_index first = logLastIndex(log) - logNumEntries(log) + 1;
+    raft_index last = logLastIndex(log);
+    raft_index index;
     int rv;
-    logClose(f->log);
-    f->log = logInit();
-    if (f->log == NULL) {
-        assert(false);
+
+    if (logNumEntries(log) == 0) {
         return;
     }
 
-    rv = logAcquire(raft->legacy.log, 1, &entries, &n);
-    assert(rv == 0);
-    for (i = 0; i < n; i++) {
-        struct raft_entry *entry = &entries[i];
+    /* If the leader compacted entries that were never copied, start over. */
+    if (logNumEntries(f->log) > 0 && first > logLastIndex(f->log) + 1) {
+        resetLeaderLog(f);
+    }
+
+    if (logNumEntries(f->log) == 0) {
+        /* Align the first index of the copy with the leader's one. The
+         * snapshot information of the copy is not used. */
+        if (first > 1) {
+            logRestore(f->log, first - 1, logSnapshotTerm(log));
+        }
+    } else if (first > logLastIndex(f->log) - logNumEntries(f->log) + 1) {
+        logSnapshot(f->log, first - 1, 0);
+    }
+
+    for (index = logLastIndex(f->log) + 1; index <= last; index++) {
+        const struct raft_entry *entry = logGet(log, index);
         struct raft_buffer buf;
+        assert(entry != NULL);
         buf.len = entry->buf.len;
         buf.base = raft_malloc(buf.len);
         assert(buf.base != NULL);
@@ -1394,7 +1707,6 @@ static void copyLeaderLog(struct raft_fixture *f)
         rv = logAppend(f->log, entry->term, entry->type, &buf, NULL);
         assert(rv == 0);
     }
-    logRelease(raft->legacy.log, 1, entries, n);
 }
 
 /* Update the commit index to match the one from the current leader. */
@@ -1427,18 +1739,11 @@ static void getLowestRequestCompletionTime(struct raft_fixture *f,
                                            raft_time *t,
                                            unsigned *i)
 {
-    unsigned j;
+    const struct scheduled *next = scheduleTop(f->schedule);
     *t = (raft_time)-1 /* Maximum value */;
-    for (j = 0; j < f->n; j++) {
-        struct io *io = f->servers[j]->io.impl;
-        queue *head;
-        QUEUE_FOREACH (head, &io->requests) {
-            struct ioRequest *r = QUEUE_DATA(head, struct ioRequest, queue);
-            if (r->completion_time < *t) {
-                *t = r->completion_time;
-                *i = j;
-            }
-        }
+    if (next != NULL) {
+        *t = next->time;
+        *i = next->index;
     }
 }
 
@@ -1455,24 +1760,21 @@ static void fireTick(struct raft_fixture *f, unsigned i)
     }
 }
 
-/* Complete the first request with completion time @t on the @i'th server. */
+/* Complete the first request with completion time @t on the @i'th server,
+ * which is the one at the top of the schedule. */
 static void completeRequest(struct raft_fixture *f, unsigned i, raft_time t)
 {
     struct io *io = f->servers[i]->io.impl;
-    queue *head;
-    struct ioRequest *r = NULL;
-    bool found = false;
+    const struct scheduled *next = scheduleTop(f->schedule);
+    struct ioRequest *r;
+    assert(next != NULL);
+    assert(next->index == i);
+    assert(next->time == t);
+    r = next->request;
+    schedulePop(f->schedule);
     f->time = t;
     f->event->server_index = i;
-    QUEUE_FOREACH (head, &io->requests) {
-        r = QUEUE_DATA(head, struct ioRequest, queue);
-        if (r->completion_time == t) {
-            found = true;
-            break;
-        }
-    }
-    assert(found);
-    QUEUE_REMOVE(head);
+    QUEUE_REMOVE(&r->queue);
     switch (r->type) {
         case APPEND:
             ioFlushAppend(io, (struct append *)r);
@@ -1494,6 +1796,10 @@ static void completeRequest(struct raft_fixture *f, unsigned i, raft_time t)
             ioFlushSnapshotGet(io, (struct snapshot_get *)r);
             f->event->type = RAFT_FIXTURE_DISK;
             break;
+        case READ:
+            ioFlushRead(io, (struct read *)r);
+            f->event->type = RAFT_FIXTURE_DISK;
+            break;
         default:
             assert(0);
     }
@@ -1525,9 +1831,11 @@ struct raft_fixture_event *raft_fixture_step(struct raft_fixture *f)
     }
 
     /* If the leader has not changed check the Leader Append-Only
-     * guarantee. */
+     * guarantee, otherwise start over with a new copy of the log. */
     if (!updateLeaderAndCheckElectionSafety(f)) {
         checkLeaderAppendOnly(f);
+    } else {
+        resetLeaderLog(f);
     }
 
     /* If we have a leader, update leader-related state . */
@@ -1930,6 +2238,41 @@ void raft_fixture_desaturate(struct raft_fixture *f, unsigned i, unsigned j)
     ioDesaturate(io1, io2);
 }
 
+/* Return the link used by the @i'th server to send messages to the @j'th. */
+static struct peer *getLink(struct raft_fixture *f, unsigned i, unsigned j)
+{
+    struct io *io1 = f->servers[i]->io.impl;
+    struct io *io2 = f->servers[j]->io.impl;
+    struct peer *peer = ioGetPeer(io1, io2->id);
+    assert(peer != NULL);
+    return peer;
+}
+
+void raft_fixture_set_bandwidth(struct raft_fixture *f,
+                                unsigned i,
+                                unsigned j,
+                                unsigned bytes)
+{
+    getLink(f, i, j)->bandwidth = bytes;
+}
+
+void raft_fixture_set_jitter(struct raft_fixture *f,
+                             unsigned i,
+                             unsigned j,
+                             unsigned msecs)
+{
+    getLink(f, i, j)->jitter = msecs;
+}
+
+void raft_fixture_set_loss(struct raft_fixture *f,
+                           unsigned i,
+                           unsigned j,
+                           unsigned percent)
+{
+    assert(percent <= 100);
+    getLink(f, i, j)->loss = percent;
+}
+
 void raft_fixture_kill(struct raft_fixture *f, unsigned i)
 {
     disconnectFromAll(f, i);
@@ -1,3 +1,5 @@
+#include <limits.h>
+
 #include "legacy.h"
 #include "assert.h"
 #include "configuration.h"
@@ -7,8 +9,10 @@
 #include "membership.h"
 #include "queue.h"
 #include "request.h"
+#include "message.h"
 #include "snapshot.h"
 #include "tracing.h"
+#include "trail.h"
 
 #define tracef(...) Tracef(r->tracer, __VA_ARGS__)
 
@@ -16,10 +20,228 @@ struct legacySendMessage
 {
     struct raft_io_send send;
     struct raft_io_snapshot_get get;
+    struct raft_io_read read;
     struct raft *r;
     struct raft_message message;
+    bool from_disk; /* Entries were read back from disk */
+    struct legacySendMessage *next; /* Link in the free list */
+};
+
+/* Initial capacity of the reusable events array. */
+#define LEGACY__EVENTS_INITIAL 8
+
+/* Maximum number of released send requests kept around for reuse. */
+#define LEGACY__MAX_FREE_SENDS 64
+
+/* Growable array of events generated while handling a single event. */
+struct legacyEvents
+{
+    struct raft_event *items; /* Events to handle, in order */
+    unsigned n;               /* Number of events */
+    unsigned cap;             /* Capacity of the items array */
+};
+
+/* Growable array of received messages whose handling was deferred. */
+struct legacyReceived
+{
+    struct raft_message *items; /* Messages received, in order */
+    unsigned n;                 /* Number of messages */
+    unsigned cap;               /* Capacity of the items array */
+};
+
+/* Buffers reused across calls to LegacyForwardToRaftIo(), so that handling
+ * ticks, messages and applies in steady state does not hit the heap. It's
+ * allocated on first use and released when the raft instance is closed. */
+struct legacyDispatch
+{
+    struct legacyEvents events;           /* Reusable events array */
+    bool busy;                            /* The events array is in use */
+    bool closed;                          /* Release once not busy anymore */
+    struct legacySendMessage *free_sends; /* Released send requests */
+    unsigned n_free_sends;                /* Length of the free list */
+    struct legacyReceived received;       /* Messages not handled yet */
+    struct legacyEvents batch;            /* Events for received messages */
 };
 
+/* Append a new event to the given array, growing it if needed. */
+static struct raft_event *legacyEventsPush(struct legacyEvents *events)
+{
+    struct raft_event *items;
+    unsigned cap;
+
+    if (events->n == events->cap) {
+        cap = events->cap == 0 ? LEGACY__EVENTS_INITIAL : events->cap * 2;
+        items = raft_realloc(events->items, cap * sizeof *items);
+        if (items == NULL) {
+            return NULL;
+        }
+        events->items = items;
+        events->cap = cap;
+    }
+
+    return &events->items[events->n++];
+}
+
+/* Append a new message to the given array, growing it if needed. */
+static struct raft_message *legacyReceivedPush(struct legacyReceived *received)
+{
+    struct raft_message *items;
+    unsigned cap;
+
+    if (received->n == received->cap) {
+        cap = received->cap == 0 ? LEGACY__EVENTS_INITIAL : received->cap * 2;
+        items = raft_realloc(received->items, cap * sizeof *items);
+        if (items == NULL) {
+            return NULL;
+        }
+        received->items = items;
+        received->cap = cap;
+    }
+
+    return &received->items[received->n++];
+}
+
+/* Release the memory of a received message that won't be handled. */
+static void legacyDiscardMessage(struct raft_message *message)
+{
+    switch (message->type) {
+        case RAFT_APPEND_ENTRIES:
+            entryBatchesDestroy(message->append_entries.entries,
+                                message->append_entries.n_entries);
+            break;
+        case RAFT_INSTALL_SNAPSHOT:
+            raft_configuration_close(&message->install_snapshot.conf);
+            raft_free(message->install_snapshot.data.base);
+            break;
+        default:
+            break;
+    }
+}
+
+/* Release the memory of a received message that was handled by raft_step(),
+ * which took ownership of its entries unless it failed. */
+static void legacyReleaseMessage(struct raft_message *message, int rv)
+{
+    switch (message->type) {
+        case RAFT_APPEND_ENTRIES:
+            if (message->append_entries.n_entries > 0) {
+                if (rv != 0) {
+                    raft_free(message->append_entries.entries[0].batch);
+                }
+                raft_free(message->append_entries.entries);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+static struct legacyDispatch *legacyDispatchGet(struct raft *r)
+{
+    struct legacyDispatch *dispatch = r->snapshot.dispatch;
+
+    if (dispatch != NULL) {
+        return dispatch;
+    }
+
+    dispatch = raft_malloc(sizeof *dispatch);
+    if (dispatch == NULL) {
+        return NULL;
+    }
+    dispatch->events.items = NULL;
+    dispatch->events.n = 0;
+    dispatch->events.cap = 0;
+    dispatch->busy = false;
+    dispatch->closed = false;
+    dispatch->free_sends = NULL;
+    dispatch->n_free_sends = 0;
+    dispatch->received.items = NULL;
+    dispatch->received.n = 0;
+    dispatch->received.cap = 0;
+    dispatch->batch.items = NULL;
+    dispatch->batch.n = 0;
+    dispatch->batch.cap = 0;
+
+    r->snapshot.dispatch = dispatch;
+
+    return dispatch;
+}
+
+static void legacyDispatchDestroy(struct legacyDispatch *dispatch)
+{
+    struct legacySendMessage *req;
+    unsigned i;
+
+    for (i = 0; i < dispatch->received.n; i++) {
+        legacyDiscardMessage(&dispatch->received.items[i]);
+    }
+    if (dispatch->received.items != NULL) {
+        raft_free(dispatch->received.items);
+    }
+    if (dispatch->batch.items != NULL) {
+        raft_free(dispatch->batch.items);
+    }
+    while (dispatch->free_sends != NULL) {
+        req = dispatch->free_sends;
+        dispatch->free_sends = req->next;
+        raft_free(req);
+    }
+    if (dispatch->events.items != NULL) {
+        raft_free(dispatch->events.items);
+    }
+    raft_free(dispatch);
+}
+
+void LegacyDispatchClose(struct raft *r)
+{
+    struct legacyDispatch *dispatch = r->snapshot.dispatch;
+
+    if (dispatch == NULL) {
+        return;
+    }
+    r->snapshot.dispatch = NULL;
+
+    /* The instance might get closed by a callback fired while handling an
+     * event, in which case LegacyForwardToRaftIo() releases the buffers. */
+    if (dispatch->busy) {
+        dispatch->closed = true;
+        return;
+    }
+
+    legacyDispatchDestroy(dispatch);
+}
+
+/* Take a send request object from the free list, or allocate a new one. */
+static struct legacySendMessage *legacySendMessageAlloc(struct raft *r)
+{
+    struct legacyDispatch *dispatch = r->snapshot.dispatch;
+    struct legacySendMessage *req;
+
+    if (dispatch != NULL && dispatch->free_sends != NULL) {
+        req = dispatch->free_sends;
+        dispatch->free_sends = req->next;
+        dispatch->n_free_sends--;
+        return req;
+    }
+
+    return raft_malloc(sizeof(struct legacySendMessage));
+}
+
+/* Put a send request object back in the free list, for later reuse. */
+static void legacySendMessageRelease(struct legacySendMessage *req)
+{
+    struct legacyDispatch *dispatch = req->r->snapshot.dispatch;
+
+    if (dispatch == NULL || dispatch->n_free_sends == LEGACY__MAX_FREE_SENDS) {
+        raft_free(req);
+        return;
+    }
+
+    req->next = dispatch->free_sends;
+    dispatch->free_sends = req;
+    dispatch->n_free_sends++;
+}
+
 static void legacySendMessageCb(struct raft_io_send *send, int status)
 {
     struct legacySendMessage *req = send->data;
@@ -29,6 +251,11 @@ static void legacySendMessageCb(struct raft_io_send *send, int status)
 
     switch (req->message.type) {
         case RAFT_APPEND_ENTRIES:
+            if (req->from_disk) {
+                entryBatchesDestroy(req->message.append_entries.entries,
+                                    req->message.append_entries.n_entries);
+                break;
+            }
             logRelease(r->legacy.log,
                        req->message.append_entries.prev_log_index + 1,
                        req->message.append_entries.entries,
@@ -42,11 +269,149 @@ static void legacySendMessageCb(struct raft_io_send *send, int status)
             break;
     }
 
-    raft_free(req);
+    legacySendMessageRelease(req);
 }
 
 static int legacyLoadSnapshot(struct legacySendMessage *req);
 
+/* Return true if the raft_io implementation can read entries back from disk. */
+static bool legacyCanReadEntries(const struct raft *r)
+{
+    return r->io->version >= 3 && r->io->read != NULL;
+}
+
+/* Number of trailing entries to keep in memory after taking a snapshot. Unless
+ * the entries dropped from memory can be read back from disk, this must match
+ * the number of trailing entries that the core keeps track of. */
+static unsigned legacySnapshotTrailingInMemory(const struct raft *r)
+{
+    if (legacyCanReadEntries(r) &&
+        r->legacy.snapshot_trailing_memory < r->legacy.snapshot_trailing) {
+        return r->legacy.snapshot_trailing_memory;
+    }
+    return r->legacy.snapshot_trailing;
+}
+
+/* Turn an AppendEntries message into an InstallSnapshot one, used when the
+ * entries to send could not be read back from disk. */
+static int legacySendSnapshotInstead(struct legacySendMessage *req)
+{
+    struct raft *r = req->r;
+    struct raft_install_snapshot *args = &req->message.install_snapshot;
+    raft_term term = req->message.append_entries.term;
+
+    req->message.type = RAFT_INSTALL_SNAPSHOT;
+    args->version = MESSAGE__INSTALL_SNAPSHOT_VERSION;
+    args->term = term;
+    args->last_index = TrailSnapshotIndex(&r->trail);
+    args->last_term = TrailSnapshotTerm(&r->trail);
+    args->conf_index = r->configuration_last_snapshot_index;
+
+    /* These overlay AppendEntries fields, and are released if loading the
+     * snapshot fails. */
+    configurationInit(&args->conf);
+    args->data.base = NULL;
+    args->data.len = 0;
+
+    return legacyLoadSnapshot(req);
+}
+
+static void legacyReadEntriesCb(struct raft_io_read *read,
+                                struct raft_entry entries[],
+                                unsigned n,
+                                int status)
+{
+    struct legacySendMessage *req = read->data;
+    struct raft *r = req->r;
+    struct raft_append_entries *args = &req->message.append_entries;
+    unsigned i;
+    int rv;
+
+    if (r->legacy.closing) {
+        if (status == 0) {
+            entryBatchesDestroy(entries, n);
+        }
+        legacySendMessageRelease(req);
+        return;
+    }
+
+    /* Entries with the same index and term are identical, so checking terms
+     * against the ones we track guards against stale data on disk. */
+    if (status == 0) {
+        for (i = 0; i < n; i++) {
+            raft_index index = args->prev_log_index + 1 + i;
+            if (entries[i].term != TrailTermOf(&r->trail, index)) {
+                entryBatchesDestroy(entries, n);
+                status = RAFT_CORRUPT;
+                break;
+            }
+        }
+    }
+
+    if (status != 0) {
+        tracef("read entries from %llu: %s", args->prev_log_index + 1,
+               raft_strerror(status));
+        rv = legacySendSnapshotInstead(req);
+        if (rv != 0) {
+            tracef("send snapshot: %s", raft_strerror(rv));
+        }
+        return;
+    }
+
+    assert(n > 0 && n <= args->n_entries);
+    args->entries = entries;
+    args->n_entries = n;
+
+    rv = r->io->send(r->io, &req->send, &req->message, legacySendMessageCb);
+    if (rv != 0) {
+        struct raft_event event;
+        raft_id id = req->message.server_id;
+        tracef("send message of type %d to %llu: %s", req->message.type, id,
+               raft_strerror(rv));
+        entryBatchesDestroy(entries, n);
+        legacySendMessageRelease(req);
+        if (rv == RAFT_BUSY) {
+            event.type = RAFT_CONGESTED;
+            event.congested.server_id = id;
+            LegacyForwardToRaftIo(r, &event);
+        }
+    }
+}
+
+/* Read from disk the entries of an AppendEntries message which are not cached
+ * in memory anymore, and then send it. Only the entries preceding the ones
+ * still in memory are sent. */
+static int legacyReadEntries(struct legacySendMessage *req)
+{
+    struct raft *r = req->r;
+    struct raft_append_entries *args = &req->message.append_entries;
+    raft_index index = args->prev_log_index + 1;
+    size_t n_cached = logNumEntries(r->legacy.log);
+    unsigned n = args->n_entries;
+    int rv;
+
+    if (n_cached > 0) {
+        raft_index first_cached = logLastIndex(r->legacy.log) - n_cached + 1;
+        assert(first_cached > index);
+        if (first_cached - index < n) {
+            n = (unsigned)(first_cached - index);
+        }
+    }
+
+    args->n_entries = n;
+    req->from_disk = true;
+    req->read.data = req;
+    rv = r->io->read(r->io, &req->read, index, n, legacyReadEntriesCb);
+    if (rv != 0) {
+        legacySendMessageRelease(req);
+        ErrMsgTransferf(r->io->errmsg, r->errmsg, "read entries at %llu",
+                        index);
+        return rv;
+    }
+
+    return 0;
+}
+
 static int legacyFillAppendEntries(struct raft *r,
                                    struct raft_append_entries *args)
 {
@@ -74,18 +439,27 @@ static int legacySendMessage(struct raft *r, struct raft_message *message)
     struct legacySendMessage *req;
     int rv;
 
-    req = raft_malloc(sizeof *req);
+    req = legacySendMessageAlloc(r);
     if (req == NULL) {
         return RAFT_NOMEM;
     }
     req->r = r;
     req->message = *message;
     req->send.data = req;
+    req->from_disk = false;
 
     switch (req->message.type) {
         case RAFT_APPEND_ENTRIES:
+            if (req->message.append_entries.n_entries > 0 &&
+                legacyCanReadEntries(r) &&
+                logGet(r->legacy.log,
+                       req->message.append_entries.prev_log_index + 1) ==
+                    NULL) {
+                return legacyReadEntries(req);
+            }
             rv = legacyFillAppendEntries(r, &req->message.append_entries);
             if (rv != 0) {
+                legacySendMessageRelease(req);
                 return rv;
             }
             break;
@@ -108,7 +482,7 @@ static int legacySendMessage(struct raft *r, struct raft_message *message)
             default:
                 break;
         }
-        raft_free(req);
+        legacySendMessageRelease(req);
         ErrMsgTransferf(r->io->errmsg, r->errmsg,
                         "send message of type %d to %llu", message->type,
                         message->server_id);
@@ -216,9 +590,15 @@ static int legacyHandleUpdateEntries(struct raft *r,
         }
     }
 
+    /* The entries might come from several messages handled by the same
+     * raft_step_batch() call, each with its own batch. */
     assert(n > 0);
-    assert(entries[0].batch != NULL);
-    raft_free(entries[0].batch);
+    for (i = 0; i < n; i++) {
+        assert(entries[i].batch != NULL);
+        if (i == 0 || entries[i].batch != entries[i - 1].batch) {
+            raft_free(entries[i].batch);
+        }
+    }
 
     rv = r->io->truncate(r->io, index);
     if (rv != 0) {
@@ -267,10 +647,74 @@ static void legacyCancelPersistSnapshot(struct legacyPersistSnapshot *req)
     raft_configuration_close(&req->metadata.configuration);
 }
 
+static void legacyPersistSnapshotDone(struct legacyPersistSnapshot *req,
+                                      int status);
+
+/* Invoked after the data of a snapshot that was streamed to disk by the I/O
+ * implementation has been loaded back, in order to restore the FSM. */
+static void legacyLoadStreamedSnapshotCb(struct raft_io_snapshot_get *get,
+                                         struct raft_snapshot *snapshot,
+                                         int status)
+{
+    struct legacyPersistSnapshot *req = get->data;
+    struct raft *r = req->r;
+
+    raft_free(get);
+
+    if (status != 0) {
+        tracef("load streamed snapshot: %s", errCodeToString(status));
+        goto out;
+    }
+
+    assert(snapshot->index == req->metadata.index);
+    assert(snapshot->n_bufs == 1);
+    req->chunk = snapshot->bufs[0];
+    configurationClose(&snapshot->configuration);
+    raft_free(snapshot->bufs);
+    raft_free(snapshot);
+
+out:
+    legacyPersistSnapshotDone(req, status);
+}
+
 static void legacyPersistSnapshotCb(struct raft_io_snapshot_put *put,
                                     int status)
 {
     struct legacyPersistSnapshot *req = put->data;
+    struct raft *r = req->r;
+    struct raft_io_snapshot_get *get;
+    int rv;
+
+    /* If the data was streamed to disk by the I/O implementation rather than
+     * held in memory, load it back now, since it's needed to restore the
+     * FSM. */
+    if (status == 0 && req->chunk.base == NULL) {
+        if (r->legacy.closing) {
+            status = RAFT_CANCELED;
+            goto done;
+        }
+        get = raft_malloc(sizeof *get);
+        if (get == NULL) {
+            status = RAFT_NOMEM;
+            goto done;
+        }
+        get->data = req;
+        rv = r->io->snapshot_get(r->io, get, legacyLoadStreamedSnapshotCb);
+        if (rv != 0) {
+            raft_free(get);
+            status = rv;
+            goto done;
+        }
+        return;
+    }
+
+done:
+    legacyPersistSnapshotDone(req, status);
+}
+
+static void legacyPersistSnapshotDone(struct legacyPersistSnapshot *req,
+                                      int status)
+{
     struct raft *r = req->r;
     struct raft_event event;
 
@@ -292,8 +736,7 @@ static void legacyPersistSnapshotCb(struct raft_io_snapshot_put *put,
         r->legacy.snapshot_chunk = req->chunk;
         LegacyForwardToRaftIo(r, &event);
     } else {
-        assert(r->legacy.closing);
-        assert(status == RAFT_CANCELED);
+        assert(r->legacy.closing || req->chunk.base == NULL);
         legacyCancelPersistSnapshot(req);
     }
 
@@ -332,7 +775,7 @@ static int legacyHandleUpdateSnapshot(struct raft *r,
     int rv;
 
     assert(!r->legacy.snapshot_install);
-    assert(r->legacy.snapshot_pending == NULL);
+    assert(r->snapshot.pending_install == NULL);
 
     req = raft_malloc(sizeof *req);
     if (req == NULL) {
@@ -354,10 +797,10 @@ static int legacyHandleUpdateSnapshot(struct raft *r,
 
     r->legacy.snapshot_install = true;
 
-    /* If we're taking a snapshot, put this install on hold until it's
-     * completed. */
-    if (r->legacy.snapshot_taking) {
-        r->legacy.snapshot_pending = req;
+    /* If we're taking a snapshot, or if the FSM is still applying entries
+     * asynchronously, put this install on hold until that's completed. */
+    if (r->legacy.snapshot_taking || r->legacy.applying > 0) {
+        r->snapshot.pending_install = req;
         return 0;
     }
 
@@ -375,14 +818,27 @@ err:
     return rv;
 }
 
+/* Send the given messages. If the I/O backend can't take more entries for a
+ * server, let the core know with a RAFT_CONGESTED event. */
 static int legacyHandleUpdateMessages(struct raft *r,
                                       struct raft_message *messages,
-                                      unsigned n)
+                                      unsigned n,
+                                      struct legacyEvents *events)
 {
+    struct raft_event *event;
     unsigned i;
     int rv;
     for (i = 0; i < n; i++) {
         rv = legacySendMessage(r, &messages[i]);
+        if (rv == RAFT_BUSY && messages[i].type == RAFT_APPEND_ENTRIES) {
+            event = legacyEventsPush(events);
+            if (event == NULL) {
+                return RAFT_NOMEM;
+            }
+            event->type = RAFT_CONGESTED;
+            event->congested.server_id = messages[i].server_id;
+            continue;
+        }
         if (rv != 0) {
             return rv;
         }
@@ -433,7 +889,7 @@ abort:
     configurationClose(&params->conf);
     raft_free(params->data.base);
 
-    raft_free(req);
+    legacySendMessageRelease(req);
 }
 
 static int legacyLoadSnapshot(struct legacySendMessage *req)
@@ -445,7 +901,7 @@ static int legacyLoadSnapshot(struct legacySendMessage *req)
 
     rv = r->io->snapshot_get(r->io, &req->get, legacyLoadSnapshotCb);
     if (rv != 0) {
-        raft_free(req);
+        legacySendMessageRelease(req);
         ErrMsgTransferf(r->io->errmsg, r->errmsg, "load snapshot at %llu",
                         req->message.install_snapshot.last_index);
         return rv;
@@ -454,6 +910,26 @@ static int legacyLoadSnapshot(struct legacySendMessage *req)
     return 0;
 }
 
+/* Start persisting a snapshot whose installation was put on hold, if there's
+ * one and nothing is holding it anymore. */
+static void legacyMaybeStartPendingSnapshot(struct raft *r)
+{
+    struct legacyPersistSnapshot *persist = r->snapshot.pending_install;
+    int rv;
+
+    if (persist == NULL) {
+        return;
+    }
+
+    if (r->legacy.snapshot_taking || r->legacy.applying > 0) {
+        return;
+    }
+
+    r->snapshot.pending_install = NULL;
+    rv = legacyPersistSnapshotStart(persist);
+    assert(rv == 0);
+}
+
 struct legacyTakeSnapshot
 {
     struct raft *r;
@@ -503,9 +979,9 @@ static void takeSnapshotCb(struct raft_io_snapshot_put *put, int status)
         status = RAFT_CANCELED;
 
         /* Also cancel any persist snapshot request. */
-        if (r->legacy.snapshot_pending != NULL) {
+        if (r->snapshot.pending_install != NULL) {
             struct legacyPersistSnapshot *persist;
-            persist = r->legacy.snapshot_pending;
+            persist = r->snapshot.pending_install;
             legacyCancelPersistSnapshot(persist);
         }
     }
@@ -517,7 +993,8 @@ static void takeSnapshotCb(struct raft_io_snapshot_put *put, int status)
         return;
     }
 
-    logSnapshot(r->legacy.log, metadata.index, r->legacy.snapshot_trailing);
+    logSnapshot(r->legacy.log, metadata.index,
+                legacySnapshotTrailingInMemory(r));
 
     event.type = RAFT_SNAPSHOT;
     memset(&event.reserved, 0, sizeof event.reserved);
@@ -525,14 +1002,7 @@ static void takeSnapshotCb(struct raft_io_snapshot_put *put, int status)
     event.snapshot.trailing = r->legacy.snapshot_trailing;
     LegacyForwardToRaftIo(r, &event);
 
-    if (r->legacy.snapshot_pending != NULL) {
-        struct legacyPersistSnapshot *persist;
-        int rv;
-        r->legacy.snapshot_pending = NULL;
-        persist = r->legacy.snapshot_pending;
-        rv = legacyPersistSnapshotStart(persist);
-        assert(rv == 0);
-    }
+    legacyMaybeStartPendingSnapshot(r);
 }
 
 static int putSnapshot(struct legacyTakeSnapshot *req)
@@ -549,9 +1019,11 @@ static int putSnapshot(struct legacyTakeSnapshot *req)
 
 static bool legacyShouldTakeSnapshot(const struct raft *r)
 {
-    /* We currently support only synchronous FSMs, where entries are applied
-     * synchronously as soon as we advance the commit index, so the two
-     * values always match when we get here. */
+    /* Wait for the FSM to catch up with the commit index. With synchronous
+     * FSMs entries are applied as soon as we advance the commit index, so the
+     * two values always match when we get here, while asynchronous FSMs might
+     * still have in-flight applies, and their state can't be snapshotted until
+     * those are completed. */
     if (r->last_applied < r->commit_index) {
         return false;
     }
@@ -590,13 +1062,12 @@ static void legacyTakeSnapshot(struct raft *r)
     struct legacyTakeSnapshot *req;
     int rv;
 
-    /* We currently support only synchronous FSMs, where entries are applied
-     * synchronously as soon as we advance the commit index, so the two
-     * values always match when we get here. */
+    /* See legacyShouldTakeSnapshot(). */
     assert(r->last_applied == r->commit_index);
+    assert(r->legacy.applying == 0);
 
     assert(!r->snapshot.installing);
-    assert(r->legacy.snapshot_pending == NULL);
+    assert(r->snapshot.pending_install == NULL);
 
     tracef("take snapshot at %lld", r->commit_index);
 
@@ -677,15 +1148,15 @@ void LegacyFailPendingRequests(struct raft *r)
 {
     /* Fail any promote request that is still outstanding because the server is
      * still catching up and no entry was submitted. */
-    if (r->legacy.change != NULL) {
-        struct raft_change *req = r->legacy.change;
+    if (r->snapshot.pending_change != NULL) {
+        struct raft_change *req = r->snapshot.pending_change;
         if (req != NULL && req->cb != NULL) {
             /* XXX: set the type here, since it's not done in client.c */
             req->type = RAFT_CHANGE;
             req->status = RAFT_LEADERSHIPLOST;
             QUEUE_PUSH(&r->legacy.requests, &req->queue);
         }
-        r->legacy.change = NULL;
+        r->snapshot.pending_change = NULL;
     }
 
     /* Fail all outstanding requests */
@@ -760,33 +1231,32 @@ void LegacyFireCompletedRequests(struct raft *r)
  * completed requests queue if so. */
 static void legacyCheckChangeRequest(struct raft *r,
                                      struct raft_entry *entry,
-                                     struct raft_event **events,
-                                     unsigned *n_events)
+                                     struct legacyEvents *events)
 {
     struct raft_change *change;
     int status;
     int rv;
 
-    if (r->legacy.change == NULL) {
+    if (r->snapshot.pending_change == NULL) {
         return;
     }
 
-    if (r->legacy.change->catch_up_id == 0) {
+    if (r->snapshot.pending_change->catch_up_id == 0) {
         return;
     }
 
-    change = r->legacy.change;
+    change = r->snapshot.pending_change;
 
     /* A raft_catch_up() call can fail only if the server is not the
      * leader or if the given ID is invalid. If the server was not the
-     * leader then r->legacy.change would be NULL, and we know that the
+     * leader then r->snapshot.pending_change would be NULL, and we know that the
      * ID is valid, otherwise the request couldn't have been submitted.
      */
-    rv = raft_catch_up(r, r->legacy.change->catch_up_id, &status);
+    rv = raft_catch_up(r, r->snapshot.pending_change->catch_up_id, &status);
     assert(rv == 0);
 
     if (status == RAFT_CATCH_UP_ABORTED) {
-        r->legacy.change = NULL;
+        r->snapshot.pending_change = NULL;
         if (change->cb != NULL) {
             change->type = RAFT_CHANGE;
             change->status = RAFT_NOCONNECTION;
@@ -802,7 +1272,7 @@ static void legacyCheckChangeRequest(struct raft *r,
 
         /* If we're transferring leadership, fail the request. */
         if (raft_transferee(r) != 0) {
-            r->legacy.change = NULL;
+            r->snapshot.pending_change = NULL;
             if (change->cb != NULL) {
                 change->type = RAFT_CHANGE;
                 change->status = RAFT_LEADERSHIPLOST;
@@ -834,11 +1304,9 @@ static void legacyCheckChangeRequest(struct raft *r,
 
         entry->batch = entry->buf.base;
 
-        *n_events += 1;
-        *events = raft_realloc(*events, *n_events * sizeof **events);
-        assert(*events != NULL);
+        event = legacyEventsPush(events);
+        assert(event != NULL);
 
-        event = &(*events)[*n_events - 1];
         event->type = RAFT_SUBMIT;
         event->submit.entries = entry;
         event->submit.n = 1;
@@ -893,6 +1361,100 @@ static int applyCommand(struct raft *r,
     return 0;
 }
 
+struct legacyApplyAsync
+{
+    struct raft_fsm_apply req;
+    struct raft *r;
+    struct raft_buffer buf;
+};
+
+static void legacyApplyResume(struct raft *r);
+
+static void legacyApplyAsyncCb(struct raft_fsm_apply *apply,
+                               int status,
+                               void *result)
+{
+    struct legacyApplyAsync *req = apply->data;
+    struct raft *r = req->r;
+    struct raft_apply *request;
+    raft_index index = apply->index;
+
+    raft_free(req);
+
+    assert(r->legacy.applying > 0);
+    r->legacy.applying -= 1;
+
+    if (r->legacy.closing) {
+        if (r->legacy.applying > 0) {
+            return;
+        }
+        /* Discard any snapshot install that was waiting for us. */
+        if (r->snapshot.pending_install != NULL && !r->legacy.snapshot_taking) {
+            struct legacyPersistSnapshot *persist = r->snapshot.pending_install;
+            r->snapshot.pending_install = NULL;
+            legacyCancelPersistSnapshot(persist);
+            raft_free(persist);
+        }
+        LegacyMaybeFireCloseCb(r);
+        return;
+    }
+
+    /* Applies must be completed in the same order they were submitted. */
+    assert(index == r->last_applied + 1);
+    r->last_applied = index;
+
+    if (status != 0) {
+        tracef("apply entry %llu: %s", index, errCodeToString(status));
+    }
+
+    request = (struct raft_apply *)legacyGetRequest(r, index, RAFT_COMMAND);
+    if (request != NULL && request->cb != NULL) {
+        request->status = status;
+        request->result = status == 0 ? result : NULL;
+        QUEUE_PUSH(&r->legacy.requests, &request->queue);
+    }
+
+    /* If the FSM completed the apply before returning from apply_async(), then
+     * legacyApply() is still running and will carry on by itself. */
+    if (r->legacy.applying_entries) {
+        return;
+    }
+
+    legacyMaybeStartPendingSnapshot(r);
+    legacyApplyResume(r);
+}
+
+/* Hand a RAFT_COMMAND entry that has been committed to the FSM, which will
+ * apply it asynchronously. */
+static int applyCommandAsync(struct raft *r,
+                             const raft_index index,
+                             const struct raft_buffer *buf)
+{
+    struct legacyApplyAsync *req;
+    int rv;
+
+    req = raft_malloc(sizeof *req);
+    if (req == NULL) {
+        return RAFT_NOMEM;
+    }
+    req->r = r;
+    req->buf = *buf;
+    req->req.data = req;
+    req->req.index = index;
+
+    /* Account for the apply before submitting it, since the FSM might invoke
+     * the callback right away. */
+    r->legacy.applying += 1;
+    rv = r->fsm->apply_async(r->fsm, &req->req, &req->buf, legacyApplyAsyncCb);
+    if (rv != 0) {
+        r->legacy.applying -= 1;
+        raft_free(req);
+        return rv;
+    }
+
+    return 0;
+}
+
 /* Fire the callback of a barrier request whose entry has been committed. */
 static void applyBarrier(struct raft *r, const raft_index index)
 {
@@ -916,8 +1478,8 @@ static void applyChange(struct raft *r, const raft_index index)
     r->last_applied = index;
 
     if (r->state == RAFT_LEADER) {
-        req = r->legacy.change;
-        r->legacy.change = NULL;
+        req = r->snapshot.pending_change;
+        r->snapshot.pending_change = NULL;
 
         if (req != NULL && req->cb != NULL) {
             /* XXX: set the type here, since it's not done in client.c */
@@ -928,36 +1490,65 @@ static void applyChange(struct raft *r, const raft_index index)
     }
 }
 
+/* Whether the FSM applies commands asynchronously. */
+static bool legacyFsmIsAsync(const struct raft *r)
+{
+    return r->fsm->version >= 4 && r->fsm->apply_async != NULL;
+}
+
 static int legacyApply(struct raft *r,
-                       struct raft_event **events,
-                       unsigned *n_events)
+                       struct legacyEvents *events)
 {
     raft_index index;
     struct raft_event *event;
+    bool async = legacyFsmIsAsync(r);
     int rv = 0;
 
-    assert(r->state == RAFT_LEADER || r->state == RAFT_FOLLOWER);
-    assert(r->last_applied <= r->commit_index);
+    /* Asynchronous applies might complete while we are candidate. */
+    assert(r->state == RAFT_LEADER || r->state == RAFT_FOLLOWER || async);
+    assert(r->last_applied + r->legacy.applying <= r->commit_index);
 
-    if (r->last_applied == r->commit_index) {
+    if (r->last_applied + r->legacy.applying == r->commit_index) {
         /* Nothing to do. */
         return 0;
     }
 
-    for (index = r->last_applied + 1; index <= r->commit_index; index++) {
-        const struct raft_entry *entry = logGet(r->legacy.log, index);
+    /* Don't hand more entries to the FSM while a snapshot install is waiting
+     * for in-flight applies to complete. */
+    if (r->snapshot.pending_install != NULL && r->legacy.applying > 0) {
+        return 0;
+    }
+
+    r->legacy.applying_entries = true;
+
+    /* The next index is computed at each iteration, since asynchronous applies
+     * might complete before apply_async() returns. */
+    while (r->last_applied + r->legacy.applying < r->commit_index) {
+        const struct raft_entry *entry;
+        index = r->last_applied + r->legacy.applying + 1;
+        entry = logGet(r->legacy.log, index);
         if (entry == NULL) {
             /* This can happen while installing a snapshot */
             tracef("replicationApply - ENTRY NULL");
-            return 0;
+            break;
         }
 
         assert(entry->type == RAFT_COMMAND || entry->type == RAFT_BARRIER ||
                entry->type == RAFT_CHANGE);
 
+        /* Barriers and configuration changes can be applied only once all
+         * previous commands have been applied. */
+        if (entry->type != RAFT_COMMAND && r->legacy.applying > 0) {
+            break;
+        }
+
         switch (entry->type) {
             case RAFT_COMMAND:
-                rv = applyCommand(r, index, &entry->buf);
+                if (async) {
+                    rv = applyCommandAsync(r, index, &entry->buf);
+                } else {
+                    rv = applyCommand(r, index, &entry->buf);
+                }
                 break;
             case RAFT_BARRIER:
                 applyBarrier(r, index);
@@ -966,11 +1557,9 @@ static int legacyApply(struct raft *r,
             case RAFT_CHANGE:
                 applyChange(r, index);
 
-                *n_events += 1;
-                *events = raft_realloc(*events, *n_events * sizeof **events);
-                assert(*events != NULL);
+                event = legacyEventsPush(events);
+                assert(event != NULL);
 
-                event = &(*events)[*n_events - 1];
                 event->type = RAFT_CONFIGURATION;
                 event->configuration.index = index;
 
@@ -988,6 +1577,14 @@ static int legacyApply(struct raft *r,
         }
     }
 
+    r->legacy.applying_entries = false;
+
+    /* A snapshot install might have been waiting for applies that completed
+     * synchronously, see legacyApplyAsyncCb(). */
+    if (async) {
+        legacyMaybeStartPendingSnapshot(r);
+    }
+
     return rv;
 }
 
@@ -1018,7 +1615,7 @@ static void legacyHandleStateUpdate(struct raft *r)
     }
 
     if (raft_state(r) == RAFT_LEADER) {
-        assert(r->legacy.change == NULL);
+        assert(r->snapshot.pending_change == NULL);
     }
 
     if (r->legacy.closing) {
@@ -1060,8 +1657,7 @@ static bool legacyShouldFireStepCb(struct raft *r)
 }
 
 static int legacyHandleUpdateCommitIndex(struct raft *r,
-                                         struct raft_event **events,
-                                         unsigned *n_events)
+                                         struct legacyEvents *events)
 {
     raft_index commit_index = raft_commit_index(r);
     int rv;
@@ -1073,6 +1669,7 @@ static int legacyHandleUpdateCommitIndex(struct raft *r,
          *
          *   8. Reset state machine using snapshot contents.
          */
+        assert(r->legacy.applying == 0);
         r->legacy.snapshot_index = 0;
         rv = r->fsm->restore(r->fsm, &r->legacy.snapshot_chunk);
         if (rv != 0) {
@@ -1082,7 +1679,7 @@ static int legacyHandleUpdateCommitIndex(struct raft *r,
         r->last_applied = commit_index;
     }
 
-    rv = legacyApply(r, events, n_events);
+    rv = legacyApply(r, events);
     if (rv != 0) {
         return rv;
     }
@@ -1090,32 +1687,71 @@ static int legacyHandleUpdateCommitIndex(struct raft *r,
     return 0;
 }
 
-/* Handle a single event, possibly adding more events. */
-static int legacyHandleEvent(struct raft *r,
-                             struct raft_entry *entry,
-                             struct raft_event **events,
-                             unsigned *n_events,
-                             unsigned i)
+/* Hand to the FSM entries that were committed while previous asynchronous
+ * applies were in flight, and forward any resulting event. */
+static void legacyApplyResume(struct raft *r)
 {
-    struct raft_event *event;
-    struct raft_update update;
+    struct legacyEvents events = {NULL, 0, 0};
+    unsigned i;
     int rv;
 
-    event = &(*events)[i];
-    event->time = r->io->time(r->io);
-    event->capacity = r->io->capacity;
-
-    rv = raft_step(r, event, &update);
+    rv = legacyApply(r, &events);
     if (rv != 0) {
-        return rv;
+        tracef("apply committed entries: %s", errCodeToString(rv));
+    }
+
+    for (i = 0; i < events.n; i++) {
+        rv = LegacyForwardToRaftIo(r, &events.items[i]);
+        if (rv != 0) {
+            break;
+        }
     }
 
-    if (update.flags & RAFT_UPDATE_STATE) {
+    if (events.items != NULL) {
+        raft_free(events.items);
+    }
+
+    if (legacyShouldTakeSnapshot(r)) {
+        legacyTakeSnapshot(r);
+    }
+}
+
+/* Program the I/O timer to fire when raft needs to run next, instead of relying
+ * on periodic ticks. */
+static void legacySetDeadline(struct raft *r)
+{
+    raft_time deadline = ULLONG_MAX;
+
+    if (r->io->version < 5 || r->io->set_deadline == NULL) {
+        return;
+    }
+    if (r->state != RAFT_UNAVAILABLE) {
+        deadline = raft_timeout(r);
+    }
+    r->io->set_deadline(r->io, deadline);
+}
+
+/* Execute the tasks of the given update, produced by handling one or more
+ * events, possibly adding more events. */
+static int legacyHandleUpdate(struct raft *r,
+                              struct raft_update *update,
+                              bool timeout,
+                              struct raft_entry *entry,
+                              struct legacyEvents *events)
+{
+    int rv;
+
+    if (update->flags & RAFT_UPDATE_STATE) {
         legacyHandleStateUpdate(r);
     }
 
+    /* The timer is one-shot, so it must be programmed again after firing. */
+    if (update->flags & RAFT_UPDATE_TIMEOUT || timeout) {
+        legacySetDeadline(r);
+    }
+
     /* Check whether a raft_change request has been completed. */
-    legacyCheckChangeRequest(r, entry, events, n_events);
+    legacyCheckChangeRequest(r, entry, events);
 
     if (legacyShouldFireStepCb(r)) {
         r->legacy.step_cb(r);
@@ -1126,7 +1762,7 @@ static int legacyHandleEvent(struct raft *r,
     }
 
     /* If the current term was updated, persist it. */
-    if (update.flags & RAFT_UPDATE_CURRENT_TERM) {
+    if (update->flags & RAFT_UPDATE_CURRENT_TERM) {
         rv = r->io->set_term(r->io, raft_current_term(r));
         if (rv != 0) {
             return rv;
@@ -1134,40 +1770,40 @@ static int legacyHandleEvent(struct raft *r,
     }
 
     /* If the current vote was updated, persist it. */
-    if (update.flags & RAFT_UPDATE_VOTED_FOR) {
+    if (update->flags & RAFT_UPDATE_VOTED_FOR) {
         rv = r->io->set_vote(r->io, raft_voted_for(r));
         if (rv != 0) {
             return rv;
         }
     }
 
-    if (update.flags & RAFT_UPDATE_ENTRIES) {
-        rv = legacyHandleUpdateEntries(r, update.entries.index,
-                                       update.entries.batch, update.entries.n);
+    if (update->flags & RAFT_UPDATE_ENTRIES) {
+        rv = legacyHandleUpdateEntries(r, update->entries.index,
+                                       update->entries.batch, update->entries.n);
         if (rv != 0) {
             return rv;
         }
     }
 
-    if (update.flags & RAFT_UPDATE_SNAPSHOT) {
+    if (update->flags & RAFT_UPDATE_SNAPSHOT) {
         rv = legacyHandleUpdateSnapshot(
-            r, &update.snapshot.metadata, update.snapshot.offset,
-            &update.snapshot.chunk, update.snapshot.last);
+            r, &update->snapshot.metadata, update->snapshot.offset,
+            &update->snapshot.chunk, update->snapshot.last);
         if (rv != 0) {
             return rv;
         }
     }
 
-    if (update.flags & RAFT_UPDATE_MESSAGES) {
-        rv = legacyHandleUpdateMessages(r, update.messages.batch,
-                                        update.messages.n);
+    if (update->flags & RAFT_UPDATE_MESSAGES) {
+        rv = legacyHandleUpdateMessages(r, update->messages.batch,
+                                        update->messages.n, events);
         if (rv != 0) {
             return rv;
         }
     }
 
-    if (update.flags & RAFT_UPDATE_COMMIT_INDEX) {
-        rv = legacyHandleUpdateCommitIndex(r, events, n_events);
+    if (update->flags & RAFT_UPDATE_COMMIT_INDEX) {
+        rv = legacyHandleUpdateCommitIndex(r, events);
         if (rv != 0) {
             return rv;
         }
@@ -1193,43 +1829,192 @@ static int legacyHandleEvent(struct raft *r,
     return 0;
 }
 
-int LegacyForwardToRaftIo(struct raft *r, struct raft_event *event)
+/* Handle a single event, possibly adding more events. */
+static int legacyHandleEvent(struct raft *r,
+                             struct raft_entry *entry,
+                             struct legacyEvents *events,
+                             unsigned i)
+{
+    struct raft_event *event;
+    struct raft_update update;
+    int rv;
+
+    event = &events->items[i];
+    event->time = r->io->time(r->io);
+    event->capacity = r->io->capacity;
+
+    rv = raft_step(r, event, &update);
+    if (rv != 0) {
+        return rv;
+    }
+
+    return legacyHandleUpdate(r, &update, event->type == RAFT_TIMEOUT, entry,
+                              events);
+}
+
+/* Handle the given events at once with raft_step_batch(), possibly adding more
+ * events. */
+static int legacyHandleBatch(struct raft *r,
+                             struct raft_entry *entry,
+                             struct raft_event batch[],
+                             unsigned n,
+                             struct legacyEvents *events)
 {
-    struct raft_event *events;
-    unsigned n_events;
+    struct raft_update update;
     unsigned i;
-    struct raft_entry entry; /* Used for actual promotion of RAFT_CHANGE reqs */
     int rv;
 
+    for (i = 0; i < n; i++) {
+        batch[i].time = r->io->time(r->io);
+        batch[i].capacity = r->io->capacity;
+    }
+
+    rv = raft_step_batch(r, batch, n, &update);
+    if (rv != 0) {
+        return rv;
+    }
+
+    return legacyHandleUpdate(r, &update, false, entry, events);
+}
+
+/* Handle the given events, the first @n of which are passed to a single
+ * raft_step_batch() call if @n is greater than one, along with the ones
+ * generated while handling them. */
+static int legacyForward(struct raft *r, struct raft_event batch[], unsigned n)
+{
+    struct legacyDispatch *dispatch;
+    struct legacyEvents nested = {NULL, 0, 0};
+    struct legacyEvents *events;
+    struct raft_event *first;
+    unsigned i;
+    struct raft_entry entry; /* Used for actual promotion of RAFT_CHANGE reqs */
+    int rv = 0;
+
     assert(r->io != NULL);
 
+    dispatch = legacyDispatchGet(r);
+    if (dispatch == NULL) {
+        return RAFT_NOMEM;
+    }
+
+    /* Reuse the dispatch events array, unless this is a nested call made by
+     * some callback fired while handling another event. */
+    if (dispatch->busy) {
+        events = &nested;
+    } else {
+        events = &dispatch->events;
+        events->n = 0;
+        dispatch->busy = true;
+    }
+
     /* Initially the set of events contains only the event passed as
      * argument, but might grow if some further events get generated by the
      * handling code. */
-    events = raft_malloc(sizeof *events);
-    if (events == NULL) {
-        return RAFT_NOMEM;
+    if (n == 1) {
+        first = legacyEventsPush(events);
+        if (first == NULL) {
+            rv = RAFT_NOMEM;
+            goto out;
+        }
+        *first = batch[0];
+    } else {
+        rv = legacyHandleBatch(r, &entry, batch, n, events);
+        if (rv != 0) {
+            goto out;
+        }
     }
-    events[0] = *event;
-    n_events = 1;
 
-    for (i = 0; i < n_events; i++) {
+    for (i = 0; i < events->n; i++) {
         if (r->legacy.closing) {
             break;
         }
-        rv = legacyHandleEvent(r, &entry, &events, &n_events, i);
+        rv = legacyHandleEvent(r, &entry, events, i);
         if (rv != 0) {
             break;
         }
     }
 
-    raft_free(events);
+out:
+    if (events == &nested) {
+        if (nested.items != NULL) {
+            raft_free(nested.items);
+        }
+    } else {
+        dispatch->busy = false;
+        if (dispatch->closed) {
+            legacyDispatchDestroy(dispatch);
+        }
+    }
 
-    if (rv != 0) {
-        return rv;
+    return rv;
+}
+
+int LegacyForwardToRaftIo(struct raft *r, struct raft_event *event)
+{
+    return legacyForward(r, event, 1);
+}
+
+void LegacyDeferReceive(struct raft *r)
+{
+    r->legacy.recv_deferred = true;
+}
+
+void LegacyFlushReceived(struct raft *r)
+{
+    struct legacyDispatch *dispatch = r->snapshot.dispatch;
+    struct legacyReceived received;
+    struct raft_event *event;
+    unsigned i;
+    int rv = 0;
+
+    if (dispatch == NULL || dispatch->received.n == 0) {
+        return;
     }
+    assert(!dispatch->busy);
 
-    return 0;
+    /* Take the messages, so that the dispatch object can be released by a
+     * callback fired while handling them. */
+    received = dispatch->received;
+    dispatch->received.items = NULL;
+    dispatch->received.n = 0;
+    dispatch->received.cap = 0;
+
+    if (r->legacy.closing) {
+        for (i = 0; i < received.n; i++) {
+            legacyDiscardMessage(&received.items[i]);
+        }
+        goto out;
+    }
+
+    dispatch->batch.n = 0;
+    for (i = 0; i < received.n; i++) {
+        event = legacyEventsPush(&dispatch->batch);
+        if (event == NULL) {
+            rv = RAFT_NOMEM;
+            break;
+        }
+        event->type = RAFT_RECEIVE;
+        event->receive.message = &received.items[i];
+    }
+
+    if (rv == 0) {
+        rv = legacyForward(r, dispatch->batch.items, dispatch->batch.n);
+    }
+
+    for (i = 0; i < received.n; i++) {
+        legacyReleaseMessage(&received.items[i], rv);
+    }
+
+    assert(rv == 0); /* TODO: just log warning? */
+
+out:
+    /* Give the array back for reuse, unless the dispatch object is gone. */
+    if (r->snapshot.dispatch == dispatch && dispatch->received.items == NULL) {
+        received.n = 0;
+        dispatch->received = received;
+    } else {
+        raft_free(received.items);
+    }
 }
 
 static void legacyLeadershipTransferInit(struct raft *r,
@@ -1245,62 +2030,77 @@ static void legacyLeadershipTransferInit(struct raft *r,
     r->transfer = req;
 }
 
-int raft_apply(struct raft *r,
-               struct raft_apply *req,
-               const struct raft_buffer bufs[],
-               const unsigned n,
-               raft_apply_cb cb)
+int LegacySubmit(struct raft *r,
+                 struct raft_entry entries[],
+                 struct request *reqs[],
+                 unsigned n)
 {
     raft_index index;
     struct raft_event event;
-    struct raft_entry entry;
+    unsigned i;
     int rv;
 
-    assert(r != NULL);
-    assert(bufs != NULL);
-    assert(n == 1);
+    assert(n > 0);
 
     /* Index of the first entry being appended. */
     index = logLastIndex(r->legacy.log) + 1;
-    req->type = RAFT_COMMAND;
-    req->index = index;
-    req->cb = cb;
 
-    entry.type = RAFT_COMMAND;
-    entry.term = r->current_term;
-    entry.buf = bufs[0];
-    entry.batch = entry.buf.base;
+    for (i = 0; i < n; i++) {
+        entries[i].term = r->current_term;
+        entries[i].batch = entries[i].buf.base;
+    }
 
     event.time = r->io->time(r->io);
     event.type = RAFT_SUBMIT;
-    event.submit.entries = &entry;
-    event.submit.n = 1;
+    event.submit.entries = entries;
+    event.submit.n = n;
 
     rv = LegacyForwardToRaftIo(r, &event);
     if (rv != 0) {
         return rv;
     }
 
-    QUEUE_PUSH(&r->legacy.pending, &req->queue);
+    for (i = 0; i < n; i++) {
+        assert(reqs[i]->type == (int)entries[i].type);
+        reqs[i]->index = index + i;
+        QUEUE_PUSH(&r->legacy.pending, &reqs[i]->queue);
+    }
 
     return 0;
 }
 
+int raft_apply(struct raft *r,
+               struct raft_apply *req,
+               const struct raft_buffer bufs[],
+               const unsigned n,
+               raft_apply_cb cb)
+{
+    struct raft_entry entry;
+    struct request *request = (struct request *)req;
+
+    assert(r != NULL);
+    assert(bufs != NULL);
+    assert(n == 1);
+
+    req->type = RAFT_COMMAND;
+    req->cb = cb;
+
+    entry.type = RAFT_COMMAND;
+    entry.buf = bufs[0];
+
+    return LegacySubmit(r, &entry, &request, 1);
+}
+
 int raft_barrier(struct raft *r, struct raft_barrier *req, raft_barrier_cb cb)
 {
-    struct raft_event event;
     struct raft_entry entry;
-    raft_index index;
+    struct request *request = (struct request *)req;
     int rv;
 
-    /* Index of the barrier entry being appended. */
-    index = logLastIndex(r->legacy.log) + 1;
     req->type = RAFT_BARRIER;
-    req->index = index;
     req->cb = cb;
 
     entry.type = RAFT_BARRIER;
-    entry.term = r->current_term;
     entry.buf.len = 8;
     entry.buf.base = raft_malloc(entry.buf.len);
 
@@ -1309,20 +2109,11 @@ int raft_barrier(struct raft *r, struct raft_barrier *req, raft_barrier_cb cb)
         goto err;
     }
 
-    entry.batch = entry.buf.base;
-
-    event.time = r->io->time(r->io);
-    event.type = RAFT_SUBMIT;
-    event.submit.entries = &entry;
-    event.submit.n = 1;
-
-    rv = LegacyForwardToRaftIo(r, &event);
+    rv = LegacySubmit(r, &entry, &request, 1);
     if (rv != 0) {
         goto err_after_buf_alloc;
     }
 
-    QUEUE_PUSH(&r->legacy.pending, &req->queue);
-
     return 0;
 
 err_after_buf_alloc:
@@ -1395,8 +2186,8 @@ int raft_add(struct raft *r,
         goto err_after_configuration_copy;
     }
 
-    assert(r->legacy.change == NULL);
-    r->legacy.change = req;
+    assert(r->snapshot.pending_change == NULL);
+    r->snapshot.pending_change = req;
 
     raft_configuration_close(&configuration);
 
@@ -1472,8 +2263,8 @@ int raft_assign(struct raft *r,
     req->cb = cb;
     req->catch_up_id = 0;
 
-    assert(r->legacy.change == NULL);
-    r->legacy.change = req;
+    assert(r->snapshot.pending_change == NULL);
+    r->snapshot.pending_change = req;
 
     /* If we are not promoting to the voter role or if the log of this
      * server is already up-to-date, we can submit the configuration change
@@ -1539,8 +2330,8 @@ int raft_remove(struct raft *r,
         goto err_after_configuration_copy;
     }
 
-    assert(r->legacy.change == NULL);
-    r->legacy.change = req;
+    assert(r->snapshot.pending_change == NULL);
+    r->snapshot.pending_change = req;
 
     raft_configuration_close(&configuration);
 
@@ -1613,6 +2404,12 @@ static void tickCb(struct raft_io *io)
 
     r = io->data;
 
+    /* A quiescent server has nothing to do until something else happens, see
+     * raft_set_quiescence(). */
+    if (raft_timeout(r) == ULLONG_MAX) {
+        return;
+    }
+
     event.type = RAFT_TIMEOUT;
     event.time = r->io->time(io);
 
@@ -1623,44 +2420,57 @@ static void tickCb(struct raft_io *io)
 static void recvCb(struct raft_io *io, struct raft_message *message)
 {
     struct raft *r = io->data;
+    struct legacyDispatch *dispatch;
+    struct raft_message *deferred;
     struct raft_event event;
     int rv;
 
     if (r->legacy.closing) {
-        switch (message->type) {
-            case RAFT_APPEND_ENTRIES:
-                entryBatchesDestroy(message->append_entries.entries,
-                                    message->append_entries.n_entries);
-                break;
-            case RAFT_INSTALL_SNAPSHOT:
-                raft_configuration_close(&message->install_snapshot.conf);
-                raft_free(message->install_snapshot.data.base);
-                break;
-            default:
-                break;
-        }
+        legacyDiscardMessage(message);
         return;
     }
 
+    /* Queue the message if the backend will hand all messages received in
+     * this loop iteration to raft_step_batch() at once. The message object
+     * itself is copied, since the backend might reuse it. */
+    if (r->legacy.recv_deferred) {
+        dispatch = legacyDispatchGet(r);
+        deferred = NULL;
+        if (dispatch != NULL && !dispatch->busy) {
+            deferred = legacyReceivedPush(&dispatch->received);
+        }
+        if (deferred != NULL) {
+            *deferred = *message;
+            return;
+        }
+    }
+
     event.type = RAFT_RECEIVE;
     event.time = r->io->time(r->io);
     event.receive.message = message;
 
     rv = LegacyForwardToRaftIo(r, &event);
 
-    switch (message->type) {
-        case RAFT_APPEND_ENTRIES:
-            if (message->append_entries.n_entries > 0) {
-                if (rv != 0) {
-                    raft_free(message->append_entries.entries[0].batch);
-                }
-                raft_free(message->append_entries.entries);
-            }
-            break;
-        default:
-            break;
+    legacyReleaseMessage(message, rv);
+
+    assert(rv == 0); /* TODO: just log warning? */
+}
+
+static void unreachableCb(struct raft_io *io, raft_id id)
+{
+    struct raft *r = io->data;
+    struct raft_event event;
+    int rv;
+
+    if (r->legacy.closing) {
+        return;
     }
 
+    event.type = RAFT_UNREACHABLE;
+    event.time = r->io->time(r->io);
+    event.unreachable.server_id = id;
+
+    rv = LegacyForwardToRaftIo(r, &event);
     assert(rv == 0); /* TODO: just log warning? */
 }
 
@@ -1755,13 +2565,19 @@ int raft_start(struct raft *r)
     }
 
     /* Start the I/O backend. The tickCb function is expected to fire every
-     * r->heartbeat_timeout milliseconds and recvCb whenever an RPC is
-     * received. */
+     * r->heartbeat_timeout milliseconds, or just when raft_timeout() expires
+     * if the backend supports it, and recvCb whenever an RPC is received. */
     rv = r->io->start(r->io, r->heartbeat_timeout, tickCb, recvCb);
     if (rv != 0) {
         tracef("io start failed %d", rv);
         goto out;
     }
+    legacySetDeadline(r);
+
+    /* Lost connections end quiescence. */
+    if (r->io->version >= 4 && r->io->set_unreachable_cb != NULL) {
+        r->io->set_unreachable_cb(r->io, unreachableCb);
+    }
 
 out:
     if (snapshot != NULL) {
@@ -1790,4 +2606,9 @@ void raft_set_snapshot_trailing(struct raft *r, unsigned n)
     r->legacy.snapshot_trailing = n;
 }
 
+void raft_set_snapshot_trailing_in_memory(struct raft *r, unsigned n)
+{
+    r->legacy.snapshot_trailing_memory = n;
+}
+
 #undef tracef
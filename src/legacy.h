@@ -4,11 +4,32 @@
 #define RAFT_LEGACY_H_
 
 #include "../include/raft.h"
+#include "request.h"
 
 /* Pass the given event to raft_step() and execute the resulting tasks using the
  * legacy raft_io interface. */
 int LegacyForwardToRaftIo(struct raft *r, struct raft_event *event);
 
+/* Queue messages received by the raft_io backend instead of handling them right
+ * away. The backend must then call LegacyFlushReceived() once per event loop
+ * iteration. */
+void LegacyDeferReceive(struct raft *r);
+
+/* Handle all queued received messages with a single raft_step_batch() call, so
+ * that their effects are combined, e.g. entries appended by several
+ * AppendEntries messages are persisted with a single write and acknowledged
+ * with a single result. */
+void LegacyFlushReceived(struct raft *r);
+
+/* Append the given entries with a single RAFT_SUBMIT event, and track each of
+ * them using the request at the same position, which must be a raft_apply or
+ * raft_barrier object whose type and callback are already set. The term of the
+ * entries is filled in. On failure the entry buffers are left to the caller. */
+int LegacySubmit(struct raft *r,
+                 struct raft_entry entries[],
+                 struct request *reqs[],
+                 unsigned n);
+
 /* Fail all pending client requests with RAFT_LEADERSHIPLOST. */
 void LegacyFailPendingRequests(struct raft *r);
 
@@ -17,4 +38,12 @@ void LegacyFireCompletedRequests(struct raft *r);
 
 void LegacyLeadershipTransferClose(struct raft *r);
 
+/* Release the buffers reused across calls to LegacyForwardToRaftIo(). */
+void LegacyDispatchClose(struct raft *r);
+
+/* Release all memory used by a closing raft instance and fire its close
+ * callback, if the raft_io object has been closed and no asynchronous FSM apply
+ * is in flight anymore. Defined in raft.c. */
+void LegacyMaybeFireCloseCb(struct raft *r);
+
 #endif /* RAFT_LEGACY_H_ */
@@ -34,6 +34,15 @@ static int messageEnsureQueueCapacity(struct raft *r, const unsigned n_messages)
     return 0;
 }
 
+unsigned short MessageFeatures(const struct raft *r)
+{
+    unsigned short features = MESSAGE__FEATURES;
+    if (r->compressed_payloads) {
+        features |= MESSAGE__FEATURE_LZ4;
+    }
+    return features;
+}
+
 int MessageEnqueue(struct raft *r, struct raft_message *message)
 {
     unsigned n_messages = r->update->messages.n + 1;
@@ -53,3 +62,57 @@ int MessageEnqueue(struct raft *r, struct raft_message *message)
 
     return 0;
 }
+
+/* Whether the later message @next makes the earlier message @prev redundant,
+ * as it's a successful AppendEntries result sent to the same server in the
+ * same term, acknowledging at least as many entries. */
+static bool messageSupersedes(const struct raft_message *prev,
+                              const struct raft_message *next)
+{
+    const struct raft_append_entries_result *a;
+    const struct raft_append_entries_result *b;
+
+    if (prev->type != RAFT_APPEND_ENTRIES_RESULT ||
+        next->type != RAFT_APPEND_ENTRIES_RESULT) {
+        return false;
+    }
+    if (prev->server_id != next->server_id) {
+        return false;
+    }
+
+    a = &prev->append_entries_result;
+    b = &next->append_entries_result;
+
+    return a->rejected == 0 && b->rejected == 0 && a->term == b->term &&
+           a->last_log_index <= b->last_log_index;
+}
+
+void MessageCoalesce(struct raft *r)
+{
+    struct raft_message *messages = r->update->messages.batch;
+    unsigned n = r->update->messages.n;
+    unsigned n_kept = 0;
+    unsigned i;
+    unsigned j;
+
+    for (i = 0; i < n; i++) {
+        for (j = i + 1; j < n; j++) {
+            if (messageSupersedes(&messages[i], &messages[j])) {
+                break;
+            }
+        }
+        if (j < n) {
+            continue;
+        }
+        if (n_kept != i) {
+            messages[n_kept] = messages[i];
+        }
+        n_kept++;
+    }
+
+    r->n_suppressed_results += n - n_kept;
+    r->update->messages.n = n_kept;
+    if (n_kept == 0) {
+        r->update->flags &= ~(unsigned)(RAFT_UPDATE_MESSAGES);
+    }
+}
@@ -9,12 +9,34 @@
 #define MESSAGE__REQUEST_VOTE_VERSION 2
 #define MESSAGE__REQUEST_VOTE_RESULT_VERSION 2
 #define MESSAGE__APPEND_ENTRIES_VERSION 0
-#define MESSAGE__APPEND_ENTRIES_RESULT_VERSION 2
+#define MESSAGE__APPEND_ENTRIES_LZ4_VERSION 1
+#define MESSAGE__APPEND_ENTRIES_FLAGS_VERSION 2
+#define MESSAGE__APPEND_ENTRIES_RESULT_VERSION 3
 #define MESSAGE__INSTALL_SNAPSHOT_VERSION 0
 #define MESSAGE__TIMEOUT_NOW_VERSION 0
 
 /* Feature flags */
 #define MESSAGE__FEATURE_CAPACITY 1 << 0
+#define MESSAGE__FEATURE_CONFLICT_TERM 1 << 1
+#define MESSAGE__FEATURE_LZ4 1 << 2
+#define MESSAGE__FEATURE_QUIESCE 1 << 3
+
+/* Features supported by every server. */
+#define MESSAGE__FEATURES                                         \
+    (MESSAGE__FEATURE_CAPACITY | MESSAGE__FEATURE_CONFLICT_TERM | \
+     MESSAGE__FEATURE_QUIESCE)
+
+/* AppendEntries flags */
+#define MESSAGE__APPEND_ENTRIES_LZ4 1 << 0     /* Payload may be compressed */
+#define MESSAGE__APPEND_ENTRIES_QUIESCE 1 << 1 /* Leader is idle */
+
+/* AppendEntries result flags */
+#define MESSAGE__APPEND_ENTRIES_RESULT_QUIESCED 1 << 0 /* Timer suspended */
+
+/* Features supported by the given server. Receiving LZ4-compressed
+ * AppendEntries payloads is only advertised if the I/O backend can decompress
+ * them, see raft_set_compressed_payloads(). */
+unsigned short MessageFeatures(const struct raft *r);
 
 /* Add the given message to the array of messages attached to the struct
  * raft_update to be returned.
@@ -26,4 +48,9 @@
  */
 int MessageEnqueue(struct raft *r, struct raft_message *message);
 
+/* Drop from the messages attached to the struct raft_update to be returned the
+ * ones made redundant by later messages to the same server, such as successful
+ * AppendEntries results superseded by more recent ones. */
+void MessageCoalesce(struct raft *r);
+
 #endif /* RAFT_MESSAGE_H_ */
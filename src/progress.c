@@ -4,6 +4,7 @@
 
 #include "assert.h"
 #include "configuration.h"
+#include "message.h"
 #include "tracing.h"
 #include "trail.h"
 
@@ -31,6 +32,8 @@ static void initProgress(struct raft_progress *p, raft_index last_index)
     p->catch_up = RAFT_CATCH_UP_NONE;
     p->features = 0;
     p->capacity = 0;
+    p->quiesce = false;
+    p->quiesced = false;
 }
 
 struct raft_progress *progressBuildArray(struct raft *r)
@@ -150,10 +153,11 @@ bool progressShouldReplicate(struct raft *r, unsigned i)
 
     /* If we never sent any AppendEntries message to this follower, or if the
      * last time we sent it an AppendEntries message was more than a heartbeat
-     * timeout ago, we need to send a heartbeat. */
+     * timeout ago, we need to send a heartbeat. Unless the whole group is
+     * quiescent. */
     if (p->last_send == ULLONG_MAX ||
         r->now - p->last_send >= r->heartbeat_timeout) {
-        needs_heartbeat = true;
+        needs_heartbeat = !(r->leader_state.quiescent && p->quiesced);
     }
 
     switch (p->state) {
@@ -301,7 +305,9 @@ const char *progressStateName(struct raft *r, unsigned i)
 bool progressMaybeDecrement(struct raft *r,
                             const unsigned i,
                             raft_index rejected,
-                            raft_index last_index)
+                            raft_index last_index,
+                            raft_term conflict_term,
+                            raft_index conflict_index)
 {
     struct raft_progress *p = &r->leader_state.progress[i];
 
@@ -368,6 +374,25 @@ bool progressMaybeDecrement(struct raft *r,
     }
 
     p->next_index = min(rejected, last_index + 1);
+
+    /* If the follower told us the term of the conflicting entry, skip all its
+     * entries in that term: if we have entries in that term, resume from the
+     * last one, otherwise resume from the first one the follower has. */
+    if (conflict_term > 0 && (p->features & MESSAGE__FEATURE_CONFLICT_TERM)) {
+        raft_index next_index = TrailTermEnd(&r->trail, conflict_term);
+        if (next_index == 0) {
+            next_index = conflict_index;
+        } else {
+            next_index += 1;
+        }
+        next_index = max(next_index, p->match_index + 1);
+        if (next_index < p->next_index) {
+            infof("skip conflicting term %llu -> next index %llu",
+                  conflict_term, next_index);
+            p->next_index = next_index;
+        }
+    }
+
     assert(p->next_index > 0);
 
     assert(p->match_index < p->next_index);
@@ -448,5 +473,29 @@ int progressCatchUpStatus(const struct raft *r, unsigned i)
     return p->catch_up;
 }
 
+void progressUpdateQuiesce(struct raft *r, unsigned i, bool quiesce)
+{
+    struct raft_progress *p = &r->leader_state.progress[i];
+    p->quiesce = quiesce;
+    if (!quiesce) {
+        p->quiesced = false;
+    }
+}
+
+bool progressMaybeQuiesced(struct raft *r, unsigned i)
+{
+    struct raft_progress *p = &r->leader_state.progress[i];
+    if (!p->quiesce) {
+        return false;
+    }
+    p->quiesced = true;
+    return true;
+}
+
+bool progressIsQuiesced(const struct raft *r, unsigned i)
+{
+    return r->leader_state.progress[i].quiesced;
+}
+
 #undef infof
 #undef tracef
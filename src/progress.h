@@ -30,6 +30,8 @@ struct raft_progress
         raft_index index;    /* Last index of most recent snapshot sent. */
         raft_time last_send; /* Timestamp of last InstallSnaphot RPC. */
     } snapshot;
+    bool quiesce;  /* Whether the last AppendEntries asked to quiesce. */
+    bool quiesced; /* Whether the server confirmed it's quiescent. */
 };
 
 /* Create and initialize the array of progress objects used by the leader to
@@ -136,12 +138,16 @@ bool progressMaybeUpdate(struct raft *r, unsigned i, raft_index last_index);
 
 /* Return false if the given rejected index comes from an out of order
  * message. Otherwise decrease the progress next index to min(rejected,
- * last_index) and returns true. To be called when receiving an unsuccessful
- * AppendEntries RPC response. */
+ * last_index) and returns true. If the server supports conflict term hints and
+ * reported the term of the conflicting entry, the next index is further moved
+ * back past all its entries in that term. To be called when receiving an
+ * unsuccessful AppendEntries RPC response. */
 bool progressMaybeDecrement(struct raft *r,
                             unsigned i,
                             raft_index rejected,
-                            raft_index last_index);
+                            raft_index last_index,
+                            raft_term conflict_term,
+                            raft_index conflict_index);
 
 /* Return true if match_index is equal or higher than the snapshot_index. */
 bool progressSnapshotDone(struct raft *r, unsigned i);
@@ -171,4 +177,16 @@ void progressCatchUpFinish(struct raft *r, unsigned i);
 /* Return the information about the catch-up progress of a server. */
 int progressCatchUpStatus(const struct raft *r, unsigned i);
 
+/* Record whether the last AppendEntries request sent to the i'th server asked
+ * it to quiesce. If not, the server is not considered quiescent anymore. */
+void progressUpdateQuiesce(struct raft *r, unsigned i, bool quiesce);
+
+/* Record that the i'th server confirmed it's quiescent. Return false if the
+ * last AppendEntries request sent to it did not ask to quiesce, in which case
+ * the confirmation is stale. */
+bool progressMaybeQuiesced(struct raft *r, unsigned i);
+
+/* Whether the i'th server has confirmed it's quiescent. */
+bool progressIsQuiesced(const struct raft *r, unsigned i);
+
 #endif /* PROGRESS_H_ */
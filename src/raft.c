@@ -110,6 +110,9 @@ int raft_init(struct raft *r,
     r->follower_state.current_leader.id = 0;
     r->follower_state.current_leader.address = NULL;
     r->follower_state.match = 0;
+    r->follower_state.result_sent = false;
+    r->follower_state.result_pending = false;
+    r->follower_state.quiescent = false;
     r->snapshot.installing = false;
     memset(r->errmsg, 0, sizeof r->errmsg);
     r->pre_vote = false;
@@ -118,7 +121,13 @@ int raft_init(struct raft *r,
     r->now = 0;
     r->messages = NULL;
     r->n_messages_cap = 0;
+    r->entries = NULL;
+    r->n_entries_cap = 0;
     r->max_inflight_entries = DEFAULT_MAX_INFLIGHT_ENTRIES;
+    r->results_window = 0;
+    r->quiescence = false;
+    r->compressed_payloads = false;
+    r->n_suppressed_results = 0;
     r->update = NULL;
     r->capacity = 0;
     r->capacity_threshold = 0;
@@ -148,20 +157,29 @@ int raft_init(struct raft *r,
         }
         r->now = r->io->time(r->io);
         raft_seed(r, (unsigned)r->io->random(r->io, 0, INT_MAX));
+        if (r->io->version >= 6 && (r->io->features & RAFT_IO_LZ4)) {
+            r->compressed_payloads = true;
+        }
         r->legacy.prev_state = r->state;
         r->legacy.closing = false;
+        r->legacy.closed = false;
+        r->legacy.applying = 0;
+        r->legacy.applying_entries = false;
+        r->legacy.recv_deferred = false;
         QUEUE_INIT(&r->legacy.pending);
         QUEUE_INIT(&r->legacy.requests);
         r->legacy.step_cb = NULL;
-        r->legacy.change = NULL;
+        r->snapshot.pending_change = NULL;
         r->legacy.snapshot_index = 0;
         r->legacy.snapshot_taking = false;
         r->legacy.snapshot_install = false;
-        r->legacy.snapshot_pending = NULL;
+        r->snapshot.pending_install = NULL;
         r->transfer = NULL;
         r->legacy.log = logInit();
         r->legacy.snapshot_threshold = DEFAULT_SNAPSHOT_THRESHOLD;
         r->legacy.snapshot_trailing = DEFAULT_SNAPSHOT_TRAILING;
+        r->legacy.snapshot_trailing_memory = UINT_MAX;
+        r->snapshot.dispatch = NULL;
         if (r->legacy.log == NULL) {
             goto err_after_address_alloc;
         }
@@ -186,6 +204,7 @@ static void finalClose(struct raft *r)
 #ifndef RAFT__LEGACY_no
     if (r->io != NULL) {
         logClose(r->legacy.log);
+        LegacyDispatchClose(r);
     }
 #endif
     raft_configuration_close(&r->configuration);
@@ -193,17 +212,35 @@ static void finalClose(struct raft *r)
     if (r->messages != NULL) {
         raft_free(r->messages);
     }
+    if (r->entries != NULL) {
+        raft_free(r->entries);
+    }
 }
 
 #ifndef RAFT__LEGACY_no
-static void ioCloseCb(struct raft_io *io)
+void LegacyMaybeFireCloseCb(struct raft *r)
 {
-    struct raft *r = io->data;
+    assert(r->legacy.closing);
+
+    /* Wait for both the raft_io object to be closed and for all in-flight
+     * asynchronous FSM applies to complete, since they hold references to
+     * entries in the log. */
+    if (!r->legacy.closed || r->legacy.applying > 0) {
+        return;
+    }
+
     finalClose(r);
     if (r->close_cb != NULL) {
         r->close_cb(r);
     }
 }
+
+static void ioCloseCb(struct raft_io *io)
+{
+    struct raft *r = io->data;
+    r->legacy.closed = true;
+    LegacyMaybeFireCloseCb(r);
+}
 #endif
 
 void raft_close(struct raft *r, void (*cb)(struct raft *r))
@@ -496,22 +533,11 @@ int stepTimeout(struct raft *r)
     return Timeout(r);
 }
 
-int raft_step(struct raft *r,
-              struct raft_event *event,
-              struct raft_update *update)
+/* Handle a single event, accumulating its effects in r->update. */
+static int stepEvent(struct raft *r, struct raft_event *event)
 {
     int rv;
 
-    assert(event != NULL);
-    assert(update != NULL);
-
-    assert(r->update == NULL);
-
-    r->update = update;
-    r->update->flags = 0;
-    r->update->messages.batch = r->messages;
-    r->update->messages.n = 0;
-
     r->now = event->time;
     r->capacity = event->capacity;
 
@@ -519,7 +545,7 @@ int raft_step(struct raft *r,
     if (r->state == RAFT_LEADER) {
         unsigned i = configurationIndexOf(&r->configuration, r->id);
         if (i < r->configuration.n) {
-            progressSetFeatures(r, i, MESSAGE__FEATURE_CAPACITY);
+            progressSetFeatures(r, i, MessageFeatures(r));
             progressSetCapacity(r, i, r->capacity);
         }
     }
@@ -566,16 +592,137 @@ int raft_step(struct raft *r,
             infof("transfer leadership to %llu", event->transfer.server_id);
             rv = ClientTransfer(r, event->transfer.server_id);
             break;
+        case RAFT_CONGESTED:
+            infof("connection to server %llu is congested",
+                  event->congested.server_id);
+            replicationCongested(r, event->congested.server_id);
+            rv = 0;
+            break;
+        case RAFT_UNREACHABLE:
+            infof("connection to server %llu was lost",
+                  event->unreachable.server_id);
+            replicationUnreachable(r, event->unreachable.server_id);
+            rv = 0;
+            break;
         default:
             rv = RAFT_INVALID;
             break;
     }
 
+    return rv;
+}
+
+static void stepBegin(struct raft *r, struct raft_update *update)
+{
+    assert(update != NULL);
+    assert(r->update == NULL);
+
+    r->update = update;
+    r->update->flags = 0;
+    r->update->messages.batch = r->messages;
+    r->update->messages.n = 0;
+}
+
+int raft_step(struct raft *r,
+              struct raft_event *event,
+              struct raft_update *update)
+{
+    int rv;
+
+    assert(event != NULL);
+
+    stepBegin(r, update);
+    rv = stepEvent(r, event);
+    if (rv == 0) {
+        replicationFlushResult(r);
+    }
+    r->update = NULL;
+
     if (rv != 0) {
-        goto out;
+        return rv;
     }
+    return 0;
+}
+
+/* Return the address of the server with the given ID, looking first at the
+ * current configuration and then at the messages received in the batch. */
+static const char *stepBatchAddressOf(struct raft *r,
+                                      struct raft_event events[],
+                                      unsigned n,
+                                      raft_id id)
+{
+    const struct raft_server *server;
+    unsigned i;
+
+    server = configurationGet(&r->configuration, id);
+    if (server != NULL) {
+        return server->address;
+    }
+
+    for (i = 0; i < n; i++) {
+        struct raft_message *message;
+        if (events[i].type != RAFT_RECEIVE) {
+            continue;
+        }
+        message = events[i].receive.message;
+        if (message->server_id == id) {
+            return message->server_address;
+        }
+    }
+
+    return NULL;
+}
+
+/* Messages queued while handling an event might point to the address of a
+ * server in a configuration that a later event replaced, so refresh them, and
+ * drop the ones directed to servers that are not known anymore. */
+static void stepBatchResolveAddresses(struct raft *r,
+                                      struct raft_event events[],
+                                      unsigned n)
+{
+    struct raft_message *messages = r->update->messages.batch;
+    unsigned n_kept = 0;
+    unsigned i;
+
+    for (i = 0; i < r->update->messages.n; i++) {
+        const char *address =
+            stepBatchAddressOf(r, events, n, messages[i].server_id);
+        if (address == NULL) {
+            continue;
+        }
+        messages[n_kept] = messages[i];
+        messages[n_kept].server_address = address;
+        n_kept++;
+    }
+
+    r->update->messages.n = n_kept;
+}
+
+int raft_step_batch(struct raft *r,
+                    struct raft_event events[],
+                    unsigned n,
+                    struct raft_update *update)
+{
+    unsigned i;
+    int rv = 0;
 
-out:
+    assert(events != NULL);
+    assert(n > 0);
+
+    stepBegin(r, update);
+    for (i = 0; i < n; i++) {
+        rv = stepEvent(r, &events[i]);
+        if (rv != 0) {
+            break;
+        }
+    }
+    if (rv == 0) {
+        replicationFlushResult(r);
+    }
+    if (n > 1) {
+        stepBatchResolveAddresses(r, events, n);
+    }
+    MessageCoalesce(r);
     r->update = NULL;
 
     if (rv != 0) {
@@ -635,13 +782,29 @@ raft_time raft_timeout(const struct raft *r)
     raft_time timeout;
     switch (r->state) {
         case RAFT_FOLLOWER:
-            /* fallthrough */
+            timeout = electionTimerExpiration(r);
+            if (r->follower_state.quiescent) {
+                timeout = ULLONG_MAX;
+            }
+            /* A delayed AppendEntries result must be sent when the results
+             * window expires. */
+            if (r->follower_state.result_pending) {
+                raft_time deadline =
+                    r->follower_state.result_time + r->results_window;
+                if (deadline < timeout) {
+                    timeout = deadline;
+                }
+            }
+            break;
         case RAFT_CANDIDATE:
             timeout = electionTimerExpiration(r);
             break;
         case RAFT_LEADER:
             /* The next timeout is either for heartbeat or a quorum check. */
             timeout = leaderTimeout(r);
+            if (r->leader_state.quiescent) {
+                timeout = ULLONG_MAX;
+            }
             break;
         default:
             timeout = 0;
@@ -752,6 +915,26 @@ void raft_set_capacity_threshold(struct raft *r, unsigned short min)
     r->capacity_threshold = min;
 }
 
+void raft_set_append_results_window(struct raft *r, unsigned msecs)
+{
+    r->results_window = msecs;
+}
+
+uint64_t raft_suppressed_append_results(const struct raft *r)
+{
+    return r->n_suppressed_results;
+}
+
+void raft_set_quiescence(struct raft *r, bool enabled)
+{
+    r->quiescence = enabled;
+}
+
+void raft_set_compressed_payloads(struct raft *r, bool enabled)
+{
+    r->compressed_payloads = enabled;
+}
+
 const char *raft_errmsg(struct raft *r)
 {
     return r->errmsg;
@@ -91,8 +91,11 @@ void recvBumpCurrentTerm(struct raft *r, raft_term term)
     }
 
     /* Reset the match index, because we don't know anything about the leader of
-     * this new term yet. */
+     * this new term yet. Any delayed result is now stale. */
     r->follower_state.match = 0;
+    r->follower_state.result_sent = false;
+    r->follower_state.result_pending = false;
+    r->follower_state.quiescent = false;
 }
 
 int recvCheckMatchingTerms(const struct raft *r, raft_term term)
@@ -23,6 +23,8 @@ int recvAppendEntries(struct raft *r,
     raft_index last_index;
     int match;
     bool async;
+    bool delayed = false;
+    bool quiesce;
     int rv;
 
     assert(r != NULL);
@@ -32,7 +34,10 @@ int recvAppendEntries(struct raft *r,
 
     result->rejected = args->prev_log_index;
     result->version = MESSAGE__APPEND_ENTRIES_RESULT_VERSION;
-    result->features = MESSAGE__FEATURE_CAPACITY;
+    result->features = MessageFeatures(r);
+    result->flags = 0;
+    result->conflict_term = 0;
+    result->conflict_index = 0;
 
     match = recvEnsureMatchingTerms(r, args->term);
 
@@ -102,6 +107,15 @@ int recvAppendEntries(struct raft *r,
     r->election_timer_start = r->now;
     r->update->flags |= RAFT_UPDATE_TIMEOUT;
 
+    /* Anything but a heartbeat from an idle leader ends quiescence, see
+     * raft_set_quiescence(). */
+    quiesce = r->quiescence &&
+              args->version >= MESSAGE__APPEND_ENTRIES_FLAGS_VERSION &&
+              (args->flags & (MESSAGE__APPEND_ENTRIES_QUIESCE));
+    if (!quiesce) {
+        r->follower_state.quiescent = false;
+    }
+
     /* If we are installing a snapshot, ignore these entries. TODO: we should do
      * something smarter, e.g. buffering the entries in the I/O backend, which
      * should be in charge of serializing everything. */
@@ -137,6 +151,14 @@ int recvAppendEntries(struct raft *r,
         if (result->last_log_index >= result->rejected) {
             result->last_log_index = result->rejected - 1;
         }
+        /* In the second case, also report the term of the conflicting entry
+         * and the first index of that term, so the leader can skip all
+         * entries in that term at once. */
+        if (TrailHasEntry(&r->trail, result->rejected)) {
+            result->conflict_term = TrailTermOf(&r->trail, result->rejected);
+            result->conflict_index =
+                TrailTermStart(&r->trail, result->rejected);
+        }
     } else {
         /* In case of synchronous success we expect to have all entries, and no
          * new entry needs to be persisted. However we might still be persisting
@@ -151,6 +173,22 @@ int recvAppendEntries(struct raft *r,
         if (result->last_log_index > r->last_stored) {
             result->last_log_index = r->last_stored;
         }
+
+        /* If our log is complete and committed we can stop expecting
+         * heartbeats, and confirm it to the leader. */
+        if (quiesce && args->n_entries == 0 &&
+            args->prev_log_index == last_index &&
+            args->leader_commit == last_index && r->last_stored == last_index) {
+            if (!r->follower_state.quiescent) {
+                infof("leader is idle -> suspend election timer");
+                r->follower_state.quiescent = true;
+            }
+            result->flags |= MESSAGE__APPEND_ENTRIES_RESULT_QUIESCED;
+        } else {
+            r->follower_state.quiescent = false;
+        }
+
+        delayed = !replicationShouldSendResult(r, result);
     }
 
 reply:
@@ -164,6 +202,10 @@ reply:
 
     result->capacity = r->capacity;
 
+    if (delayed) {
+        return 0;
+    }
+
     message.type = RAFT_APPEND_ENTRIES_RESULT;
     message.server_id = id;
     message.server_address = address;
@@ -24,7 +24,10 @@ int recvInstallSnapshot(struct raft *r,
     assert(address != NULL);
 
     result->version = MESSAGE__APPEND_ENTRIES_RESULT_VERSION;
-    result->features = MESSAGE__FEATURE_CAPACITY;
+    result->features = MessageFeatures(r);
+    result->flags = 0;
+    result->conflict_term = 0;
+    result->conflict_index = 0;
 
     match = recvEnsureMatchingTerms(r, args->term);
 
@@ -50,6 +53,7 @@ int recvInstallSnapshot(struct raft *r,
     }
     r->election_timer_start = r->now;
     r->update->flags |= RAFT_UPDATE_TIMEOUT;
+    r->follower_state.quiescent = false;
 
     rv = replicationInstallSnapshot(r, args, &async);
     if (rv != 0) {
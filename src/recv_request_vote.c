@@ -51,6 +51,17 @@ int recvRequestVote(struct raft *r,
     has_leader =
         r->state == RAFT_LEADER ||
         (r->state == RAFT_FOLLOWER && r->follower_state.current_leader.id != 0);
+
+    /* A quiescent follower doesn't hear from its leader anymore, so if the
+     * leader itself is asking for votes it must have stepped down. */
+    if (r->state == RAFT_FOLLOWER && r->follower_state.quiescent &&
+        r->follower_state.current_leader.id == id) {
+        infof("leader is campaigning -> resume election timer");
+        r->follower_state.quiescent = false;
+        electionResetTimer(r);
+        has_leader = false;
+    }
+
     if (has_leader && !args->disrupt_leader) {
         if (r->state == RAFT_LEADER) {
             infof("local server is leader -> reject");
@@ -116,7 +127,7 @@ reply:
         result->term = args->term;
     }
 
-    result->features = MESSAGE__FEATURE_CAPACITY;
+    result->features = MessageFeatures(r);
     result->capacity = r->capacity;
 
     message.type = RAFT_REQUEST_VOTE_RESULT;
@@ -4,6 +4,7 @@
 #include "assert.h"
 #include "configuration.h"
 #include "convert.h"
+#include "election.h"
 #include "entry.h"
 #ifdef __GLIBC__
 #include "error.h"
@@ -31,6 +32,83 @@
 #define min(a, b) ((a) < (b) ? (a) : (b))
 #endif
 
+/* Whether the group is idle and the followers can be asked to quiesce: all
+ * entries are committed and replicated on every server that gets heartbeats,
+ * and no promotion or leadership transfer is in progress. */
+static bool replicationIsIdle(struct raft *r)
+{
+    raft_index last_index = TrailLastIndex(&r->trail);
+    unsigned i;
+
+    if (!r->quiescence) {
+        return false;
+    }
+    if (r->commit_index < last_index || r->last_stored < last_index) {
+        return false;
+    }
+    if (r->leader_state.promotee_id != 0 || r->leader_state.transferee != 0) {
+        return false;
+    }
+
+    for (i = 0; i < r->configuration.n; i++) {
+        const struct raft_server *server = &r->configuration.servers[i];
+        if (server->id == r->id || server->role == RAFT_SPARE) {
+            continue;
+        }
+        if (!(progressGetFeatures(r, i) & (MESSAGE__FEATURE_QUIESCE))) {
+            return false;
+        }
+        if (progressState(r, i) == PROGRESS__SNAPSHOT ||
+            progressMatchIndex(r, i) != last_index) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* Stop sending heartbeats if all servers that get them confirmed they are
+ * quiescent. */
+static void replicationMaybeQuiesce(struct raft *r)
+{
+    unsigned i;
+
+    if (r->leader_state.quiescent || !replicationIsIdle(r)) {
+        return;
+    }
+
+    for (i = 0; i < r->configuration.n; i++) {
+        const struct raft_server *server = &r->configuration.servers[i];
+        if (server->id == r->id || server->role == RAFT_SPARE) {
+            continue;
+        }
+        if (!progressIsQuiesced(r, i)) {
+            return;
+        }
+    }
+
+    infof("all servers are quiescent -> stop heartbeats");
+    r->leader_state.quiescent = true;
+    r->update->flags |= RAFT_UPDATE_TIMEOUT;
+}
+
+void replicationUnquiesce(struct raft *r)
+{
+    assert(r->state == RAFT_LEADER);
+
+    if (!r->leader_state.quiescent) {
+        return;
+    }
+
+    infof("leave quiescence -> resume heartbeats");
+    r->leader_state.quiescent = false;
+
+    /* Followers have not been contacting us, give them a full election timeout
+     * before checking again that a majority of them is reachable. */
+    r->election_timer_start = r->now;
+    r->update->flags |= RAFT_UPDATE_TIMEOUT;
+}
+
 /* Send an AppendEntries message to the i'th server, including all log entries
  * from the given point onwards. */
 static int sendAppendEntries(struct raft *r,
@@ -43,6 +121,8 @@ static int sendAppendEntries(struct raft *r,
     struct raft_message message;
     struct raft_append_entries *args = &message.append_entries;
     raft_index next_index = prev_index + 1;
+    unsigned short features = progressGetFeatures(r, i);
+    bool quiesce = false;
     int rv;
 
     args->term = r->current_term;
@@ -101,7 +181,27 @@ static int sendAppendEntries(struct raft *r,
               TrailTermOf(&r->trail, next_index + args->n_entries - 1));
     }
 
-    args->version = MESSAGE__APPEND_ENTRIES_VERSION;
+    /* Heartbeats sent while the group is idle ask the follower to quiesce. */
+    if (args->n_entries == 0 && replicationIsIdle(r)) {
+        quiesce = true;
+    }
+
+    /* Let the transport know that it may compress the entries payload, if the
+     * follower is able to decompress it. */
+    args->flags = 0;
+    if (features & (MESSAGE__FEATURE_QUIESCE)) {
+        args->version = MESSAGE__APPEND_ENTRIES_FLAGS_VERSION;
+        if (features & (MESSAGE__FEATURE_LZ4)) {
+            args->flags |= MESSAGE__APPEND_ENTRIES_LZ4;
+        }
+        if (quiesce) {
+            args->flags |= MESSAGE__APPEND_ENTRIES_QUIESCE;
+        }
+    } else if (features & (MESSAGE__FEATURE_LZ4)) {
+        args->version = MESSAGE__APPEND_ENTRIES_LZ4_VERSION;
+    } else {
+        args->version = MESSAGE__APPEND_ENTRIES_VERSION;
+    }
 
     message.type = RAFT_APPEND_ENTRIES;
     message.server_id = server->id;
@@ -118,6 +218,13 @@ static int sendAppendEntries(struct raft *r,
     }
 
     progressUpdateLastSend(r, i);
+
+    /* Anything but a heartbeat asking to quiesce wakes the follower up. */
+    progressUpdateQuiesce(r, i, quiesce);
+    if (!quiesce) {
+        replicationUnquiesce(r);
+    }
+
     return 0;
 
 err:
@@ -363,23 +470,127 @@ int replicationPersistEntriesDone(struct raft *r, raft_index index)
     return 0;
 }
 
-static void persistEntries(struct raft *r,
-                           raft_index index,
-                           struct raft_entry entries[],
-                           unsigned n)
+/* Release the batches of the entries in [from, n) that are not referenced by
+ * any entry in [0, from). */
+static void releaseDroppedBatches(struct raft_entry *entries,
+                                  unsigned from,
+                                  unsigned n)
+{
+    unsigned i;
+    unsigned j;
+
+    for (i = from; i < n; i++) {
+        void *batch = entries[i].batch;
+        if (batch == NULL) {
+            continue;
+        }
+        for (j = 0; j < i; j++) {
+            if (entries[j].batch == batch) {
+                break;
+            }
+        }
+        if (j == i) {
+            raft_free(batch);
+        }
+    }
+}
+
+/* Ensure that the r->entries array has at least n slots. */
+static int ensureEntriesCapacity(struct raft *r, unsigned n)
+{
+    struct raft_entry *entries;
+    unsigned n_entries_cap = r->n_entries_cap;
+
+    if (n <= n_entries_cap) {
+        return 0;
+    }
+
+    if (n_entries_cap == 0) {
+        n_entries_cap = 16; /* Initial cap */
+    }
+    while (n_entries_cap < n) {
+        n_entries_cap *= 2;
+    }
+
+    entries = raft_realloc(r->entries, sizeof *entries * n_entries_cap);
+    if (entries == NULL) {
+        return RAFT_NOMEM;
+    }
+
+    /* The entries being merged might already live in the old array. */
+    if (r->update->entries.batch == r->entries) {
+        r->update->entries.batch = entries;
+    }
+    r->entries = entries;
+    r->n_entries_cap = n_entries_cap;
+
+    return 0;
+}
+
+/* Merge new entries to persist with the ones set by a previous event handled
+ * in the same raft_step_batch() call. The new entries either follow the
+ * previous ones or replace a suffix of them, in case of a log truncation. */
+static int mergeEntries(struct raft *r,
+                        raft_index index,
+                        struct raft_entry entries[],
+                        unsigned n)
+{
+    struct raft_update *update = r->update;
+    unsigned kept = 0;
+    int rv;
+
+    assert(index <= update->entries.index + update->entries.n);
+
+    if (index > update->entries.index) {
+        kept = (unsigned)(index - update->entries.index);
+        rv = ensureEntriesCapacity(r, kept + n);
+        if (rv != 0) {
+            return rv;
+        }
+    }
+
+    /* The consumer will never see the replaced entries, so release them. */
+    releaseDroppedBatches(update->entries.batch, kept, update->entries.n);
+
+    if (kept == 0) {
+        update->entries.index = index;
+        update->entries.batch = entries;
+        update->entries.n = n;
+        return 0;
+    }
+
+    if (update->entries.batch != r->entries) {
+        memcpy(r->entries, update->entries.batch, kept * sizeof *entries);
+    }
+    memcpy(&r->entries[kept], entries, n * sizeof *entries);
+
+    update->entries.batch = r->entries;
+    update->entries.n = kept + n;
+
+    return 0;
+}
+
+static int persistEntries(struct raft *r,
+                          raft_index index,
+                          struct raft_entry entries[],
+                          unsigned n)
 {
     assert(n > 0);
     assert(entries != NULL);
 
-    /* This must be the first time during this raft_step() call where we set new
-     * entries to be persisted. */
-    assert(!(r->update->flags & RAFT_UPDATE_ENTRIES));
+    /* If a previous event handled by this raft_step_batch() call already set
+     * entries to be persisted, merge them. */
+    if (r->update->flags & RAFT_UPDATE_ENTRIES) {
+        return mergeEntries(r, index, entries, n);
+    }
 
     r->update->flags |= RAFT_UPDATE_ENTRIES;
 
     r->update->entries.index = index;
     r->update->entries.batch = entries;
     r->update->entries.n = n;
+
+    return 0;
 }
 
 int replicationTrigger(struct raft *r,
@@ -387,7 +598,11 @@ int replicationTrigger(struct raft *r,
                        struct raft_entry *entries,
                        unsigned n)
 {
-    persistEntries(r, index, entries, n);
+    int rv;
+    rv = persistEntries(r, index, entries, n);
+    if (rv != 0) {
+        return rv;
+    }
     return triggerAll(r);
 }
 
@@ -423,8 +638,9 @@ int replicationUpdate(struct raft *r,
      */
     if (result->rejected > 0) {
         bool retry;
-        retry = progressMaybeDecrement(r, i, result->rejected,
-                                       result->last_log_index);
+        retry = progressMaybeDecrement(
+            r, i, result->rejected, result->last_log_index,
+            result->conflict_term, result->conflict_index);
         if (retry) {
             /* Retry, ignoring errors. */
             infof("log mismatch -> send old entries");
@@ -450,6 +666,13 @@ int replicationUpdate(struct raft *r,
      *   If successful update nextIndex and matchIndex for follower.
      */
     if (!progressMaybeUpdate(r, i, last_index)) {
+        /* A quiescent server confirms it with a result that doesn't carry
+         * news about its log. */
+        if ((result->flags & (MESSAGE__APPEND_ENTRIES_RESULT_QUIESCED)) &&
+            last_index == TrailLastIndex(&r->trail) &&
+            progressMaybeQuiesced(r, i)) {
+            replicationMaybeQuiesce(r);
+        }
         return 0;
     }
 
@@ -534,12 +757,16 @@ static void sendAppendEntriesResult(
         return;
     }
 
+    message.append_entries_result = *result;
+
     if (result->rejected == 0) {
+        if (!replicationShouldSendResult(r, &message.append_entries_result)) {
+            return;
+        }
         infof("send success result to %llu", id);
     }
 
     message.type = RAFT_APPEND_ENTRIES_RESULT;
-    message.append_entries_result = *result;
 
     message.server_id = id;
     message.server_address = address;
@@ -551,6 +778,78 @@ static void sendAppendEntriesResult(
     }
 }
 
+bool replicationShouldSendResult(struct raft *r,
+                                 struct raft_append_entries_result *result)
+{
+    raft_index last_log_index;
+
+    assert(r->state == RAFT_FOLLOWER);
+    assert(result->rejected == 0);
+
+    if (r->results_window == 0) {
+        return true;
+    }
+
+    if (r->follower_state.result_sent &&
+        r->now < r->follower_state.result_time + r->results_window) {
+        /* If another result was already pending, it gets merged into this
+         * one. */
+        if (r->follower_state.result_pending) {
+            r->n_suppressed_results++;
+        }
+        infof("delay success result");
+        r->follower_state.result_pending = true;
+        r->update->flags |= RAFT_UPDATE_TIMEOUT;
+        return false;
+    }
+
+    if (r->follower_state.result_pending) {
+        r->n_suppressed_results++;
+        r->follower_state.result_pending = false;
+    }
+
+    /* Always report the highest index that we can safely acknowledge. */
+    last_log_index = min(r->last_stored, r->follower_state.match);
+    if (result->last_log_index < last_log_index) {
+        result->last_log_index = last_log_index;
+    }
+
+    r->follower_state.result_time = r->now;
+    r->follower_state.result_sent = true;
+
+    return true;
+}
+
+void replicationFlushResult(struct raft *r)
+{
+    struct raft_append_entries_result result;
+
+    if (r->state != RAFT_FOLLOWER || !r->follower_state.result_pending) {
+        return;
+    }
+
+    if (r->now < r->follower_state.result_time + r->results_window) {
+        return;
+    }
+
+    r->follower_state.result_pending = false;
+
+    result.term = r->current_term;
+    result.version = MESSAGE__APPEND_ENTRIES_RESULT_VERSION;
+    result.features = MessageFeatures(r);
+    result.flags = 0;
+    if (r->follower_state.quiescent) {
+        result.flags |= MESSAGE__APPEND_ENTRIES_RESULT_QUIESCED;
+    }
+    result.conflict_term = 0;
+    result.conflict_index = 0;
+    result.rejected = 0;
+    result.last_log_index = min(r->last_stored, r->follower_state.match);
+    result.capacity = r->capacity;
+
+    sendAppendEntriesResult(r, &result);
+}
+
 static void followerPersistEntriesDone(struct raft *r, raft_index index)
 {
     struct raft_append_entries_result result;
@@ -559,7 +858,10 @@ static void followerPersistEntriesDone(struct raft *r, raft_index index)
 
     result.term = r->current_term;
     result.version = MESSAGE__APPEND_ENTRIES_RESULT_VERSION;
-    result.features = MESSAGE__FEATURE_CAPACITY;
+    result.features = MessageFeatures(r);
+    result.flags = 0;
+    result.conflict_term = 0;
+    result.conflict_index = 0;
 
     /* We received an InstallSnapshot RPC while these entries were being
      * persisted to disk */
@@ -855,7 +1157,10 @@ int replicationAppend(struct raft *r,
         }
     }
 
-    persistEntries(r, index, entries, n_entries);
+    rv = persistEntries(r, index, entries, n_entries);
+    if (rv != 0) {
+        goto err;
+    }
 
     return 0;
 
@@ -889,7 +1194,10 @@ int replicationPersistSnapshotDone(struct raft *r,
 
     result.term = r->current_term;
     result.version = MESSAGE__APPEND_ENTRIES_RESULT_VERSION;
-    result.features = MESSAGE__FEATURE_CAPACITY;
+    result.features = MessageFeatures(r);
+    result.flags = 0;
+    result.conflict_term = 0;
+    result.conflict_index = 0;
     result.rejected = 0;
 
     /* From Figure 5.3:
@@ -1039,6 +1347,57 @@ int replicationApplyConfigurationChange(struct raft *r,
     return 0;
 }
 
+void replicationCongested(struct raft *r, raft_id id)
+{
+    unsigned i;
+
+    if (r->state != RAFT_LEADER) {
+        return;
+    }
+
+    i = configurationIndexOf(&r->configuration, id);
+    if (i == r->configuration.n) {
+        return;
+    }
+
+    /* Stop sending entries optimistically and wait for the follower to catch
+     * up, probing it once per heartbeat. */
+    if (progressState(r, i) == PROGRESS__PIPELINE) {
+        infof("server %llu is in pipeline mode -> switch to probe", id);
+        progressToProbe(r, i);
+    }
+}
+
+void replicationUnreachable(struct raft *r, raft_id id)
+{
+    unsigned i;
+
+    switch (r->state) {
+        case RAFT_FOLLOWER:
+            /* Without heartbeats a quiescent follower would never notice that
+             * the leader is gone. */
+            if (r->follower_state.quiescent &&
+                r->follower_state.current_leader.id == id) {
+                infof("leader is unreachable -> resume election timer");
+                r->follower_state.quiescent = false;
+                electionResetTimer(r);
+            }
+            break;
+        case RAFT_LEADER:
+            i = configurationIndexOf(&r->configuration, id);
+            if (i == r->configuration.n) {
+                break;
+            }
+            /* Resume heartbeats, so we find out whether we can still reach a
+             * majority of servers. */
+            progressUpdateQuiesce(r, i, false);
+            replicationUnquiesce(r);
+            break;
+        default:
+            break;
+    }
+}
+
 int replicationSnapshot(struct raft *r,
                         struct raft_snapshot_metadata *metadata,
                         unsigned trailing)
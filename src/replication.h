@@ -78,6 +78,21 @@ int replicationInstallSnapshot(struct raft *r,
                                const struct raft_install_snapshot *args,
                                bool *async);
 
+/* Decide whether a successful AppendEntries result can be sent right away.
+ *
+ * If a results window is set and a previous result was sent less than a window
+ * ago, the result is delayed: return false and mark it as pending, so that
+ * replicationFlushResult() will send it once the window expires.
+ *
+ * Otherwise return true, after bumping the result's last_log_index to the
+ * highest index known to be both persisted and matching the leader. */
+bool replicationShouldSendResult(struct raft *r,
+                                 struct raft_append_entries_result *result);
+
+/* Send the pending AppendEntries result, if any and if the results window has
+ * expired. */
+void replicationFlushResult(struct raft *r);
+
 /* Called when handling a RAFT_PERSISTED_ENTRIES event. */
 int replicationPersistEntriesDone(struct raft *r, raft_index index);
 
@@ -93,6 +108,17 @@ int replicationSnapshot(struct raft *r,
                         struct raft_snapshot_metadata *metadata,
                         unsigned trailing);
 
+/* Called when a RAFT_CONGESTED event is fired, signalling that the connection
+ * to the given server can't take more entries for now. */
+void replicationCongested(struct raft *r, raft_id id);
+
+/* Called when a RAFT_UNREACHABLE event is fired, signalling that the connection
+ * with the given server was lost. */
+void replicationUnreachable(struct raft *r, raft_id id);
+
+/* Leave quiescence, resuming heartbeats. Must be called only by leaders. */
+void replicationUnquiesce(struct raft *r);
+
 /* Apply a RAFT_CHANGE entry that has been committed. */
 int replicationApplyConfigurationChange(struct raft *r,
                                         struct raft_configuration *conf,
@@ -22,6 +22,12 @@ static int timeoutFollower(struct raft *r)
     assert(r != NULL);
     assert(r->state == RAFT_FOLLOWER);
 
+    /* The leader is idle and won't send heartbeats, see
+     * raft_set_quiescence(). */
+    if (r->follower_state.quiescent) {
+        goto out;
+    }
+
     server = configurationGet(&r->configuration, r->id);
 
     /* If we have been removed from the configuration, or maybe we didn't
@@ -147,6 +153,12 @@ static int timeoutLeader(struct raft *r)
 {
     assert(r->state == RAFT_LEADER);
 
+    /* All followers are quiescent and don't expect heartbeats, nor send us
+     * anything that would let us check that we can reach them. */
+    if (r->leader_state.quiescent) {
+        return 0;
+    }
+
     /* Check if we still can reach a majority of servers.
      *
      * From Section 6.2:
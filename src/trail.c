@@ -134,6 +134,53 @@ raft_term TrailTermOf(const struct raft_trail *t, raft_index index)
     return t->records[i].term;
 }
 
+raft_index TrailTermStart(const struct raft_trail *t, raft_index index)
+{
+    unsigned n;
+    unsigned i;
+
+    assert(index > t->offset);
+    assert(index <= t->offset + TrailNumEntries(t));
+
+    /* Look for the last record whose index is lower than the given one: the
+     * term of the given entry starts right after it. */
+    n = trailNumRecords(t);
+    while (n > 1) {
+        i = trailPositionAt(t, n - 2);
+        if (index > t->records[i].index) {
+            return t->records[i].index + 1;
+        }
+        n -= 1;
+    }
+
+    return t->offset + 1;
+}
+
+raft_index TrailTermEnd(const struct raft_trail *t, raft_term term)
+{
+    unsigned n = trailNumRecords(t);
+    unsigned i;
+
+    /* Terms are increasing, so start from the most recent record. */
+    while (n > 0) {
+        i = trailPositionAt(t, n - 1);
+        if (t->records[i].term == term) {
+            return t->records[i].index;
+        }
+        if (t->records[i].term < term) {
+            break;
+        }
+        n -= 1;
+    }
+
+    /* All entries with the given term might be in the last snapshot. */
+    if (t->snapshot.term == term) {
+        return t->snapshot.index;
+    }
+
+    return 0;
+}
+
 /* Ensure that the last record in the circular buffer is at the given term,
  * creating a new record if necessary.
  *
@@ -35,6 +35,16 @@ raft_term TrailLastTerm(const struct raft_trail *t);
  * in the most recent snapshot). */
 raft_term TrailTermOf(const struct raft_trail *t, raft_index index);
 
+/* Get the index of the first entry that has the same term as the entry with
+ * the given index, which must be present in the log. If older entries with that
+ * term were deleted by a snapshot, return the index of the oldest one still
+ * present. */
+raft_index TrailTermStart(const struct raft_trail *t, raft_index index);
+
+/* Get the index of the last entry with the given term, possibly the last one
+ * in the most recent snapshot. Return 0 if there is no entry with that term. */
+raft_index TrailTermEnd(const struct raft_trail *t, raft_term term);
+
 /* Record a new entry at TrailLastIndex() + 1, with the given term.
  *
  * Errors:
@@ -1,5 +1,6 @@
 #include "../include/raft/uv.h"
 
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -23,11 +24,6 @@
 
 #define tracef(...) Tracef(uv->tracer, __VA_ARGS__)
 
-/* Retry to connect to peer servers every second.
- *
- * TODO: implement an exponential backoff instead.  */
-#define CONNECT_RETRY_DELAY 1000
-
 /* Cleans up files that are no longer used by the system */
 static int uvMaintenance(const char *dir, char *errmsg)
 {
@@ -109,16 +105,24 @@ static int uvInit(struct raft_io *io, raft_id id, const char *address)
     }
     uv->metadata = metadata;
 
-    rv = uv->transport->init(uv->transport, id, address);
-    if (rv != 0) {
-        ErrMsgTransfer(uv->transport->errmsg, io->errmsg, "transport");
-        return rv;
-    }
-    uv->transport->data = uv;
+    /* Groups of a host share its transport and its tick timer. */
+    if (uv->host != NULL) {
+        rv = UvHostInit(uv, id, address);
+        if (rv != 0) {
+            return rv;
+        }
+    } else {
+        rv = uv->transport->init(uv->transport, id, address);
+        if (rv != 0) {
+            ErrMsgTransfer(uv->transport->errmsg, io->errmsg, "transport");
+            return rv;
+        }
+        uv->transport->data = uv;
 
-    rv = uv_timer_init(uv->loop, &uv->timer);
-    assert(rv == 0); /* This should never fail */
-    uv->timer.data = uv;
+        rv = uv_timer_init(uv->loop, &uv->timer);
+        assert(rv == 0); /* This should never fail */
+        uv->timer.data = uv;
+    }
 
     rv = uv_prepare_init(uv->loop, &uv->prepare);
     assert(rv == 0);
@@ -128,6 +132,10 @@ static int uvInit(struct raft_io *io, raft_id id, const char *address)
     assert(rv == 0);
     uv->check.data = uv;
 
+    if (UvInprocEnabled(uv)) {
+        UvInprocStart(uv);
+    }
+
     rv = uv_timer_init(uv->loop, &uv->prepare_retry);
     assert(rv == 0); /* This should never fail */
     uv->prepare_retry.data = uv;
@@ -143,16 +151,36 @@ static int uvInit(struct raft_io *io, raft_id id, const char *address)
     return 0;
 }
 
-/* Periodic timer callback */
+/* Periodic or one-shot timer callback */
 static void uvTickTimerCb(uv_timer_t *timer)
 {
     struct uv *uv;
     uv = timer->data;
+    uv->tick_deadline = ULLONG_MAX;
     if (uv->tick_cb != NULL) {
         uv->tick_cb(uv->io);
     }
 }
 
+/* Arm the timer to fire once at uv->tick_deadline. */
+static void uvScheduleTick(struct uv *uv)
+{
+    raft_time now;
+    int rv;
+
+    if (uv->tick_deadline == ULLONG_MAX) {
+        rv = uv_timer_stop(&uv->timer);
+        assert(rv == 0);
+        return;
+    }
+
+    now = uv_now(uv->loop);
+    rv = uv_timer_start(&uv->timer, uvTickTimerCb,
+                        uv->tick_deadline > now ? uv->tick_deadline - now : 0,
+                        0);
+    assert(rv == 0);
+}
+
 static void uvUpdateCapacity(struct uv *uv)
 {
     size_t bytes = UvPrepareCount(uv) * uv->segment_size;
@@ -176,6 +204,9 @@ static void uvCheckLoopCb(struct uv_check_s *check)
     uv = check->data;
     uvUpdateCapacity(uv);
     if (uv->io->data != NULL && uv->io->version != 0) {
+        /* Messages are read in the poll phase, so all the ones received in
+         * this loop iteration are queued by now. */
+        LegacyFlushReceived(uv->io->data);
         LegacyFireCompletedRequests(uv->io->data);
     }
 }
@@ -192,12 +223,26 @@ static int uvStart(struct raft_io *io,
     uv->state = UV__ACTIVE;
     uv->tick_cb = tick_cb;
     uv->recv_cb = recv_cb;
-    rv = UvRecvStart(uv);
-    if (rv != 0) {
-        return rv;
+    if (io->data != NULL && io->version != 0) {
+        LegacyDeferReceive(io->data);
+    }
+    if (uv->host != NULL) {
+        rv = UvHostStart(uv, msecs);
+        if (rv != 0) {
+            return rv;
+        }
+    } else {
+        rv = UvRecvStart(uv);
+        if (rv != 0) {
+            return rv;
+        }
+        if (uv->tick_oneshot) {
+            uvScheduleTick(uv);
+        } else {
+            rv = uv_timer_start(&uv->timer, uvTickTimerCb, msecs, msecs);
+            assert(rv == 0);
+        }
     }
-    rv = uv_timer_start(&uv->timer, uvTickTimerCb, msecs, msecs);
-    assert(rv == 0);
     rv = uv_prepare_start(&uv->prepare, uvPrepareLoopCb);
     assert(rv == 0);
     rv = uv_check_start(&uv->check, uvCheckLoopCb);
@@ -215,18 +260,27 @@ void uvMaybeFireCloseCb(struct uv *uv)
         return;
     }
 
-    if (uv->transport->data != NULL) {
+    if (uv->host == NULL && uv->transport->data != NULL) {
+        return;
+    }
+    if (uv->host_sends > 0) {
         return;
     }
     if (uv->timer.data != NULL) {
         return;
     }
+    if (uv->keepalive.data != NULL) {
+        return;
+    }
     if (uv->prepare.data != NULL) {
         return;
     }
     if (uv->check.data != NULL) {
         return;
     }
+    if (uv->inproc_idle.data != NULL) {
+        return;
+    }
     if (uv->prepare_retry.data != NULL) {
         return;
     }
@@ -260,6 +314,9 @@ void uvMaybeFireCloseCb(struct uv *uv)
     if (!QUEUE_IS_EMPTY(&uv->async_work_reqs)) {
         return;
     }
+    if (!QUEUE_IS_EMPTY(&uv->read_reqs)) {
+        return;
+    }
     if (!QUEUE_IS_EMPTY(&uv->aborting)) {
         return;
     }
@@ -311,6 +368,47 @@ static void uvPrepareRetryCloseCb(uv_handle_t *handle)
     uvMaybeFireCloseCb(uv);
 }
 
+static void uvKeepaliveTimerCb(uv_timer_t *timer)
+{
+    struct uv *uv = timer->data;
+    UvSendKeepalive(uv);
+    UvRecvKeepalive(uv);
+}
+
+void UvKeepaliveStart(struct uv *uv)
+{
+    int rv;
+
+    assert(!uv->closing);
+
+    if (uv->keepalive_interval == 0 || uv->keepalive.data != NULL) {
+        return;
+    }
+
+    rv = uv_timer_init(uv->loop, &uv->keepalive);
+    assert(rv == 0); /* This should never fail */
+    uv->keepalive.data = uv;
+    rv = uv_timer_start(&uv->keepalive, uvKeepaliveTimerCb,
+                        uv->keepalive_interval, uv->keepalive_interval);
+    assert(rv == 0);
+}
+
+static void uvKeepaliveCloseCb(uv_handle_t *handle)
+{
+    struct uv *uv = handle->data;
+    assert(uv->closing);
+    uv->keepalive.data = NULL;
+    uvMaybeFireCloseCb(uv);
+}
+
+void UvKeepaliveClose(struct uv *uv)
+{
+    assert(uv->closing);
+    if (uv->keepalive.data != NULL) {
+        uv_close((uv_handle_t *)&uv->keepalive, uvKeepaliveCloseCb);
+    }
+}
+
 /* Implementation of raft_io->close. */
 static void uvClose(struct raft_io *io, raft_io_close_cb cb)
 {
@@ -321,9 +419,11 @@ static void uvClose(struct raft_io *io, raft_io_close_cb cb)
     uv->close_cb = cb;
     uv->closing = true;
     UvSendClose(uv);
+    UvInprocClose(uv);
     UvRecvClose(uv);
+    UvKeepaliveClose(uv);
     uvAppendClose(uv);
-    if (uv->transport->data != NULL) {
+    if (uv->host == NULL && uv->transport->data != NULL) {
         uv->transport->close(uv->transport, uvTransportCloseCb);
     }
     if (uv->timer.data != NULL) {
@@ -460,6 +560,7 @@ static int uvLoadSnapshotAndEntries(struct uv *uv,
     struct uvSegmentInfo *segments;
     size_t n_snapshots;
     size_t n_segments;
+    uint64_t t;
     int rv;
 
     *snapshot = NULL;
@@ -468,8 +569,10 @@ static int uvLoadSnapshotAndEntries(struct uv *uv,
     *n = 0;
 
     /* List available snapshots and segments. */
+    t = uv_hrtime();
     rv = UvList(uv, &snapshots, &n_snapshots, &segments, &n_segments,
                 uv->io->errmsg);
+    UvLoadStatsAdd(&uv->load_stats, list, t);
     if (rv != 0) {
         goto err;
     }
@@ -487,7 +590,7 @@ static int uvLoadSnapshotAndEntries(struct uv *uv,
             uvSnapshotFilenameOf(&snapshots[n_snapshots - i],
                                  snapshot_filename);
             rv = UvSnapshotLoad(uv, &snapshots[n_snapshots - i], *snapshot,
-                                uv->io->errmsg);
+                                &uv->load_stats, uv->io->errmsg);
             if (rv == 0) {
                 break;
             }
@@ -525,8 +628,18 @@ static int uvLoadSnapshotAndEntries(struct uv *uv,
     /* Read data from segments, closing any open segments. */
     if (segments != NULL) {
         raft_index last_index;
-        rv = uvSegmentLoadAll(uv, *start_index, segments, n_segments, entries,
-                              n);
+        raft_index from = 0;
+
+        /* Entries behind the snapshot and past the configured trailing amount
+         * are not needed, don't bother loading them. */
+        if (*snapshot != NULL && uv->load_trailing != UV__LOAD_TRAILING_ALL) {
+            if ((*snapshot)->index >= uv->load_trailing) {
+                from = (*snapshot)->index - uv->load_trailing + 1;
+            }
+        }
+
+        rv = uvSegmentLoadAll(uv, start_index, from, segments, n_segments,
+                              entries, n);
         if (rv != 0) {
             goto err;
         }
@@ -589,13 +702,22 @@ static int uvLoad(struct raft_io *io,
                   size_t *n_entries)
 {
     struct uv *uv;
+    uint64_t start;
     int rv;
     uv = io->impl;
 
+    start = uv_hrtime();
+    memset(&uv->load_stats, 0, sizeof uv->load_stats);
+
     *term = uv->metadata.term;
     *voted_for = uv->metadata.voted_for;
     *snapshot = NULL;
 
+    rv = uvSegmentTruncateRecover(uv, io->errmsg);
+    if (rv != 0) {
+        return rv;
+    }
+
     rv = uvLoadSnapshotAndEntries(uv, snapshot, start_index, entries, n_entries,
                                   0);
     if (rv != 0) {
@@ -609,6 +731,9 @@ static int uvLoad(struct raft_io *io,
     /* Set the index of the next entry that will be appended. */
     uv->append_next_index = *start_index + *n_entries;
 
+    uv->load_stats.total = uv_hrtime() - start;
+    Trace(uv->tracer, RAFT_UV_TRACER_LOAD_COMPLETE, &uv->load_stats);
+
     return 0;
 }
 
@@ -724,6 +849,34 @@ static raft_time uvTime(struct raft_io *io)
     return uv_now(uv->loop);
 }
 
+/* Implementation of raft_io->set_unreachable_cb. */
+static void uvSetUnreachableCb(struct raft_io *io, raft_io_unreachable_cb cb)
+{
+    struct uv *uv;
+    uv = io->impl;
+    uv->unreachable_cb = cb;
+}
+
+/* Implementation of raft_io->set_deadline. */
+static void uvSetDeadline(struct raft_io *io, raft_time deadline)
+{
+    struct uv *uv;
+    uv = io->impl;
+    if (uv->closing) {
+        return;
+    }
+    uv->tick_deadline = deadline;
+    uv->tick_oneshot = true;
+    if (uv->state != UV__ACTIVE) {
+        return; /* The timer will be armed by raft_io->start() */
+    }
+    if (uv->host != NULL) {
+        UvHostSetDeadline(uv);
+    } else {
+        uvScheduleTick(uv);
+    }
+}
+
 /* Implementation of raft_io->random. */
 static int uvRandom(struct raft_io *io, int min, int max)
 {
@@ -800,11 +953,14 @@ int raft_uv_init(struct raft_io *io,
     uv->direct_io = false;
     uv->async_io = false;
     uv->segment_size = UV__MAX_SEGMENT_SIZE;
+    uv->segment_load_threads = UV__SEGMENT_LOAD_THREADS;
+    memset(&uv->load_stats, 0, sizeof uv->load_stats);
+    uv->load_trailing = UV__LOAD_TRAILING_ALL;
     uv->disk_retry = UV__DISK_RETRY_RATE;
     uv->block_size = 0;
     QUEUE_INIT(&uv->clients);
     QUEUE_INIT(&uv->servers);
-    uv->connect_retry_delay = CONNECT_RETRY_DELAY;
+    uv->connect_retry_delay = UV__CONNECT_RETRY_DELAY;
     uv->prepare_inflight = NULL;
     QUEUE_INIT(&uv->prepare_reqs);
     QUEUE_INIT(&uv->prepare_pool);
@@ -819,19 +975,45 @@ int raft_uv_init(struct raft_io *io,
     uv->truncate_work.data = NULL;
     QUEUE_INIT(&uv->snapshot_get_reqs);
     QUEUE_INIT(&uv->async_work_reqs);
+    QUEUE_INIT(&uv->read_reqs);
     uv->snapshot_put_work.data = NULL;
+    uv->snapshot_stream_threshold = UV__SNAPSHOT_STREAM_THRESHOLD;
+    uv->append_compression_threshold = UV__APPEND_COMPRESSION_THRESHOLD;
+    uv->send_queue_size = UV__SEND_QUEUE_SIZE;
+    uv->send_corked = false;
+    uv->keepalive_interval = UV__KEEPALIVE_INTERVAL;
+    uv->keepalive.data = NULL;
+    uv->snapshot_staged.fd = -1;
     uv->timer.data = NULL;
     uv->tick_cb = NULL; /* Set by raft_io->start() */
+    uv->tick_deadline = ULLONG_MAX;
+    uv->tick_oneshot = false;
     uv->recv_cb = NULL; /* Set by raft_io->start() */
+    uv->unreachable_cb = NULL; /* Set by raft_io->set_unreachable_cb() */
     QUEUE_INIT(&uv->aborting);
+    QUEUE_INIT(&uv->inproc_reqs);
+    uv->inproc_idle.data = NULL; /* Set by raft_io->init() */
     uv->closing = false;
     uv->close_cb = NULL;
     uv->auto_recovery = true;
+    uv->host = NULL; /* Set by raft_uv_init_group() */
+    uv->group = 0;
+    uv->host_sends = 0;
+    uv->host_tick = 0;
+    uv->host_last_tick = 0;
+    uv->hub = NULL;
+
+    rv = UvReadCacheInit(uv);
+    if (rv != 0) {
+        ErrMsgPrintf(io->errmsg, "init read cache");
+        raft_free(uv);
+        goto err;
+    }
 
     uvSeedRand(uv);
 
     /* Set the raft_io implementation. */
-    io->version = 2; /* future-proof'ing */
+    io->version = 6; /* future-proof'ing */
     io->capacity = 0;
     io->impl = uv;
     io->init = uvInit;
@@ -849,6 +1031,14 @@ int raft_uv_init(struct raft_io *io,
     io->snapshot_get = UvSnapshotGet;
     io->time = uvTime;
     io->random = uvRandom;
+    io->read = UvRead;
+    io->set_unreachable_cb = uvSetUnreachableCb;
+    io->set_deadline = uvSetDeadline;
+#ifdef LZ4_AVAILABLE
+    io->features = RAFT_IO_LZ4;
+#else
+    io->features = 0;
+#endif
 
     return 0;
 
@@ -865,6 +1055,10 @@ void raft_uv_close(struct raft_io *io)
     struct uv *uv;
     uv = io->impl;
     io->impl = NULL;
+    if (uv->host != NULL) {
+        UvHostDetach(uv);
+    }
+    UvReadCacheClose(uv);
     raft_free(uv);
 }
 
@@ -903,6 +1097,13 @@ void raft_uv_set_connect_retry_delay(struct raft_io *io, unsigned msecs)
     uv->connect_retry_delay = msecs;
 }
 
+void raft_uv_set_keepalive(struct raft_io *io, unsigned msecs)
+{
+    struct uv *uv;
+    uv = io->impl;
+    uv->keepalive_interval = msecs;
+}
+
 void raft_uv_set_tracer(struct raft_io *io, struct raft_tracer *tracer)
 {
     struct uv *uv;
@@ -917,4 +1118,46 @@ void raft_uv_set_auto_recovery(struct raft_io *io, bool flag)
     uv->auto_recovery = flag;
 }
 
+void raft_uv_set_segment_load_threads(struct raft_io *io, unsigned n)
+{
+    struct uv *uv;
+    uv = io->impl;
+    uv->segment_load_threads = n;
+}
+
+void raft_uv_set_load_trailing(struct raft_io *io, unsigned n)
+{
+    struct uv *uv;
+    uv = io->impl;
+    uv->load_trailing = n;
+}
+
+void raft_uv_set_snapshot_stream_threshold(struct raft_io *io, size_t size)
+{
+    struct uv *uv;
+    uv = io->impl;
+    uv->snapshot_stream_threshold = size;
+}
+
+void raft_uv_set_append_compression_threshold(struct raft_io *io, size_t size)
+{
+    struct uv *uv;
+    uv = io->impl;
+    uv->append_compression_threshold = size;
+}
+
+void raft_uv_set_send_queue_size(struct raft_io *io, size_t size)
+{
+    struct uv *uv;
+    uv = io->impl;
+    uv->send_queue_size = size;
+}
+
+void raft_uv_set_read_cache_size(struct raft_io *io, size_t size)
+{
+    struct uv *uv;
+    uv = io->impl;
+    uv->read_cache.max_size = size;
+}
+
 #undef tracef
@@ -4,6 +4,7 @@
 #define UV_H_
 
 #include "../include/raft.h"
+#include "../include/raft/uv.h"
 #include "err.h"
 #include "queue.h"
 #include "tracing.h"
@@ -13,6 +14,15 @@
 /* 8 Megabytes */
 #define UV__MAX_SEGMENT_SIZE (8 * 1024 * 1024)
 
+/* Add the nanoseconds elapsed since START to the FIELD counter of the given
+ * load stats, unless STATS is NULL. */
+#define UvLoadStatsAdd(STATS, FIELD, START)          \
+    do {                                             \
+        if ((STATS) != NULL) {                       \
+            (STATS)->FIELD += uv_hrtime() - (START); \
+        }                                            \
+    } while (0)
+
 /* Template string for closed segment filenames: start index (inclusive), end
  * index (inclusive). */
 #define UV__CLOSED_TEMPLATE "%016llu-%016llu"
@@ -23,9 +33,50 @@
 /* Enough to hold a segment filename (either open or closed) */
 #define UV__SEGMENT_FILENAME_BUF_SIZE 34
 
+/* Template string for the index of a closed segment, listing the offset of
+ * each batch in the segment. */
+#define UV__CLOSED_INDEX_TEMPLATE UV__CLOSED_TEMPLATE ".idx"
+
+/* Template string for a closed segment being truncated: start index
+ * (inclusive), end index after truncation (inclusive). */
+#define UV__TRUNCATE_TEMPLATE "truncate-" UV__CLOSED_TEMPLATE
+
+/* Load all entries behind the last snapshot at startup by default. */
+#define UV__LOAD_TRAILING_ALL UINT_MAX
+
+/* Load closed segments at startup using up to 4 threads by default. */
+#define UV__SEGMENT_LOAD_THREADS 4
+
+/* Retry to connect to peer servers every second by default.
+ *
+ * TODO: implement an exponential backoff instead.  */
+#define UV__CONNECT_RETRY_DELAY 1000
+
 /* Retry failed disk operations every 5 seconds by default. */
 #define UV__DISK_RETRY_RATE 1000 * 5
 
+/* InstallSnapshot payloads of 8 Megabytes or more are streamed to disk. */
+#define UV__SNAPSHOT_STREAM_THRESHOLD (8 * 1024 * 1024)
+
+/* Size of the chunks used when streaming InstallSnapshot payloads to disk. */
+#define UV__SNAPSHOT_STREAM_CHUNK (1024 * 1024)
+
+/* AppendEntries payloads are not compressed by default. */
+#define UV__APPEND_COMPRESSION_THRESHOLD 0
+
+/* Queue up to 16 Megabytes of outgoing messages for each peer connection. */
+#define UV__SEND_QUEUE_SIZE (16 * 1024 * 1024)
+
+/* Write a keepalive frame on connections idle for a second by default. */
+#define UV__KEEPALIVE_INTERVAL 1000
+
+/* Drop an inbound connection after this many keepalive intervals of the peer
+ * without receiving anything. */
+#define UV__KEEPALIVE_MISSES 3
+
+/* Keep up to 8 Megabytes of entries read back from disk in memory. */
+#define UV__READ_CACHE_SIZE (8 * 1024 * 1024)
+
 /* Template string for snapshot filenames: snapshot term, snapshot index,
  * creation timestamp (milliseconds since epoch). */
 #define UV__SNAPSHOT_TEMPLATE "snapshot-%llu-%llu-%llu"
@@ -55,6 +106,30 @@ struct uvMetadata
     raft_id voted_for;          /* Server ID of last vote, or 0 */
 };
 
+/* InstallSnapshot payload that was streamed to an invisible temporary file,
+ * waiting for raft_io->snapshot_put() to persist it. */
+struct uvSnapshotStaged
+{
+    uv_file fd;       /* Temporary file holding the data, or -1 */
+    raft_term term;   /* Term of the last entry included in the snapshot */
+    raft_index index; /* Index of the last entry included in the snapshot */
+    size_t len;       /* Size of the snapshot data */
+};
+
+/* Entries recently read back from disk by raft_io->read(), shared by the
+ * worker threads serving read requests. */
+struct uvReadCache
+{
+    uv_mutex_t mutex;   /* Serialize access to the cache */
+    queue chunks;       /* Cached chunks of entries, least recently used first */
+    size_t size;        /* Total size of the entries data in the cache */
+    size_t max_size;    /* Evict chunks when the size exceeds this */
+    unsigned long gen;  /* Bumped whenever the cache is cleared */
+};
+
+/* Resources shared by the groups of a raft_uv_host (defined in uv_host.c). */
+struct uvHost;
+
 /* Hold state of a libuv-based raft_io implementation. */
 struct uv
 {
@@ -69,6 +144,9 @@ struct uv
     bool direct_io;                       /* Whether direct I/O is supported */
     bool async_io;                        /* Whether async I/O is supported */
     size_t segment_size;                  /* Initial size of open segments. */
+    unsigned segment_load_threads;        /* Threads loading closed segments */
+    unsigned load_trailing;               /* Entries loaded behind snapshot */
+    struct raft_uv_load_stats load_stats; /* Timings of the last load */
     unsigned disk_retry;                  /* Disk operations retry rate */
     size_t block_size;                    /* Block size of the data dir */
     queue clients;                        /* Outbound connections */
@@ -90,23 +168,61 @@ struct uv
     struct uv_work_s truncate_work;       /* Execute truncate log requests */
     queue snapshot_get_reqs;              /* Inflight get snapshot requests */
     queue async_work_reqs;                /* Inflight async work requests */
+    queue read_reqs;                      /* Inflight read entries requests */
+    struct uvReadCache read_cache;        /* Entries read back from disk */
     struct uv_work_s snapshot_put_work;   /* Execute snapshot put requests */
     struct uv_timer_s snapshot_put_retry; /* Timer for snapshot put retries */
+    size_t snapshot_stream_threshold;     /* Min. size of streamed payloads */
+    size_t append_compression_threshold;  /* Min. size of compressed entries */
+    size_t send_queue_size;               /* Max. bytes queued for a peer */
+    bool send_corked;                     /* Hold writes until uncorked */
+    unsigned keepalive_interval;          /* Keepalive interval, 0 if off */
+    struct uv_timer_s keepalive;          /* Send and check keepalives */
+    struct uvSnapshotStaged snapshot_staged; /* Last streamed payload */
     struct uvMetadata metadata;           /* Cache of metadata on disk */
     struct uv_timer_s timer;              /* Timer for periodic ticks */
     raft_io_tick_cb tick_cb;              /* Invoked when the timer expires */
+    raft_time tick_deadline;              /* Next tick, see set_deadline() */
+    bool tick_oneshot;                    /* Tick just at tick_deadline */
     raft_io_recv_cb recv_cb;              /* Invoked when upon RPC messages */
+    raft_io_unreachable_cb unreachable_cb; /* Invoked upon lost connections */
     queue aborting;                       /* Cleanups upon errors or shutdown */
     bool closing;                         /* True if we are closing */
     raft_io_close_cb close_cb;            /* Invoked when finishing closing */
     bool auto_recovery; /* Try to recover from corrupt segments */
     struct uv_prepare_s prepare;
     struct uv_check_s check;
+    queue inproc_reqs;            /* Messages to in-process servers */
+    struct uv_idle_s inproc_idle; /* Deliver in-process messages */
+    struct uvHost *host;          /* Host we're a group of, if any */
+    uint32_t group;               /* Our group ID within the host */
+    queue host_queue;             /* Groups of the host */
+    unsigned host_sends;          /* Messages queued on host connections */
+    unsigned host_tick;           /* Tick interval requested by start() */
+    raft_time host_last_tick;     /* Last time the host ticked us */
+    struct uvHost *hub;           /* Host whose connections we manage */
 };
 
 /* Implementation of raft_io->truncate. */
 int UvTruncate(struct raft_io *io, raft_index index);
 
+/* Implementation of raft_io->read. */
+int UvRead(struct raft_io *io,
+           struct raft_io_read *req,
+           raft_index index,
+           unsigned n,
+           raft_io_read_cb cb);
+
+/* Initialize the cache of entries read back from disk. */
+int UvReadCacheInit(struct uv *uv);
+
+/* Drop all entries in the read cache. Reads that were in flight at that point
+ * fail instead of returning or caching what they loaded. */
+void UvReadCacheClear(struct uv *uv);
+
+/* Release all resources used by the read cache. */
+void UvReadCacheClose(struct uv *uv);
+
 /* Load Raft metadata from disk, choosing the most recent version (either the
  * metadata1 or metadata2 file). */
 int uvMetadataLoad(const char *dir, struct uvMetadata *metadata, char *errmsg);
@@ -162,10 +278,31 @@ int uvSegmentLoadClosed(struct uv *uv,
                         struct raft_entry *entries[],
                         size_t *n);
 
+/* Read back the entries of the given closed segment, starting from the batch
+ * containing @index. The index of the first returned entry is the segment's end
+ * index minus @n plus one. All entries share the same batch buffer.
+ *
+ * This does not modify the segment and can be called from a worker thread. */
+int uvSegmentReadClosed(struct uv *uv,
+                        struct uvSegmentInfo *segment,
+                        raft_index index,
+                        struct raft_entry *entries[],
+                        size_t *n,
+                        char *errmsg);
+
 /* Load raft entries from the given segments. The @start_index is the expected
- * index of the first entry of the first segment. */
+ * index of the first entry of the first segment.
+ *
+ * Entries of closed segments with index lower than @from are not needed and
+ * might be skipped, using the segment's index file to seek straight to the
+ * batch containing @from. In that case @start_index is updated to the index
+ * of the first entry actually loaded.
+ *
+ * The time spent reading, checksumming and decoding is added to
+ * uv->load_stats. */
 int uvSegmentLoadAll(struct uv *uv,
-                     const raft_index start_index,
+                     raft_index *start_index,
+                     raft_index from,
                      struct uvSegmentInfo *segments,
                      size_t n_segments,
                      struct raft_entry **entries,
@@ -228,11 +365,28 @@ int uvSegmentCreateClosedWithConfiguration(
 int uvSegmentCreateFirstClosed(struct uv *uv,
                                const struct raft_configuration *configuration);
 
-/* Truncate a segment that was already closed. */
+/* Write the index file of the given closed segment, recording the offset,
+ * first index and term of each of its batches. */
+int uvSegmentIndexWrite(struct uv *uv,
+                        raft_index first_index,
+                        raft_index end_index,
+                        char *errmsg);
+
+/* Remove the index file of the given closed segment, if any. */
+void uvSegmentIndexRemove(struct uv *uv,
+                          raft_index first_index,
+                          raft_index end_index);
+
+/* Truncate a segment that was already closed, removing all entries from
+ * @index onward. */
 int uvSegmentTruncate(struct uv *uv,
                       struct uvSegmentInfo *segment,
                       raft_index index);
 
+/* Complete any truncation of a closed segment that was interrupted by a
+ * crash. */
+int uvSegmentTruncateRecover(struct uv *uv, char *errmsg);
+
 /* Info about a persisted snapshot stored in snapshot metadata file. */
 struct uvSnapshotInfo
 {
@@ -266,10 +420,12 @@ int UvSnapshotInfoAppendIfMatch(struct uv *uv,
  * snapshots will come first. */
 void UvSnapshotSort(struct uvSnapshotInfo *infos, size_t n_infos);
 
-/* Load the snapshot associated with the given metadata. */
+/* Load the snapshot associated with the given metadata, accounting the time
+ * spent in @stats if not NULL. */
 int UvSnapshotLoad(struct uv *uv,
                    struct uvSnapshotInfo *meta,
                    struct raft_snapshot *snapshot,
+                   struct raft_uv_load_stats *stats,
                    char *errmsg);
 
 /* Implementation raft_io->snapshot_put (defined in uv_snapshot.c). */
@@ -287,6 +443,14 @@ int UvSnapshotGet(struct raft_io *io,
 /* Cancel any pending snapshot operation. */
 void UvSnapshotClose(struct uv *uv);
 
+/* Take ownership of the temporary file @fd, holding the streamed payload of the
+ * given InstallSnapshot message. A subsequent raft_io->snapshot_put() request
+ * for a snapshot with NULL data will persist it without copying it again. Any
+ * previously staged file is discarded. */
+void UvSnapshotStage(struct uv *uv,
+                     uv_file fd,
+                     const struct raft_install_snapshot *params);
+
 /* Return a list of all snapshots and segments found in the data directory. Both
  * snapshots and segments are ordered by filename (closed segments come before
  * open ones). */
@@ -423,6 +587,33 @@ int UvSend(struct raft_io *io,
  * pending send requests.  */
 void UvSendClose(struct uv *uv);
 
+/* Queue the messages sent from now on instead of writing them right away. */
+void UvSendCork(struct uv *uv);
+
+/* Write out the messages queued since UvSendCork(), using a single write
+ * request per connection. */
+void UvSendUncork(struct uv *uv);
+
+/* Write a keepalive frame on the connections to peers that expect them and
+ * that have been idle since the last call. */
+void UvSendKeepalive(struct uv *uv);
+
+/* Whether the transport is the in-process one, in which case all messages are
+ * sent with UvInprocSend(). */
+bool UvInprocEnabled(struct uv *uv);
+
+/* Initialize the idle handle used to deliver in-process messages. */
+void UvInprocStart(struct uv *uv);
+
+/* Queue a message for delivery to an in-process server. */
+int UvInprocSend(struct uv *uv,
+                 struct raft_io_send *req,
+                 const struct raft_message *message,
+                 raft_io_send_cb cb);
+
+/* Cancel all pending in-process messages and close the idle handle. */
+void UvInprocClose(struct uv *uv);
+
 /* Start receiving messages from new incoming connections. */
 int UvRecvStart(struct uv *uv);
 
@@ -430,6 +621,54 @@ int UvRecvStart(struct uv *uv);
  * requests being received.  */
 void UvRecvClose(struct uv *uv);
 
+/* Drop the inbound connections whose peer sends keepalives but that have been
+ * silent for UV__KEEPALIVE_MISSES of its intervals, reporting the peer as
+ * unreachable. */
+void UvRecvKeepalive(struct uv *uv);
+
+/* Start the keepalive timer of the given connection owner, either a standalone
+ * instance or the hub of a host, unless already started or disabled.
+ *
+ * A quiescent follower doesn't expect messages from its leader, so it would
+ * not notice a leader that lost power or that sits behind a partition that
+ * drops packets without closing the connection. Once a peer has been sent an
+ * AppendEntries request asking it to quiesce, which only servers that
+ * understand keepalive frames are sent, its connection carries a keepalive
+ * frame whenever it stays idle for a keepalive interval. The receiver drops
+ * connections that go silent, which ends quiescence like a closed connection
+ * does, see raft_io->set_unreachable_cb(). */
+void UvKeepaliveStart(struct uv *uv);
+
+/* Close the keepalive timer, if started. */
+void UvKeepaliveClose(struct uv *uv);
+
 void uvMaybeFireCloseCb(struct uv *uv);
 
+/* Adopt the given server ID and address as the ones of the host, or check that
+ * they match the ones adopted by other groups. */
+int UvHostInit(struct uv *uv, raft_id id, const char *address);
+
+/* Start receiving messages for the given group, listening on the host's
+ * transport if it isn't yet, and tick the group every @msecs. */
+int UvHostStart(struct uv *uv, unsigned msecs);
+
+/* Tick the given group once its tick_deadline expires, instead of every
+ * @msecs. */
+void UvHostSetDeadline(struct uv *uv);
+
+/* Return the instance managing the connections shared by all groups. */
+struct uv *UvHostHub(struct uvHost *h);
+
+/* Pass a message received over a host connection to the recv callback of the
+ * given group. Return false if there's no such active group, in which case the
+ * message is not consumed. */
+bool UvHostRecv(struct uvHost *h, uint32_t group, struct raft_message *message);
+
+/* Detach the given group from its host. */
+void UvHostDetach(struct uv *uv);
+
+/* Let all groups of the host know that the connection with the given server was
+ * lost. */
+void UvHostUnreachable(struct uvHost *h, raft_id id);
+
 #endif /* UV_H_ */
@@ -6,7 +6,9 @@
 #include "../include/raft/uv.h"
 #include "assert.h"
 #include "byte.h"
+#include "compress.h"
 #include "configuration.h"
+#include "heap.h"
 
 /**
  * Size of the request preamble.
@@ -46,12 +48,16 @@ static size_t sizeofRequestVoteResult(void)
 
 static size_t sizeofAppendEntries(const struct raft_append_entries *p)
 {
-    return sizeof(uint64_t) +                  /* Leader's term. */
-           sizeof(uint64_t) +                  /* Previous log entry index */
-           sizeof(uint64_t) +                  /* Previous log entry term */
-           sizeof(uint64_t) +                  /* Leader's commit index */
-           uvSizeofBatchHeader(p->n_entries) + /* Batch header */
-           sizeof(uint64_t);                   /* XXX: currently unused */
+    size_t size = sizeof(uint64_t) +                  /* Leader's term. */
+                  sizeof(uint64_t) +                  /* Previous index */
+                  sizeof(uint64_t) +                  /* Previous term */
+                  sizeof(uint64_t) +                  /* Commit index */
+                  uvSizeofBatchHeader(p->n_entries) + /* Batch header */
+                  sizeof(uint64_t); /* Compressed payload size */
+    if (p->version >= 2) {
+        size += sizeof(uint64_t); /* Request flags */
+    }
+    return size;
 }
 
 static size_t sizeofAppendEntriesResultV0(void)
@@ -61,7 +67,7 @@ static size_t sizeofAppendEntriesResultV0(void)
            sizeof(uint64_t);  /* Last log index. */
 }
 
-static size_t sizeofAppendEntriesResult(void)
+static size_t sizeofAppendEntriesResultV2(void)
 {
     return sizeofAppendEntriesResultV0() + /* Size of older version 0 message */
            sizeof(uint16_t) +              /* Server features. */
@@ -69,6 +75,17 @@ static size_t sizeofAppendEntriesResult(void)
            sizeof(uint32_t);               /* Unused */
 }
 
+static size_t sizeofAppendEntriesResult(
+    const struct raft_append_entries_result *p)
+{
+    if (p->version < 3) {
+        return sizeofAppendEntriesResultV2();
+    }
+    return sizeofAppendEntriesResultV2() + /* Size of older version 2 message */
+           sizeof(uint64_t) +              /* Conflict term. */
+           sizeof(uint64_t);               /* Conflict index. */
+}
+
 static size_t sizeofInstallSnapshot(const struct raft_install_snapshot *p)
 {
     size_t conf_size = configurationEncodedSize(&p->conf);
@@ -149,7 +166,10 @@ static void encodeAppendEntries(const struct raft_append_entries *p, void *buf)
     uvEncodeBatchHeader(p->entries, p->n_entries, cursor); /* Batch header */
 
     cursor = (uint8_t *)cursor + uvSizeofBatchHeader(p->n_entries);
-    bytePut64(&cursor, 0); /* XXX: currently unused */
+    if (p->version >= 2) {
+        bytePut64(&cursor, p->flags); /* Request flags */
+    }
+    bytePut64(&cursor, 0); /* Set by uvEncodeCompressedEntries() */
 }
 
 static void encodeAppendEntriesResult(
@@ -163,7 +183,12 @@ static void encodeAppendEntriesResult(
     bytePut64(&cursor, p->last_log_index);
     bytePut16(&cursor, p->features);
     bytePut16(&cursor, p->capacity);
-    bytePut32(&cursor, 0 /* Unused */);
+    bytePut16(&cursor, p->version >= 3 ? p->flags : 0);
+    bytePut16(&cursor, 0 /* Unused */);
+    if (p->version >= 3) {
+        bytePut64(&cursor, p->conflict_term);
+        bytePut64(&cursor, p->conflict_index);
+    }
 }
 
 static void encodeInstallSnapshot(const struct raft_install_snapshot *p,
@@ -223,7 +248,8 @@ int uvEncodeMessage(const struct raft_message *message,
             version = message->append_entries.version;
             break;
         case RAFT_APPEND_ENTRIES_RESULT:
-            header.len += sizeofAppendEntriesResult();
+            header.len +=
+                sizeofAppendEntriesResult(&message->append_entries_result);
             version = message->append_entries_result.version;
             break;
         case RAFT_INSTALL_SNAPSHOT:
@@ -319,6 +345,69 @@ oom:
     return RAFT_NOMEM;
 }
 
+void uvEncodeMessageGroup(uv_buf_t *header, uint32_t group)
+{
+    uint8_t *cursor = (uint8_t *)header->base + 4;
+    assert(header->len >= RAFT_IO_UV__PREAMBLE_SIZE);
+    bytePut32(&cursor, group);
+}
+
+void uvEncodeKeepalive(unsigned interval, void *buf)
+{
+    uint8_t *cursor = buf;
+    bytePut8(&cursor, UV__KEEPALIVE);
+    bytePut8(&cursor, 0);
+    bytePut8(&cursor, 0);
+    bytePut8(&cursor, 0);
+    bytePut32(&cursor, 0);
+    bytePut64(&cursor, sizeof(uint64_t));
+    bytePut64(&cursor, interval);
+}
+
+int uvEncodeCompressedEntries(uv_buf_t *bufs, unsigned *n_bufs)
+{
+    char errmsg[RAFT_ERRMSG_BUF_SIZE];
+    struct raft_buffer *payload;
+    struct raft_buffer compressed;
+    size_t len = 0;
+    uint8_t *cursor;
+    unsigned n = *n_bufs - 1;
+    unsigned i;
+    int rv;
+
+    assert(n > 0);
+
+    payload = RaftHeapMalloc(n * sizeof *payload);
+    if (payload == NULL) {
+        return RAFT_NOMEM;
+    }
+    for (i = 0; i < n; i++) {
+        payload[i].base = bufs[i + 1].base;
+        payload[i].len = bufs[i + 1].len;
+        len += bufs[i + 1].len;
+    }
+
+    rv = Compress(payload, n, &compressed, errmsg);
+    RaftHeapFree(payload);
+    if (rv != 0) {
+        return rv;
+    }
+    if (compressed.len >= len) {
+        raft_free(compressed.base);
+        return RAFT_INVALID;
+    }
+
+    /* The compressed size is the last field of the AppendEntries header. */
+    cursor = (uint8_t *)bufs[0].base + bufs[0].len - sizeof(uint64_t);
+    bytePut64(&cursor, compressed.len);
+
+    bufs[1].base = compressed.base;
+    bufs[1].len = compressed.len;
+    *n_bufs = 2;
+
+    return 0;
+}
+
 void uvEncodeBatchHeader(const struct raft_entry *entries,
                          unsigned n,
                          void *buf)
@@ -472,7 +561,8 @@ err:
 
 static int decodeAppendEntries(unsigned char version,
                                const uv_buf_t *buf,
-                               struct raft_append_entries *args)
+                               struct raft_append_entries *args,
+                               size_t *compressed_len)
 {
     const uint8_t *cursor;
     int rv;
@@ -487,18 +577,33 @@ static int decodeAppendEntries(unsigned char version,
     args->prev_log_index = byteGet64(&cursor);
     args->prev_log_term = byteGet64(&cursor);
     args->leader_commit = byteGet64(&cursor);
+    args->flags = 0;
 
     rv = uvDecodeBatchHeader(cursor, &args->entries, &args->n_entries);
     if (rv != 0) {
         return rv;
     }
 
+    /* Since version 1 the payload might be compressed. */
+    *compressed_len = 0;
+    if (version >= 1) {
+        cursor += uvSizeofBatchHeader(args->n_entries);
+        if (buf->len < sizeofAppendEntries(args)) {
+            RaftHeapFree(args->entries);
+            return RAFT_MALFORMED;
+        }
+        if (version >= 2) {
+            args->flags = (unsigned char)byteGet64(&cursor);
+        }
+        *compressed_len = (size_t)byteGet64(&cursor);
+    }
+
     return 0;
 }
 
-static void decodeAppendEntriesResult(unsigned char version,
-                                      const uv_buf_t *buf,
-                                      struct raft_append_entries_result *p)
+static int decodeAppendEntriesResult(unsigned char version,
+                                     const uv_buf_t *buf,
+                                     struct raft_append_entries_result *p)
 {
     const uint8_t *cursor;
 
@@ -513,6 +618,11 @@ static void decodeAppendEntriesResult(unsigned char version,
     }
 
     p->version = version;
+    if (buf->len < (version == 0 ? sizeofAppendEntriesResultV0()
+                                 : sizeofAppendEntriesResult(p))) {
+        return RAFT_MALFORMED;
+    }
+
     p->term = byteGet64(&cursor);
     p->rejected = byteGet64(&cursor);
     p->last_log_index = byteGet64(&cursor);
@@ -524,6 +634,17 @@ static void decodeAppendEntriesResult(unsigned char version,
     if (p->version >= 2) {
         p->capacity = byteGet16(&cursor);
     }
+    p->conflict_term = 0;
+    p->conflict_index = 0;
+    p->flags = 0;
+    if (p->version >= 3) {
+        p->flags = byteGet16(&cursor);
+        byteGet16(&cursor); /* Unused */
+        p->conflict_term = byteGet64(&cursor);
+        p->conflict_index = byteGet64(&cursor);
+    }
+
+    return 0;
 }
 
 static int decodeInstallSnapshot(unsigned char version,
@@ -569,12 +690,29 @@ static void decodeTimeoutNow(const uv_buf_t *buf, struct raft_timeout_now *p)
     p->last_log_term = byteGet64(&cursor);
 }
 
+int uvDecodeKeepalive(const uv_buf_t *header, unsigned *interval)
+{
+    const uint8_t *cursor = (const uint8_t *)header->base;
+    uint64_t value;
+    if (header->len != sizeof(uint64_t)) {
+        return RAFT_MALFORMED;
+    }
+    value = byteGet64(&cursor);
+    if (value == 0 || value > UINT_MAX) {
+        return RAFT_MALFORMED;
+    }
+    *interval = (unsigned)value;
+    return 0;
+}
+
 int uvDecodeMessage(uint8_t type,
                     uint8_t version,
                     const uv_buf_t *header,
                     struct raft_message *message,
-                    size_t *payload_len)
+                    size_t *payload_len,
+                    bool *compressed)
 {
+    size_t compressed_len;
     unsigned i;
     int rv = 0;
 
@@ -582,6 +720,7 @@ int uvDecodeMessage(uint8_t type,
     message->type = (unsigned short)type;
 
     *payload_len = 0;
+    *compressed = false;
 
     /* Decode the header. */
     switch (type) {
@@ -593,14 +732,23 @@ int uvDecodeMessage(uint8_t type,
                                     &message->request_vote_result);
             break;
         case RAFT_APPEND_ENTRIES:
-            rv = decodeAppendEntries(version, header, &message->append_entries);
+            rv = decodeAppendEntries(version, header, &message->append_entries,
+                                     &compressed_len);
+            if (rv != 0) {
+                break;
+            }
+            if (compressed_len > 0) {
+                *payload_len = compressed_len;
+                *compressed = true;
+                break;
+            }
             for (i = 0; i < message->append_entries.n_entries; i++) {
                 *payload_len += message->append_entries.entries[i].buf.len;
             }
             break;
         case RAFT_APPEND_ENTRIES_RESULT:
-            decodeAppendEntriesResult(version, header,
-                                      &message->append_entries_result);
+            rv = decodeAppendEntriesResult(version, header,
+                                           &message->append_entries_result);
             break;
         case RAFT_INSTALL_SNAPSHOT:
             rv = decodeInstallSnapshot(version, header,
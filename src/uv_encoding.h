@@ -14,11 +14,41 @@ int uvEncodeMessage(const struct raft_message *message,
                     uv_buf_t **bufs,
                     unsigned *n_bufs);
 
+/* Record the given group ID in the preamble of an encoded message, using the
+ * last 4 bytes of the message type field, which are otherwise zero. */
+void uvEncodeMessageGroup(uv_buf_t *header, uint32_t group);
+
+/* Type code of the keepalive frames written on idle connections. It's not
+ * used by any raft message, see UvKeepaliveStart(). */
+#define UV__KEEPALIVE 255
+
+/* Size of an encoded keepalive frame: a preamble followed by an 8-byte header
+ * holding the keepalive interval of the sender, in milliseconds. */
+#define UV__KEEPALIVE_SIZE (3 * sizeof(uint64_t))
+
+/* Encode a keepalive frame into a buffer of UV__KEEPALIVE_SIZE bytes. */
+void uvEncodeKeepalive(unsigned interval, void *buf);
+
+/* Decode the header of a keepalive frame, returning the keepalive interval of
+ * the sender. */
+int uvDecodeKeepalive(const uv_buf_t *header, unsigned *interval);
+
+/* Compress the entries payload of an encoded AppendEntries message into a
+ * single LZ4 frame, which replaces the entry buffers and whose size is recorded
+ * in the message header. The frame is returned in the last buffer and is owned
+ * by the caller. If compression would not shrink the payload, the message is
+ * left untouched and RAFT_INVALID is returned. */
+int uvEncodeCompressedEntries(uv_buf_t *bufs, unsigned *n_bufs);
+
+/* Decode the given message header. If the message is an AppendEntries request
+ * whose payload was compressed with uvEncodeCompressedEntries(), @compressed is
+ * set to true and @payload_len is the size of the compressed frame. */
 int uvDecodeMessage(uint8_t type,
                     uint8_t version,
                     const uv_buf_t *header,
                     struct raft_message *message,
-                    size_t *payload_len);
+                    size_t *payload_len,
+                    bool *compressed);
 
 int uvDecodeBatchHeader(const void *batch,
                         struct raft_entry **entries,
@@ -55,6 +55,15 @@ static void uvFinalizeWorkCb(uv_work_t *work)
         goto err;
     }
 
+    /* Write the segment's batch index, so startup can seek past entries that
+     * are already covered by a snapshot. The index is just an optimization,
+     * failing to write it is not an error. */
+    rv = uvSegmentIndexWrite(uv, segment->first_index, segment->last_index,
+                             errmsg);
+    if (rv != 0) {
+        tracef("write index of segment %s: %s", filename2, errmsg);
+    }
+
 sync:
     rv = UvFsSyncDir(uv->dir, errmsg);
     if (rv != 0) {
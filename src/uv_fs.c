@@ -234,6 +234,33 @@ err:
     return rv;
 }
 
+int UvFsAllocateTempFile(const char *dir,
+                         size_t size,
+                         uv_file *fd,
+                         char *errmsg)
+{
+    int rv;
+
+    rv = uvFsOpenFile(dir, "", O_TMPFILE | O_WRONLY, S_IRUSR | S_IWUSR, fd,
+                      errmsg);
+    if (rv != 0) {
+        goto err;
+    }
+
+    rv = uvFsAllocate(*fd, size, errmsg);
+    if (rv != 0) {
+        goto err_after_open;
+    }
+
+    return 0;
+
+err_after_open:
+    UvOsClose(*fd);
+err:
+    assert(rv != 0);
+    return rv;
+}
+
 int UvFsCreateTempFile(const char *dir,
                        struct raft_buffer *bufs,
                        unsigned n_bufs,
@@ -248,17 +275,11 @@ int UvFsCreateTempFile(const char *dir,
         size += bufs[i].len;
     }
 
-    rv = uvFsOpenFile(dir, "", O_TMPFILE | O_WRONLY, S_IRUSR | S_IWUSR, fd,
-                      errmsg);
+    rv = UvFsAllocateTempFile(dir, size, fd, errmsg);
     if (rv != 0) {
         goto err;
     }
 
-    rv = uvFsAllocate(*fd, size, errmsg);
-    if (rv != 0) {
-        goto err_after_open;
-    }
-
     rv = UvOsWrite(*fd, (const uv_buf_t *)bufs, n_bufs, 0);
     if (rv != (int)(size)) {
         if (rv < 0) {
@@ -539,6 +560,35 @@ int UvFsReadInto(uv_file fd, struct raft_buffer *buf, char *errmsg)
     return 0;
 }
 
+int UvFsReadAt(uv_file fd,
+               struct raft_buffer *buf,
+               size_t offset,
+               char *errmsg)
+{
+    ssize_t rv;
+    size_t n = 0;
+
+    while (n < buf->len) {
+        rv = pread(fd, (char *)buf->base + n, buf->len - n,
+                   (off_t)(offset + n));
+        if (rv == -1) {
+            UvOsErrMsg(errmsg, "pread", -errno);
+            return RAFT_IOERR;
+        }
+        if (rv == 0) {
+            break;
+        }
+        assert(rv > 0);
+        n += (size_t)rv;
+    }
+    if (n < buf->len) {
+        ErrMsgPrintf(errmsg, "short read: %zu bytes instead of %zu", n,
+                     buf->len);
+        return RAFT_IOERR;
+    }
+    return 0;
+}
+
 int UvFsReadFile(const char *dir,
                  const char *filename,
                  struct raft_buffer *buf,
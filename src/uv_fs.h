@@ -43,6 +43,14 @@ int UvFsAllocateFile(const char *dir,
                      uv_file *fd,
                      char *errmsg);
 
+/* Allocate an invisible temporary file of the given size within the given
+ * directory, returning its file descriptor. The file content is left
+ * uninitialized. */
+int UvFsAllocateTempFile(const char *dir,
+                         size_t size,
+                         uv_file *fd,
+                         char *errmsg);
+
 /* Allocate and write an invisible temporary file of the given size within the
  * given directory, returning its file descriptor. */
 int UvFsCreateTempFile(const char *dir,
@@ -88,6 +96,13 @@ int UvFsOpenFileForReading(const char *dir,
    buf->base. Fail if less than buf->len bytes are read. */
 int UvFsReadInto(uv_file fd, struct raft_buffer *buf, char *errmsg);
 
+/* Read exactly buf->len bytes from the given file descriptor into buf->base,
+ * starting at the given offset. Fail if less than buf->len bytes are read. */
+int UvFsReadAt(uv_file fd,
+               struct raft_buffer *buf,
+               size_t offset,
+               char *errmsg);
+
 /* Read all the content of the given file. */
 int UvFsReadFile(const char *dir,
                  const char *filename,
@@ -0,0 +1,452 @@
+#include <limits.h>
+#include <string.h>
+
+#include "../include/raft/uv.h"
+#include "assert.h"
+#include "err.h"
+#include "heap.h"
+#include "uv.h"
+
+#define tracef(...) Tracef(h->hub.tracer, __VA_ARGS__)
+
+/* A host lets many raft groups share the network connections and the tick
+ * timer that a standalone libuv raft_io instance would own:
+ *
+ * - The hub is a partially initialized uv object which only manages network
+ *   connections, using the same code as standalone instances. It listens on
+ *   the host's transport and owns the clients connected to peer hosts.
+ *
+ * - Sending a message from a group encodes it as usual, records the group ID
+ *   in its preamble and queues it on the hub client connected to the target
+ *   server, see UvSend().
+ *
+ * - Messages read from the connections accepted by the hub are passed to the
+ *   group whose ID is in the preamble, see UvHostRecv().
+ *
+ * - A single one-shot timer ticks all started groups. It's armed for the
+ *   earliest tick due, either the deadline set by a group with
+ *   raft_io->set_deadline() or the next periodic tick of a group that didn't
+ *   set any. The hub is corked while ticking, so the heartbeats that the groups
+ *   send to the same peer are coalesced into a single write, see
+ *   UvSendUncork().
+ *
+ * - Keepalives are exchanged by the hub, once per peer host rather than once
+ *   per group, and a silent connection is reported as unreachable to all
+ *   groups, see UvKeepaliveStart().
+ *
+ * Disk I/O is not shared yet: each group has its own data directory, segments
+ * and prepare pool, like a standalone instance. Sharing a single write-ahead
+ * segment stream needs a new on-disk format, where batches carry their group ID
+ * and each group indexes its entries in the shared segments, plus a way to
+ * truncate a single group's log and to remove a shared segment only once all
+ * groups having entries in it took a snapshot past them. */
+
+struct uvHost
+{
+    struct raft_uv_host *host;           /* Interface object we implement */
+    struct uv_loop_s *loop;              /* UV event loop */
+    struct raft_uv_transport *transport; /* Transport shared by all groups */
+    raft_id id;                          /* Server ID, set by the first group */
+    char *address;                       /* Server address */
+    bool listening;                      /* Whether the hub is listening */
+    queue groups;                        /* Attached raft_io instances */
+    struct uv_timer_s timer;             /* Tick all groups */
+    raft_time due;                       /* Timer expiration, if armed */
+    bool ticking;                        /* Whether the timer cb is running */
+    struct raft_io io;                   /* Placeholder owning the hub */
+    struct uv hub;                       /* Shared connections */
+    bool hub_closed;                     /* Whether the hub has been closed */
+    raft_uv_host_close_cb close_cb;      /* Invoked when finishing closing */
+};
+
+/* Initialize the hub, which only needs the state used to manage connections. */
+static void uvHostHubInit(struct uvHost *h)
+{
+    struct uv *hub = &h->hub;
+    memset(hub, 0, sizeof *hub);
+    memset(&h->io, 0, sizeof h->io);
+    h->io.impl = hub;
+    h->io.data = h;
+    hub->io = &h->io;
+    hub->loop = h->loop;
+    hub->transport = h->transport;
+    hub->tracer = &StderrTracer;
+    hub->state = UV__ACTIVE;
+    QUEUE_INIT(&hub->clients);
+    QUEUE_INIT(&hub->servers);
+    hub->connect_retry_delay = UV__CONNECT_RETRY_DELAY;
+    QUEUE_INIT(&hub->prepare_reqs);
+    QUEUE_INIT(&hub->prepare_pool);
+    QUEUE_INIT(&hub->append_segments);
+    QUEUE_INIT(&hub->append_pending_reqs);
+    QUEUE_INIT(&hub->append_writing_reqs);
+    QUEUE_INIT(&hub->finalize_reqs);
+    QUEUE_INIT(&hub->snapshot_get_reqs);
+    QUEUE_INIT(&hub->async_work_reqs);
+    QUEUE_INIT(&hub->read_reqs);
+    /* Streamed payloads are staged in the data directory of the receiver,
+     * which is not known until the whole header has been read. */
+    hub->snapshot_stream_threshold = 0;
+    hub->send_queue_size = UV__SEND_QUEUE_SIZE;
+    hub->keepalive_interval = UV__KEEPALIVE_INTERVAL;
+    hub->snapshot_staged.fd = -1;
+    QUEUE_INIT(&hub->aborting);
+    QUEUE_INIT(&hub->inproc_reqs);
+    hub->hub = h;
+}
+
+int raft_uv_host_init(struct raft_uv_host *host,
+                      struct uv_loop_s *loop,
+                      struct raft_uv_transport *transport)
+{
+    struct uvHost *h;
+    void *data = host->data;
+    int rv;
+
+    assert(loop != NULL);
+    assert(transport != NULL);
+
+    memset(host, 0, sizeof *host);
+    host->data = data;
+
+    if (transport->version == 0) {
+        ErrMsgPrintf(host->errmsg, "transport->version must be set");
+        return RAFT_INVALID;
+    }
+
+    h = raft_malloc(sizeof *h);
+    if (h == NULL) {
+        ErrMsgOom(host->errmsg);
+        return RAFT_NOMEM;
+    }
+    h->host = host;
+    h->loop = loop;
+    h->transport = transport;
+    h->id = 0;
+    h->address = NULL;
+    h->listening = false;
+    QUEUE_INIT(&h->groups);
+    rv = uv_timer_init(loop, &h->timer);
+    assert(rv == 0); /* This should never fail */
+    h->timer.data = h;
+    h->due = ULLONG_MAX;
+    h->ticking = false;
+    h->hub_closed = false;
+    h->close_cb = NULL;
+    uvHostHubInit(h);
+
+    transport->data = NULL; /* Set when the first group gets initialized */
+
+    host->impl = h;
+
+    return 0;
+}
+
+/* Release the host once both the hub and the timer are closed. */
+static void uvHostMaybeFireCloseCb(struct uvHost *h)
+{
+    struct raft_uv_host *host = h->host;
+    raft_uv_host_close_cb cb = h->close_cb;
+
+    if (!h->hub_closed || h->timer.data != NULL) {
+        return;
+    }
+
+    host->impl = NULL;
+    RaftHeapFree(h->address);
+    raft_free(h);
+
+    if (cb != NULL) {
+        cb(host);
+    }
+}
+
+static void uvHostHubCloseCb(struct raft_io *io)
+{
+    struct uvHost *h = io->data;
+    h->hub_closed = true;
+    uvHostMaybeFireCloseCb(h);
+}
+
+static void uvHostTransportCloseCb(struct raft_uv_transport *transport)
+{
+    struct uv *hub = transport->data;
+    assert(hub->closing);
+    transport->data = NULL;
+    uvMaybeFireCloseCb(hub);
+}
+
+static void uvHostTimerCloseCb(uv_handle_t *handle)
+{
+    struct uvHost *h = handle->data;
+    h->timer.data = NULL;
+    uvHostMaybeFireCloseCb(h);
+}
+
+void raft_uv_host_close(struct raft_uv_host *host, raft_uv_host_close_cb cb)
+{
+    struct uvHost *h = host->impl;
+    struct uv *hub = &h->hub;
+
+    assert(QUEUE_IS_EMPTY(&h->groups));
+    assert(!hub->closing);
+
+    h->close_cb = cb;
+    hub->close_cb = uvHostHubCloseCb;
+    hub->closing = true;
+    UvSendClose(hub);
+    UvRecvClose(hub);
+    UvKeepaliveClose(hub);
+    if (h->transport->data != NULL) {
+        h->transport->close(h->transport, uvHostTransportCloseCb);
+    }
+    uv_close((uv_handle_t *)&h->timer, uvHostTimerCloseCb);
+    uvMaybeFireCloseCb(hub);
+}
+
+void raft_uv_host_set_keepalive(struct raft_uv_host *host, unsigned msecs)
+{
+    struct uvHost *h = host->impl;
+    h->hub.keepalive_interval = msecs;
+}
+
+int raft_uv_init_group(struct raft_io *io,
+                       struct raft_uv_host *host,
+                       const char *dir,
+                       uint32_t group)
+{
+    struct uvHost *h = host->impl;
+    struct uv *uv;
+    queue *head;
+    int rv;
+
+    assert(!h->hub.closing);
+
+    QUEUE_FOREACH (head, &h->groups) {
+        uv = QUEUE_DATA(head, struct uv, host_queue);
+        if (uv->group == group) {
+            ErrMsgPrintf(io->errmsg, "group %u already exists", group);
+            return RAFT_DUPLICATEID;
+        }
+    }
+
+    rv = raft_uv_init(io, h->loop, dir, h->transport);
+    if (rv != 0) {
+        return rv;
+    }
+
+    /* Undo the reset of the transport done by raft_uv_init(). */
+    if (h->id != 0) {
+        h->transport->data = &h->hub;
+    }
+
+    uv = io->impl;
+    uv->host = h;
+    uv->group = group;
+    QUEUE_PUSH(&h->groups, &uv->host_queue);
+
+    return 0;
+}
+
+void UvHostDetach(struct uv *uv)
+{
+    assert(uv->host != NULL);
+    QUEUE_REMOVE(&uv->host_queue);
+    uv->host = NULL;
+}
+
+int UvHostInit(struct uv *uv, raft_id id, const char *address)
+{
+    struct uvHost *h = uv->host;
+    char *copy;
+    int rv;
+
+    if (h->id != 0) {
+        if (id != h->id || strcmp(address, h->address) != 0) {
+            ErrMsgPrintf(uv->io->errmsg,
+                         "server %llu at %s doesn't match host server %llu "
+                         "at %s",
+                         id, address, h->id, h->address);
+            return RAFT_INVALID;
+        }
+        return 0;
+    }
+
+    /* The transport might keep a reference to the address, which must outlive
+     * the group. */
+    copy = RaftHeapMalloc(strlen(address) + 1);
+    if (copy == NULL) {
+        ErrMsgOom(uv->io->errmsg);
+        return RAFT_NOMEM;
+    }
+    strcpy(copy, address);
+
+    rv = h->transport->init(h->transport, id, copy);
+    if (rv != 0) {
+        ErrMsgTransfer(h->transport->errmsg, uv->io->errmsg, "transport");
+        RaftHeapFree(copy);
+        return rv;
+    }
+    h->transport->data = &h->hub;
+    h->id = id;
+    h->address = copy;
+
+    return 0;
+}
+
+/* Time of the next tick of the given group, or ULLONG_MAX if none. */
+static raft_time uvHostNextTick(struct uv *uv)
+{
+    if (uv->closing || uv->tick_cb == NULL) {
+        return ULLONG_MAX;
+    }
+    if (uv->tick_oneshot) {
+        return uv->tick_deadline;
+    }
+    return uv->host_last_tick + uv->host_tick;
+}
+
+static void uvHostTimerCb(uv_timer_t *timer);
+
+/* Arm the timer to fire at the given time, or stop it. */
+static void uvHostArm(struct uvHost *h, raft_time due)
+{
+    raft_time now = uv_now(h->loop);
+    int rv;
+
+    h->due = due;
+    if (due == ULLONG_MAX) {
+        rv = uv_timer_stop(&h->timer);
+    } else {
+        rv = uv_timer_start(&h->timer, uvHostTimerCb,
+                            due > now ? due - now : 0, 0);
+    }
+    assert(rv == 0);
+}
+
+/* Arm the timer for the earliest tick due. */
+static void uvHostSchedule(struct uvHost *h)
+{
+    raft_time due = ULLONG_MAX;
+    queue *head;
+
+    QUEUE_FOREACH (head, &h->groups) {
+        struct uv *uv = QUEUE_DATA(head, struct uv, host_queue);
+        raft_time next = uvHostNextTick(uv);
+        if (next < due) {
+            due = next;
+        }
+    }
+
+    uvHostArm(h, due);
+}
+
+/* Tick all started groups whose deadline or tick interval has elapsed. */
+static void uvHostTimerCb(uv_timer_t *timer)
+{
+    struct uvHost *h = timer->data;
+    raft_time now = uv_now(h->loop);
+    queue *head;
+
+    h->ticking = true;
+    UvSendCork(&h->hub);
+    QUEUE_FOREACH (head, &h->groups) {
+        struct uv *uv = QUEUE_DATA(head, struct uv, host_queue);
+        if (uvHostNextTick(uv) > now) {
+            continue;
+        }
+        if (uv->tick_oneshot) {
+            uv->tick_deadline = ULLONG_MAX;
+        } else {
+            /* Advance by one interval, so that a slightly late timer doesn't
+             * make the following ticks drift, but don't try to catch up
+             * after a long stall. */
+            if (now - uv->host_last_tick < 2 * (raft_time)uv->host_tick) {
+                uv->host_last_tick += uv->host_tick;
+            } else {
+                uv->host_last_tick = now;
+            }
+        }
+        uv->tick_cb(uv->io);
+    }
+    UvSendUncork(&h->hub);
+    h->ticking = false;
+
+    uvHostSchedule(h);
+}
+
+int UvHostStart(struct uv *uv, unsigned msecs)
+{
+    struct uvHost *h = uv->host;
+    int rv;
+
+    assert(h->id != 0);
+
+    if (!h->listening) {
+        rv = UvRecvStart(&h->hub);
+        if (rv != 0) {
+            ErrMsgTransfer(h->transport->errmsg, uv->io->errmsg, "transport");
+            return rv;
+        }
+        h->listening = true;
+    }
+
+    uv->host_tick = msecs;
+    uv->host_last_tick = uv_now(h->loop);
+
+    if (!h->ticking && uvHostNextTick(uv) < h->due) {
+        uvHostArm(h, uvHostNextTick(uv));
+    }
+
+    return 0;
+}
+
+void UvHostSetDeadline(struct uv *uv)
+{
+    struct uvHost *h = uv->host;
+
+    /* A later deadline doesn't need to re-arm the timer: when it fires too
+     * early it just re-arms itself for the earliest tick due. */
+    if (!h->ticking && uvHostNextTick(uv) < h->due) {
+        uvHostArm(h, uvHostNextTick(uv));
+    }
+}
+
+struct uv *UvHostHub(struct uvHost *h)
+{
+    return &h->hub;
+}
+
+bool UvHostRecv(struct uvHost *h, uint32_t group, struct raft_message *message)
+{
+    queue *head;
+
+    QUEUE_FOREACH (head, &h->groups) {
+        struct uv *uv = QUEUE_DATA(head, struct uv, host_queue);
+        if (uv->group != group) {
+            continue;
+        }
+        if (uv->closing || uv->recv_cb == NULL) {
+            break;
+        }
+        uv->recv_cb(uv->io, message);
+        return true;
+    }
+
+    return false;
+}
+
+void UvHostUnreachable(struct uvHost *h, raft_id id)
+{
+    queue *head;
+
+    QUEUE_FOREACH (head, &h->groups) {
+        struct uv *uv = QUEUE_DATA(head, struct uv, host_queue);
+        if (uv->closing || uv->unreachable_cb == NULL) {
+            continue;
+        }
+        uv->unreachable_cb(uv->io, id);
+    }
+}
+
+#undef tracef
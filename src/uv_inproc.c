@@ -0,0 +1,460 @@
+#include <string.h>
+
+#include "../include/raft/uv.h"
+#include "assert.h"
+#include "byte.h"
+#include "configuration.h"
+#include "err.h"
+#include "heap.h"
+#include "uv.h"
+
+#define tracef(...) Tracef(uv->tracer, __VA_ARGS__)
+
+/* The in-process transport is meant for several raft_io instances running in
+ * the same process, on the same event loop. It never establishes connections:
+ * instead, raft_io->send() recognizes it and takes a shortcut.
+ *
+ * - Listening registers the transport in a process-wide registry, keyed by
+ *   event loop and address.
+ *
+ * - Sending a message copies it into a request object, without encoding it.
+ *   Entries and snapshot payloads are copied into a single buffer, since the
+ *   receiver takes ownership of them. The request is queued and an idle handle
+ *   is started, so the send callback is never fired synchronously.
+ *
+ * - In the next loop iteration the idle handle looks up the receiving instance
+ *   in the registry, fires its recv callback with the message and then fires
+ *   the send callback. If there's no such instance, the request fails with
+ *   RAFT_NOCONNECTION.
+ */
+
+struct uvInproc
+{
+    struct raft_uv_transport *transport; /* Interface object we implement */
+    struct uv_loop_s *loop;              /* Event loop */
+    raft_id id;                          /* ID of this raft server */
+    char *address;                       /* Address of this raft server */
+    bool listening;                      /* Whether we're in the registry */
+    queue queue;                         /* Registry of listening transports */
+};
+
+/* Hold state for a single send request to an in-process server. */
+struct uvInprocSend
+{
+    struct raft_io_send *req;    /* User request */
+    struct raft_message message; /* Copy of the message, owned by us */
+    char *address;               /* Address of the receiving server */
+    queue queue;                 /* Pending send requests queue */
+};
+
+static uv_once_t uvInprocOnce = UV_ONCE_INIT;
+static uv_mutex_t uvInprocMutex;
+static queue uvInprocRegistry;
+
+static void uvInprocRegistryInit(void)
+{
+    int rv;
+    rv = uv_mutex_init(&uvInprocMutex);
+    assert(rv == 0);
+    QUEUE_INIT(&uvInprocRegistry);
+}
+
+/* Find the listening transport with the given address on the given loop. */
+static struct uvInproc *uvInprocRegistryGet(struct uv_loop_s *loop,
+                                            const char *address)
+{
+    struct uvInproc *i;
+    queue *head;
+    QUEUE_FOREACH (head, &uvInprocRegistry) {
+        i = QUEUE_DATA(head, struct uvInproc, queue);
+        if (i->loop == loop && strcmp(i->address, address) == 0) {
+            return i;
+        }
+    }
+    return NULL;
+}
+
+/* Implementation of raft_uv_transport->init. */
+static int uvInprocInit(struct raft_uv_transport *transport,
+                        raft_id id,
+                        const char *address)
+{
+    struct uvInproc *i = transport->impl;
+    char *copy;
+    assert(id > 0);
+    assert(address != NULL);
+    assert(!i->listening);
+    copy = RaftHeapMalloc(strlen(address) + 1);
+    if (copy == NULL) {
+        ErrMsgOom(transport->errmsg);
+        return RAFT_NOMEM;
+    }
+    strcpy(copy, address);
+    RaftHeapFree(i->address);
+    i->id = id;
+    i->address = copy;
+    return 0;
+}
+
+/* Implementation of raft_uv_transport->listen. */
+static int uvInprocListen(struct raft_uv_transport *transport,
+                          raft_uv_accept_cb cb)
+{
+    struct uvInproc *i = transport->impl;
+    int rv = 0;
+    (void)cb; /* Messages are delivered directly, without connections. */
+    assert(i->address != NULL);
+    assert(!i->listening);
+    uv_mutex_lock(&uvInprocMutex);
+    if (uvInprocRegistryGet(i->loop, i->address) != NULL) {
+        ErrMsgPrintf(transport->errmsg, "address %s already in use",
+                     i->address);
+        rv = RAFT_IOERR;
+    } else {
+        QUEUE_PUSH(&uvInprocRegistry, &i->queue);
+        i->listening = true;
+    }
+    uv_mutex_unlock(&uvInprocMutex);
+    return rv;
+}
+
+/* Implementation of raft_uv_transport->connect. */
+static int uvInprocConnect(struct raft_uv_transport *transport,
+                           struct raft_uv_connect *req,
+                           raft_id id,
+                           const char *address,
+                           raft_uv_connect_cb cb)
+{
+    (void)req;
+    (void)id;
+    (void)cb;
+    ErrMsgPrintf(transport->errmsg, "can't connect to %s: in-process transport",
+                 address);
+    return RAFT_NOCONNECTION;
+}
+
+/* Implementation of raft_uv_transport->close. */
+static void uvInprocClose(struct raft_uv_transport *transport,
+                          raft_uv_transport_close_cb cb)
+{
+    struct uvInproc *i = transport->impl;
+    if (i->listening) {
+        uv_mutex_lock(&uvInprocMutex);
+        QUEUE_REMOVE(&i->queue);
+        uv_mutex_unlock(&uvInprocMutex);
+        i->listening = false;
+    }
+    if (cb != NULL) {
+        cb(transport);
+    }
+}
+
+int raft_uv_inproc_init(struct raft_uv_transport *transport,
+                        struct uv_loop_s *loop)
+{
+    struct uvInproc *i;
+    void *data = transport->data;
+    int version = transport->version;
+    if (version != 1) {
+        ErrMsgPrintf(transport->errmsg, "Invalid version: %d", version);
+        return RAFT_INVALID;
+    }
+
+    uv_once(&uvInprocOnce, uvInprocRegistryInit);
+
+    memset(transport, 0, sizeof *transport);
+    transport->data = data;
+    transport->version = version;
+    i = raft_malloc(sizeof *i);
+    if (i == NULL) {
+        ErrMsgOom(transport->errmsg);
+        return RAFT_NOMEM;
+    }
+    i->transport = transport;
+    i->loop = loop;
+    i->id = 0;
+    i->address = NULL;
+    i->listening = false;
+
+    transport->impl = i;
+    transport->init = uvInprocInit;
+    transport->close = uvInprocClose;
+    transport->listen = uvInprocListen;
+    transport->connect = uvInprocConnect;
+
+    return 0;
+}
+
+void raft_uv_inproc_close(struct raft_uv_transport *transport)
+{
+    struct uvInproc *i = transport->impl;
+    assert(!i->listening);
+    RaftHeapFree(i->address);
+    raft_free(i);
+}
+
+bool UvInprocEnabled(struct uv *uv)
+{
+    return uv->transport->init == uvInprocInit;
+}
+
+/* Copy the entries of an AppendEntries message, placing all their data in a
+ * single batch. */
+static int uvInprocCopyEntries(const struct raft_entry *src,
+                               unsigned n,
+                               struct raft_entry **dst)
+{
+    struct raft_entry *entries;
+    uint8_t *cursor;
+    void *batch;
+    size_t size = 0;
+    unsigned j;
+
+    for (j = 0; j < n; j++) {
+        size += bytePad64(src[j].buf.len);
+    }
+
+    entries = RaftHeapMalloc(n * sizeof *entries);
+    if (entries == NULL) {
+        goto oom;
+    }
+    batch = RaftHeapMalloc(size > 0 ? size : 1);
+    if (batch == NULL) {
+        goto oom_after_entries_alloc;
+    }
+
+    cursor = batch;
+    for (j = 0; j < n; j++) {
+        entries[j].term = src[j].term;
+        entries[j].type = src[j].type;
+        entries[j].buf.base = cursor;
+        entries[j].buf.len = src[j].buf.len;
+        entries[j].batch = batch;
+        if (src[j].buf.len > 0) {
+            memcpy(cursor, src[j].buf.base, src[j].buf.len);
+        }
+        cursor += bytePad64(src[j].buf.len);
+    }
+
+    *dst = entries;
+    return 0;
+
+oom_after_entries_alloc:
+    RaftHeapFree(entries);
+oom:
+    return RAFT_NOMEM;
+}
+
+/* Copy the given message, including any payload that the receiver will take
+ * ownership of. */
+static int uvInprocCopyMessage(const struct raft_message *src,
+                               struct raft_message *dst)
+{
+    struct raft_install_snapshot *snapshot;
+    int rv;
+
+    *dst = *src;
+
+    switch (src->type) {
+        case RAFT_APPEND_ENTRIES:
+            dst->append_entries.entries = NULL;
+            if (src->append_entries.n_entries == 0) {
+                break;
+            }
+            rv = uvInprocCopyEntries(src->append_entries.entries,
+                                     src->append_entries.n_entries,
+                                     &dst->append_entries.entries);
+            if (rv != 0) {
+                return rv;
+            }
+            break;
+        case RAFT_INSTALL_SNAPSHOT:
+            snapshot = &dst->install_snapshot;
+            rv = configurationCopy(&src->install_snapshot.conf,
+                                   &snapshot->conf);
+            if (rv != 0) {
+                return rv;
+            }
+            snapshot->data.base = RaftHeapMalloc(
+                snapshot->data.len > 0 ? snapshot->data.len : 1);
+            if (snapshot->data.base == NULL) {
+                raft_configuration_close(&snapshot->conf);
+                return RAFT_NOMEM;
+            }
+            if (snapshot->data.len > 0) {
+                memcpy(snapshot->data.base, src->install_snapshot.data.base,
+                       snapshot->data.len);
+            }
+            break;
+        default:
+            break;
+    }
+
+    return 0;
+}
+
+/* Release the payload of a message that was never delivered. */
+static void uvInprocReleaseMessage(struct raft_message *message)
+{
+    switch (message->type) {
+        case RAFT_APPEND_ENTRIES:
+            if (message->append_entries.entries != NULL) {
+                RaftHeapFree(message->append_entries.entries[0].batch);
+                RaftHeapFree(message->append_entries.entries);
+            }
+            break;
+        case RAFT_INSTALL_SNAPSHOT:
+            raft_configuration_close(&message->install_snapshot.conf);
+            RaftHeapFree(message->install_snapshot.data.base);
+            break;
+        default:
+            break;
+    }
+}
+
+/* Deliver the given message to its receiver and complete the request. */
+static void uvInprocDeliver(struct uv *uv, struct uvInprocSend *send)
+{
+    struct uvInproc *i = uv->transport->impl;
+    struct uvInproc *peer;
+    struct uv *target = NULL;
+    struct raft_io_send *req = send->req;
+    int status = 0;
+
+    uv_mutex_lock(&uvInprocMutex);
+    peer = uvInprocRegistryGet(uv->loop, send->address);
+    uv_mutex_unlock(&uvInprocMutex);
+
+    if (peer != NULL) {
+        target = peer->transport->data;
+    }
+
+    if (target == NULL || target->closing || target->recv_cb == NULL) {
+        tracef("no in-process server at %s", send->address);
+        uvInprocReleaseMessage(&send->message);
+        status = RAFT_NOCONNECTION;
+    } else {
+        send->message.server_id = i->id;
+        send->message.server_address = i->address;
+        target->recv_cb(target->io, &send->message);
+    }
+
+    RaftHeapFree(send->address);
+    RaftHeapFree(send);
+
+    if (req->cb != NULL) {
+        req->cb(req, status);
+    }
+}
+
+/* Deliver the messages that were queued before this loop iteration. Messages
+ * sent by the callbacks we fire will be delivered in the next iteration. */
+static void uvInprocIdleCb(uv_idle_t *idle)
+{
+    struct uv *uv = idle->data;
+    queue *last = QUEUE_TAIL(&uv->inproc_reqs);
+    queue *head;
+    bool done = false;
+
+    while (!done && !uv->closing && !QUEUE_IS_EMPTY(&uv->inproc_reqs)) {
+        struct uvInprocSend *send;
+        head = QUEUE_HEAD(&uv->inproc_reqs);
+        done = head == last;
+        send = QUEUE_DATA(head, struct uvInprocSend, queue);
+        QUEUE_REMOVE(head);
+        uvInprocDeliver(uv, send);
+    }
+
+    if (!uv->closing && QUEUE_IS_EMPTY(&uv->inproc_reqs)) {
+        uv_idle_stop(idle);
+    }
+}
+
+void UvInprocStart(struct uv *uv)
+{
+    int rv;
+    rv = uv_idle_init(uv->loop, &uv->inproc_idle);
+    assert(rv == 0);
+    uv->inproc_idle.data = uv;
+}
+
+int UvInprocSend(struct uv *uv,
+                 struct raft_io_send *req,
+                 const struct raft_message *message,
+                 raft_io_send_cb cb)
+{
+    struct uvInprocSend *send;
+    int rv;
+
+    assert(!uv->closing);
+    assert(uv->inproc_idle.data != NULL);
+
+    send = RaftHeapMalloc(sizeof *send);
+    if (send == NULL) {
+        rv = RAFT_NOMEM;
+        goto err;
+    }
+    send->req = req;
+    req->cb = cb;
+
+    send->address = RaftHeapMalloc(strlen(message->server_address) + 1);
+    if (send->address == NULL) {
+        rv = RAFT_NOMEM;
+        goto err_after_send_alloc;
+    }
+    strcpy(send->address, message->server_address);
+
+    rv = uvInprocCopyMessage(message, &send->message);
+    if (rv != 0) {
+        goto err_after_address_alloc;
+    }
+
+    if (QUEUE_IS_EMPTY(&uv->inproc_reqs)) {
+        rv = uv_idle_start(&uv->inproc_idle, uvInprocIdleCb);
+        assert(rv == 0);
+    }
+    QUEUE_PUSH(&uv->inproc_reqs, &send->queue);
+
+    return 0;
+
+err_after_address_alloc:
+    RaftHeapFree(send->address);
+err_after_send_alloc:
+    RaftHeapFree(send);
+err:
+    assert(rv != 0);
+    return rv;
+}
+
+static void uvInprocIdleCloseCb(uv_handle_t *handle)
+{
+    struct uv *uv = handle->data;
+    assert(uv->closing);
+    uv->inproc_idle.data = NULL;
+    uvMaybeFireCloseCb(uv);
+}
+
+void UvInprocClose(struct uv *uv)
+{
+    assert(uv->closing);
+    while (!QUEUE_IS_EMPTY(&uv->inproc_reqs)) {
+        queue *head;
+        struct uvInprocSend *send;
+        struct raft_io_send *req;
+        head = QUEUE_HEAD(&uv->inproc_reqs);
+        send = QUEUE_DATA(head, struct uvInprocSend, queue);
+        QUEUE_REMOVE(head);
+        req = send->req;
+        uvInprocReleaseMessage(&send->message);
+        RaftHeapFree(send->address);
+        RaftHeapFree(send);
+        if (req->cb != NULL) {
+            req->cb(req, RAFT_CANCELED);
+        }
+    }
+    if (uv->inproc_idle.data != NULL) {
+        uv_close((uv_handle_t *)&uv->inproc_idle, uvInprocIdleCloseCb);
+    }
+}
+
+#undef tracef
@@ -0,0 +1,352 @@
+#include <string.h>
+
+#include "assert.h"
+#include "entry.h"
+#include "heap.h"
+#include "uv.h"
+
+#define tracef(...) Tracef(uv->tracer, __VA_ARGS__)
+
+/* Contiguous range of entries read back from a single segment. All entries
+ * share the same batch buffer. */
+struct uvReadChunk
+{
+    raft_index first_index;     /* Index of the first entry */
+    struct raft_entry *entries; /* Entries in the chunk */
+    size_t n;                   /* Number of entries */
+    size_t size;                /* Size of the entries data */
+    queue queue;                /* Link in the cache, oldest used first */
+};
+
+/* Track a read entries request. */
+struct uvRead
+{
+    struct uv *uv;
+    struct raft_io_read *req;
+    raft_index index;           /* Index of the first entry to read */
+    unsigned n;                 /* Maximum number of entries to read */
+    struct raft_entry *entries; /* Entries read */
+    unsigned n_entries;         /* Number of entries read */
+    unsigned long gen;          /* Cache generation when the read started */
+    struct uv_work_s work;
+    char errmsg[RAFT_ERRMSG_BUF_SIZE];
+    int status;
+    queue queue;
+};
+
+static void uvReadChunkDestroy(struct uvReadChunk *chunk)
+{
+    entryBatchesDestroy(chunk->entries, chunk->n);
+    RaftHeapFree(chunk);
+}
+
+/* Copy into the request the entries of the chunk starting at the requested
+ * index. */
+static int uvReadChunkCopy(struct uvReadChunk *chunk, struct uvRead *read)
+{
+    size_t offset = (size_t)(read->index - chunk->first_index);
+    size_t n = chunk->n - offset;
+    int rv;
+
+    assert(read->index >= chunk->first_index);
+    assert(offset < chunk->n);
+
+    if (n > read->n) {
+        n = read->n;
+    }
+    rv = entryBatchCopy(&chunk->entries[offset], &read->entries, n);
+    if (rv != 0) {
+        return rv;
+    }
+    read->n_entries = (unsigned)n;
+    return 0;
+}
+
+static bool uvReadChunkHas(const struct uvReadChunk *chunk, raft_index index)
+{
+    return index >= chunk->first_index && index < chunk->first_index + chunk->n;
+}
+
+/* Serve the request from the cache, if possible. Return false on misses, after
+ * recording the current cache generation. */
+static bool uvReadCacheLookup(struct uv *uv, struct uvRead *read)
+{
+    struct uvReadCache *cache = &uv->read_cache;
+    struct uvReadChunk *chunk;
+    queue *head;
+    bool hit = false;
+
+    uv_mutex_lock(&cache->mutex);
+    read->gen = cache->gen;
+    QUEUE_FOREACH (head, &cache->chunks) {
+        chunk = QUEUE_DATA(head, struct uvReadChunk, queue);
+        if (!uvReadChunkHas(chunk, read->index)) {
+            continue;
+        }
+        /* Move the chunk to the back, as most recently used. */
+        QUEUE_REMOVE(&chunk->queue);
+        QUEUE_PUSH(&cache->chunks, &chunk->queue);
+        read->status = uvReadChunkCopy(chunk, read);
+        hit = true;
+        break;
+    }
+    uv_mutex_unlock(&cache->mutex);
+
+    return hit;
+}
+
+/* Add a chunk loaded by the given request to the cache, evicting the least
+ * recently used ones if the cache gets too large. Chunks larger than the cache
+ * itself are not kept.
+ *
+ * If the cache was cleared since the request started, the log was truncated
+ * while the chunk was being loaded, so the chunk is dropped and false is
+ * returned. */
+static bool uvReadCacheInsert(struct uv *uv,
+                              struct uvRead *read,
+                              struct uvReadChunk *chunk)
+{
+    struct uvReadCache *cache = &uv->read_cache;
+    struct uvReadChunk *victim;
+    queue *head;
+
+    uv_mutex_lock(&cache->mutex);
+
+    if (cache->gen != read->gen) {
+        uv_mutex_unlock(&cache->mutex);
+        uvReadChunkDestroy(chunk);
+        return false;
+    }
+
+    if (chunk->size > cache->max_size) {
+        uv_mutex_unlock(&cache->mutex);
+        uvReadChunkDestroy(chunk);
+        return true;
+    }
+
+    QUEUE_PUSH(&cache->chunks, &chunk->queue);
+    cache->size += chunk->size;
+
+    while (cache->size > cache->max_size) {
+        head = QUEUE_HEAD(&cache->chunks);
+        victim = QUEUE_DATA(head, struct uvReadChunk, queue);
+        assert(victim != chunk);
+        QUEUE_REMOVE(&victim->queue);
+        cache->size -= victim->size;
+        uvReadChunkDestroy(victim);
+    }
+
+    uv_mutex_unlock(&cache->mutex);
+
+    return true;
+}
+
+/* Load from disk the entries of the closed segment containing the given index.
+ *
+ * Open segments are not read, since the writer might be appending to them at
+ * the same time: their entries are recent enough to still be cached in memory
+ * by the caller, and reading them fails with RAFT_NOTFOUND. */
+static int uvReadChunkLoad(struct uv *uv,
+                           raft_index index,
+                           struct uvReadChunk **chunk,
+                           char *errmsg)
+{
+    struct uvSnapshotInfo *snapshots;
+    struct uvSegmentInfo *segments;
+    struct uvSegmentInfo *segment;
+    struct raft_entry *entries = NULL;
+    size_t n_snapshots;
+    size_t n_segments;
+    size_t n = 0;
+    raft_index first_index = 0;
+    size_t i;
+    int rv;
+
+    rv = UvList(uv, &snapshots, &n_snapshots, &segments, &n_segments, errmsg);
+    if (rv != 0) {
+        return rv;
+    }
+    if (snapshots != NULL) {
+        RaftHeapFree(snapshots);
+    }
+
+    for (i = 0; i < n_segments; i++) {
+        segment = &segments[i];
+        if (segment->is_open || index < segment->first_index ||
+            index > segment->end_index) {
+            continue;
+        }
+        rv = uvSegmentReadClosed(uv, segment, index, &entries, &n, errmsg);
+        if (rv != 0) {
+            goto out;
+        }
+        first_index = segment->end_index - n + 1;
+        break;
+    }
+
+    if (n == 0) {
+        ErrMsgPrintf(errmsg, "no entry with index %llu", index);
+        rv = RAFT_NOTFOUND;
+        goto out;
+    }
+
+    *chunk = RaftHeapMalloc(sizeof **chunk);
+    if (*chunk == NULL) {
+        entryBatchesDestroy(entries, n);
+        rv = RAFT_NOMEM;
+        goto out;
+    }
+    (*chunk)->first_index = first_index;
+    (*chunk)->entries = entries;
+    (*chunk)->n = n;
+    (*chunk)->size = 0;
+    for (i = 0; i < n; i++) {
+        (*chunk)->size += entries[i].buf.len;
+    }
+
+out:
+    if (segments != NULL) {
+        RaftHeapFree(segments);
+    }
+    return rv;
+}
+
+static void uvReadWorkCb(uv_work_t *work)
+{
+    struct uvRead *read = work->data;
+    struct uv *uv = read->uv;
+    struct uvReadChunk *chunk;
+    int rv;
+
+    read->status = 0;
+
+    if (uvReadCacheLookup(uv, read)) {
+        return;
+    }
+
+    rv = uvReadChunkLoad(uv, read->index, &chunk, read->errmsg);
+    if (rv != 0) {
+        read->status = rv;
+        return;
+    }
+
+    read->status = uvReadChunkCopy(chunk, read);
+    if (!uvReadCacheInsert(uv, read, chunk)) {
+        if (read->status == 0) {
+            entryBatchesDestroy(read->entries, read->n_entries);
+            read->entries = NULL;
+            read->n_entries = 0;
+        }
+        ErrMsgPrintf(read->errmsg, "log truncated while reading");
+        read->status = RAFT_NOTFOUND;
+    }
+}
+
+static void uvReadAfterWorkCb(uv_work_t *work, int status)
+{
+    struct uvRead *read = work->data;
+    struct raft_io_read *req = read->req;
+    struct raft_entry *entries = read->entries;
+    unsigned n = read->n_entries;
+    int req_status = read->status;
+    struct uv *uv = read->uv;
+    assert(status == 0);
+    if (req_status != 0) {
+        tracef("read entries from %llu: %s", read->index, read->errmsg);
+        entries = NULL;
+        n = 0;
+    }
+    QUEUE_REMOVE(&read->queue);
+    RaftHeapFree(read);
+    req->cb(req, entries, n, req_status);
+    uvMaybeFireCloseCb(uv);
+}
+
+int UvRead(struct raft_io *io,
+           struct raft_io_read *req,
+           raft_index index,
+           unsigned n,
+           raft_io_read_cb cb)
+{
+    struct uv *uv;
+    struct uvRead *read;
+    int rv;
+
+    uv = io->impl;
+    assert(!uv->closing);
+    assert(n > 0);
+
+    read = RaftHeapMalloc(sizeof *read);
+    if (read == NULL) {
+        rv = RAFT_NOMEM;
+        goto err;
+    }
+    read->uv = uv;
+    read->req = req;
+    read->index = index;
+    read->n = n;
+    read->entries = NULL;
+    read->n_entries = 0;
+    read->gen = 0;
+    read->errmsg[0] = '\0';
+    read->work.data = read;
+    req->cb = cb;
+
+    QUEUE_PUSH(&uv->read_reqs, &read->queue);
+    rv = uv_queue_work(uv->loop, &read->work, uvReadWorkCb, uvReadAfterWorkCb);
+    if (rv != 0) {
+        QUEUE_REMOVE(&read->queue);
+        tracef("read entries: %s", uv_strerror(rv));
+        rv = RAFT_IOERR;
+        goto err_after_req_alloc;
+    }
+
+    return 0;
+
+err_after_req_alloc:
+    RaftHeapFree(read);
+err:
+    assert(rv != 0);
+    return rv;
+}
+
+int UvReadCacheInit(struct uv *uv)
+{
+    struct uvReadCache *cache = &uv->read_cache;
+    int rv;
+    rv = uv_mutex_init(&cache->mutex);
+    if (rv != 0) {
+        return RAFT_IOERR;
+    }
+    QUEUE_INIT(&cache->chunks);
+    cache->size = 0;
+    cache->max_size = UV__READ_CACHE_SIZE;
+    cache->gen = 0;
+    return 0;
+}
+
+void UvReadCacheClear(struct uv *uv)
+{
+    struct uvReadCache *cache = &uv->read_cache;
+    struct uvReadChunk *chunk;
+    queue *head;
+
+    uv_mutex_lock(&cache->mutex);
+    while (!QUEUE_IS_EMPTY(&cache->chunks)) {
+        head = QUEUE_HEAD(&cache->chunks);
+        chunk = QUEUE_DATA(head, struct uvReadChunk, queue);
+        QUEUE_REMOVE(&chunk->queue);
+        uvReadChunkDestroy(chunk);
+    }
+    cache->size = 0;
+    cache->gen++;
+    uv_mutex_unlock(&cache->mutex);
+}
+
+void UvReadCacheClose(struct uv *uv)
+{
+    UvReadCacheClear(uv);
+    uv_mutex_destroy(&uv->read_cache.mutex);
+}
+
+#undef tracef
@@ -3,6 +3,7 @@
 #include "../include/raft/uv.h"
 #include "assert.h"
 #include "byte.h"
+#include "compress.h"
 #include "configuration.h"
 #include "err.h"
 #include "heap.h"
@@ -26,6 +27,10 @@
  *
  * - Optionally, the RPC message payload is read (for AppendEntries requests).
  *
+ * - Large InstallSnapshot payloads are not read into memory: reading from the
+ *   socket is paused while each fixed-size chunk gets written to a temporary
+ *   file in the thread pool, which is then staged for raft_io->snapshot_put().
+ *
  * - The recv callback passed to raft_io->start() gets fired with the received
  *   message.
  *
@@ -37,6 +42,13 @@
  *
  * - The peer server sends us invalid data. In this case we close the stream
  *   handle and act like above.
+ *
+ * The connections accepted by the hub of a raft_uv_host carry messages for
+ * several groups: each message is passed to the recv callback of the group
+ * whose ID is in the preamble, or dropped if there's no such group.
+ *
+ * Keepalive frames are not passed to anyone: they just tell that the peer is
+ * alive, and how often it writes when idle, see UvKeepaliveStart().
  */
 
 struct uvServer
@@ -49,8 +61,22 @@ struct uvServer
     uint64_t preamble[2];        /* Static buffer with the request preamble */
     uv_buf_t header;             /* Dynamic buffer with the request header */
     uv_buf_t payload;            /* Dynamic buffer with the request payload */
+    bool compressed;             /* Whether the payload is LZ4-compressed */
+    uint32_t group;              /* Group ID of the message being received */
     struct raft_message message; /* The message being received */
     queue queue;                 /* Servers queue */
+    struct
+    {
+        uv_file fd;              /* Temporary file, or -1 if not streaming */
+        size_t offset;           /* Payload bytes written to the file */
+        uv_buf_t chunk;          /* Buffer holding the chunk being read */
+        struct uv_work_s work;   /* Open the file or write a chunk to it */
+        int status;              /* Result of the last work request */
+        char errmsg[RAFT_ERRMSG_BUF_SIZE];
+    } snapshot;                  /* Streamed InstallSnapshot payload */
+    bool closed;                 /* Whether the stream handle was closed */
+    unsigned keepalive;          /* Keepalive interval of the peer, if any */
+    uint64_t last_read;          /* Loop time of the last read */
 };
 
 /* Initialize a new server object for reading requests from an incoming
@@ -79,6 +105,16 @@ static int uvServerInit(struct uvServer *s,
     s->message.type = 0;
     s->payload.base = NULL;
     s->payload.len = 0;
+    s->compressed = false;
+    s->group = 0;
+    s->snapshot.fd = -1;
+    s->snapshot.offset = 0;
+    s->snapshot.chunk.base = NULL;
+    s->snapshot.chunk.len = 0;
+    s->snapshot.work.data = NULL;
+    s->closed = false;
+    s->keepalive = 0;
+    s->last_read = uv_now(uv->loop);
     QUEUE_PUSH(&uv->servers, &s->queue);
     return 0;
 }
@@ -105,6 +141,13 @@ static void uvServerDestroy(struct uvServer *s)
         /* This means we were interrupted while reading the payload. */
         RaftHeapFree(s->payload.base);
     }
+    if (s->snapshot.fd != -1) {
+        /* This means we were interrupted while streaming the payload. */
+        UvOsClose(s->snapshot.fd);
+    }
+    if (s->snapshot.chunk.base != NULL) {
+        RaftHeapFree(s->snapshot.chunk.base);
+    }
     RaftHeapFree(s->address);
     RaftHeapFree(s->stream);
 }
@@ -152,6 +195,26 @@ static void uvServerAllocCb(uv_handle_t *handle,
 
         /* If we get here we should be expecting the payload. */
         assert(s->payload.len > 0);
+
+        /* When streaming, read the next chunk into the chunk buffer. */
+        if (s->snapshot.fd != -1) {
+            size_t n = s->payload.len - s->snapshot.offset;
+            if (n > UV__SNAPSHOT_STREAM_CHUNK) {
+                n = UV__SNAPSHOT_STREAM_CHUNK;
+            }
+            if (s->snapshot.chunk.base == NULL) {
+                s->snapshot.chunk.base = RaftHeapMalloc(n);
+                if (s->snapshot.chunk.base == NULL) {
+                    memset(buf, 0, sizeof *buf);
+                    return;
+                }
+            }
+            s->buf.base = s->snapshot.chunk.base;
+            s->buf.len = n;
+            s->snapshot.chunk.len = n;
+            goto out;
+        }
+
         s->payload.base = RaftHeapMalloc(s->payload.len);
         if (s->payload.base == NULL) {
             /* Setting all buffer fields to 0 will make read_cb fail with
@@ -173,6 +236,12 @@ static void uvServerStreamCloseCb(uv_handle_t *handle)
 {
     struct uvServer *s = handle->data;
     struct uv *uv = s->uv;
+    /* If a streaming work request is in flight, its after work callback will
+     * release the server. */
+    if (s->snapshot.work.data != NULL) {
+        s->closed = true;
+        return;
+    }
     uvServerDestroy(s);
     RaftHeapFree(s);
     uvMaybeFireCloseCb(uv);
@@ -186,10 +255,47 @@ static void uvServerAbort(struct uvServer *s)
     uv_close((struct uv_handle_s *)s->stream, uvServerStreamCloseCb);
 }
 
+/* Let the groups served by this connection know that the peer can't reach us
+ * through it anymore. A quiescent follower relies on this to resume its
+ * election timer when the leader goes away. */
+static void uvServerNotifyUnreachable(struct uvServer *s)
+{
+    struct uv *uv = s->uv;
+    if (uv->closing) {
+        return;
+    }
+    if (uv->hub != NULL) {
+        UvHostUnreachable(uv->hub, s->id);
+    } else if (uv->unreachable_cb != NULL) {
+        uv->unreachable_cb(uv->io, s->id);
+    }
+}
+
+/* Release a message that no group of the host is going to receive. */
+static void uvServerDiscardMessage(struct uvServer *s)
+{
+    Tracef(s->uv->tracer, "drop message for unknown group %u", s->group);
+    switch (s->message.type) {
+        case RAFT_APPEND_ENTRIES:
+            RaftHeapFree(s->message.append_entries.entries);
+            break;
+        case RAFT_INSTALL_SNAPSHOT:
+            configurationClose(&s->message.install_snapshot.conf);
+            break;
+        default:
+            break;
+    }
+    RaftHeapFree(s->payload.base);
+}
+
 /* Invoke the receive callback. */
 static void uvFireRecvCb(struct uvServer *s)
 {
-    s->uv->recv_cb(s->uv->io, &s->message);
+    if (s->uv->hub == NULL) {
+        s->uv->recv_cb(s->uv->io, &s->message);
+    } else if (!UvHostRecv(s->uv->hub, s->group, &s->message)) {
+        uvServerDiscardMessage(s);
+    }
 
     /* Reset our state as we'll start reading a new message. We don't need to
      * release the payload buffer, since ownership was transferred to the
@@ -201,6 +307,180 @@ static void uvFireRecvCb(struct uvServer *s)
     s->header.len = 0;
     s->payload.base = NULL;
     s->payload.len = 0;
+    s->compressed = false;
+}
+
+/* Whether the preamble just read is the one of a keepalive frame. */
+static bool uvServerIsKeepalive(const struct uvServer *s)
+{
+    return (uint8_t)byteFlip64(s->preamble[0]) == UV__KEEPALIVE;
+}
+
+/* Record the keepalive interval of the peer and get ready to read the next
+ * message. */
+static int uvServerRecvKeepalive(struct uvServer *s)
+{
+    unsigned interval;
+    int rv;
+
+    rv = uvDecodeKeepalive(&s->header, &interval);
+    if (rv != 0) {
+        Tracef(s->uv->tracer, "decode keepalive: %s", errCodeToString(rv));
+        return rv;
+    }
+    if (s->keepalive != interval) {
+        Tracef(s->uv->tracer, "server %llu sends keepalives every %u ms",
+               s->id, interval);
+        s->keepalive = interval;
+    }
+
+    memset(s->preamble, 0, sizeof s->preamble);
+    RaftHeapFree(s->header.base);
+    s->header.base = NULL;
+    s->header.len = 0;
+
+    UvKeepaliveStart(s->uv);
+
+    return 0;
+}
+
+static void uvServerReadCb(uv_stream_t *stream,
+                           ssize_t nread,
+                           const uv_buf_t *buf);
+
+/* Callback invoked afer a streaming work request has completed. Resume reading
+ * from the socket, or finish receiving the message if the whole payload has
+ * been written. */
+static void uvServerSnapshotAfterWorkCb(uv_work_t *work, int status)
+{
+    struct uvServer *s = work->data;
+    struct uv *uv = s->uv;
+    int rv;
+
+    assert(status == 0);
+    work->data = NULL;
+
+    if (s->closed) {
+        uvServerDestroy(s);
+        RaftHeapFree(s);
+        uvMaybeFireCloseCb(uv);
+        return;
+    }
+    if (uv_is_closing((struct uv_handle_s *)s->stream)) {
+        return;
+    }
+
+    if (s->snapshot.status != 0) {
+        Tracef(uv->tracer, "stream snapshot: %s", s->snapshot.errmsg);
+        goto abort;
+    }
+
+    if (s->snapshot.offset == s->payload.len) {
+        RaftHeapFree(s->snapshot.chunk.base);
+        s->snapshot.chunk.base = NULL;
+        s->snapshot.chunk.len = 0;
+        s->message.install_snapshot.data.base = NULL;
+        s->message.install_snapshot.data.len = s->payload.len;
+        UvSnapshotStage(uv, s->snapshot.fd, &s->message.install_snapshot);
+        s->snapshot.fd = -1;
+        s->snapshot.offset = 0;
+        uvFireRecvCb(s);
+    }
+
+    /* The peer couldn't get through while reading was paused. */
+    s->last_read = uv_now(uv->loop);
+    rv = uv_read_start(s->stream, uvServerAllocCb, uvServerReadCb);
+    if (rv != 0) {
+        Tracef(uv->tracer, "start reading: %s", uv_strerror(rv));
+        goto abort;
+    }
+
+    return;
+
+abort:
+    uvServerAbort(s);
+}
+
+static void uvServerSnapshotOpenWorkCb(uv_work_t *work)
+{
+    struct uvServer *s = work->data;
+    s->snapshot.status = UvFsAllocateTempFile(
+        s->uv->dir, s->payload.len, &s->snapshot.fd, s->snapshot.errmsg);
+    if (s->snapshot.status != 0) {
+        s->snapshot.fd = -1;
+    }
+}
+
+static void uvServerSnapshotWriteWorkCb(uv_work_t *work)
+{
+    struct uvServer *s = work->data;
+    size_t n = s->snapshot.chunk.len;
+    int rv;
+
+    rv = UvOsWrite(s->snapshot.fd, &s->snapshot.chunk, 1,
+                   (int64_t)s->snapshot.offset);
+    if (rv != (int)n) {
+        if (rv < 0) {
+            UvOsErrMsg(s->snapshot.errmsg, "write", rv);
+        } else {
+            ErrMsgPrintf(s->snapshot.errmsg,
+                         "short write: only %d bytes written", rv);
+        }
+        s->snapshot.status = RAFT_IOERR;
+        return;
+    }
+    s->snapshot.offset += n;
+    s->snapshot.status = 0;
+}
+
+/* Stop reading from the socket and run the given streaming work function in
+ * the thread pool. */
+static int uvServerSnapshotQueueWork(struct uvServer *s, uv_work_cb work_cb)
+{
+    int rv;
+    rv = uv_read_stop(s->stream);
+    assert(rv == 0);
+    s->snapshot.work.data = s;
+    rv = uv_queue_work(s->uv->loop, &s->snapshot.work, work_cb,
+                       uvServerSnapshotAfterWorkCb);
+    if (rv != 0) {
+        Tracef(s->uv->tracer, "stream snapshot: %s", uv_strerror(rv));
+        s->snapshot.work.data = NULL;
+        return RAFT_IOERR;
+    }
+    return 0;
+}
+
+/* Replace the LZ4-compressed entries payload that was just read with its
+ * decompressed content. */
+static int uvServerDecompressEntries(struct uvServer *s)
+{
+    struct raft_append_entries *args = &s->message.append_entries;
+    struct raft_buffer compressed;
+    struct raft_buffer payload;
+    char errmsg[RAFT_ERRMSG_BUF_SIZE];
+    size_t len = 0;
+    unsigned i;
+    int rv;
+
+    for (i = 0; i < args->n_entries; i++) {
+        len += args->entries[i].buf.len;
+    }
+
+    compressed.base = s->payload.base;
+    compressed.len = s->payload.len;
+    rv = DecompressExact(compressed, len, &payload, errmsg);
+    if (rv != 0) {
+        Tracef(s->uv->tracer, "decompress entries: %s", errmsg);
+        return rv;
+    }
+
+    RaftHeapFree(s->payload.base);
+    s->payload.base = payload.base;
+    s->payload.len = payload.len;
+    s->compressed = false;
+
+    return 0;
 }
 
 /* Callback invoked when data has been read from the socket. */
@@ -220,6 +500,8 @@ static void uvServerReadCb(uv_stream_t *stream,
     if (nread > 0) {
         size_t n = (size_t)nread;
 
+        s->last_read = uv_now(s->uv->loop);
+
         /* We shouldn't have read more data than the pending amount. */
         assert(n <= s->buf.len);
 
@@ -245,6 +527,11 @@ static void uvServerReadCb(uv_stream_t *stream,
                 Tracef(s->uv->tracer, "message has zero length");
                 goto abort;
             }
+        } else if (s->payload.len == 0 && uvServerIsKeepalive(s)) {
+            rv = uvServerRecvKeepalive(s);
+            if (rv != 0) {
+                goto abort;
+            }
         } else if (s->payload.len == 0) {
             /* If the payload buffer is not set, it means we just completed
              * reading the message header. */
@@ -263,10 +550,11 @@ static void uvServerReadCb(uv_stream_t *stream,
              *
              * Once this change has been active for sufficiently long time, we
              * can start using the second byte of the preamble if needed. */
-            type = (uint8_t)preamble0;            /* Byte 0 */
-            version = (uint8_t)(preamble0 >> 16); /* Byte 2 */
+            type = (uint8_t)preamble0;              /* Byte 0 */
+            version = (uint8_t)(preamble0 >> 16);   /* Byte 2 */
+            s->group = (uint32_t)(preamble0 >> 32); /* Bytes 4-7 */
             rv = uvDecodeMessage(type, version, &s->header, &s->message,
-                                 &s->payload.len);
+                                 &s->payload.len, &s->compressed);
             if (rv != 0) {
                 Tracef(s->uv->tracer, "decode message: %s",
                        errCodeToString(rv));
@@ -279,6 +567,20 @@ static void uvServerReadCb(uv_stream_t *stream,
             /* If the message has no payload, we're done. */
             if (s->payload.len == 0) {
                 uvFireRecvCb(s);
+            } else if (s->message.type == RAFT_INSTALL_SNAPSHOT &&
+                       s->uv->snapshot_stream_threshold > 0 &&
+                       s->payload.len >= s->uv->snapshot_stream_threshold) {
+                /* Create the temporary file before reading the payload. */
+                rv = uvServerSnapshotQueueWork(s, uvServerSnapshotOpenWorkCb);
+                if (rv != 0) {
+                    goto abort;
+                }
+            }
+        } else if (s->snapshot.fd != -1) {
+            /* We've just read a chunk of a streamed payload. */
+            rv = uvServerSnapshotQueueWork(s, uvServerSnapshotWriteWorkCb);
+            if (rv != 0) {
+                goto abort;
             }
         } else {
             /* If we get here it means that we've just completed reading the
@@ -289,6 +591,12 @@ static void uvServerReadCb(uv_stream_t *stream,
 
             switch (s->message.type) {
                 case RAFT_APPEND_ENTRIES:
+                    if (s->compressed) {
+                        rv = uvServerDecompressEntries(s);
+                        if (rv != 0) {
+                            goto abort;
+                        }
+                    }
                     payload.base = s->payload.base;
                     payload.len = s->payload.len;
                     uvDecodeEntriesBatch(payload.base, 0,
@@ -328,6 +636,7 @@ static void uvServerReadCb(uv_stream_t *stream,
     }
 
 abort:
+    uvServerNotifyUnreachable(s);
     uvServerAbort(s);
 }
 
@@ -405,6 +714,31 @@ int UvRecvStart(struct uv *uv)
     return 0;
 }
 
+void UvRecvKeepalive(struct uv *uv)
+{
+    uint64_t now = uv_now(uv->loop);
+    queue *head = QUEUE_NEXT(&uv->servers);
+
+    while (head != &uv->servers) {
+        struct uvServer *s = QUEUE_DATA(head, struct uvServer, queue);
+        head = QUEUE_NEXT(head);
+
+        /* Reading is paused while a streamed payload is written to disk. */
+        if (s->keepalive == 0 || s->snapshot.work.data != NULL) {
+            continue;
+        }
+        if (now - s->last_read <
+            (uint64_t)UV__KEEPALIVE_MISSES * s->keepalive) {
+            continue;
+        }
+
+        tracef("no data from server %llu for %llu ms -> disconnect", s->id,
+               (unsigned long long)(now - s->last_read));
+        uvServerNotifyUnreachable(s);
+        uvServerAbort(s);
+    }
+}
+
 void UvRecvClose(struct uv *uv)
 {
     while (!QUEUE_IS_EMPTY(&uv->servers)) {
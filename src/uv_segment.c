@@ -149,6 +149,8 @@ int uvSegmentKeepTrailing(struct uv *uv,
                             segment->filename);
                 return rv;
             }
+            uvSegmentIndexRemove(uv, segment->first_index,
+                                 segment->end_index);
         } else {
             break;
         }
@@ -161,17 +163,18 @@ int uvSegmentKeepTrailing(struct uv *uv,
 static int uvReadSegmentFile(struct uv *uv,
                              const char *filename,
                              struct raft_buffer *buf,
-                             uint64_t *format)
+                             uint64_t *format,
+                             char *errmsg)
 {
-    char errmsg[RAFT_ERRMSG_BUF_SIZE];
+    char cause[RAFT_ERRMSG_BUF_SIZE];
     int rv;
-    rv = UvFsReadFile(uv->dir, filename, buf, errmsg);
+    rv = UvFsReadFile(uv->dir, filename, buf, cause);
     if (rv != 0) {
-        ErrMsgTransfer(errmsg, uv->io->errmsg, "read file");
+        ErrMsgTransfer(cause, errmsg, "read file");
         return RAFT_IOERR;
     }
     if (buf->len < 8) {
-        ErrMsgPrintf(uv->io->errmsg, "file has only %zu bytes", buf->len);
+        ErrMsgPrintf(errmsg, "file has only %zu bytes", buf->len);
         RaftHeapFree(buf->base);
         return RAFT_IOERR;
     }
@@ -203,13 +206,15 @@ static int uvConsumeContent(const struct raft_buffer *content,
 
 /* Load a single batch of entries from a segment.
  *
- * Set @last to #true if the loaded batch is the last one. */
-static int uvLoadEntriesBatch(struct uv *uv,
-                              const struct raft_buffer *content,
+ * Set @last to #true if the loaded batch is the last one. If @stats is not
+ * NULL, the time spent checksumming and decoding is added to it. */
+static int uvLoadEntriesBatch(const struct raft_buffer *content,
                               struct raft_entry **entries,
                               unsigned *n_entries,
                               size_t *offset, /* Offset of last batch */
-                              bool *last)
+                              bool *last,
+                              struct raft_uv_load_stats *stats,
+                              char *errmsg)
 {
     void *checksums;           /* CRC32 checksums */
     void *batch;               /* Entries batch */
@@ -220,8 +225,9 @@ static int uvLoadEntriesBatch(struct uv *uv,
     struct raft_buffer data;   /* Batch data */
     uint32_t crc1;             /* Target checksum */
     uint32_t crc2;             /* Actual checksum */
-    char errmsg[RAFT_ERRMSG_BUF_SIZE];
+    char cause[RAFT_ERRMSG_BUF_SIZE];
     size_t start;
+    uint64_t t;
     int rv;
 
     /* Save the current offset, to provide more information when logging. */
@@ -229,23 +235,23 @@ static int uvLoadEntriesBatch(struct uv *uv,
 
     /* Read the checksums. */
     rv = uvConsumeContent(content, offset, sizeof(uint32_t) * 2, &checksums,
-                          errmsg);
+                          cause);
     if (rv != 0) {
-        ErrMsgTransfer(errmsg, uv->io->errmsg, "read preamble");
+        ErrMsgTransfer(cause, errmsg, "read preamble");
         return RAFT_IOERR;
     }
 
     /* Read the first 8 bytes of the batch, which contains the number of entries
      * in the batch. */
-    rv = uvConsumeContent(content, offset, sizeof(uint64_t), &batch, errmsg);
+    rv = uvConsumeContent(content, offset, sizeof(uint64_t), &batch, cause);
     if (rv != 0) {
-        ErrMsgTransfer(errmsg, uv->io->errmsg, "read preamble");
+        ErrMsgTransfer(cause, errmsg, "read preamble");
         return RAFT_IOERR;
     }
 
     n = (size_t)byteFlip64(*(uint64_t *)batch);
     if (n == 0) {
-        ErrMsgPrintf(uv->io->errmsg, "entries count in preamble is zero");
+        ErrMsgPrintf(errmsg, "entries count in preamble is zero");
         rv = RAFT_CORRUPT;
         goto err;
     }
@@ -257,7 +263,7 @@ static int uvLoadEntriesBatch(struct uv *uv,
     max_n = UV__MAX_SEGMENT_SIZE / (sizeof(uint64_t) * 4);
 
     if (n > max_n) {
-        ErrMsgPrintf(uv->io->errmsg,
+        ErrMsgPrintf(errmsg,
                      "entries count %lu in preamble is too high", n);
         rv = RAFT_CORRUPT;
         goto err;
@@ -270,24 +276,28 @@ static int uvLoadEntriesBatch(struct uv *uv,
 
     rv = uvConsumeContent(content, offset,
                           uvSizeofBatchHeader(n) - sizeof(uint64_t), NULL,
-                          errmsg);
+                          cause);
     if (rv != 0) {
-        ErrMsgTransfer(errmsg, uv->io->errmsg, "read header");
+        ErrMsgTransfer(cause, errmsg, "read header");
         rv = RAFT_IOERR;
         goto err;
     }
 
     /* Check batch header integrity. */
+    t = uv_hrtime();
     crc1 = byteFlip32(((uint32_t *)checksums)[0]);
     crc2 = byteCrc32(header.base, header.len, 0);
+    UvLoadStatsAdd(stats, segment_crc, t);
     if (crc1 != crc2) {
-        ErrMsgPrintf(uv->io->errmsg, "header checksum mismatch");
+        ErrMsgPrintf(errmsg, "header checksum mismatch");
         rv = RAFT_CORRUPT;
         goto err;
     }
 
     /* Decode the batch header, allocating the entries array. */
+    t = uv_hrtime();
     rv = uvDecodeBatchHeader(header.base, entries, n_entries);
+    UvLoadStatsAdd(stats, segment_decode, t);
     if (rv != 0) {
         goto err;
     }
@@ -300,24 +310,28 @@ static int uvLoadEntriesBatch(struct uv *uv,
     data.base = (uint8_t *)content->base + *offset;
 
     /* Consume the batch data */
-    rv = uvConsumeContent(content, offset, data.len, NULL, errmsg);
+    rv = uvConsumeContent(content, offset, data.len, NULL, cause);
     if (rv != 0) {
-        ErrMsgTransfer(errmsg, uv->io->errmsg, "read data");
+        ErrMsgTransfer(cause, errmsg, "read data");
         rv = RAFT_IOERR;
         goto err_after_header_decode;
     }
 
     /* Check batch data integrity. */
+    t = uv_hrtime();
     crc1 = byteFlip32(((uint32_t *)checksums)[1]);
     crc2 = byteCrc32(data.base, data.len, 0);
+    UvLoadStatsAdd(stats, segment_crc, t);
     if (crc1 != crc2) {
-        ErrMsgPrintf(uv->io->errmsg, "data checksum mismatch");
+        ErrMsgPrintf(errmsg, "data checksum mismatch");
         rv = RAFT_CORRUPT;
         goto err_after_header_decode;
     }
 
+    t = uv_hrtime();
     uvDecodeEntriesBatch(content->base, *offset - data.len, *entries,
                          *n_entries);
+    UvLoadStatsAdd(stats, segment_decode, t);
 
     *last = *offset == content->len;
 
@@ -358,10 +372,463 @@ static int extendEntries(const struct raft_entry *entries1,
     return 0;
 }
 
-int uvSegmentLoadClosed(struct uv *uv,
-                        struct uvSegmentInfo *info,
-                        struct raft_entry *entries[],
-                        size_t *n)
+/* Format version of segment index files. */
+#define UV__INDEX_FORMAT 1
+
+/* Position of a single batch within a closed segment. */
+struct uvSegmentIndexRecord
+{
+    uint64_t offset;        /* Offset of the batch preamble */
+    raft_index first_index; /* Index of the first entry in the batch */
+    raft_term term;         /* Term of the first entry in the batch */
+    uint32_t crc;           /* Checksum of the batch header */
+};
+
+/* Size of the encoded index header (format, segment size, number of records),
+ * of each encoded record and of the trailing checksum. */
+#define UV__INDEX_HEADER_SIZE (sizeof(uint64_t) * 3)
+#define UV__INDEX_RECORD_SIZE (sizeof(uint64_t) * 4)
+#define UV__INDEX_CRC_SIZE sizeof(uint64_t)
+
+/* Scan the headers of all batches in a closed segment, without reading or
+ * checksumming their data. The @end offset is the one right after the batch
+ * containing @end_index, which is the size of the file unless it has extra
+ * data past that batch. */
+static int uvSegmentIndexScan(struct uv *uv,
+                              const char *filename,
+                              raft_index first_index,
+                              raft_index end_index,
+                              struct uvSegmentIndexRecord **records,
+                              size_t *n_records,
+                              size_t *size,
+                              size_t *end,
+                              char *errmsg)
+{
+    struct uvSegmentIndexRecord record;
+    struct raft_buffer buf;
+    uint8_t preamble[sizeof(uint32_t) * 2 + sizeof(uint64_t)];
+    const uint8_t *cursor;
+    off_t file_size;
+    raft_index index;
+    uint64_t n;
+    uint64_t max_n;
+    size_t data_len;
+    size_t offset;
+    uv_file fd;
+    uint64_t i;
+    int rv;
+
+    *records = NULL;
+    *n_records = 0;
+
+    rv = UvFsFileSize(uv->dir, filename, &file_size, errmsg);
+    if (rv != 0) {
+        return rv;
+    }
+    *size = (size_t)file_size;
+    rv = UvFsOpenFileForReading(uv->dir, filename, &fd, errmsg);
+    if (rv != 0) {
+        return rv;
+    }
+
+    max_n = UV__MAX_SEGMENT_SIZE / (sizeof(uint64_t) * 4);
+    index = first_index;
+    offset = sizeof(uint64_t); /* Format version */
+    while (index <= end_index) {
+        buf.base = preamble;
+        buf.len = sizeof preamble;
+        rv = UvFsReadAt(fd, &buf, offset, errmsg);
+        if (rv != 0) {
+            goto err;
+        }
+        cursor = preamble;
+        record.offset = offset;
+        record.first_index = index;
+        record.crc = byteGet32(&cursor);
+        byteGet32(&cursor); /* Data checksum */
+        n = byteGet64(&cursor);
+        if (n == 0 || n > max_n) {
+            ErrMsgPrintf(errmsg, "bad entries count %ju at byte %zu",
+                         (uintmax_t)n, offset);
+            rv = RAFT_CORRUPT;
+            goto err;
+        }
+
+        /* Read the entry headers, to get the term of the first entry and the
+         * size of the batch data. */
+        buf.len = uvSizeofBatchHeader((size_t)n) - sizeof(uint64_t);
+        buf.base = RaftHeapMalloc(buf.len);
+        if (buf.base == NULL) {
+            rv = RAFT_NOMEM;
+            goto err;
+        }
+        rv = UvFsReadAt(fd, &buf, offset + sizeof preamble, errmsg);
+        if (rv != 0) {
+            RaftHeapFree(buf.base);
+            goto err;
+        }
+        cursor = buf.base;
+        record.term = byteGet64(&cursor);
+        data_len = 0;
+        for (i = 0; i < n; i++) {
+            cursor = (const uint8_t *)buf.base + i * 16 + 12;
+            data_len += byteGet32(&cursor);
+        }
+        RaftHeapFree(buf.base);
+
+        ARRAY__APPEND(struct uvSegmentIndexRecord, record, records, n_records,
+                      rv);
+        if (rv != 0) {
+            rv = RAFT_NOMEM;
+            goto err;
+        }
+
+        index += n;
+        offset += sizeof preamble + buf.len + data_len;
+    }
+
+    if (index != end_index + 1) {
+        ErrMsgPrintf(errmsg, "found %llu entries (expected %llu)",
+                     index - first_index, end_index - first_index + 1);
+        rv = RAFT_CORRUPT;
+        goto err;
+    }
+
+    *end = offset;
+
+    UvOsClose(fd);
+    return 0;
+
+err:
+    UvOsClose(fd);
+    raft_free(*records);
+    *records = NULL;
+    *n_records = 0;
+    assert(rv != 0);
+    return rv;
+}
+
+int uvSegmentIndexWrite(struct uv *uv,
+                        raft_index first_index,
+                        raft_index end_index,
+                        char *errmsg)
+{
+    char filename[UV__FILENAME_LEN];
+    char index_filename[UV__FILENAME_LEN];
+    struct uvSegmentIndexRecord *records;
+    struct raft_buffer buf;
+    size_t n_records;
+    size_t size;
+    size_t end;
+    uint8_t *cursor;
+    size_t i;
+    int rv;
+
+    sprintf(filename, UV__CLOSED_TEMPLATE, first_index, end_index);
+    sprintf(index_filename, UV__CLOSED_INDEX_TEMPLATE, first_index,
+            end_index);
+
+    rv = uvSegmentIndexScan(uv, filename, first_index, end_index, &records,
+                            &n_records, &size, &end, errmsg);
+    if (rv != 0) {
+        return rv;
+    }
+
+    buf.len = UV__INDEX_HEADER_SIZE + n_records * UV__INDEX_RECORD_SIZE +
+              UV__INDEX_CRC_SIZE;
+    buf.base = RaftHeapMalloc(buf.len);
+    if (buf.base == NULL) {
+        rv = RAFT_NOMEM;
+        goto out;
+    }
+    cursor = buf.base;
+    bytePut64(&cursor, UV__INDEX_FORMAT);
+    bytePut64(&cursor, size);
+    bytePut64(&cursor, n_records);
+    for (i = 0; i < n_records; i++) {
+        bytePut64(&cursor, records[i].offset);
+        bytePut64(&cursor, records[i].first_index);
+        bytePut64(&cursor, records[i].term);
+        bytePut64(&cursor, records[i].crc);
+    }
+    bytePut64(&cursor, byteCrc32(buf.base, buf.len - UV__INDEX_CRC_SIZE, 0));
+
+    /* Drop any stale index left around by a segment with the same name. */
+    uvSegmentIndexRemove(uv, first_index, end_index);
+    rv = UvFsMakeFile(uv->dir, index_filename, &buf, 1, errmsg);
+    if (rv != 0) {
+        rv = RAFT_IOERR;
+    }
+
+    RaftHeapFree(buf.base);
+out:
+    raft_free(records);
+    return rv;
+}
+
+void uvSegmentIndexRemove(struct uv *uv,
+                          raft_index first_index,
+                          raft_index end_index)
+{
+    char filename[UV__FILENAME_LEN];
+    char errmsg[RAFT_ERRMSG_BUF_SIZE];
+    sprintf(filename, UV__CLOSED_INDEX_TEMPLATE, first_index, end_index);
+    UvFsRemoveFile(uv->dir, filename, errmsg); /* Ignore errors */
+}
+
+/* Use the index file of the given closed segment to find the batch containing
+ * the entry with the given index. Return its offset and the index of its first
+ * entry, along with the expected checksum of its header. */
+static int uvSegmentIndexLookup(struct uv *uv,
+                                struct uvSegmentInfo *info,
+                                raft_index index,
+                                size_t *offset,
+                                raft_index *first_index,
+                                uint32_t *crc,
+                                char *errmsg)
+{
+    char filename[UV__FILENAME_LEN];
+    struct raft_buffer buf;
+    const uint8_t *cursor;
+    uint64_t format;
+    uint64_t size;
+    uint64_t n;
+    uint64_t i;
+    off_t segment_size;
+    int rv;
+
+    sprintf(filename, UV__CLOSED_INDEX_TEMPLATE, info->first_index,
+            info->end_index);
+    rv = UvFsReadFile(uv->dir, filename, &buf, errmsg);
+    if (rv != 0) {
+        return rv;
+    }
+
+    rv = RAFT_CORRUPT;
+    if (buf.len < UV__INDEX_HEADER_SIZE + UV__INDEX_CRC_SIZE) {
+        ErrMsgPrintf(errmsg, "index has only %zu bytes", buf.len);
+        goto out;
+    }
+    cursor = (const uint8_t *)buf.base + buf.len - UV__INDEX_CRC_SIZE;
+    if (byteGet64(&cursor) !=
+        byteCrc32(buf.base, buf.len - UV__INDEX_CRC_SIZE, 0)) {
+        ErrMsgPrintf(errmsg, "index checksum mismatch");
+        goto out;
+    }
+    cursor = buf.base;
+    format = byteGet64(&cursor);
+    size = byteGet64(&cursor);
+    n = byteGet64(&cursor);
+    if (format != UV__INDEX_FORMAT) {
+        ErrMsgPrintf(errmsg, "unexpected index format version %ju",
+                     (uintmax_t)format);
+        goto out;
+    }
+    if (n == 0 || buf.len != UV__INDEX_HEADER_SIZE +
+                                 n * UV__INDEX_RECORD_SIZE +
+                                 UV__INDEX_CRC_SIZE) {
+        ErrMsgPrintf(errmsg, "index has %ju records", (uintmax_t)n);
+        goto out;
+    }
+
+    /* The index is only valid for the exact segment it was built from. */
+    rv = UvFsFileSize(uv->dir, info->filename, &segment_size, errmsg);
+    if (rv != 0) {
+        goto out;
+    }
+    rv = RAFT_CORRUPT;
+    if ((uint64_t)segment_size != size) {
+        ErrMsgPrintf(errmsg, "index is stale");
+        goto out;
+    }
+
+    /* Pick the last batch starting at or before the given index. */
+    *offset = 0;
+    for (i = 0; i < n; i++) {
+        uint64_t record_offset;
+        raft_index record_index;
+        uint32_t record_crc;
+        record_offset = byteGet64(&cursor);
+        record_index = byteGet64(&cursor);
+        byteGet64(&cursor); /* Term */
+        record_crc = (uint32_t)byteGet64(&cursor);
+        if (record_offset >= size || record_index < info->first_index ||
+            record_index > info->end_index) {
+            ErrMsgPrintf(errmsg, "bad index record %ju", (uintmax_t)i);
+            goto out;
+        }
+        if (record_index > index) {
+            break;
+        }
+        *offset = (size_t)record_offset;
+        *first_index = record_index;
+        *crc = record_crc;
+    }
+    if (*offset == 0) {
+        ErrMsgPrintf(errmsg, "no batch found for index %llu", index);
+        goto out;
+    }
+
+    rv = 0;
+
+out:
+    RaftHeapFree(buf.base);
+    return rv;
+}
+
+/* Read the format version of a segment file and all its content starting from
+ * the given offset. */
+static int uvReadSegmentFileFrom(struct uv *uv,
+                                 const char *filename,
+                                 size_t offset,
+                                 struct raft_buffer *buf,
+                                 uint64_t *format,
+                                 char *errmsg)
+{
+    uint8_t preamble[sizeof *format];
+    struct raft_buffer tmp;
+    const uint8_t *cursor;
+    off_t size;
+    uv_file fd;
+    int rv;
+
+    rv = UvFsFileSize(uv->dir, filename, &size, errmsg);
+    if (rv != 0) {
+        return rv;
+    }
+    if ((size_t)size <= offset) {
+        ErrMsgPrintf(errmsg, "file has only %jd bytes", (intmax_t)size);
+        return RAFT_IOERR;
+    }
+    rv = UvFsOpenFileForReading(uv->dir, filename, &fd, errmsg);
+    if (rv != 0) {
+        return rv;
+    }
+
+    tmp.base = preamble;
+    tmp.len = sizeof preamble;
+    rv = UvFsReadAt(fd, &tmp, 0, errmsg);
+    if (rv != 0) {
+        goto err;
+    }
+    cursor = preamble;
+    *format = byteGet64(&cursor);
+
+    buf->len = (size_t)size - offset;
+    buf->base = RaftHeapMalloc(buf->len);
+    if (buf->base == NULL) {
+        ErrMsgOom(errmsg);
+        rv = RAFT_NOMEM;
+        goto err;
+    }
+    rv = UvFsReadAt(fd, buf, offset, errmsg);
+    if (rv != 0) {
+        RaftHeapFree(buf->base);
+        goto err;
+    }
+
+    UvOsClose(fd);
+    return 0;
+
+err:
+    UvOsClose(fd);
+    return rv;
+}
+
+/* Load the entries of a closed segment starting from the batch containing the
+ * entry with index @from, using the segment's index file to seek straight to
+ * that batch. Entries in earlier batches are neither read nor checksummed. */
+static int uvSegmentLoadClosedFrom(struct uv *uv,
+                                   struct uvSegmentInfo *info,
+                                   raft_index from,
+                                   struct raft_entry *entries[],
+                                   size_t *n,
+                                   struct raft_uv_load_stats *stats,
+                                   char *errmsg)
+{
+    struct raft_entry *tmp_entries; /* Entries in current batch */
+    struct raft_buffer buf;         /* Segment file content */
+    raft_index first_index;         /* Index of the first loaded entry */
+    uint64_t format;                /* Format version */
+    uint32_t crc;                   /* Expected header checksum */
+    size_t offset;                  /* Content read cursor */
+    unsigned tmp_n;                 /* Number of entries in current batch */
+    bool last;                      /* Whether the last batch was reached */
+    uint64_t t;
+    int rv;
+
+    t = uv_hrtime();
+    rv = uvSegmentIndexLookup(uv, info, from, &offset, &first_index, &crc,
+                              errmsg);
+    if (rv != 0) {
+        return rv;
+    }
+    rv = uvReadSegmentFileFrom(uv, info->filename, offset, &buf, &format,
+                               errmsg);
+    UvLoadStatsAdd(stats, segment_read, t);
+    if (rv != 0) {
+        return rv;
+    }
+    if (format != UV__DISK_FORMAT ||
+        buf.len < sizeof(uint32_t) || byteFlip32(*(uint32_t *)buf.base) != crc) {
+        ErrMsgPrintf(errmsg, "index does not match segment content");
+        rv = RAFT_CORRUPT;
+        goto err;
+    }
+
+    *entries = NULL;
+    *n = 0;
+
+    last = false;
+    offset = 0;
+    while (!last) {
+        rv = uvLoadEntriesBatch(&buf, &tmp_entries, &tmp_n, &offset, &last,
+                                stats, errmsg);
+        if (rv != 0) {
+            goto err_after_extend_entries;
+        }
+        rv = extendEntries(tmp_entries, tmp_n, entries, n);
+        if (rv != 0) {
+            raft_free(tmp_entries);
+            goto err_after_extend_entries;
+        }
+        raft_free(tmp_entries);
+    }
+
+    if (*n != info->end_index - first_index + 1) {
+        ErrMsgPrintf(errmsg, "found %zu entries (expected %llu)", *n,
+                     info->end_index - first_index + 1);
+        rv = RAFT_CORRUPT;
+        goto err_after_extend_entries;
+    }
+
+    return 0;
+
+err_after_extend_entries:
+    if (*entries != NULL) {
+        RaftHeapFree(*entries);
+        *entries = NULL;
+    }
+err:
+    RaftHeapFree(buf.base);
+    assert(rv != 0);
+    return rv;
+}
+
+/* Load all entries contained in a closed segment, filling @errmsg in case of
+ * errors. This does not touch any shared state of @uv and can be called
+ * concurrently from multiple threads.
+ *
+ * If @from is greater than the first index of the segment, entries before it
+ * may be skipped, see uvSegmentLoadClosedFrom(). If @stats is not NULL, the
+ * time spent is added to it. */
+static int uvSegmentLoadClosedInternal(struct uv *uv,
+                                       struct uvSegmentInfo *info,
+                                       raft_index from,
+                                       struct raft_entry *entries[],
+                                       size_t *n,
+                                       struct raft_uv_load_stats *stats,
+                                       char *errmsg)
 {
     bool empty;                     /* Whether the file is empty */
     uint64_t format;                /* Format version */
@@ -372,31 +839,45 @@ int uvSegmentLoadClosed(struct uv *uv,
     unsigned tmp_n;                 /* Number of entries in current batch */
     unsigned expected_n; /* Number of entries that we expect to find */
     int i;
-    char errmsg[RAFT_ERRMSG_BUF_SIZE];
+    char cause[RAFT_ERRMSG_BUF_SIZE];
+    uint64_t t;
     int rv;
 
     expected_n = (unsigned)(info->end_index - info->first_index + 1);
 
+    /* Try to skip the batches we don't need. If that fails for any reason,
+     * e.g. missing or stale index, load the segment in full. */
+    if (from > info->first_index) {
+        rv = uvSegmentLoadClosedFrom(uv, info, from, entries, n, stats,
+                                     cause);
+        if (rv == 0) {
+            return 0;
+        }
+        tracef("load %s from index %llu: %s", info->filename, from, cause);
+    }
+
     /* If the segment is completely empty, just bail out. */
-    rv = UvFsFileIsEmpty(uv->dir, info->filename, &empty, errmsg);
+    t = uv_hrtime();
+    rv = UvFsFileIsEmpty(uv->dir, info->filename, &empty, cause);
     if (rv != 0) {
-        tracef("stat %s: %s", info->filename, errmsg);
+        tracef("stat %s: %s", info->filename, cause);
         rv = RAFT_IOERR;
         goto err;
     }
     if (empty) {
-        ErrMsgPrintf(uv->io->errmsg, "file is empty");
+        ErrMsgPrintf(errmsg, "file is empty");
         rv = RAFT_CORRUPT;
         goto err;
     }
 
     /* Open the segment file. */
-    rv = uvReadSegmentFile(uv, info->filename, &buf, &format);
+    rv = uvReadSegmentFile(uv, info->filename, &buf, &format, errmsg);
+    UvLoadStatsAdd(stats, segment_read, t);
     if (rv != 0) {
         goto err;
     }
     if (format != UV__DISK_FORMAT) {
-        ErrMsgPrintf(uv->io->errmsg, "unexpected format version %ju", format);
+        ErrMsgPrintf(errmsg, "unexpected format version %ju", format);
         rv = RAFT_CORRUPT;
         goto err_after_read;
     }
@@ -408,10 +889,11 @@ int uvSegmentLoadClosed(struct uv *uv,
     last = false;
     offset = sizeof format;
     for (i = 1; !last; i++) {
-        rv = uvLoadEntriesBatch(uv, &buf, &tmp_entries, &tmp_n, &offset, &last);
+        rv = uvLoadEntriesBatch(&buf, &tmp_entries, &tmp_n, &offset, &last,
+                                stats, errmsg);
         if (rv != 0) {
-            ErrMsgWrapf(uv->io->errmsg, "entries batch %u starting at byte %zu",
-                        i, offset);
+            ErrMsgWrapf(errmsg, "entries batch %u starting at byte %zu", i,
+                        offset);
             /* Clean up the last allocation from extendEntries. */
             goto err_after_extend_entries;
         }
@@ -423,8 +905,7 @@ int uvSegmentLoadClosed(struct uv *uv,
     }
 
     if (*n != expected_n) {
-        ErrMsgPrintf(uv->io->errmsg, "found %zu entries (expected %u)", *n,
-                     expected_n);
+        ErrMsgPrintf(errmsg, "found %zu entries (expected %u)", *n, expected_n);
         rv = RAFT_CORRUPT;
         goto err_after_extend_entries;
     }
@@ -452,6 +933,26 @@ err:
     return rv;
 }
 
+int uvSegmentLoadClosed(struct uv *uv,
+                        struct uvSegmentInfo *info,
+                        struct raft_entry *entries[],
+                        size_t *n)
+{
+    return uvSegmentLoadClosedInternal(uv, info, 0, entries, n, NULL,
+                                       uv->io->errmsg);
+}
+
+int uvSegmentReadClosed(struct uv *uv,
+                        struct uvSegmentInfo *info,
+                        raft_index index,
+                        struct raft_entry *entries[],
+                        size_t *n,
+                        char *errmsg)
+{
+    return uvSegmentLoadClosedInternal(uv, info, index, entries, n, NULL,
+                                       errmsg);
+}
+
 /* Check if the content of the segment file contains all zeros from the current
  * offset onward. */
 static bool uvContentHasOnlyTrailingZeros(const struct raft_buffer *buf,
@@ -488,10 +989,12 @@ static int uvSegmentLoadOpen(struct uv *uv,
     unsigned tmp_n_entries;         /* Number of entries in current batch */
     int i;
     char errmsg[RAFT_ERRMSG_BUF_SIZE];
+    uint64_t t;
     int rv;
 
     first_index = *next_index;
 
+    t = uv_hrtime();
     rv = UvFsFileIsEmpty(uv->dir, info->filename, &empty, errmsg);
     if (rv != 0) {
         tracef("check if %s is empty: %s", info->filename, errmsg);
@@ -506,7 +1009,9 @@ static int uvSegmentLoadOpen(struct uv *uv,
         goto done;
     }
 
-    rv = uvReadSegmentFile(uv, info->filename, &buf, &format);
+    rv = uvReadSegmentFile(uv, info->filename, &buf, &format,
+                           uv->io->errmsg);
+    UvLoadStatsAdd(&uv->load_stats, segment_read, t);
     if (rv != 0) {
         goto err;
     }
@@ -534,8 +1039,8 @@ static int uvSegmentLoadOpen(struct uv *uv,
 
     /* Load all batches in the segment. */
     for (i = 1; !last; i++) {
-        rv = uvLoadEntriesBatch(uv, &buf, &tmp_entries, &tmp_n_entries, &offset,
-                                &last);
+        rv = uvLoadEntriesBatch(&buf, &tmp_entries, &tmp_n_entries, &offset,
+                                &last, &uv->load_stats, uv->io->errmsg);
         if (rv != 0) {
             /* If this isn't a decoding error, just bail out. */
             if (rv != RAFT_CORRUPT) {
@@ -831,6 +1336,10 @@ static void uvMoveCorruptSegment(struct uv *uv, struct uvSegmentInfo *info)
         tracef("%s", errmsg);
         return;
     }
+
+    if (!info->is_open) {
+        uvSegmentIndexRemove(uv, info->first_index, info->end_index);
+    }
 }
 
 /*
@@ -867,8 +1376,147 @@ static void uvRecoverFromCorruptSegment(struct uv *uv,
     }
 }
 
+/* Result of loading a closed segment in a worker thread. */
+struct uvSegmentLoadJob
+{
+    struct uvSegmentInfo *info;      /* Segment to load */
+    raft_index from;                 /* First entry needed */
+    struct raft_entry *entries;      /* Loaded entries */
+    size_t n;                        /* Number of loaded entries */
+    int status;                      /* Result code */
+    struct raft_uv_load_stats stats; /* Time spent loading the segment */
+    char errmsg[RAFT_ERRMSG_BUF_SIZE];
+};
+
+/* Pool of threads loading closed segments concurrently. */
+struct uvSegmentLoader
+{
+    struct uv *uv;
+    struct uvSegmentLoadJob *jobs;
+    size_t n_jobs;
+    size_t next;    /* Next job to be picked by a thread */
+    uv_mutex_t mutex; /* Serialize access to next */
+};
+
+/* Keep picking jobs until there are none left. */
+static void uvSegmentLoaderRun(void *arg)
+{
+    struct uvSegmentLoader *l = arg;
+    struct uvSegmentLoadJob *job;
+    for (;;) {
+        uv_mutex_lock(&l->mutex);
+        if (l->next == l->n_jobs) {
+            uv_mutex_unlock(&l->mutex);
+            break;
+        }
+        job = &l->jobs[l->next];
+        l->next++;
+        uv_mutex_unlock(&l->mutex);
+        job->status = uvSegmentLoadClosedInternal(l->uv, job->info, job->from,
+                                                  &job->entries, &job->n,
+                                                  &job->stats, job->errmsg);
+    }
+}
+
+/* Read, checksum and decode the given closed segments, using up to
+ * uv->segment_load_threads threads. Individual failures are reported in each
+ * job's status. */
+static int uvSegmentLoadClosedParallel(struct uv *uv,
+                                       struct uvSegmentInfo *infos,
+                                       size_t n_infos,
+                                       raft_index from,
+                                       struct uvSegmentLoadJob **jobs)
+{
+    struct uvSegmentLoader loader;
+    uv_thread_t *threads;
+    size_t n_threads;
+    size_t i;
+    int rv;
+
+    *jobs = RaftHeapCalloc(n_infos, sizeof **jobs);
+    if (*jobs == NULL) {
+        return RAFT_NOMEM;
+    }
+    for (i = 0; i < n_infos; i++) {
+        (*jobs)[i].info = &infos[i];
+    }
+    (*jobs)[0].from = from;
+
+    /* The calling thread is a worker too. */
+    n_threads = uv->segment_load_threads - 1;
+    if (n_threads > n_infos - 1) {
+        n_threads = n_infos - 1;
+    }
+    threads = RaftHeapMalloc(n_threads * sizeof *threads);
+    if (threads == NULL) {
+        rv = RAFT_NOMEM;
+        goto err;
+    }
+
+    loader.uv = uv;
+    loader.jobs = *jobs;
+    loader.n_jobs = n_infos;
+    loader.next = 0;
+    rv = uv_mutex_init(&loader.mutex);
+    if (rv != 0) {
+        rv = RAFT_IOERR;
+        goto err_after_threads_alloc;
+    }
+
+    tracef("load %zu closed segments with %zu threads", n_infos, n_threads + 1);
+
+    for (i = 0; i < n_threads; i++) {
+        rv = uv_thread_create(&threads[i], uvSegmentLoaderRun, &loader);
+        if (rv != 0) {
+            /* Just go on with the threads we have. */
+            tracef("create segment loader thread: %s", uv_strerror(rv));
+            n_threads = i;
+            break;
+        }
+    }
+    uvSegmentLoaderRun(&loader);
+    for (i = 0; i < n_threads; i++) {
+        uv_thread_join(&threads[i]);
+    }
+
+    uv_mutex_destroy(&loader.mutex);
+    RaftHeapFree(threads);
+
+    /* Now that the workers are done, account the time they spent. */
+    for (i = 0; i < n_infos; i++) {
+        struct raft_uv_load_stats *stats = &(*jobs)[i].stats;
+        uv->load_stats.segment_read += stats->segment_read;
+        uv->load_stats.segment_crc += stats->segment_crc;
+        uv->load_stats.segment_decode += stats->segment_decode;
+    }
+
+    return 0;
+
+err_after_threads_alloc:
+    RaftHeapFree(threads);
+err:
+    RaftHeapFree(*jobs);
+    *jobs = NULL;
+    assert(rv != 0);
+    return rv;
+}
+
+/* Release the entries of the jobs that were not consumed. */
+static void uvSegmentLoadJobsDestroy(struct uvSegmentLoadJob *jobs,
+                                     size_t n_jobs)
+{
+    size_t i;
+    for (i = 0; i < n_jobs; i++) {
+        if (jobs[i].status == 0 && jobs[i].entries != NULL) {
+            entryBatchesDestroy(jobs[i].entries, jobs[i].n);
+        }
+    }
+    RaftHeapFree(jobs);
+}
+
 int uvSegmentLoadAll(struct uv *uv,
-                     const raft_index start_index,
+                     raft_index *start_index,
+                     raft_index from,
                      struct uvSegmentInfo *infos,
                      size_t n_infos,
                      struct raft_entry **entries,
@@ -877,16 +1525,45 @@ int uvSegmentLoadAll(struct uv *uv,
     raft_index next_index;          /* Next entry to load from disk */
     struct raft_entry *tmp_entries; /* Entries in current segment */
     size_t tmp_n;                   /* Number of entries in current segment */
+    struct uvSegmentLoadJob *jobs;  /* Closed segments loaded in parallel */
+    size_t n_jobs;                  /* Number of leading closed segments */
     size_t i;
     int rv;
 
-    assert(start_index >= 1);
+    assert(*start_index >= 1);
     assert(n_infos > 0);
 
     *entries = NULL;
     *n_entries = 0;
 
-    next_index = start_index;
+    /* Closed segments whose entries are all before @from don't need to be
+     * loaded at all. Keep at least the last closed segment though, since open
+     * segments don't encode their first index and are expected to follow it. */
+    while (n_infos > 1 && !infos[0].is_open && !infos[1].is_open &&
+           infos[0].end_index < from) {
+        tracef("skip segment %s", infos[0].filename);
+        infos++;
+        n_infos--;
+        *start_index = infos[0].first_index;
+    }
+
+    next_index = *start_index;
+
+    /* Closed segments are independent from each other, so the bulk of the work
+     * needed to load them can be done concurrently. Their entries are then
+     * stitched together in index order below, exactly like in the sequential
+     * case. */
+    jobs = NULL;
+    n_jobs = 0;
+    while (n_jobs < n_infos && !infos[n_jobs].is_open) {
+        n_jobs++;
+    }
+    if (uv->segment_load_threads > 1 && n_jobs > 1) {
+        rv = uvSegmentLoadClosedParallel(uv, infos, n_jobs, from, &jobs);
+        if (rv != 0) {
+            goto err;
+        }
+    }
 
     for (i = 0; i < n_infos; i++) {
         struct uvSegmentInfo *info = &infos[i];
@@ -903,7 +1580,7 @@ int uvSegmentLoadAll(struct uv *uv,
                 goto err;
             }
         } else {
-            assert(info->first_index >= start_index);
+            assert(info->first_index >= *start_index);
             assert(info->first_index <= info->end_index);
 
             /* Check that the start index encoded in the name of the segment
@@ -917,7 +1594,22 @@ int uvSegmentLoadAll(struct uv *uv,
                 goto err;
             }
 
-            rv = uvSegmentLoadClosed(uv, info, &tmp_entries, &tmp_n);
+            if (jobs != NULL) {
+                struct uvSegmentLoadJob *job = &jobs[i];
+                rv = job->status;
+                if (rv == 0) {
+                    tmp_entries = job->entries;
+                    tmp_n = job->n;
+                    job->entries = NULL;
+                } else {
+                    ErrMsgPrintf(uv->io->errmsg, "%s", job->errmsg);
+                }
+            } else {
+                rv = uvSegmentLoadClosedInternal(uv, info, i == 0 ? from : 0,
+                                                 &tmp_entries, &tmp_n,
+                                                 &uv->load_stats,
+                                                 uv->io->errmsg);
+            }
             if (rv != 0) {
                 ErrMsgWrapf(uv->io->errmsg, "load closed segment %s",
                             info->filename);
@@ -936,14 +1628,29 @@ int uvSegmentLoadAll(struct uv *uv,
 
             raft_free(tmp_entries);
             next_index += tmp_n;
+
+            /* Leading entries of the first segment might have been skipped. */
+            if (i == 0 && tmp_n < info->end_index - info->first_index + 1) {
+                *start_index = info->end_index - tmp_n + 1;
+                next_index = info->end_index + 1;
+                tracef("skipped entries before %llu", *start_index);
+            }
         }
     }
 
+    if (jobs != NULL) {
+        uvSegmentLoadJobsDestroy(jobs, n_jobs);
+    }
+
     return 0;
 
 err:
     assert(rv != 0);
 
+    if (jobs != NULL) {
+        uvSegmentLoadJobsDestroy(jobs, n_jobs);
+    }
+
     /* Free any batch that we might have allocated and the entries array as
      * well. */
     if (*entries != NULL) {
@@ -1071,68 +1778,277 @@ err:
     return rv;
 }
 
+/* Complete the truncation of the closed segment starting at @first_index, whose
+ * surviving entries up to @end_index were moved to a temporary file. Any other
+ * closed segment starting at @first_index is the original one, which is
+ * removed. The temporary file is then cut right after @end_index, in case it
+ * still has data past it, and renamed to its final closed segment name.
+ *
+ * Every step can be safely repeated, so this is also used at startup to
+ * complete truncations that were interrupted by a crash. */
+static int uvSegmentTruncateComplete(struct uv *uv,
+                                     raft_index first_index,
+                                     raft_index end_index,
+                                     char *errmsg)
+{
+    char tmp_filename[UV__FILENAME_LEN];
+    char filename[UV__FILENAME_LEN];
+    struct uvSnapshotInfo *snapshots;
+    struct uvSegmentInfo *segments;
+    struct uvSegmentIndexRecord *records;
+    size_t n_snapshots;
+    size_t n_segments;
+    size_t n_records;
+    size_t size;
+    size_t end;
+    size_t i;
+    int rv;
+
+    sprintf(tmp_filename, UV__TRUNCATE_TEMPLATE, first_index, end_index);
+    sprintf(filename, UV__CLOSED_TEMPLATE, first_index, end_index);
+
+    rv = UvList(uv, &snapshots, &n_snapshots, &segments, &n_segments, errmsg);
+    if (rv != 0) {
+        return rv;
+    }
+    if (snapshots != NULL) {
+        RaftHeapFree(snapshots);
+    }
+    for (i = 0; i < n_segments; i++) {
+        struct uvSegmentInfo *segment = &segments[i];
+        if (segment->is_open || segment->first_index != first_index) {
+            continue;
+        }
+        rv = UvFsRemoveFile(uv->dir, segment->filename, errmsg);
+        if (rv != 0) {
+            rv = RAFT_IOERR;
+            break;
+        }
+        uvSegmentIndexRemove(uv, segment->first_index, segment->end_index);
+    }
+    if (segments != NULL) {
+        RaftHeapFree(segments);
+    }
+    if (rv != 0) {
+        return rv;
+    }
+
+    rv = uvSegmentIndexScan(uv, tmp_filename, first_index, end_index,
+                            &records, &n_records, &size, &end, errmsg);
+    if (rv != 0) {
+        return rv;
+    }
+    raft_free(records);
+
+    rv = UvFsTruncateAndRenameFile(uv->dir, end, tmp_filename, filename,
+                                   errmsg);
+    if (rv != 0) {
+        return rv;
+    }
+    rv = UvFsSyncDir(uv->dir, errmsg);
+    if (rv != 0) {
+        return RAFT_IOERR;
+    }
+
+    return 0;
+}
+
+/* Write to the given temporary file the entries of a closed segment that
+ * precede @index, which falls in the middle of the batch described by
+ * @record. Only that batch is decoded and re-encoded, the content of the
+ * batches before it is copied as is. */
+static int uvSegmentTruncateSplitBatch(struct uv *uv,
+                                       struct uvSegmentInfo *segment,
+                                       struct uvSegmentIndexRecord *record,
+                                       size_t batch_end,
+                                       raft_index index,
+                                       const char *tmp_filename,
+                                       char *errmsg)
+{
+    struct raft_buffer content;
+    struct raft_buffer bufs[2];
+    struct uvSegmentBuffer buf;
+    struct raft_entry *entries;
+    unsigned n_entries;
+    size_t offset;
+    bool last;
+    uv_file fd;
+    int rv;
+
+    rv = UvFsOpenFileForReading(uv->dir, segment->filename, &fd, errmsg);
+    if (rv != 0) {
+        return rv;
+    }
+    content.len = batch_end;
+    content.base = RaftHeapMalloc(content.len);
+    if (content.base == NULL) {
+        UvOsClose(fd);
+        return RAFT_NOMEM;
+    }
+    rv = UvFsReadAt(fd, &content, 0, errmsg);
+    UvOsClose(fd);
+    if (rv != 0) {
+        goto out;
+    }
+
+    offset = (size_t)record->offset;
+    rv = uvLoadEntriesBatch(&content, &entries, &n_entries, &offset, &last,
+                            NULL, errmsg);
+    if (rv != 0) {
+        goto out;
+    }
+    assert(index - record->first_index < n_entries);
+
+    uvSegmentBufferInit(&buf, uv->block_size);
+    rv = uvSegmentBufferAppend(&buf, entries,
+                               (unsigned)(index - record->first_index));
+    RaftHeapFree(entries);
+    if (rv != 0) {
+        goto out_after_buffer_init;
+    }
+
+    bufs[0].base = content.base;
+    bufs[0].len = (size_t)record->offset;
+    bufs[1].base = buf.arena.base;
+    bufs[1].len = buf.n;
+    rv = UvFsMakeFile(uv->dir, tmp_filename, bufs, 2, errmsg);
+    if (rv != 0) {
+        rv = RAFT_IOERR;
+    }
+
+out_after_buffer_init:
+    uvSegmentBufferClose(&buf);
+out:
+    RaftHeapFree(content.base);
+    return rv;
+}
+
 int uvSegmentTruncate(struct uv *uv,
                       struct uvSegmentInfo *segment,
                       raft_index index)
 {
-    char filename[UV__FILENAME_LEN];
-    struct raft_entry *entries;
-    struct uvSegmentBuffer buf;
-    struct raft_buffer data;
-    size_t n;
-    unsigned m;
+    char tmp_filename[UV__FILENAME_LEN];
+    struct uvSegmentIndexRecord *records;
+    struct uvSegmentIndexRecord *record;
+    size_t n_records;
+    size_t size;
+    size_t end;
+    size_t i;
     char errmsg[RAFT_ERRMSG_BUF_SIZE];
     int rv;
 
     assert(!segment->is_open);
+    assert(index > segment->first_index && index <= segment->end_index);
 
     tracef("truncate %llu-%llu at %llu", segment->first_index,
            segment->end_index, index);
 
-    rv = uvSegmentLoadClosed(uv, segment, &entries, &n);
+    /* Find the batch containing the truncate index. */
+    rv = uvSegmentIndexScan(uv, segment->filename, segment->first_index,
+                            segment->end_index, &records, &n_records, &size,
+                            &end, errmsg);
     if (rv != 0) {
-        ErrMsgWrapf(uv->io->errmsg, "load closed segment %s",
-                    segment->filename);
-        goto out;
+        ErrMsgTransferf(errmsg, uv->io->errmsg, "scan closed segment %s",
+                        segment->filename);
+        return rv;
+    }
+    for (i = n_records; i > 0; i--) {
+        if (records[i - 1].first_index <= index) {
+            break;
+        }
     }
+    assert(i > 0);
+    record = &records[i - 1];
 
-    /* Discard all entries after the truncate index (included) */
-    assert(index - segment->first_index < n);
-    m = (unsigned)(index - segment->first_index);
+    sprintf(tmp_filename, UV__TRUNCATE_TEMPLATE, segment->first_index,
+            index - 1);
 
-    uvSegmentBufferInit(&buf, uv->block_size);
+    if (record->first_index == index) {
+        /* The truncate index is the first of a batch: move the segment out of
+         * the way and then just cut it at the offset of that batch. */
+        rv = UvFsRenameFile(uv->dir, segment->filename, tmp_filename, errmsg);
+        if (rv == 0) {
+            rv = UvFsSyncDir(uv->dir, errmsg);
+        }
+        if (rv != 0) {
+            rv = RAFT_IOERR;
+        }
+        uvSegmentIndexRemove(uv, segment->first_index, segment->end_index);
+    } else {
+        /* The truncate index falls in the middle of a batch, which needs to be
+         * split. Write the surviving entries to a temporary file, so the
+         * original segment stays intact until they are safely on disk. */
+        rv = uvSegmentTruncateSplitBatch(
+            uv, segment, record,
+            i < n_records ? (size_t)records[i].offset : end, index,
+            tmp_filename, errmsg);
+    }
+    raft_free(records);
+    if (rv != 0) {
+        ErrMsgTransferf(errmsg, uv->io->errmsg, "truncate %s",
+                        segment->filename);
+        return rv;
+    }
 
-    rv = uvSegmentBufferFormat(&buf);
+    rv = uvSegmentTruncateComplete(uv, segment->first_index, index - 1,
+                                   errmsg);
     if (rv != 0) {
-        goto out_after_buffer_init;
+        ErrMsgTransferf(errmsg, uv->io->errmsg, "truncate %s",
+                        segment->filename);
+        return rv;
     }
 
-    rv = uvSegmentBufferAppend(&buf, entries, m);
+    /* Failing to index the new segment just means slower loads. */
+    rv = uvSegmentIndexWrite(uv, segment->first_index, index - 1, errmsg);
     if (rv != 0) {
-        goto out_after_buffer_init;
+        tracef("index %llu-%llu: %s", segment->first_index, index - 1,
+               errmsg);
     }
 
-    /* Render the path.
-     *
-     * TODO: we should use a temporary file name so in case of crash we don't
-     *      consider this segment as corrupted.
-     */
-    sprintf(filename, UV__CLOSED_TEMPLATE, segment->first_index, index - 1);
+    return 0;
+}
 
-    data.base = buf.arena.base;
-    data.len = buf.n;
+int uvSegmentTruncateRecover(struct uv *uv, char *errmsg)
+{
+    struct uv_fs_s req;
+    struct uv_dirent_s entry;
+    raft_index first_index;
+    raft_index end_index;
+    int consumed;
+    int matched;
+    int n;
+    int i;
+    int rv = 0;
+    int rv2;
 
-    rv = UvFsMakeFile(uv->dir, filename, &data, 1, errmsg);
-    if (rv != 0) {
-        tracef("write %s: %s", filename, errmsg);
-        rv = RAFT_IOERR;
-        goto out_after_buffer_init;
+    n = uv_fs_scandir(NULL, &req, uv->dir, 0, NULL);
+    if (n < 0) {
+        ErrMsgPrintf(errmsg, "scan data directory: %s", uv_strerror(n));
+        return RAFT_IOERR;
     }
 
-out_after_buffer_init:
-    uvSegmentBufferClose(&buf);
-    entryBatchesDestroy(entries, n);
-out:
+    for (i = 0; i < n; i++) {
+        rv2 = uv_fs_scandir_next(&req, &entry);
+        assert(rv2 == 0); /* Can't fail in libuv */
+        if (rv != 0) {
+            continue;
+        }
+        matched = sscanf(entry.name, UV__TRUNCATE_TEMPLATE "%n", &first_index,
+                         &end_index, &consumed);
+        if (matched != 2 || consumed != (int)strlen(entry.name)) {
+            continue;
+        }
+        tracef("complete interrupted truncation of %llu-%llu", first_index,
+               end_index);
+        rv = uvSegmentTruncateComplete(uv, first_index, end_index, errmsg);
+        if (rv != 0) {
+            ErrMsgWrapf(errmsg, "complete truncation of %s", entry.name);
+        }
+    }
+
+    rv2 = uv_fs_scandir_next(&req, &entry);
+    assert(rv2 == UV_EOF);
+
     return rv;
 }
 
@@ -2,7 +2,9 @@
 
 #include "../include/raft/uv.h"
 #include "assert.h"
+#include "err.h"
 #include "heap.h"
+#include "message.h"
 #include "uv.h"
 #include "uv_encoding.h"
 
@@ -30,11 +32,32 @@
  * - The write request fails (either synchronously or asynchronously). In this
  *   case we fire the request callback with an error, close the connection
  *   stream, and start a re-connection attempt.
+ *
+ * Each peer server has two client objects: InstallSnapshot requests are sent
+ * over a dedicated bulk connection, while all other messages use the control
+ * one. This way heartbeats and AppendEntries don't queue up behind a large
+ * snapshot payload being written out, which on slow links could take longer
+ * than the election timeout.
+ *
+ * The total size of the messages queued on a client, either waiting for a
+ * connection or being written out, is bounded by uv->send_queue_size. When the
+ * budget is exhausted AppendEntries requests carrying entries are rejected with
+ * RAFT_BUSY, which tells the leader to stop pipelining to that follower. While
+ * the connection is down, the oldest queued messages are evicted instead.
+ *
+ * Groups of a raft_uv_host don't have clients of their own: their messages are
+ * tagged with the group ID and queued on the clients of the host's hub, which
+ * are shared by all groups sending to the same peer. While the host ticks its
+ * groups the hub is corked: the heartbeats of all groups are queued and then
+ * written out to each peer with a single write request, see UvSendUncork().
+ *
+ * A control client that has sent an AppendEntries request asking its peer to
+ * quiesce writes a keepalive frame whenever the connection has been idle for a
+ * keepalive interval, see UvKeepaliveStart(). It also writes one as soon as it
+ * starts doing so and upon every new connection, so that the peer knows what to
+ * expect before the connection goes idle.
  */
 
-/* Maximum number of requests that can be buffered.  */
-#define UV__CLIENT_MAX_PENDING 3
-
 struct uvClient
 {
     struct uv *uv;                  /* libuv I/O implementation object */
@@ -45,9 +68,13 @@ struct uvClient
     unsigned n_connect_attempt;     /* Consecutive connection attempts */
     raft_id id;                     /* ID of the other server */
     char *address;                  /* Address of the other server */
+    bool bulk;                      /* Reserved to InstallSnapshot messages */
     queue pending;                  /* Pending send message requests */
+    size_t n_bytes;                 /* Size of pending and inflight messages */
     queue queue;                    /* Clients queue */
     bool closing;                   /* True after calling uvClientAbort */
+    bool keepalive;                 /* Whether the peer expects keepalives */
+    bool idle;                      /* No write since the last keepalive */
 };
 
 /* Hold state for a single send RPC message request. */
@@ -57,6 +84,9 @@ struct uvSend
     struct raft_io_send *req; /* User request */
     uv_buf_t *bufs;           /* Encoded raft RPC message to send */
     unsigned n_bufs;          /* Number of buffers */
+    size_t size;              /* Total size of the buffers */
+    bool compressed;          /* Whether the payload buffer is ours */
+    struct uv *group;         /* Sending group, if using host connections */
     uv_write_t write;         /* Stream write request */
     queue queue;              /* Pending send requests queue */
 };
@@ -70,17 +100,43 @@ static void uvSendDestroy(struct uvSend *s)
          * payloads, which we were passed but we don't own. */
         RaftHeapFree(s->bufs[0].base);
 
+        /* A compressed AppendEntries payload was allocated by us. */
+        if (s->compressed) {
+            RaftHeapFree(s->bufs[1].base);
+        }
+
         /* Release the buffers array. */
         RaftHeapFree(s->bufs);
     }
     RaftHeapFree(s);
 }
 
+/* Release the given send request and fire its callback. */
+static void uvSendFinish(struct uvSend *s, int status)
+{
+    struct raft_io_send *req = s->req;
+    struct uv *group = s->group;
+
+    uvSendDestroy(s);
+
+    if (req->cb != NULL) {
+        req->cb(req, status);
+    }
+
+    /* A closing group waits for its messages on the host connections. */
+    if (group != NULL) {
+        assert(group->host_sends > 0);
+        group->host_sends--;
+        uvMaybeFireCloseCb(group);
+    }
+}
+
 /* Initialize a new client associated with the given server. */
 static int uvClientInit(struct uvClient *c,
                         struct uv *uv,
                         raft_id id,
-                        const char *address)
+                        const char *address,
+                        bool bulk)
 {
     int rv;
     c->uv = uv;
@@ -90,6 +146,7 @@ static int uvClientInit(struct uvClient *c,
     c->old_stream = NULL;   /* Set after closing the current connection */
     c->n_connect_attempt = 0;
     c->id = id;
+    c->bulk = bulk;
     c->address = RaftHeapMalloc(strlen(address) + 1);
     if (c->address == NULL) {
         return RAFT_NOMEM;
@@ -98,7 +155,10 @@ static int uvClientInit(struct uvClient *c,
     assert(rv == 0);
     strcpy(c->address, address);
     QUEUE_INIT(&c->pending);
+    c->n_bytes = 0;
     c->closing = false;
+    c->keepalive = false;
+    c->idle = false;
     QUEUE_PUSH(&uv->clients, &c->queue);
     return 0;
 }
@@ -124,16 +184,13 @@ static void uvClientMaybeDestroy(struct uvClient *c)
     while (!QUEUE_IS_EMPTY(&c->pending)) {
         queue *head;
         struct uvSend *send;
-        struct raft_io_send *req;
         head = QUEUE_HEAD(&c->pending);
         send = QUEUE_DATA(head, struct uvSend, queue);
         QUEUE_REMOVE(head);
-        req = send->req;
-        uvSendDestroy(send);
-        if (req->cb != NULL) {
-            req->cb(req, RAFT_CANCELED);
-        }
+        c->n_bytes -= send->size;
+        uvSendFinish(send, RAFT_CANCELED);
     }
+    assert(c->n_bytes == 0);
 
     QUEUE_REMOVE(&c->queue);
 
@@ -172,14 +229,23 @@ static void uvClientDisconnect(struct uvClient *c)
     uv_close((struct uv_handle_s *)c->old_stream, uvClientDisconnectCloseCb);
 }
 
-/* Invoked once an encoded RPC message has been written out. */
-static void uvSendWriteCb(struct uv_write_s *write, const int status)
+/* Several send requests written out with a single write request. */
+struct uvSendBatch
+{
+    uv_write_t write; /* Stream write request */
+    uv_buf_t *bufs;   /* Buffers of all requests */
+    queue sends;      /* Requests being written */
+};
+
+/* Account for a send request whose message has been written out. */
+static void uvSendWritten(struct uvSend *send, const int status)
 {
-    struct uvSend *send = write->data;
     struct uvClient *c = send->client;
-    struct raft_io_send *req = send->req;
     int cb_status = 0;
 
+    assert(c->n_bytes >= send->size);
+    c->n_bytes -= send->size;
+
     /* If the write failed and we're not currently closing, let's consider the
      * current stream handle as busted and start disconnecting (unless we're
      * already doing so). We'll trigger a new connection attempt once the handle
@@ -195,35 +261,153 @@ static void uvSendWriteCb(struct uv_write_s *write, const int status)
         }
     }
 
-    uvSendDestroy(send);
+    uvSendFinish(send, cb_status);
+}
 
-    if (req->cb != NULL) {
-        req->cb(req, cb_status);
+/* Invoked once an encoded RPC message has been written out. */
+static void uvSendWriteCb(struct uv_write_s *write, const int status)
+{
+    uvSendWritten(write->data, status);
+}
+
+/* Invoked once a batch of encoded RPC messages has been written out. */
+static void uvSendBatchWriteCb(struct uv_write_s *write, const int status)
+{
+    struct uvSendBatch *batch = write->data;
+
+    while (!QUEUE_IS_EMPTY(&batch->sends)) {
+        queue *head;
+        struct uvSend *send;
+        head = QUEUE_HEAD(&batch->sends);
+        send = QUEUE_DATA(head, struct uvSend, queue);
+        QUEUE_REMOVE(head);
+        uvSendWritten(send, status);
+    }
+
+    RaftHeapFree(batch->bufs);
+    RaftHeapFree(batch);
+}
+
+/* A keepalive frame being written out. */
+struct uvKeepalive
+{
+    struct uvClient *client;           /* Client writing the frame */
+    uv_write_t write;                  /* Stream write request */
+    uint8_t frame[UV__KEEPALIVE_SIZE]; /* Encoded frame */
+};
+
+static void uvKeepaliveWriteCb(struct uv_write_s *write, const int status)
+{
+    struct uvKeepalive *keepalive = write->data;
+    struct uvClient *c = keepalive->client;
+
+    RaftHeapFree(keepalive);
+
+    /* Like a failed message, a failed keepalive busts the connection. */
+    if (status != 0 && !c->closing && c->stream != NULL) {
+        tracef("write keepalive failed -> disconnect");
+        uvClientDisconnect(c);
+    }
+}
+
+/* Write a keepalive frame to the current connection. */
+static void uvClientWriteKeepalive(struct uvClient *c)
+{
+    struct uvKeepalive *keepalive;
+    uv_buf_t buf;
+    int rv;
+
+    keepalive = RaftHeapMalloc(sizeof *keepalive);
+    if (keepalive == NULL) {
+        return; /* The next keepalive will be attempted anyway. */
+    }
+    keepalive->client = c;
+    keepalive->write.data = keepalive;
+    uvEncodeKeepalive(c->uv->keepalive_interval, keepalive->frame);
+    buf.base = (char *)keepalive->frame;
+    buf.len = sizeof keepalive->frame;
+
+    rv = uv_write(&keepalive->write, c->stream, &buf, 1, uvKeepaliveWriteCb);
+    if (rv != 0) {
+        tracef("write keepalive failed -> rv %d", rv);
+        RaftHeapFree(keepalive);
     }
 }
 
-static int uvClientSend(struct uvClient *c, struct uvSend *send)
+/* Write the given message to the current connection. */
+static int uvClientWrite(struct uvClient *c, struct uvSend *send)
+{
+    int rv;
+    assert(c->stream != NULL);
+    send->write.data = send;
+    rv = uv_write(&send->write, c->stream, send->bufs, send->n_bufs,
+                  uvSendWriteCb);
+    if (rv != 0) {
+        tracef("write message failed -> rv %d", rv);
+        /* UNTESTED: what are the error conditions? perhaps ENOMEM */
+        return RAFT_IOERR;
+    }
+    c->idle = false;
+    return 0;
+}
+
+/* Fail the oldest pending requests with RAFT_NOCONNECTION, until the queue fits
+ * the configured budget. The most recent request is always kept. */
+static void uvClientEvictPending(struct uvClient *c)
+{
+    while (c->n_bytes > c->uv->send_queue_size) {
+        queue *head;
+        struct uvSend *old_send;
+        head = QUEUE_HEAD(&c->pending);
+        if (QUEUE_NEXT(head) == &c->pending) {
+            break;
+        }
+        tracef("queue full -> evict oldest message");
+        old_send = QUEUE_DATA(head, struct uvSend, queue);
+        QUEUE_REMOVE(head);
+        c->n_bytes -= old_send->size;
+        uvSendFinish(old_send, RAFT_NOCONNECTION);
+    }
+}
+
+static int uvClientSend(struct uvClient *c,
+                        struct uvSend *send,
+                        const struct raft_message *message)
 {
     int rv;
     assert(!c->closing);
     send->client = c;
 
+    /* If the queue is full, refuse to pile up more entries. */
+    if (c->n_bytes > 0 && c->n_bytes + send->size > c->uv->send_queue_size &&
+        message->type == RAFT_APPEND_ENTRIES &&
+        message->append_entries.n_entries > 0) {
+        tracef("queue full -> reject entries");
+        return RAFT_BUSY;
+    }
+
     /* If there's no connection available, let's queue the request. */
     if (c->stream == NULL) {
         tracef("no connection available -> enqueue message");
         QUEUE_PUSH(&c->pending, &send->queue);
+        c->n_bytes += send->size;
+        return 0;
+    }
+
+    /* The request will be written out together with the other ones sent while
+     * corked. */
+    if (c->uv->send_corked) {
+        QUEUE_PUSH(&c->pending, &send->queue);
+        c->n_bytes += send->size;
         return 0;
     }
 
     tracef("connection available -> write message");
-    send->write.data = send;
-    rv = uv_write(&send->write, c->stream, send->bufs, send->n_bufs,
-                  uvSendWriteCb);
+    rv = uvClientWrite(c, send);
     if (rv != 0) {
-        tracef("write message failed -> rv %d", rv);
-        /* UNTESTED: what are the error conditions? perhaps ENOMEM */
-        return RAFT_IOERR;
+        return rv;
     }
+    c->n_bytes += send->size;
 
     return 0;
 }
@@ -241,14 +425,75 @@ static void uvClientSendPending(struct uvClient *c)
         head = QUEUE_HEAD(&c->pending);
         send = QUEUE_DATA(head, struct uvSend, queue);
         QUEUE_REMOVE(head);
-        rv = uvClientSend(c, send);
+        rv = uvClientWrite(c, send);
         if (rv != 0) {
-            if (send->req->cb != NULL) {
-                send->req->cb(send->req, rv);
-            }
-            uvSendDestroy(send);
+            c->n_bytes -= send->size;
+            uvSendFinish(send, rv);
+        }
+    }
+}
+
+/* Write all pending send requests to the current connection with a single
+ * write request. */
+static void uvClientFlushPending(struct uvClient *c)
+{
+    struct uvSendBatch *batch;
+    queue *head;
+    unsigned n_bufs = 0;
+    unsigned i;
+    int rv;
+
+    assert(c->stream != NULL);
+
+    QUEUE_FOREACH (head, &c->pending) {
+        n_bufs += QUEUE_DATA(head, struct uvSend, queue)->n_bufs;
+    }
+
+    /* A single request needs no batch, and if we can't allocate one let's
+     * just write the requests one by one. */
+    head = QUEUE_HEAD(&c->pending);
+    if (QUEUE_NEXT(head) == &c->pending) {
+        goto fallback;
+    }
+    batch = RaftHeapMalloc(sizeof *batch);
+    if (batch == NULL) {
+        goto fallback;
+    }
+    batch->bufs = RaftHeapMalloc(n_bufs * sizeof *batch->bufs);
+    if (batch->bufs == NULL) {
+        RaftHeapFree(batch);
+        goto fallback;
+    }
+
+    n_bufs = 0;
+    QUEUE_FOREACH (head, &c->pending) {
+        struct uvSend *send = QUEUE_DATA(head, struct uvSend, queue);
+        for (i = 0; i < send->n_bufs; i++) {
+            batch->bufs[n_bufs++] = send->bufs[i];
         }
     }
+
+    batch->write.data = batch;
+    rv = uv_write(&batch->write, c->stream, batch->bufs, n_bufs,
+                  uvSendBatchWriteCb);
+    if (rv != 0) {
+        tracef("write batch failed -> rv %d", rv);
+        RaftHeapFree(batch->bufs);
+        RaftHeapFree(batch);
+        goto fallback;
+    }
+    c->idle = false;
+
+    QUEUE_INIT(&batch->sends);
+    while (!QUEUE_IS_EMPTY(&c->pending)) {
+        head = QUEUE_HEAD(&c->pending);
+        QUEUE_REMOVE(head);
+        QUEUE_PUSH(&batch->sends, head);
+    }
+    return;
+
+fallback:
+    uvClientSendPending(c);
 }
 
 static void uvClientTimerCb(uv_timer_t *timer)
@@ -258,24 +503,11 @@ static void uvClientTimerCb(uv_timer_t *timer)
     uvClientConnect(c); /* Retry to connect. */
 }
 
-/* Return the number of send requests that we have been parked in the send queue
- * because no connection is available yet. */
-static unsigned uvClientPendingCount(struct uvClient *c)
-{
-    queue *head;
-    unsigned n = 0;
-    QUEUE_FOREACH (head, &c->pending) {
-        n++;
-    }
-    return n;
-}
-
 static void uvClientConnectCb(struct raft_uv_connect *req,
                               struct uv_stream_s *stream,
                               int status)
 {
     struct uvClient *c = req->data;
-    unsigned n_pending;
     int rv;
 
     tracef("connect attempt completed -> status %s", errCodeToString(status));
@@ -308,28 +540,15 @@ static void uvClientConnectCb(struct raft_uv_connect *req,
         c->n_connect_attempt = 0;
         c->stream->data = c;
         uvClientSendPending(c);
+        /* Tell the peer right away to expect keepalives on this connection. */
+        if (c->keepalive && c->stream != NULL) {
+            uvClientWriteKeepalive(c);
+        }
         return;
     }
 
     /* Shrink the queue of pending requests, by failing the oldest ones */
-    n_pending = uvClientPendingCount(c);
-    if (n_pending > UV__CLIENT_MAX_PENDING) {
-        unsigned i;
-        for (i = 0; i < n_pending - UV__CLIENT_MAX_PENDING; i++) {
-            tracef("queue full -> evict oldest message");
-            queue *head;
-            struct uvSend *old_send;
-            struct raft_io_send *old_req;
-            head = QUEUE_HEAD(&c->pending);
-            old_send = QUEUE_DATA(head, struct uvSend, queue);
-            QUEUE_REMOVE(head);
-            old_req = old_send->req;
-            uvSendDestroy(old_send);
-            if (old_req->cb != NULL) {
-                old_req->cb(old_req, RAFT_NOCONNECTION);
-            }
-        }
-    }
+    uvClientEvictPending(c);
 
     /* Let's schedule another attempt. */
     rv = uv_timer_start(&c->timer, uvClientTimerCb, c->uv->connect_retry_delay,
@@ -401,11 +620,12 @@ static void uvClientAbort(struct uvClient *c)
     c->closing = true;
 }
 
-/* Find the client object associated with the given server, or create one if
- * there's none yet. */
+/* Find the control or bulk client object associated with the given server, or
+ * create one if there's none yet. */
 static int uvGetClient(struct uv *uv,
                        const raft_id id,
                        const char *address,
+                       bool bulk,
                        struct uvClient **client)
 {
     queue *head;
@@ -414,7 +634,7 @@ static int uvGetClient(struct uv *uv,
     /* Check if we already have a client object for this peer server. */
     QUEUE_FOREACH (head, &uv->clients) {
         *client = QUEUE_DATA(head, struct uvClient, queue);
-        if ((*client)->id != id) {
+        if ((*client)->id != id || (*client)->bulk != bulk) {
             continue;
         }
 
@@ -434,7 +654,7 @@ static int uvGetClient(struct uv *uv,
         goto err;
     }
 
-    rv = uvClientInit(*client, uv, id, address);
+    rv = uvClientInit(*client, uv, id, address, bulk);
     if (rv != 0) {
         goto err_after_client_alloc;
     }
@@ -451,18 +671,81 @@ err:
     return rv;
 }
 
+/* Compress the entries payload of an AppendEntries request, if the receiver
+ * supports it and the payload is large enough. Compression is best-effort: upon
+ * failure the payload is sent as is. */
+static void uvSendMaybeCompress(struct uv *uv,
+                                struct uvSend *send,
+                                const struct raft_message *message)
+{
+    size_t len = 0;
+    unsigned i;
+    int rv;
+
+    if (message->type != RAFT_APPEND_ENTRIES ||
+        uv->append_compression_threshold == 0) {
+        return;
+    }
+
+    /* Since version 2 the leader tells whether the receiver can decompress. */
+    switch (message->append_entries.version) {
+        case 0:
+            return;
+        case 1:
+            break;
+        default:
+            if (!(message->append_entries.flags &
+                  MESSAGE__APPEND_ENTRIES_LZ4)) {
+                return;
+            }
+            break;
+    }
+
+    for (i = 1; i < send->n_bufs; i++) {
+        len += send->bufs[i].len;
+    }
+    if (len == 0 || len < uv->append_compression_threshold) {
+        return;
+    }
+
+    rv = uvEncodeCompressedEntries(send->bufs, &send->n_bufs);
+    if (rv != 0) {
+        if (rv != RAFT_INVALID) {
+            Tracef(uv->tracer, "compress entries: %s", errCodeToString(rv));
+        }
+        return;
+    }
+    send->compressed = true;
+}
+
+/* Whether the given message is an AppendEntries request asking to quiesce. */
+static bool uvSendAsksToQuiesce(const struct raft_message *message)
+{
+    return message->type == RAFT_APPEND_ENTRIES &&
+           message->append_entries.version >=
+               MESSAGE__APPEND_ENTRIES_FLAGS_VERSION &&
+           (message->append_entries.flags & MESSAGE__APPEND_ENTRIES_QUIESCE);
+}
+
 int UvSend(struct raft_io *io,
            struct raft_io_send *req,
            const struct raft_message *message,
            raft_io_send_cb cb)
 {
     struct uv *uv = io->impl;
+    struct uv *sender = uv;
     struct uvSend *send;
     struct uvClient *client;
+    unsigned i;
     int rv;
 
     assert(!uv->closing);
 
+    /* Servers in the same process get the message without encoding it. */
+    if (UvInprocEnabled(uv)) {
+        return UvInprocSend(uv, req, message, cb);
+    }
+
     /* Allocate a new request object. */
     send = RaftHeapMalloc(sizeof *send);
     if (send == NULL) {
@@ -470,6 +753,8 @@ int UvSend(struct raft_io *io,
         goto err;
     }
     send->req = req;
+    send->compressed = false;
+    send->group = NULL;
     req->cb = cb;
 
     rv = uvEncodeMessage(message, &send->bufs, &send->n_bufs);
@@ -477,19 +762,48 @@ int UvSend(struct raft_io *io,
         send->bufs = NULL;
         goto err_after_send_alloc;
     }
+    uvSendMaybeCompress(uv, send, message);
+    send->size = 0;
+    for (i = 0; i < send->n_bufs; i++) {
+        send->size += send->bufs[i].len;
+    }
+
+    /* Groups of a host send over the connections of the host's hub. */
+    if (uv->host != NULL) {
+        uvEncodeMessageGroup(&send->bufs[0], uv->group);
+        sender = UvHostHub(uv->host);
+    }
 
     /* Get a client object connected to the target server, creating it if it
      * doesn't exist yet. */
-    rv = uvGetClient(uv, message->server_id, message->server_address, &client);
+    rv = uvGetClient(sender, message->server_id, message->server_address,
+                     message->type == RAFT_INSTALL_SNAPSHOT, &client);
     if (rv != 0) {
         goto err_after_send_alloc;
     }
 
-    rv = uvClientSend(client, send);
+    rv = uvClientSend(client, send, message);
     if (rv != 0) {
         goto err_after_send_alloc;
     }
 
+    /* Only servers that know about keepalives get asked to quiesce. The first
+     * keepalive is written right away, so the peer notices if we go silent
+     * even before a full interval has elapsed. */
+    if (!client->keepalive && sender->keepalive_interval > 0 &&
+        uvSendAsksToQuiesce(message)) {
+        client->keepalive = true;
+        UvKeepaliveStart(sender);
+        if (client->stream != NULL) {
+            uvClientWriteKeepalive(client);
+        }
+    }
+
+    if (uv->host != NULL) {
+        send->group = uv;
+        uv->host_sends++;
+    }
+
     return 0;
 
 err_after_send_alloc:
@@ -499,9 +813,72 @@ err:
     return rv;
 }
 
+/* Cancel the messages of the given group which are still waiting for a
+ * connection of the hub. Messages being written out will complete normally. */
+static void uvSendCancelGroup(struct uv *hub, struct uv *group)
+{
+    queue *head;
+    QUEUE_FOREACH (head, &hub->clients) {
+        struct uvClient *c = QUEUE_DATA(head, struct uvClient, queue);
+        queue *pending = QUEUE_NEXT(&c->pending);
+        while (pending != &c->pending) {
+            struct uvSend *send = QUEUE_DATA(pending, struct uvSend, queue);
+            pending = QUEUE_NEXT(pending);
+            if (send->group != group) {
+                continue;
+            }
+            QUEUE_REMOVE(&send->queue);
+            c->n_bytes -= send->size;
+            uvSendFinish(send, RAFT_CANCELED);
+        }
+    }
+}
+
+void UvSendCork(struct uv *uv)
+{
+    assert(!uv->send_corked);
+    uv->send_corked = true;
+}
+
+void UvSendUncork(struct uv *uv)
+{
+    queue *head;
+
+    assert(uv->send_corked);
+    uv->send_corked = false;
+
+    QUEUE_FOREACH (head, &uv->clients) {
+        struct uvClient *c = QUEUE_DATA(head, struct uvClient, queue);
+        if (c->stream == NULL || QUEUE_IS_EMPTY(&c->pending)) {
+            continue;
+        }
+        uvClientFlushPending(c);
+    }
+}
+
+void UvSendKeepalive(struct uv *uv)
+{
+    queue *head;
+
+    QUEUE_FOREACH (head, &uv->clients) {
+        struct uvClient *c = QUEUE_DATA(head, struct uvClient, queue);
+        if (!c->keepalive || c->stream == NULL) {
+            continue;
+        }
+        if (c->idle && QUEUE_IS_EMPTY(&c->pending)) {
+            uvClientWriteKeepalive(c);
+        }
+        c->idle = true;
+    }
+}
+
 void UvSendClose(struct uv *uv)
 {
     assert(uv->closing);
+    if (uv->host != NULL) {
+        uvSendCancelGroup(UvHostHub(uv->host), uv);
+        return;
+    }
     while (!QUEUE_IS_EMPTY(&uv->clients)) {
         queue *head;
         struct uvClient *client;
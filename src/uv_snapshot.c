@@ -322,15 +322,19 @@ err:
 static int uvSnapshotLoadData(struct uv *uv,
                               struct uvSnapshotInfo *info,
                               struct raft_snapshot *snapshot,
+                              struct raft_uv_load_stats *stats,
                               char *errmsg)
 {
     char filename[UV__FILENAME_LEN];
     struct raft_buffer buf;
+    uint64_t t;
     int rv;
 
     uvSnapshotFilenameOf(info, filename);
 
+    t = uv_hrtime();
     rv = UvFsReadFile(uv->dir, filename, &buf, errmsg);
+    UvLoadStatsAdd(stats, snapshot_read, t);
     if (rv != 0) {
         tracef("stat %s: %s", filename, errmsg);
         goto err;
@@ -339,7 +343,9 @@ static int uvSnapshotLoadData(struct uv *uv,
     if (IsCompressed(buf.base, buf.len)) {
         struct raft_buffer decompressed = {0};
         tracef("snapshot decompress start");
+        t = uv_hrtime();
         rv = Decompress(buf, &decompressed, errmsg);
+        UvLoadStatsAdd(stats, snapshot_decompress, t);
         tracef("snapshot decompress end %d", rv);
         if (rv != 0) {
             tracef("decompress failed rv:%d", rv);
@@ -369,14 +375,18 @@ err:
 int UvSnapshotLoad(struct uv *uv,
                    struct uvSnapshotInfo *meta,
                    struct raft_snapshot *snapshot,
+                   struct raft_uv_load_stats *stats,
                    char *errmsg)
 {
+    uint64_t t;
     int rv;
+    t = uv_hrtime();
     rv = uvSnapshotLoadMeta(uv, meta, snapshot, errmsg);
+    UvLoadStatsAdd(stats, snapshot_read, t);
     if (rv != 0) {
         return rv;
     }
-    rv = uvSnapshotLoadData(uv, meta, snapshot, errmsg);
+    rv = uvSnapshotLoadData(uv, meta, snapshot, stats, errmsg);
     if (rv != 0) {
         return rv;
     }
@@ -390,6 +400,7 @@ struct uvSnapshotPut
     struct raft_io_snapshot_put *req;
     const struct raft_snapshot *snapshot;
     uv_file snapshot_fd; /* Pre-allocated snapshot file */
+    bool staged;         /* Whether snapshot_fd holds a streamed payload */
     struct
     {
         unsigned long long timestamp;
@@ -509,6 +520,7 @@ static void uvSnapshotPutWorkCb(uv_work_t *work)
             put->snapshot->index, put->meta.timestamp);
 
     rv = UvFsFinalizeTempFile(put->snapshot_fd, uv->dir, snapshot, put->errmsg);
+    put->snapshot_fd = -1;
     tracef("snapshot write end %d", rv);
     if (rv != 0) {
         tracef("snapshot creation failed %d", rv);
@@ -545,6 +557,9 @@ static void uvSnapshotPutFinish(struct uvSnapshotPut *put)
     int status = put->status;
     struct uv *uv = put->uv;
     assert(uv->snapshot_put_work.data == NULL);
+    if (put->staged && put->snapshot_fd != -1) {
+        UvOsClose(put->snapshot_fd);
+    }
     RaftHeapFree(put->meta.bufs[1].base);
     RaftHeapFree(put);
     req->cb(req, status);
@@ -615,10 +630,20 @@ static void uvSnapshotPutWorkAllocateCb(uv_work_t *work)
         goto abort;
     }
 
-    rv = UvFsCreateTempFile(uv->dir, snapshot->bufs, snapshot->n_bufs,
-                            &put->snapshot_fd, put->errmsg);
-    if (rv != 0) {
-        goto abort_after_meta_open;
+    /* A streamed payload has already been written, just flush it. */
+    if (put->staged) {
+        rv = UvOsFsync(put->snapshot_fd);
+        if (rv != 0) {
+            UvOsErrMsg(put->errmsg, "fsync", rv);
+            rv = RAFT_IOERR;
+            goto abort_after_meta_open;
+        }
+    } else {
+        rv = UvFsCreateTempFile(uv->dir, snapshot->bufs, snapshot->n_bufs,
+                                &put->snapshot_fd, put->errmsg);
+        if (rv != 0) {
+            goto abort_after_meta_open;
+        }
     }
 
     put->status = 0;
@@ -727,10 +752,28 @@ int UvSnapshotPut(struct raft_io *io,
     put->snapshot = snapshot;
     put->meta.timestamp = uv_now(uv->loop);
     put->trailing = trailing;
+    put->snapshot_fd = -1;
+    put->staged = false;
     put->barrier.data = put;
     put->barrier.blocking = trailing == 0;
     put->barrier.cb = uvSnapshotPutBarrierCb;
 
+    /* A snapshot without data refers to a payload streamed by UvRecv. */
+    if (snapshot->n_bufs == 1 && snapshot->bufs[0].base == NULL) {
+        struct uvSnapshotStaged *staged = &uv->snapshot_staged;
+        if (staged->fd == -1 || staged->index != snapshot->index ||
+            staged->term != snapshot->term ||
+            staged->len != snapshot->bufs[0].len) {
+            ErrMsgPrintf(io->errmsg, "no streamed snapshot at %llu",
+                         snapshot->index);
+            rv = RAFT_INVALID;
+            goto err_after_req_alloc;
+        }
+        put->snapshot_fd = staged->fd;
+        put->staged = true;
+        staged->fd = -1;
+    }
+
     req->cb = cb;
 
     /* Prepare the buffers for the metadata file. */
@@ -768,6 +811,9 @@ int UvSnapshotPut(struct raft_io *io,
 err_after_configuration_encode:
     RaftHeapFree(put->meta.bufs[1].base);
 err_after_req_alloc:
+    if (put->staged) {
+        UvOsClose(put->snapshot_fd);
+    }
     RaftHeapFree(put);
 err:
     assert(rv != 0);
@@ -792,7 +838,7 @@ static void uvSnapshotGetWorkCb(uv_work_t *work)
     }
     if (snapshots != NULL) {
         rv = UvSnapshotLoad(uv, &snapshots[n_snapshots - 1], get->snapshot,
-                            get->errmsg);
+                            NULL, get->errmsg);
         if (rv != 0) {
             get->status = rv;
         }
@@ -875,8 +921,27 @@ static void uvSnapshotPutRetryCloseCb(uv_handle_t *handle)
     uvMaybeFireCloseCb(uv);
 }
 
+void UvSnapshotStage(struct uv *uv,
+                     uv_file fd,
+                     const struct raft_install_snapshot *params)
+{
+    struct uvSnapshotStaged *staged = &uv->snapshot_staged;
+    if (staged->fd != -1) {
+        tracef("discard streamed snapshot at %llu", staged->index);
+        UvOsClose(staged->fd);
+    }
+    staged->fd = fd;
+    staged->term = params->last_term;
+    staged->index = params->last_index;
+    staged->len = params->data.len;
+}
+
 void UvSnapshotClose(struct uv *uv)
 {
+    if (uv->snapshot_staged.fd != -1) {
+        UvOsClose(uv->snapshot_staged.fd);
+        uv->snapshot_staged.fd = -1;
+    }
     if (uv->snapshot_put_retry.data != NULL) {
         if (uv->snapshot_put_retry.data != uv) {
             struct uvSnapshotPut *put = uv->snapshot_put_retry.data;
@@ -0,0 +1,396 @@
+#include <stdatomic.h>
+#include <string.h>
+
+#include "../include/raft/uv.h"
+#include "assert.h"
+#include "err.h"
+#include "legacy.h"
+#include "request.h"
+
+/* Submissions from other threads are pushed onto a lock-free stack: producers
+ * link the new request to the current head and swap it in with a
+ * compare-and-swap, while the loop thread takes the whole stack at once by
+ * exchanging the head with NULL, and reverses it to restore the submission
+ * order. Since the consumer never pops single items, the stack is not subject
+ * to the ABA problem.
+ *
+ * Only the producer that finds the stack empty wakes up the loop thread: the
+ * others know that a wakeup is already pending and that their request will be
+ * taken along with the ones before it.
+ *
+ * Completion queues use the same stack, with a mutex and a condition variable
+ * only used to let the consumer sleep while the stack is empty. */
+
+/* Lock-free stack of requests. */
+struct uvStack
+{
+    _Atomic(struct raft_uv_submit *) head;
+};
+
+struct uvQueue
+{
+    struct raft_uv_queue *queue;     /* Interface object */
+    struct raft *raft;               /* Target raft instance */
+    struct uvStack submitted;        /* Submitted requests */
+    struct uv_async_s async;         /* Wake up the loop thread */
+    struct raft_entry *entries;      /* Entries of the batch */
+    struct request **reqs;           /* Requests of the batch */
+    unsigned cap;                    /* Capacity of the arrays */
+    raft_uv_queue_close_cb close_cb; /* Invoked once closed */
+    atomic_bool closing;             /* Whether close has started */
+};
+
+struct uvCompletion
+{
+    struct uvStack completed; /* Completed requests */
+    uv_mutex_t mutex;         /* Serialize sleeping and waking */
+    uv_cond_t cond;           /* Signaled when not empty */
+};
+
+/* Push a request onto the given stack, returning true if it was empty. */
+static bool uvStackPush(struct uvStack *s, struct raft_uv_submit *req)
+{
+    struct raft_uv_submit *next;
+
+    next = atomic_load_explicit(&s->head, memory_order_relaxed);
+    do {
+        req->next = next;
+    } while (!atomic_compare_exchange_weak_explicit(
+        &s->head, &next, req, memory_order_release, memory_order_relaxed));
+
+    return next == NULL;
+}
+
+/* Take all requests off the given stack, in the order they were pushed. */
+static struct raft_uv_submit *uvStackTake(struct uvStack *s)
+{
+    struct raft_uv_submit *req;
+    struct raft_uv_submit *prev = NULL;
+
+    req = atomic_exchange_explicit(&s->head, NULL, memory_order_acquire);
+    while (req != NULL) {
+        struct raft_uv_submit *next = req->next;
+        req->next = prev;
+        prev = req;
+        req = next;
+    }
+
+    return prev;
+}
+
+/* Fire the callback of a completed request, or hand it to the thread running
+ * its completion queue. */
+static void uvSubmitDone(struct raft_uv_submit *req, int status, void *result)
+{
+    struct uvCompletion *c;
+
+    if (req->completion == NULL) {
+        req->cb(req, status, result);
+        return;
+    }
+
+    req->status = status;
+    req->result = result;
+    c = req->completion->impl;
+    if (uvStackPush(&c->completed, req)) {
+        uv_mutex_lock(&c->mutex);
+        uv_cond_signal(&c->cond);
+        uv_mutex_unlock(&c->mutex);
+    }
+}
+
+static void uvSubmitApplyCb(struct raft_apply *apply, int status, void *result)
+{
+    uvSubmitDone(apply->data, status, result);
+}
+
+static void uvSubmitBarrierCb(struct raft_barrier *barrier, int status)
+{
+    uvSubmitDone(barrier->data, status, NULL);
+}
+
+/* Fail all the given requests, releasing their buffers. */
+static void uvQueueFail(struct raft_uv_submit *req, int status)
+{
+    while (req != NULL) {
+        struct raft_uv_submit *next = req->next;
+        raft_free(req->buf.base);
+        uvSubmitDone(req, status, NULL);
+        req = next;
+    }
+}
+
+/* Allocate the payloads of the barriers in the given list of requests. This is
+ * done on the loop thread, so that a failure is reported like any other. */
+static int uvQueueAllocBarriers(struct raft_uv_submit *req)
+{
+    for (; req != NULL; req = req->next) {
+        if (req->req.apply.type != RAFT_BARRIER) {
+            continue;
+        }
+        req->buf.len = 8;
+        req->buf.base = raft_calloc(1, req->buf.len);
+        if (req->buf.base == NULL) {
+            return RAFT_NOMEM;
+        }
+    }
+    return 0;
+}
+
+/* Make room for a batch of n entries. */
+static int uvQueueGrow(struct uvQueue *q, unsigned n)
+{
+    struct raft_entry *entries;
+    struct request **reqs;
+    unsigned cap = q->cap == 0 ? 16 : q->cap;
+
+    if (n <= q->cap) {
+        return 0;
+    }
+    while (cap < n) {
+        cap *= 2;
+    }
+
+    entries = raft_realloc(q->entries, cap * sizeof *entries);
+    if (entries == NULL) {
+        return RAFT_NOMEM;
+    }
+    q->entries = entries;
+
+    reqs = raft_realloc(q->reqs, cap * sizeof *reqs);
+    if (reqs == NULL) {
+        return RAFT_NOMEM;
+    }
+    q->reqs = reqs;
+
+    q->cap = cap;
+
+    return 0;
+}
+
+/* Append all requests submitted so far with a single RAFT_SUBMIT event. */
+static void uvQueueAsyncCb(uv_async_t *async)
+{
+    struct uvQueue *q = async->data;
+    struct raft_uv_submit *head;
+    struct raft_uv_submit *req;
+    unsigned n = 0;
+    unsigned i;
+    int rv;
+
+    head = uvStackTake(&q->submitted);
+    for (req = head; req != NULL; req = req->next) {
+        n++;
+    }
+    if (n == 0) {
+        return;
+    }
+
+    rv = uvQueueGrow(q, n);
+    if (rv == 0) {
+        rv = uvQueueAllocBarriers(head);
+    }
+    if (rv != 0) {
+        uvQueueFail(head, rv);
+        return;
+    }
+
+    for (req = head, i = 0; req != NULL; req = req->next, i++) {
+        struct raft_entry *entry = &q->entries[i];
+        entry->type = req->req.apply.type;
+        entry->buf = req->buf;
+        q->reqs[i] = (struct request *)&req->req;
+    }
+
+    rv = LegacySubmit(q->raft, q->entries, q->reqs, n);
+    if (rv != 0) {
+        uvQueueFail(head, rv);
+    }
+}
+
+int raft_uv_queue_init(struct raft_uv_queue *queue,
+                       struct uv_loop_s *loop,
+                       struct raft *r)
+{
+    struct uvQueue *q;
+    void *data = queue->data;
+    int rv;
+
+    assert(loop != NULL);
+    assert(r != NULL);
+
+    memset(queue, 0, sizeof *queue);
+    queue->data = data;
+
+    q = raft_malloc(sizeof *q);
+    if (q == NULL) {
+        ErrMsgOom(queue->errmsg);
+        return RAFT_NOMEM;
+    }
+    q->queue = queue;
+    q->raft = r;
+    atomic_init(&q->submitted.head, NULL);
+    q->entries = NULL;
+    q->reqs = NULL;
+    q->cap = 0;
+    q->close_cb = NULL;
+    atomic_init(&q->closing, false);
+
+    rv = uv_async_init(loop, &q->async, uvQueueAsyncCb);
+    if (rv != 0) {
+        ErrMsgPrintf(queue->errmsg, "uv_async_init: %s", uv_strerror(rv));
+        raft_free(q);
+        return RAFT_IOERR;
+    }
+    q->async.data = q;
+
+    queue->impl = q;
+
+    return 0;
+}
+
+static void uvQueueAsyncCloseCb(uv_handle_t *handle)
+{
+    struct uvQueue *q = handle->data;
+    struct raft_uv_queue *queue = q->queue;
+    raft_uv_queue_close_cb cb = q->close_cb;
+
+    raft_free(q->reqs);
+    raft_free(q->entries);
+    raft_free(q);
+    queue->impl = NULL;
+
+    if (cb != NULL) {
+        cb(queue);
+    }
+}
+
+void raft_uv_queue_close(struct raft_uv_queue *queue, raft_uv_queue_close_cb cb)
+{
+    struct uvQueue *q = queue->impl;
+
+    atomic_store(&q->closing, true);
+    uvQueueFail(uvStackTake(&q->submitted), RAFT_CANCELED);
+
+    q->close_cb = cb;
+    uv_close((uv_handle_t *)&q->async, uvQueueAsyncCloseCb);
+}
+
+static void uvQueuePush(struct raft_uv_queue *queue,
+                        struct raft_uv_submit *req,
+                        struct raft_uv_completion *completion,
+                        raft_uv_submit_cb cb)
+{
+    struct uvQueue *q = queue->impl;
+
+    /* Pushing concurrently with raft_uv_queue_close() is a use-after-free,
+     * this only catches pushes that start too late. */
+    assert(!atomic_load_explicit(&q->closing, memory_order_relaxed));
+
+    req->cb = cb;
+    req->completion = completion;
+    req->queue = queue;
+
+    if (uvStackPush(&q->submitted, req)) {
+        uv_async_send(&q->async);
+    }
+}
+
+void raft_uv_queue_apply(struct raft_uv_queue *queue,
+                         struct raft_uv_submit *req,
+                         const struct raft_buffer *buf,
+                         struct raft_uv_completion *completion,
+                         raft_uv_submit_cb cb)
+{
+    req->req.apply.data = req;
+    req->req.apply.type = RAFT_COMMAND;
+    req->req.apply.cb = uvSubmitApplyCb;
+    req->buf = *buf;
+    uvQueuePush(queue, req, completion, cb);
+}
+
+void raft_uv_queue_barrier(struct raft_uv_queue *queue,
+                           struct raft_uv_submit *req,
+                           struct raft_uv_completion *completion,
+                           raft_uv_submit_cb cb)
+{
+    req->req.barrier.data = req;
+    req->req.barrier.type = RAFT_BARRIER;
+    req->req.barrier.cb = uvSubmitBarrierCb;
+    /* Allocated by the loop thread, see uvQueueAllocBarriers(). */
+    req->buf.base = NULL;
+    req->buf.len = 0;
+    uvQueuePush(queue, req, completion, cb);
+}
+
+int raft_uv_completion_init(struct raft_uv_completion *completion)
+{
+    struct uvCompletion *c;
+    int rv;
+
+    c = raft_malloc(sizeof *c);
+    if (c == NULL) {
+        return RAFT_NOMEM;
+    }
+    atomic_init(&c->completed.head, NULL);
+
+    rv = uv_mutex_init(&c->mutex);
+    if (rv != 0) {
+        goto err_after_alloc;
+    }
+    rv = uv_cond_init(&c->cond);
+    if (rv != 0) {
+        goto err_after_mutex_init;
+    }
+
+    completion->impl = c;
+
+    return 0;
+
+err_after_mutex_init:
+    uv_mutex_destroy(&c->mutex);
+err_after_alloc:
+    raft_free(c);
+    return RAFT_NOMEM;
+}
+
+void raft_uv_completion_close(struct raft_uv_completion *completion)
+{
+    struct uvCompletion *c = completion->impl;
+
+    assert(atomic_load(&c->completed.head) == NULL);
+
+    uv_cond_destroy(&c->cond);
+    uv_mutex_destroy(&c->mutex);
+    raft_free(c);
+    completion->impl = NULL;
+}
+
+unsigned raft_uv_completion_run(struct raft_uv_completion *completion,
+                                bool wait)
+{
+    struct uvCompletion *c = completion->impl;
+    struct raft_uv_submit *req;
+    unsigned n = 0;
+
+    /* The producer signals after pushing onto an empty stack while holding
+     * the mutex, so checking the head with the mutex held can't miss it. */
+    if (wait) {
+        uv_mutex_lock(&c->mutex);
+        while (atomic_load_explicit(&c->completed.head,
+                                    memory_order_relaxed) == NULL) {
+            uv_cond_wait(&c->cond, &c->mutex);
+        }
+        uv_mutex_unlock(&c->mutex);
+    }
+
+    req = uvStackTake(&c->completed);
+    while (req != NULL) {
+        struct raft_uv_submit *next = req->next;
+        req->cb(req, req->status, req->result);
+        n++;
+        req = next;
+    }
+
+    return n;
+}
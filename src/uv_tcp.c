@@ -56,8 +56,36 @@ void UvTcpMaybeFireCloseCb(struct UvTcp *t)
     }
 }
 
-int raft_uv_tcp_init(struct raft_uv_transport *transport,
-                     struct uv_loop_s *loop)
+int UvTcpStreamInit(struct UvTcp *t, struct uv_stream_s **stream)
+{
+    struct uv_tcp_s *tcp;
+    struct uv_pipe_s *pipe;
+    int rv;
+
+    if (t->family == AF_UNIX) {
+        pipe = RaftHeapMalloc(sizeof *pipe);
+        if (pipe == NULL) {
+            return RAFT_NOMEM;
+        }
+        rv = uv_pipe_init(t->loop, pipe, 0);
+        assert(rv == 0);
+        *stream = (struct uv_stream_s *)pipe;
+        return 0;
+    }
+
+    tcp = RaftHeapMalloc(sizeof *tcp);
+    if (tcp == NULL) {
+        return RAFT_NOMEM;
+    }
+    rv = uv_tcp_init(t->loop, tcp);
+    assert(rv == 0);
+    *stream = (struct uv_stream_s *)tcp;
+    return 0;
+}
+
+static int uvTcpTransportInit(struct raft_uv_transport *transport,
+                              struct uv_loop_s *loop,
+                              int family)
 {
     struct UvTcp *t;
     void *data = transport->data;
@@ -77,6 +105,7 @@ int raft_uv_tcp_init(struct raft_uv_transport *transport,
     }
     t->transport = transport;
     t->loop = loop;
+    t->family = family;
     t->id = 0;
     t->address = NULL;
     t->bind_address = NULL;
@@ -98,6 +127,18 @@ int raft_uv_tcp_init(struct raft_uv_transport *transport,
     return 0;
 }
 
+int raft_uv_tcp_init(struct raft_uv_transport *transport,
+                     struct uv_loop_s *loop)
+{
+    return uvTcpTransportInit(transport, loop, AF_INET);
+}
+
+int raft_uv_unix_init(struct raft_uv_transport *transport,
+                      struct uv_loop_s *loop)
+{
+    return uvTcpTransportInit(transport, loop, AF_UNIX);
+}
+
 void raft_uv_tcp_close(struct raft_uv_transport *transport)
 {
     struct UvTcp *t = transport->impl;
@@ -113,10 +154,12 @@ int raft_uv_tcp_set_bind_address(struct raft_uv_transport *transport,
     char service[NI_MAXSERV];
     int rv;
 
-    rv = uvIpAddrSplit(address, hostname, sizeof(hostname), service,
-                       sizeof(service));
-    if (rv != 0) {
-        return RAFT_INVALID;
+    if (t->family == AF_INET) {
+        rv = uvIpAddrSplit(address, hostname, sizeof(hostname), service,
+                           sizeof(service));
+        if (rv != 0) {
+            return RAFT_INVALID;
+        }
     }
 
     t->bind_address = raft_malloc(strlen(address) + 1);
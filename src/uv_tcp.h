@@ -7,14 +7,24 @@
 /* Protocol version. */
 #define UV__TCP_HANDSHAKE_PROTOCOL 1
 
+/* Maximum length of a Unix socket path, including the terminating null byte. */
+#define UV__UNIX_PATH_MAX 108
+
+/* Listener socket, either bound to an IP address or to a Unix socket path. */
+union UvTcpListener {
+    struct uv_tcp_s tcp;
+    struct uv_pipe_s pipe;
+};
+
 struct UvTcp
 {
     struct raft_uv_transport *transport; /* Interface object we implement */
     struct uv_loop_s *loop;              /* Event loop */
     raft_id id;                          /* ID of this raft server */
     const char *address;                 /* Address of this raft server */
+    int family;                          /* Either AF_INET or AF_UNIX */
     unsigned n_listeners;                /* Number of listener sockets */
-    struct uv_tcp_s *listeners;          /* Listener sockets */
+    union UvTcpListener *listeners;      /* Listener sockets */
     raft_uv_accept_cb accept_cb;         /* Call after accepting a connection */
     queue accepting;                     /* Connections being accepted */
     queue connecting;                    /* Pending connection requests */
@@ -40,6 +50,10 @@ int UvTcpConnect(struct raft_uv_transport *transport,
 /* Abort all pending connection requests. */
 void UvTcpConnectClose(struct UvTcp *t);
 
+/* Allocate and initialize a stream handle for a new connection, either a TCP
+ * or a pipe handle, depending on the transport's address family. */
+int UvTcpStreamInit(struct UvTcp *t, struct uv_stream_s **stream);
+
 /* Fire the transport close callback if the transport is closing and there's no
  * more pending callback. */
 void UvTcpMaybeFireCloseCb(struct UvTcp *t);
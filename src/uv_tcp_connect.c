@@ -29,6 +29,10 @@
  *
  * - Either the TCP connect or the write request fails: close the TCP handle and
  *   fire the request callback with RAFT_NOCONNECTION.
+ *
+ * Transports created with raft_uv_unix_init() follow the same path, except that
+ * they use a pipe handle connected to a Unix socket path and skip the name
+ * resolution step.
  */
 
 /* Hold state for a single connection request. */
@@ -37,7 +41,7 @@ struct uvTcpConnect
     struct UvTcp *t;                     /* Transport implementation */
     struct raft_uv_connect *req;         /* User request */
     uv_buf_t handshake;                  /* Handshake data */
-    struct uv_tcp_s *tcp;                /* TCP connection socket handle */
+    struct uv_stream_s *stream;          /* Connection socket handle */
     struct uv_getaddrinfo_s getaddrinfo; /* DNS resolve request */
     const struct addrinfo *ai_current; /* The current sockaddr to connect to */
     struct uv_connect_s connect;       /* TCP connection request */
@@ -76,7 +80,7 @@ static int uvTcpEncodeHandshake(raft_id id, const char *address, uv_buf_t *buf)
  * callback. */
 static void uvTcpConnectFinish(struct uvTcpConnect *connect)
 {
-    struct uv_stream_s *stream = (struct uv_stream_s *)connect->tcp;
+    struct uv_stream_s *stream = connect->stream;
     struct raft_uv_connect *req = connect->req;
     int status = connect->status;
     QUEUE_REMOVE(&connect->queue);
@@ -93,9 +97,9 @@ static void uvTcpConnectUvCloseCb(struct uv_handle_s *handle)
     struct uvTcpConnect *connect = handle->data;
     struct UvTcp *t = connect->t;
     assert(connect->status != 0);
-    assert(handle == (struct uv_handle_s *)connect->tcp);
-    RaftHeapFree(connect->tcp);
-    connect->tcp = NULL;
+    assert(handle == (struct uv_handle_s *)connect->stream);
+    RaftHeapFree(connect->stream);
+    connect->stream = NULL;
     uvTcpConnectFinish(connect);
     UvTcpMaybeFireCloseCb(t);
 }
@@ -105,11 +109,13 @@ static void uvTcpConnectAbort(struct uvTcpConnect *connect)
 {
     QUEUE_REMOVE(&connect->queue);
     QUEUE_PUSH(&connect->t->aborting, &connect->queue);
-    uv_cancel((struct uv_req_s *)&connect->getaddrinfo);
+    if (connect->resolving) {
+        uv_cancel((struct uv_req_s *)&connect->getaddrinfo);
+    }
     /* If there is no getaddrinfo request in flight, close the TCP handle now
      * (otherwise it will be closed after the getaddrinfo request completes). */
     if (!connect->resolving && !connect->retry) {
-        uv_close((struct uv_handle_s *)connect->tcp, uvTcpConnectUvCloseCb);
+        uv_close((struct uv_handle_s *)connect->stream, uvTcpConnectUvCloseCb);
     }
 }
 
@@ -153,7 +159,7 @@ static void uvTcpTryNextConnectCb(struct uv_handle_s *handle)
         uvTcpConnectUvCloseCb(handle);
         return;
     }
-    rv = uv_tcp_init(t->loop, connect->tcp);
+    rv = uv_tcp_init(t->loop, (struct uv_tcp_s *)connect->stream);
     assert(rv == 0);
     uvTcpAsyncConnect(connect);
 }
@@ -172,13 +178,16 @@ static void uvTcpConnectUvConnectCb(struct uv_connect_s *req, int status)
 
     if (status != 0) {
         assert(status != UV_ECANCELED); /* t->closing would have been true */
-        connect->ai_current = connect->ai_current->ai_next;
+        if (connect->ai_current != NULL) {
+            connect->ai_current = connect->ai_current->ai_next;
+        }
         if (connect->ai_current) {
             /* For the next connect attempt we need to close the tcp handle. */
             /* To avoid interference with aborting we set a flag to indicate the
              * connect attempt */
             connect->retry = true;
-            uv_close((struct uv_handle_s *)connect->tcp, uvTcpTryNextConnectCb);
+            uv_close((struct uv_handle_s *)connect->stream,
+                     uvTcpTryNextConnectCb);
             return;
         }
         connect->status = RAFT_NOCONNECTION;
@@ -187,8 +196,8 @@ static void uvTcpConnectUvConnectCb(struct uv_connect_s *req, int status)
         goto err;
     }
 
-    rv = uv_write(&connect->write, (struct uv_stream_s *)connect->tcp,
-                  &connect->handshake, 1, uvTcpConnectUvWriteCb);
+    rv = uv_write(&connect->write, connect->stream, &connect->handshake, 1,
+                  uvTcpConnectUvWriteCb);
     if (rv != 0) {
         /* UNTESTED: what are the error conditions? perhaps ENOMEM */
         connect->status = RAFT_NOCONNECTION;
@@ -205,7 +214,7 @@ err:
 static void uvTcpAsyncConnect(struct uvTcpConnect *connect)
 {
     int rv;
-    rv = uv_tcp_connect(&connect->connect, connect->tcp,
+    rv = uv_tcp_connect(&connect->connect, (struct uv_tcp_s *)connect->stream,
                         connect->ai_current->ai_addr, uvTcpConnectUvConnectCb);
     if (rv != 0) {
         /* UNTESTED: since parsing succeed, this should fail only because of
@@ -232,7 +241,7 @@ static void uvTcpConnectGetAddrInfoCb(uv_getaddrinfo_t *req,
         connect->status = RAFT_CANCELED;
 
         /* We need to close the tcp handle to abort connection attempt */
-        uv_close((struct uv_handle_s *)connect->tcp, uvTcpConnectUvCloseCb);
+        uv_close((struct uv_handle_s *)connect->stream, uvTcpConnectUvCloseCb);
         return;
     }
 
@@ -247,6 +256,74 @@ static void uvTcpConnectGetAddrInfoCb(uv_getaddrinfo_t *req,
     uvTcpAsyncConnect(connect);
 }
 
+/* Submit a connection request for the given Unix socket path. Paths starting
+ * with '@' are names in the Linux abstract namespace. */
+static int uvTcpPipeConnect(struct uvTcpConnect *r, const char *path)
+{
+    struct uv_pipe_s *pipe = (struct uv_pipe_s *)r->stream;
+    size_t len = strlen(path);
+    if (path[0] != '@') {
+        if (len >= UV__UNIX_PATH_MAX) {
+            return UV_ENAMETOOLONG;
+        }
+        uv_pipe_connect(&r->connect, pipe, path, uvTcpConnectUvConnectCb);
+        return 0;
+    }
+#if UV_VERSION_HEX >= 0x012e00
+    {
+        char name[UV__UNIX_PATH_MAX];
+        if (len > sizeof name) {
+            return UV_ENAMETOOLONG;
+        }
+        memcpy(name, path, len);
+        name[0] = '\0';
+        return uv_pipe_connect2(&r->connect, pipe, name, len, 0,
+                                uvTcpConnectUvConnectCb);
+    }
+#else
+    return UV_ENOTSUP;
+#endif
+}
+
+/* Create a new pipe handle and submit a connection request to the event loop.
+ * There's no name resolution step: the address is the socket path itself. */
+static int uvTcpConnectStartPath(struct uvTcpConnect *r, const char *address)
+{
+    struct UvTcp *t = r->t;
+    int rv;
+
+    rv = uvTcpEncodeHandshake(t->id, t->address, &r->handshake);
+    if (rv != 0) {
+        assert(rv == RAFT_NOMEM);
+        ErrMsgOom(t->transport->errmsg);
+        goto err;
+    }
+
+    rv = UvTcpStreamInit(t, &r->stream);
+    if (rv != 0) {
+        ErrMsgOom(t->transport->errmsg);
+        goto err_after_encode_handshake;
+    }
+    r->stream->data = r;
+
+    rv = uvTcpPipeConnect(r, address);
+    if (rv != 0) {
+        ErrMsgPrintf(t->transport->errmsg, "uv_pipe_connect(): %s",
+                     uv_strerror(rv));
+        rv = RAFT_NOCONNECTION;
+        goto err_after_stream_init;
+    }
+
+    return 0;
+
+err_after_stream_init:
+    uv_close((uv_handle_t *)r->stream, (uv_close_cb)RaftHeapFree);
+err_after_encode_handshake:
+    RaftHeapFree(r->handshake.base);
+err:
+    return rv;
+}
+
 /* Create a new TCP handle and submit a connection request to the event loop. */
 static int uvTcpConnectStart(struct uvTcpConnect *r, const char *address)
 {
@@ -277,16 +354,12 @@ static int uvTcpConnectStart(struct uvTcpConnect *r, const char *address)
         goto err;
     }
 
-    r->tcp = RaftHeapMalloc(sizeof *r->tcp);
-    if (r->tcp == NULL) {
+    rv = UvTcpStreamInit(t, &r->stream);
+    if (rv != 0) {
         ErrMsgOom(t->transport->errmsg);
-        rv = RAFT_NOMEM;
         goto err_after_encode_handshake;
     }
-
-    rv = uv_tcp_init(r->t->loop, r->tcp);
-    assert(rv == 0);
-    r->tcp->data = r;
+    r->stream->data = r;
 
     rv = uv_getaddrinfo(r->t->loop, &r->getaddrinfo, &uvTcpConnectGetAddrInfoCb,
                         hostname, service, &hints);
@@ -302,7 +375,7 @@ static int uvTcpConnectStart(struct uvTcpConnect *r, const char *address)
     return 0;
 
 err_after_tcp_init:
-    uv_close((uv_handle_t *)r->tcp, (uv_close_cb)RaftHeapFree);
+    uv_close((uv_handle_t *)r->stream, (uv_close_cb)RaftHeapFree);
 err_after_encode_handshake:
     RaftHeapFree(r->handshake.base);
 err:
@@ -333,6 +406,8 @@ int UvTcpConnect(struct raft_uv_transport *transport,
     r->status = 0;
     r->write.data = r;
     r->getaddrinfo.data = r;
+    r->getaddrinfo.addrinfo = NULL;
+    r->ai_current = NULL;
     r->resolving = false;
     r->retry = false;
     r->connect.data = r;
@@ -342,7 +417,11 @@ int UvTcpConnect(struct raft_uv_transport *transport,
     QUEUE_PUSH(&t->connecting, &r->queue);
 
     /* Start connecting */
-    rv = uvTcpConnectStart(r, address);
+    if (t->family == AF_UNIX) {
+        rv = uvTcpConnectStartPath(r, address);
+    } else {
+        rv = uvTcpConnectStart(r, address);
+    }
     if (rv != 0) {
         goto err_after_alloc;
     }
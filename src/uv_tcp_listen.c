@@ -22,6 +22,9 @@
  *   by calling tcp_accept_stop(): the incoming TCP connection handle gets
  *   closed, preventing any further handshake data notification, and all
  *   allocated memory gets released in the handle close callback.
+ *
+ * Transports created with raft_uv_unix_init() have a single listener pipe
+ * handle bound to the socket path, and accept pipe handles instead of TCP ones.
  */
 
 /* Hold state for a connection being accepted. */
@@ -35,9 +38,9 @@ struct uvTcpHandshake
 /* Hold handshake data for a new connection being established. */
 struct uvTcpIncoming
 {
-    struct UvTcp *t;           /* Transport implementation */
-    struct uv_tcp_s *listener; /* The tcp handle, which accepted this socket */
-    struct uv_tcp_s *tcp;      /* TCP connection socket handle */
+    struct UvTcp *t;                 /* Transport implementation */
+    struct uv_stream_s *listener;    /* The handle which accepted this socket */
+    struct uv_stream_s *stream;      /* Connection socket handle */
     struct uvTcpHandshake handshake; /* Handshake data */
     queue queue;                     /* Pending accept queue */
 };
@@ -72,7 +75,7 @@ static void uvTcpIncomingCloseCb(struct uv_handle_s *handle)
     if (incoming->handshake.address.base != NULL) {
         RaftHeapFree(incoming->handshake.address.base);
     }
-    RaftHeapFree(incoming->tcp);
+    RaftHeapFree(incoming->stream);
     RaftHeapFree(incoming);
     UvTcpMaybeFireCloseCb(t);
 }
@@ -85,7 +88,7 @@ static void uvTcpIncomingAbort(struct uvTcpIncoming *incoming)
      * read_cb will be called. */
     QUEUE_REMOVE(&incoming->queue);
     QUEUE_PUSH(&t->aborting, &incoming->queue);
-    uv_close((struct uv_handle_s *)incoming->tcp, uvTcpIncomingCloseCb);
+    uv_close((struct uv_handle_s *)incoming->stream, uvTcpIncomingCloseCb);
 }
 
 /* Read the address part of the handshake. */
@@ -142,7 +145,7 @@ static void uvTcpIncomingReadCbAddress(uv_stream_t *stream,
     address = incoming->handshake.address.base;
     QUEUE_REMOVE(&incoming->queue);
     incoming->t->accept_cb(incoming->t->transport, id, address,
-                           (struct uv_stream_s *)incoming->tcp);
+                           incoming->stream);
     RaftHeapFree(incoming->handshake.address.base);
     RaftHeapFree(incoming);
 }
@@ -201,8 +204,8 @@ static void uvTcpIncomingReadCbPreamble(uv_stream_t *stream,
 
     rv = uv_read_stop(stream);
     assert(rv == 0);
-    rv = uv_read_start((uv_stream_t *)incoming->tcp,
-                       uvTcpIncomingAllocCbAddress, uvTcpIncomingReadCbAddress);
+    rv = uv_read_start(incoming->stream, uvTcpIncomingAllocCbAddress,
+                       uvTcpIncomingReadCbAddress);
     assert(rv == 0);
 }
 
@@ -213,30 +216,25 @@ static int uvTcpIncomingStart(struct uvTcpIncoming *incoming)
 
     memset(&incoming->handshake, 0, sizeof incoming->handshake);
 
-    incoming->tcp = RaftHeapMalloc(sizeof *incoming->tcp);
-    if (incoming->tcp == NULL) {
-        return RAFT_NOMEM;
+    rv = UvTcpStreamInit(incoming->t, &incoming->stream);
+    if (rv != 0) {
+        return rv;
     }
-    incoming->tcp->data = incoming;
+    incoming->stream->data = incoming;
 
-    rv = uv_tcp_init(incoming->t->loop, incoming->tcp);
-    assert(rv == 0);
-
-    rv = uv_accept((struct uv_stream_s *)incoming->listener,
-                   (struct uv_stream_s *)incoming->tcp);
+    rv = uv_accept(incoming->listener, incoming->stream);
     if (rv != 0) {
         rv = RAFT_IOERR;
         goto err_after_tcp_init;
     }
-    rv = uv_read_start((uv_stream_t *)incoming->tcp,
-                       uvTcpIncomingAllocCbPreamble,
+    rv = uv_read_start(incoming->stream, uvTcpIncomingAllocCbPreamble,
                        uvTcpIncomingReadCbPreamble);
     assert(rv == 0);
 
     return 0;
 
 err_after_tcp_init:
-    uv_close((uv_handle_t *)incoming->tcp, (uv_close_cb)RaftHeapFree);
+    uv_close((uv_handle_t *)incoming->stream, (uv_close_cb)RaftHeapFree);
     return rv;
 }
 
@@ -266,8 +264,8 @@ static void uvTcpListenCb(struct uv_stream_s *stream, int status)
         goto err;
     }
     incoming->t = t;
-    incoming->listener = (struct uv_tcp_s *)stream;
-    incoming->tcp = NULL;
+    incoming->listener = stream;
+    incoming->stream = NULL;
 
     QUEUE_PUSH(&t->accepting, &incoming->queue);
 
@@ -320,7 +318,7 @@ static int uvTcpListenOnMultipleIP(struct raft_uv_transport *transport,
 
     t->n_listeners = n_listeners;
     for (n_listeners = 0; n_listeners < t->n_listeners; ++n_listeners) {
-        struct uv_tcp_s *listener = &t->listeners[n_listeners];
+        struct uv_tcp_s *listener = &t->listeners[n_listeners].tcp;
         listener->data = t;
         if (uv_tcp_init(t->loop, listener) ||
             uvTcpBindListen(listener, current->ai_addr)) {
@@ -361,6 +359,61 @@ static bool uvIsAddressDuplication(struct addrinfo *addr_info)
     return true;
 }
 
+/* Bind the given pipe handle to a Unix socket path. Paths starting with '@'
+ * are names in the Linux abstract namespace. */
+static int uvTcpPipeBind(struct uv_pipe_s *pipe, const char *path)
+{
+    size_t len = strlen(path);
+    if (path[0] != '@') {
+        if (len >= UV__UNIX_PATH_MAX) {
+            return UV_ENAMETOOLONG;
+        }
+        return uv_pipe_bind(pipe, path);
+    }
+#if UV_VERSION_HEX >= 0x012e00
+    {
+        char name[UV__UNIX_PATH_MAX];
+        if (len > sizeof name) {
+            return UV_ENAMETOOLONG;
+        }
+        memcpy(name, path, len);
+        name[0] = '\0';
+        return uv_pipe_bind2(pipe, name, len, 0);
+    }
+#else
+    return UV_ENOTSUP;
+#endif
+}
+
+/* Create a pipe handle and do bind/listen on the Unix socket path */
+static int uvTcpListenOnPath(struct UvTcp *t, const char *path)
+{
+    struct uv_pipe_s *listener;
+    int rv;
+
+    t->listeners = raft_malloc(sizeof *t->listeners);
+    if (t->listeners == NULL) {
+        return RAFT_NOMEM;
+    }
+    t->n_listeners = 1;
+
+    listener = &t->listeners[0].pipe;
+    listener->data = t;
+    rv = uv_pipe_init(t->loop, listener, 0);
+    assert(rv == 0);
+    if (uvTcpPipeBind(listener, path) ||
+        uv_listen((uv_stream_t *)listener, 1, uvTcpListenCb)) {
+        /* The listener is the first and only item of the array, so the whole
+         * array is released by the close callback. */
+        uv_close((struct uv_handle_s *)listener, (uv_close_cb)raft_free);
+        t->listeners = NULL;
+        t->n_listeners = 0;
+        return RAFT_IOERR;
+    }
+
+    return 0;
+}
+
 int UvTcpListen(struct raft_uv_transport *transport, raft_uv_accept_cb cb)
 {
     struct UvTcp *t;
@@ -370,6 +423,11 @@ int UvTcpListen(struct raft_uv_transport *transport, raft_uv_accept_cb cb)
     t = transport->impl;
     t->accept_cb = cb;
 
+    if (t->family == AF_UNIX) {
+        return uvTcpListenOnPath(
+            t, t->bind_address != NULL ? t->bind_address : t->address);
+    }
+
     if (t->bind_address == NULL) {
         rv = uvIpResolveBindAddresses(t->address, &addr_infos);
     } else {
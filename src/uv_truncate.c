@@ -34,6 +34,11 @@ static void uvTruncateWorkCb(uv_work_t *work)
     char errmsg[RAFT_ERRMSG_BUF_SIZE];
     int rv;
 
+    /* Entries read back from disk past the truncation point are now stale.
+     * Clear the cache again once done, so that reads overlapping with the
+     * changes below fail instead of caching what they saw. */
+    UvReadCacheClear(uv);
+
     /* Load all segments on disk. */
     rv = UvList(uv, &snapshots, &n_snapshots, &segments, &n_segments, errmsg);
     if (rv != 0) {
@@ -58,27 +63,39 @@ static void uvTruncateWorkCb(uv_work_t *work)
     }
     assert(i < n_segments);
 
-    /* If the truncate index is not the first of the segment, we need to
-     * truncate it. */
-    if (truncate->index > segment->first_index) {
-        rv = uvSegmentTruncate(uv, segment, truncate->index);
+    /* Remove all closed segments past the one containing the truncate index,
+     * starting from the last one, so that a crash in the middle leaves a
+     * shorter but contiguous log. */
+    for (j = n_segments; j > i + 1; j--) {
+        segment = &segments[j - 1];
+        if (segment->is_open) {
+            continue;
+        }
+        rv = UvFsRemoveFile(uv->dir, segment->filename, errmsg);
         if (rv != 0) {
+            tracef("unlink segment %s: %s", segment->filename, errmsg);
+            rv = RAFT_IOERR;
             goto err_after_list;
         }
+        uvSegmentIndexRemove(uv, segment->first_index, segment->end_index);
     }
 
-    /* Remove all closed segments past the one containing the truncate index. */
-    for (j = i; j < n_segments; j++) {
-        segment = &segments[j];
-        if (segment->is_open) {
-            continue;
+    /* If the truncate index is not the first of the segment, we need to
+     * truncate it, otherwise we remove it entirely. */
+    segment = &segments[i];
+    if (truncate->index > segment->first_index) {
+        rv = uvSegmentTruncate(uv, segment, truncate->index);
+        if (rv != 0) {
+            goto err_after_list;
         }
+    } else {
         rv = UvFsRemoveFile(uv->dir, segment->filename, errmsg);
         if (rv != 0) {
             tracef("unlink segment %s: %s", segment->filename, errmsg);
             rv = RAFT_IOERR;
             goto err_after_list;
         }
+        uvSegmentIndexRemove(uv, segment->first_index, segment->end_index);
     }
     rv = UvFsSyncDir(uv->dir, errmsg);
     if (rv != 0) {
@@ -88,6 +105,7 @@ static void uvTruncateWorkCb(uv_work_t *work)
     }
 
     RaftHeapFree(segments);
+    UvReadCacheClear(uv);
     truncate->status = 0;
 
     tracef("uv truncate work cb ok");
@@ -97,6 +115,7 @@ err_after_list:
     RaftHeapFree(segments);
 err:
     assert(rv != 0);
+    UvReadCacheClear(uv);
     truncate->status = rv;
 }
 
@@ -14,30 +14,32 @@
 struct fixture
 {
     FIXTURE_HEAP;
-    struct raft_fsm fsms[N_SERVERS];
+    struct raft_fsm fsms[RAFT_FIXTURE_MAX_SERVERS];
     struct raft_fixture fixture;
 };
 
-static void *setUp(const MunitParameter params[], MUNIT_UNUSED void *user_data)
+/* Create a fixture with @n voting servers. */
+static struct fixture *setUpServers(const MunitParameter params[],
+                                    unsigned n)
 {
     struct fixture *f = munit_calloc(1, sizeof *f);
     struct raft_configuration configuration;
     unsigned i;
     int rc;
     SET_UP_HEAP;
-    for (i = 0; i < N_SERVERS; i++) {
+    for (i = 0; i < RAFT_FIXTURE_MAX_SERVERS; i++) {
         FsmInit(&f->fsms[i], 2);
     }
 
     rc = raft_fixture_init(&f->fixture);
     munit_assert_int(rc, ==, 0);
 
-    for (i = 0; i < N_SERVERS; i++) {
+    for (i = 0; i < n; i++) {
         rc = raft_fixture_grow(&f->fixture, &f->fsms[i]);
         munit_assert_int(rc, ==, 0);
     }
 
-    rc = raft_fixture_configuration(&f->fixture, N_SERVERS, &configuration);
+    rc = raft_fixture_configuration(&f->fixture, n, &configuration);
     munit_assert_int(rc, ==, 0);
 
     rc = raft_fixture_bootstrap(&f->fixture, &configuration);
@@ -51,12 +53,23 @@ static void *setUp(const MunitParameter params[], MUNIT_UNUSED void *user_data)
     return f;
 }
 
+static void *setUp(const MunitParameter params[], MUNIT_UNUSED void *user_data)
+{
+    return setUpServers(params, N_SERVERS);
+}
+
+static void *setUpMax(const MunitParameter params[],
+                      MUNIT_UNUSED void *user_data)
+{
+    return setUpServers(params, RAFT_FIXTURE_MAX_SERVERS);
+}
+
 static void tearDown(void *data)
 {
     struct fixture *f = data;
     unsigned i;
     raft_fixture_close(&f->fixture);
-    for (i = 0; i < N_SERVERS; i++) {
+    for (i = 0; i < RAFT_FIXTURE_MAX_SERVERS; i++) {
         FsmClose(&f->fsms[i]);
     }
     TEAR_DOWN_HEAP;
@@ -304,3 +317,155 @@ TEST(raft_fixture_step_until_applied, two, setUp, tearDown, 0, NULL)
     free(req2);
     return MUNIT_OK;
 }
+
+/* Entries keep being applied while the leader compacts its log. */
+TEST(raft_fixture_step_until_applied, snapshot, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    struct raft_apply reqs[10];
+    unsigned i;
+    for (i = 0; i < N_SERVERS; i++) {
+        raft_set_snapshot_threshold(GET(i), 3);
+        raft_set_snapshot_trailing(GET(i), 1);
+    }
+    ELECT(0);
+    for (i = 0; i < 10; i++) {
+        APPLY(0, &reqs[i]);
+        STEP_UNTIL_APPLIED(i + 2);
+    }
+    ASSERT_FSM_X(0, 10);
+    ASSERT_FSM_X(1, 10);
+    ASSERT_FSM_X(2, 10);
+    return MUNIT_OK;
+}
+
+/******************************************************************************
+ *
+ * raft_fixture_grow
+ *
+ *****************************************************************************/
+
+SUITE(raft_fixture_grow)
+
+/* A cluster can have up to RAFT_FIXTURE_MAX_SERVERS voters. */
+TEST(raft_fixture_grow, max, setUpMax, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    struct raft_apply *req = munit_malloc(sizeof *req);
+    unsigned i;
+    bool done;
+    munit_assert_uint(raft_fixture_n(&f->fixture), ==,
+                      RAFT_FIXTURE_MAX_SERVERS);
+    ELECT(0);
+    APPLY(0, req);
+    done = raft_fixture_step_until_applied(
+        &f->fixture, RAFT_FIXTURE_MAX_SERVERS, 2, 2000);
+    munit_assert_true(done);
+    for (i = 0; i < RAFT_FIXTURE_MAX_SERVERS; i++) {
+        ASSERT_FSM_X(i, 1);
+    }
+    free(req);
+    return MUNIT_OK;
+}
+
+/******************************************************************************
+ *
+ * raft_fixture_set_bandwidth
+ *
+ *****************************************************************************/
+
+SUITE(raft_fixture_set_bandwidth)
+
+/* Return true if the server with the index in @arg has received at least one
+ * AppendEntries message. */
+static bool hasReceivedAppendEntries(struct raft_fixture *f, void *arg)
+{
+    unsigned *i = arg;
+    return raft_fixture_n_recv(f, *i, RAFT_APPEND_ENTRIES) > 0;
+}
+
+/* Messages take a time proportional to their size to be sent before the
+ * network latency starts to elapse. */
+TEST(raft_fixture_set_bandwidth, serialization, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    bool done;
+    raft_fixture_set_bandwidth(&f->fixture, 0, 1, 1);
+    STEP_UNTIL_STATE_IS(0, RAFT_CANDIDATE);
+    ASSERT_TIME(1000);
+
+    /* The 64 bytes RequestVote message is sent in 64 milliseconds. */
+    done = raft_fixture_step_until_term_is(&f->fixture, 1, 2, 100);
+    munit_assert_true(done);
+    ASSERT_TIME(1000 + 64 + 15);
+
+    /* The unlimited link to server 2 is not affected. */
+    munit_assert_int(raft_fixture_n_recv(&f->fixture, 2, RAFT_REQUEST_VOTE), ==,
+                     1);
+    return MUNIT_OK;
+}
+
+/* Messages sent through a link with limited bandwidth are queued. */
+TEST(raft_fixture_set_bandwidth, queue, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    unsigned i = 1;
+    bool done;
+    raft_fixture_set_bandwidth(&f->fixture, 0, 1, 1);
+    STEP_UNTIL_STATE_IS(0, RAFT_CANDIDATE);
+
+    /* Server 0 wins the election with the vote of server 2, at 1030, and
+     * sends a heartbeat to server 1, which gets queued behind the RequestVote
+     * message, whose sending completes at 1064. */
+    done = raft_fixture_step_until(&f->fixture, hasReceivedAppendEntries, &i,
+                                   200);
+    munit_assert_true(done);
+    ASSERT_TIME(1064 + 64 + 15);
+    return MUNIT_OK;
+}
+
+/******************************************************************************
+ *
+ * raft_fixture_set_jitter
+ *
+ *****************************************************************************/
+
+SUITE(raft_fixture_set_jitter)
+
+/* A random delay is added to the network latency. */
+TEST(raft_fixture_set_jitter, delay, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    bool done;
+    raft_fixture_set_jitter(&f->fixture, 0, 1, 50);
+    STEP_UNTIL_STATE_IS(0, RAFT_CANDIDATE);
+    done = raft_fixture_step_until_term_is(&f->fixture, 1, 2, 100);
+    munit_assert_true(done);
+    munit_assert_ullong(raft_fixture_time(&f->fixture), >=, 1000 + 15);
+    munit_assert_ullong(raft_fixture_time(&f->fixture), <=, 1000 + 15 + 50);
+    return MUNIT_OK;
+}
+
+/******************************************************************************
+ *
+ * raft_fixture_set_loss
+ *
+ *****************************************************************************/
+
+SUITE(raft_fixture_set_loss)
+
+/* Messages sent through a link with 100% loss are never delivered. */
+TEST(raft_fixture_set_loss, all, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    raft_fixture_set_loss(&f->fixture, 0, 1, 100);
+    STEP_UNTIL_STATE_IS(0, RAFT_CANDIDATE);
+    raft_fixture_step_until_elapsed(&f->fixture, 50);
+    munit_assert_int(raft_fixture_n_send(&f->fixture, 0, RAFT_REQUEST_VOTE),
+                     ==, 2);
+    munit_assert_int(raft_fixture_n_recv(&f->fixture, 1, RAFT_REQUEST_VOTE),
+                     ==, 0);
+    munit_assert_int(raft_fixture_n_recv(&f->fixture, 2, RAFT_REQUEST_VOTE),
+                     ==, 1);
+    return MUNIT_OK;
+}
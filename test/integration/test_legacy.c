@@ -1,3 +1,4 @@
+#include "../../src/log.h"
 #include "../lib/legacy.h"
 #include "../lib/runner.h"
 
@@ -6,6 +7,12 @@ struct fixture
     FIXTURE_CLUSTER;
 };
 
+struct result
+{
+    int status;
+    bool done;
+};
+
 SUITE(legacy)
 
 static void *setUp(const MunitParameter params[], MUNIT_UNUSED void *user_data)
@@ -133,6 +140,328 @@ TEST(legacy, snapshotBlocksCandidate, setUp, tearDown, 0, NULL)
     return MUNIT_OK;
 }
 
+static void *setUpApplyAsync(const MunitParameter params[],
+                             MUNIT_UNUSED void *user_data)
+{
+    struct fixture *f = munit_malloc(sizeof *f);
+    unsigned j;
+    SETUP_CLUSTER(3);
+    for (j = 0; j < CLUSTER_N; j++) {
+        FsmSetApplyAsync(CLUSTER_FSM(j));
+    }
+    CLUSTER_BOOTSTRAP;
+    CLUSTER_START();
+    CLUSTER_ELECT(0);
+    return f;
+}
+
+static void tearDownApplyAsync(void *data)
+{
+    struct fixture *f = data;
+    unsigned j;
+    /* Complete all in-flight applies, otherwise raft_close() would wait. */
+    for (j = 0; j < CLUSTER_N; j++) {
+        while (FsmApplyAsyncFlush(CLUSTER_FSM(j)) > 0) {
+        }
+    }
+    TEAR_DOWN_CLUSTER;
+    free(f);
+}
+
+static void applyCbAssertResult(struct raft_apply *req, int status, void *result)
+{
+    struct result *r = req->data;
+    (void)result;
+    munit_assert_int(status, ==, r->status);
+    r->done = true;
+}
+
+/* Committed commands are submitted to the FSM, but last_applied only advances
+ * and the apply callback only fires once the FSM completes them. */
+TEST(legacy, applyAsync, setUpApplyAsync, tearDownApplyAsync, 0, NULL)
+{
+    struct fixture *f = data;
+    struct raft_apply req;
+    struct result result = {0, false};
+    raft_index index;
+    (void)params;
+
+    req.data = &result;
+    CLUSTER_APPLY_ADD_X(0, &req, 3, applyCbAssertResult);
+    index = req.index;
+    CLUSTER_STEP_UNTIL_ELAPSED(200);
+
+    munit_assert_ullong(raft_commit_index(CLUSTER_RAFT(0)), >=, index);
+    munit_assert_ullong(CLUSTER_LAST_APPLIED(0), ==, index - 1);
+    munit_assert_uint(FsmApplyAsyncPending(CLUSTER_FSM(0)), ==, 1);
+    munit_assert_int(FsmGetX(CLUSTER_FSM(0)), ==, 0);
+    munit_assert_false(result.done);
+
+    munit_assert_uint(FsmApplyAsyncFlush(CLUSTER_FSM(0)), ==, 1);
+    munit_assert_ullong(CLUSTER_LAST_APPLIED(0), ==, index);
+    munit_assert_int(FsmGetX(CLUSTER_FSM(0)), ==, 3);
+    CLUSTER_STEP;
+    munit_assert_true(result.done);
+
+    /* Followers apply too, once their FSMs complete. */
+    munit_assert_uint(FsmApplyAsyncFlush(CLUSTER_FSM(1)), ==, 1);
+    munit_assert_int(FsmGetX(CLUSTER_FSM(1)), ==, 3);
+
+    return MUNIT_OK;
+}
+
+/* Snapshots are not taken while applies are in flight. */
+TEST(legacy,
+     applyAsyncDefersSnapshot,
+     setUpApplyAsync,
+     tearDownApplyAsync,
+     0,
+     NULL)
+{
+    struct fixture *f = data;
+    struct raft_apply reqs[3];
+    unsigned j;
+    (void)params;
+
+    SET_SNAPSHOT_THRESHOLD(3);
+    SET_SNAPSHOT_TRAILING(1);
+
+    for (j = 0; j < 3; j++) {
+        CLUSTER_APPLY_ADD_X(0, &reqs[j], 1, NULL);
+    }
+    CLUSTER_STEP_UNTIL_ELAPSED(200);
+    munit_assert_uint(FsmApplyAsyncPending(CLUSTER_FSM(0)), ==, 3);
+    munit_assert_ullong(CLUSTER_RAFT(0)->legacy.log->snapshot.last_index, ==, 0);
+
+    FsmApplyAsyncFlush(CLUSTER_FSM(0));
+    munit_assert_int(FsmGetX(CLUSTER_FSM(0)), ==, 3);
+    CLUSTER_STEP_UNTIL_ELAPSED(200);
+    munit_assert_ullong(CLUSTER_RAFT(0)->legacy.log->snapshot.last_index, ==,
+                        reqs[2].index);
+
+    return MUNIT_OK;
+}
+
+static void *setUpApplyAsyncImmediate(const MunitParameter params[],
+                                      MUNIT_UNUSED void *user_data)
+{
+    struct fixture *f = munit_malloc(sizeof *f);
+    unsigned j;
+    SETUP_CLUSTER(3);
+    for (j = 0; j < CLUSTER_N; j++) {
+        FsmSetApplyAsyncImmediate(CLUSTER_FSM(j));
+    }
+    CLUSTER_BOOTSTRAP;
+    CLUSTER_START();
+    CLUSTER_ELECT(0);
+    return f;
+}
+
+/* The FSM may complete asynchronous applies before apply_async() returns. */
+TEST(legacy,
+     applyAsyncImmediate,
+     setUpApplyAsyncImmediate,
+     tearDownApplyAsync,
+     0,
+     NULL)
+{
+    struct fixture *f = data;
+    struct raft_apply reqs[3];
+    struct result results[3] = {{0, false}, {0, false}, {0, false}};
+    struct raft_barrier barrier;
+    unsigned j;
+    int rv;
+    (void)params;
+
+    SET_SNAPSHOT_THRESHOLD(3);
+    SET_SNAPSHOT_TRAILING(1);
+
+    for (j = 0; j < 3; j++) {
+        reqs[j].data = &results[j];
+        CLUSTER_APPLY_ADD_X(0, &reqs[j], 1, applyCbAssertResult);
+    }
+    rv = raft_barrier(CLUSTER_RAFT(0), &barrier, NULL);
+    munit_assert_int(rv, ==, 0);
+    CLUSTER_STEP_UNTIL_APPLIED(CLUSTER_N, barrier.index, 2000);
+
+    for (j = 0; j < CLUSTER_N; j++) {
+        munit_assert_int(FsmGetX(CLUSTER_FSM(j)), ==, 3);
+        munit_assert_uint(CLUSTER_RAFT(j)->legacy.applying, ==, 0);
+    }
+    CLUSTER_STEP;
+    for (j = 0; j < 3; j++) {
+        munit_assert_true(results[j].done);
+    }
+    munit_assert_ullong(CLUSTER_RAFT(0)->legacy.log->snapshot.last_index, >=,
+                        reqs[2].index);
+
+    return MUNIT_OK;
+}
+
+/* A leader that keeps fewer trailing entries in memory than on disk reads the
+ * missing ones back from disk to catch up a lagging follower, instead of
+ * sending it a snapshot. */
+TEST(legacy, catchUpFromDisk, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    raft_index index;
+    unsigned j;
+    (void)params;
+
+    SET_SNAPSHOT_THRESHOLD(3);
+    SET_SNAPSHOT_TRAILING(100);
+    for (j = 0; j < CLUSTER_N; j++) {
+        raft_set_snapshot_trailing_in_memory(CLUSTER_RAFT(j), 1);
+    }
+
+    /* Server 2 falls behind, without disrupting the cluster. */
+    raft_fixture_set_randomized_election_timeout(&f->cluster, 2, 10000);
+    raft_set_election_timeout(CLUSTER_RAFT(2), 10000);
+    CLUSTER_DISCONNECT(0, 2);
+    CLUSTER_DISCONNECT(2, 0);
+    for (j = 0; j < 6; j++) {
+        CLUSTER_MAKE_PROGRESS;
+    }
+    index = CLUSTER_RAFT(0)->last_applied;
+
+    /* The leader took a snapshot and dropped from memory the entries that
+     * server 2 is missing. */
+    munit_assert_ullong(CLUSTER_RAFT(0)->legacy.log->offset, >,
+                        CLUSTER_RAFT(2)->last_applied + 1);
+
+    CLUSTER_RECONNECT(0, 2);
+    CLUSTER_RECONNECT(2, 0);
+    CLUSTER_STEP_UNTIL_APPLIED(2, index, 5000);
+    munit_assert_int(CLUSTER_N_SEND(0, RAFT_INSTALL_SNAPSHOT), ==, 0);
+
+    return MUNIT_OK;
+}
+
+/* Original I/O methods and callbacks wrapped by the failing ones below. */
+static struct
+{
+    int (*read)(struct raft_io *io,
+                struct raft_io_read *req,
+                raft_index index,
+                unsigned n,
+                raft_io_read_cb cb);
+    int (*snapshot_get)(struct raft_io *io,
+                        struct raft_io_snapshot_get *req,
+                        raft_io_snapshot_get_cb cb);
+    raft_io_read_cb read_cb;
+    raft_io_snapshot_get_cb snapshot_get_cb;
+    unsigned n_snapshot_get_failures;
+} faulty;
+
+static void ioReadFailCb(struct raft_io_read *req,
+                         struct raft_entry entries[],
+                         unsigned n,
+                         int status)
+{
+    void *batch = NULL;
+    unsigned i;
+    if (status == 0) {
+        for (i = 0; i < n; i++) {
+            if (entries[i].batch != batch) {
+                batch = entries[i].batch;
+                raft_free(batch);
+            }
+        }
+        raft_free(entries);
+    }
+    faulty.read_cb(req, NULL, 0, RAFT_IOERR);
+}
+
+/* Read entries as usual, but report a failure once done. */
+static int ioMethodReadFail(struct raft_io *io,
+                            struct raft_io_read *req,
+                            raft_index index,
+                            unsigned n,
+                            raft_io_read_cb cb)
+{
+    faulty.read_cb = cb;
+    return faulty.read(io, req, index, n, ioReadFailCb);
+}
+
+static void ioSnapshotGetFailCb(struct raft_io_snapshot_get *req,
+                                struct raft_snapshot *snapshot,
+                                int status)
+{
+    unsigned i;
+    if (status == 0) {
+        raft_configuration_close(&snapshot->configuration);
+        for (i = 0; i < snapshot->n_bufs; i++) {
+            raft_free(snapshot->bufs[i].base);
+        }
+        raft_free(snapshot->bufs);
+        raft_free(snapshot);
+    }
+    faulty.n_snapshot_get_failures++;
+    faulty.snapshot_get_cb(req, NULL, RAFT_IOERR);
+}
+
+/* Load the snapshot as usual, but report a failure once done. */
+static int ioMethodSnapshotGetFail(struct raft_io *io,
+                                   struct raft_io_snapshot_get *req,
+                                   raft_io_snapshot_get_cb cb)
+{
+    faulty.snapshot_get_cb = cb;
+    return faulty.snapshot_get(io, req, ioSnapshotGetFailCb);
+}
+
+static bool snapshotGetFailed(struct raft_fixture *f, void *arg)
+{
+    (void)f;
+    (void)arg;
+    return faulty.n_snapshot_get_failures > 0;
+}
+
+/* If the entries can't be read back from disk and the snapshot sent instead
+ * can't be loaded either, the message is dropped and the follower is caught
+ * up later. */
+TEST(legacy, catchUpFromDiskSnapshotGetFail, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    struct raft_io *io = CLUSTER_RAFT(0)->io;
+    raft_index index;
+    unsigned j;
+    bool failed;
+    (void)params;
+
+    SET_SNAPSHOT_THRESHOLD(3);
+    SET_SNAPSHOT_TRAILING(100);
+    for (j = 0; j < CLUSTER_N; j++) {
+        raft_set_snapshot_trailing_in_memory(CLUSTER_RAFT(j), 1);
+    }
+
+    raft_fixture_set_randomized_election_timeout(&f->cluster, 2, 10000);
+    raft_set_election_timeout(CLUSTER_RAFT(2), 10000);
+    CLUSTER_DISCONNECT(0, 2);
+    CLUSTER_DISCONNECT(2, 0);
+    for (j = 0; j < 6; j++) {
+        CLUSTER_MAKE_PROGRESS;
+    }
+    index = CLUSTER_RAFT(0)->last_applied;
+
+    memset(&faulty, 0, sizeof faulty);
+    faulty.read = io->read;
+    faulty.snapshot_get = io->snapshot_get;
+    io->read = ioMethodReadFail;
+    io->snapshot_get = ioMethodSnapshotGetFail;
+
+    CLUSTER_RECONNECT(0, 2);
+    CLUSTER_RECONNECT(2, 0);
+    failed =
+        raft_fixture_step_until(&f->cluster, snapshotGetFailed, NULL, 5000);
+    munit_assert_true(failed);
+
+    io->read = faulty.read;
+    io->snapshot_get = faulty.snapshot_get;
+    CLUSTER_STEP_UNTIL_APPLIED(2, index, 5000);
+
+    return MUNIT_OK;
+}
+
 static void *setUpReplication(const MunitParameter params[],
                               MUNIT_UNUSED void *user_data)
 {
@@ -313,12 +642,6 @@ static void tearDownAssign(void *data)
     free(f);
 }
 
-struct result
-{
-    int status;
-    bool done;
-};
-
 static void changeCbAssertResult(struct raft_change *req, int status)
 {
     struct result *result = req->data;
@@ -0,0 +1,376 @@
+#include "../../include/raft.h"
+#include "../lib/fsm.h"
+#include "../lib/heap.h"
+#include "../lib/runner.h"
+
+/******************************************************************************
+ *
+ * Minimal raft_io implementation which never allocates memory, so that all
+ * allocations performed while handling events can be attributed to raft.
+ *
+ *****************************************************************************/
+
+#define STUB_MAX_SENDS 16
+
+struct stub
+{
+    raft_time time;
+    raft_io_tick_cb tick;
+    raft_io_recv_cb recv;
+    struct raft_io_send *sends[STUB_MAX_SENDS];
+    struct raft_message messages[STUB_MAX_SENDS];
+    unsigned n_sends;
+    struct raft_io_append *append;
+};
+
+static int stubInit(struct raft_io *io, raft_id id, const char *address)
+{
+    (void)io;
+    (void)id;
+    (void)address;
+    return 0;
+}
+
+static void stubClose(struct raft_io *io, raft_io_close_cb cb)
+{
+    if (cb != NULL) {
+        cb(io);
+    }
+}
+
+/* Load a log containing a single configuration entry, where server 1 is the
+ * only voter and server 2 is a stand-by. */
+static int stubLoad(struct raft_io *io,
+                    raft_term *term,
+                    raft_id *voted_for,
+                    struct raft_snapshot **snapshot,
+                    raft_index *start_index,
+                    struct raft_entry **entries,
+                    size_t *n_entries)
+{
+    struct raft_configuration configuration;
+    int rv;
+    (void)io;
+
+    raft_configuration_init(&configuration);
+    rv = raft_configuration_add(&configuration, 1, "1", RAFT_VOTER);
+    munit_assert_int(rv, ==, 0);
+    rv = raft_configuration_add(&configuration, 2, "2", RAFT_STANDBY);
+    munit_assert_int(rv, ==, 0);
+
+    *entries = raft_malloc(sizeof **entries);
+    munit_assert_ptr_not_null(*entries);
+    (*entries)[0].term = 1;
+    (*entries)[0].type = RAFT_CHANGE;
+    rv = raft_configuration_encode(&configuration, &(*entries)[0].buf);
+    munit_assert_int(rv, ==, 0);
+    (*entries)[0].batch = (*entries)[0].buf.base;
+    raft_configuration_close(&configuration);
+
+    *term = 1;
+    *voted_for = 0;
+    *snapshot = NULL;
+    *start_index = 1;
+    *n_entries = 1;
+
+    return 0;
+}
+
+static int stubStart(struct raft_io *io,
+                     unsigned msecs,
+                     raft_io_tick_cb tick,
+                     raft_io_recv_cb recv)
+{
+    struct stub *s = io->impl;
+    (void)msecs;
+    s->tick = tick;
+    s->recv = recv;
+    return 0;
+}
+
+static int stubSetTerm(struct raft_io *io, raft_term term)
+{
+    (void)io;
+    (void)term;
+    return 0;
+}
+
+static int stubSetVote(struct raft_io *io, raft_id server_id)
+{
+    (void)io;
+    (void)server_id;
+    return 0;
+}
+
+static int stubSend(struct raft_io *io,
+                    struct raft_io_send *req,
+                    const struct raft_message *message,
+                    raft_io_send_cb cb)
+{
+    struct stub *s = io->impl;
+    munit_assert_uint(s->n_sends, <, STUB_MAX_SENDS);
+    req->cb = cb;
+    s->sends[s->n_sends] = req;
+    s->messages[s->n_sends] = *message;
+    s->n_sends++;
+    return 0;
+}
+
+static int stubAppend(struct raft_io *io,
+                      struct raft_io_append *req,
+                      const struct raft_entry entries[],
+                      unsigned n,
+                      raft_io_append_cb cb)
+{
+    struct stub *s = io->impl;
+    (void)entries;
+    (void)n;
+    munit_assert_ptr_null(s->append);
+    req->cb = cb;
+    s->append = req;
+    return 0;
+}
+
+static int stubTruncate(struct raft_io *io, raft_index index)
+{
+    (void)io;
+    (void)index;
+    return 0;
+}
+
+static raft_time stubTime(struct raft_io *io)
+{
+    struct stub *s = io->impl;
+    return s->time;
+}
+
+static int stubRandom(struct raft_io *io, int min, int max)
+{
+    (void)io;
+    (void)max;
+    return min;
+}
+
+/* Complete all pending requests. Whenever server 1 sent an AppendEntries
+ * message to server 2, deliver back a successful result. */
+static void stubFlush(struct raft_io *io)
+{
+    struct stub *s = io->impl;
+    struct raft_io_append *append = s->append;
+    unsigned n = s->n_sends;
+    unsigned j;
+
+    if (append != NULL) {
+        s->append = NULL;
+        append->cb(append, 0);
+    }
+
+    s->n_sends = 0;
+    for (j = 0; j < n; j++) {
+        struct raft_message *message = &s->messages[j];
+        struct raft_message result;
+        s->sends[j]->cb(s->sends[j], 0);
+        if (message->type != RAFT_APPEND_ENTRIES) {
+            continue;
+        }
+        result.type = RAFT_APPEND_ENTRIES_RESULT;
+        result.server_id = 2;
+        result.server_address = "2";
+        result.append_entries_result.version = 1;
+        result.append_entries_result.term = message->append_entries.term;
+        result.append_entries_result.rejected = 0;
+        result.append_entries_result.last_log_index =
+            message->append_entries.prev_log_index +
+            message->append_entries.n_entries;
+        result.append_entries_result.features = 0;
+        result.append_entries_result.capacity = 0;
+        s->recv(io, &result);
+    }
+}
+
+/* Advance the time by the given amount of milliseconds and fire a tick. */
+static void stubTick(struct raft_io *io, unsigned msecs)
+{
+    struct stub *s = io->impl;
+    s->time += msecs;
+    s->tick(io);
+}
+
+/******************************************************************************
+ *
+ * Heap wrapping the test one, counting the number of allocations.
+ *
+ *****************************************************************************/
+
+struct counter
+{
+    struct raft_heap heap;
+    struct raft_heap *wrapped;
+    unsigned n;
+};
+
+static void *counterMalloc(void *data, size_t size)
+{
+    struct counter *c = data;
+    c->n++;
+    return c->wrapped->malloc(c->wrapped->data, size);
+}
+
+static void counterFree(void *data, void *ptr)
+{
+    struct counter *c = data;
+    c->wrapped->free(c->wrapped->data, ptr);
+}
+
+static void *counterCalloc(void *data, size_t nmemb, size_t size)
+{
+    struct counter *c = data;
+    c->n++;
+    return c->wrapped->calloc(c->wrapped->data, nmemb, size);
+}
+
+static void *counterRealloc(void *data, void *ptr, size_t size)
+{
+    struct counter *c = data;
+    c->n++;
+    return c->wrapped->realloc(c->wrapped->data, ptr, size);
+}
+
+static void *counterAlignedAlloc(void *data, size_t alignment, size_t size)
+{
+    struct counter *c = data;
+    c->n++;
+    return c->wrapped->aligned_alloc(c->wrapped->data, alignment, size);
+}
+
+static void counterAlignedFree(void *data, size_t alignment, void *ptr)
+{
+    struct counter *c = data;
+    c->wrapped->aligned_free(c->wrapped->data, alignment, ptr);
+}
+
+static void counterInstall(struct counter *c, struct raft_heap *wrapped)
+{
+    c->heap.data = c;
+    c->heap.malloc = counterMalloc;
+    c->heap.free = counterFree;
+    c->heap.calloc = counterCalloc;
+    c->heap.realloc = counterRealloc;
+    c->heap.aligned_alloc = counterAlignedAlloc;
+    c->heap.aligned_free = counterAlignedFree;
+    c->wrapped = wrapped;
+    c->n = 0;
+    raft_heap_set(&c->heap);
+}
+
+/******************************************************************************
+ *
+ * Fixture
+ *
+ *****************************************************************************/
+
+struct fixture
+{
+    FIXTURE_HEAP;
+    struct stub stub;
+    struct raft_io io;
+    struct raft_fsm fsm;
+    struct raft raft;
+};
+
+static void *setUp(const MunitParameter params[], MUNIT_UNUSED void *user_data)
+{
+    struct fixture *f = munit_malloc(sizeof *f);
+    int rv;
+
+    SET_UP_HEAP;
+
+    memset(&f->stub, 0, sizeof f->stub);
+    memset(&f->io, 0, sizeof f->io);
+    f->io.version = 2;
+    f->io.impl = &f->stub;
+    f->io.init = stubInit;
+    f->io.close = stubClose;
+    f->io.load = stubLoad;
+    f->io.start = stubStart;
+    f->io.set_term = stubSetTerm;
+    f->io.set_vote = stubSetVote;
+    f->io.send = stubSend;
+    f->io.append = stubAppend;
+    f->io.truncate = stubTruncate;
+    f->io.time = stubTime;
+    f->io.random = stubRandom;
+
+    FsmInit(&f->fsm, 2);
+
+    rv = raft_init(&f->raft, &f->io, &f->fsm, 1, "1");
+    munit_assert_int(rv, ==, 0);
+    rv = raft_start(&f->raft);
+    munit_assert_int(rv, ==, 0);
+
+    return f;
+}
+
+static void tearDown(void *data)
+{
+    struct fixture *f = data;
+    stubFlush(&f->io);
+    raft_close(&f->raft, NULL);
+    FsmClose(&f->fsm);
+    TEAR_DOWN_HEAP;
+    free(f);
+}
+
+/* Keep ticking and flushing until server 1 becomes leader. */
+#define ELECT                                                         \
+    do {                                                              \
+        unsigned _j;                                                  \
+        for (_j = 0; _j < 100; _j++) {                                \
+            if (raft_state(&f->raft) == RAFT_LEADER) {                \
+                break;                                                \
+            }                                                         \
+            stubTick(&f->io, f->raft.heartbeat_timeout);              \
+            stubFlush(&f->io);                                        \
+        }                                                             \
+        munit_assert_int(raft_state(&f->raft), ==, RAFT_LEADER);      \
+    } while (0)
+
+/******************************************************************************
+ *
+ * Event dispatch in the v0.x compatibility layer
+ *
+ *****************************************************************************/
+
+SUITE(legacy_dispatch)
+
+/* Once warmed up, handling ticks, sending heartbeats and receiving their
+ * results does not allocate any memory. */
+TEST(legacy_dispatch, steadyStateNoAlloc, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    struct counter counter;
+    unsigned n_sent = 0;
+    unsigned j;
+    (void)params;
+
+    ELECT;
+
+    /* Warm up the reusable buffers. */
+    for (j = 0; j < 3; j++) {
+        stubTick(&f->io, f->raft.heartbeat_timeout);
+        stubFlush(&f->io);
+    }
+
+    counterInstall(&counter, &f->heap);
+    for (j = 0; j < 10; j++) {
+        stubTick(&f->io, f->raft.heartbeat_timeout);
+        n_sent += f->stub.n_sends;
+        stubFlush(&f->io);
+    }
+    raft_heap_set(&f->heap);
+
+    munit_assert_uint(n_sent, >=, 10);
+    munit_assert_uint(counter.n, ==, 0);
+
+    return MUNIT_OK;
+}
@@ -0,0 +1,221 @@
+#include <limits.h>
+
+#include "../lib/cluster.h"
+#include "../lib/runner.h"
+
+struct fixture
+{
+    FIXTURE_CLUSTER;
+};
+
+static void *setUp(const MunitParameter params[], MUNIT_UNUSED void *user_data)
+{
+    struct fixture *f = munit_malloc(sizeof *f);
+    SETUP_CLUSTER();
+    return f;
+}
+
+static void tearDown(void *data)
+{
+    struct fixture *f = data;
+    TEAR_DOWN_CLUSTER();
+    free(f);
+}
+
+SUITE(quiescence)
+
+/* Start a cluster of 2 voters with quiescence enabled on the given servers,
+ * let server 1 become leader and send its first pipelined heartbeat. */
+static void startCluster(struct fixture *f, bool quiescence1, bool quiescence2)
+{
+    unsigned id;
+
+    raft_set_quiescence(CLUSTER_RAFT(1), quiescence1);
+    raft_set_quiescence(CLUSTER_RAFT(2), quiescence2);
+
+    for (id = 1; id <= 2; id++) {
+        CLUSTER_SET_TERM(id, 1 /* term */);
+        CLUSTER_ADD_ENTRY(id, RAFT_CHANGE, 2 /* servers */, 2 /* voters */);
+        CLUSTER_START(id);
+    }
+
+    CLUSTER_TRACE(
+        "[   0] 1 > term 1, 1 entry (1^1)\n"
+        "[   0] 2 > term 1, 1 entry (1^1)\n"
+        "[ 100] 1 > timeout as follower\n"
+        "           convert to candidate, start election for term 2\n"
+        "[ 110] 2 > recv request vote from server 1\n"
+        "           remote term is higher (2 vs 1) -> bump term\n"
+        "           remote log is equal (1^1) -> grant vote\n"
+        "[ 120] 1 > recv request vote result from server 2\n"
+        "           quorum reached with 2 votes out of 2 -> convert to leader\n"
+        "           probe server 2 sending a heartbeat (no entries)\n"
+        "[ 130] 2 > recv append entries from server 1\n"
+        "           no new entries to persist\n"
+        "[ 140] 1 > recv append entries result from server 2\n"
+        "[ 170] 1 > timeout as leader\n"
+        "           pipeline server 2 sending a heartbeat (no entries)\n");
+}
+
+/* Once all followers are caught up, the leader asks them to quiesce with its
+ * next heartbeat. After they confirm, no more heartbeats are sent and nobody
+ * times out. */
+TEST(quiescence, Idle, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+
+    startCluster(f, true, true);
+
+    CLUSTER_TRACE(
+        "[ 180] 2 > recv append entries from server 1\n"
+        "           no new entries to persist\n"
+        "           leader is idle -> suspend election timer\n"
+        "[ 190] 1 > recv append entries result from server 2\n"
+        "           all servers are quiescent -> stop heartbeats\n");
+
+    munit_assert_ullong(raft_timeout(CLUSTER_RAFT(1)), ==, ULLONG_MAX);
+    munit_assert_ullong(raft_timeout(CLUSTER_RAFT(2)), ==, ULLONG_MAX);
+
+    /* Nothing happens for a long time. */
+    CLUSTER_ELAPSE(10000);
+    munit_assert_int(raft_state(CLUSTER_RAFT(1)), ==, RAFT_LEADER);
+    munit_assert_int(raft_state(CLUSTER_RAFT(2)), ==, RAFT_FOLLOWER);
+    munit_assert_ullong(raft_current_term(CLUSTER_RAFT(2)), ==, 2);
+
+    return MUNIT_OK;
+}
+
+/* A follower that doesn't have quiescence enabled keeps its election timer
+ * running, so the leader keeps sending heartbeats. */
+TEST(quiescence, FollowerDisabled, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+
+    startCluster(f, true, false);
+
+    CLUSTER_TRACE(
+        "[ 180] 2 > recv append entries from server 1\n"
+        "           no new entries to persist\n"
+        "[ 190] 1 > recv append entries result from server 2\n"
+        "[ 220] 1 > timeout as leader\n"
+        "           pipeline server 2 sending a heartbeat (no entries)\n");
+
+    munit_assert_false(CLUSTER_RAFT(1)->leader_state.quiescent);
+    munit_assert_false(CLUSTER_RAFT(2)->follower_state.quiescent);
+
+    return MUNIT_OK;
+}
+
+/* Submitting a new entry wakes up a quiescent leader, whose followers resume
+ * their election timers when receiving the entry. */
+TEST(quiescence, Submit, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+
+    startCluster(f, true, true);
+
+    CLUSTER_TRACE(
+        "[ 180] 2 > recv append entries from server 1\n"
+        "           no new entries to persist\n"
+        "           leader is idle -> suspend election timer\n"
+        "[ 190] 1 > recv append entries result from server 2\n"
+        "           all servers are quiescent -> stop heartbeats\n");
+
+    CLUSTER_ELAPSE(1000);
+    CLUSTER_SUBMIT(1 /* ID */, COMMAND, 8 /* size */);
+
+    CLUSTER_TRACE(
+        "[1190] 1 > submit 1 new client entry\n"
+        "           replicate 1 new command entry (2^2)\n"
+        "           pipeline server 2 sending 1 entry (2^2)\n"
+        "           leave quiescence -> resume heartbeats\n"
+        "[1200] 1 > persisted 1 entry (2^2)\n"
+        "           next uncommitted entry (2^2) has 1 vote out of 2\n"
+        "[1200] 2 > recv append entries from server 1\n"
+        "           start persisting 1 new entry (2^2)\n"
+        "[1210] 2 > persisted 1 entry (2^2)\n"
+        "           send success result to 1\n"
+        "[1220] 1 > recv append entries result from server 2\n"
+        "           commit 1 new entry (2^2)\n");
+
+    munit_assert_false(CLUSTER_RAFT(1)->leader_state.quiescent);
+    munit_assert_false(CLUSTER_RAFT(2)->follower_state.quiescent);
+    munit_assert_ullong(raft_timeout(CLUSTER_RAFT(1)), <, ULLONG_MAX);
+    munit_assert_ullong(raft_timeout(CLUSTER_RAFT(2)), <, ULLONG_MAX);
+
+    /* Once the entry is committed, the group quiesces again. */
+    CLUSTER_TRACE(
+        "[1240] 1 > timeout as leader\n"
+        "           pipeline server 2 sending a heartbeat (no entries)\n"
+        "[1250] 2 > recv append entries from server 1\n"
+        "           no new entries to persist\n"
+        "           leader is idle -> suspend election timer\n"
+        "[1260] 1 > recv append entries result from server 2\n"
+        "           all servers are quiescent -> stop heartbeats\n");
+
+    return MUNIT_OK;
+}
+
+/* When a quiescent follower loses its connection with the leader, it resumes
+ * its election timer and eventually starts an election. */
+TEST(quiescence, LeaderUnreachable, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+
+    startCluster(f, true, true);
+
+    CLUSTER_TRACE(
+        "[ 180] 2 > recv append entries from server 1\n"
+        "           no new entries to persist\n"
+        "           leader is idle -> suspend election timer\n"
+        "[ 190] 1 > recv append entries result from server 2\n"
+        "           all servers are quiescent -> stop heartbeats\n");
+
+    CLUSTER_ELAPSE(1000);
+    CLUSTER_DISCONNECT(1, 2);
+    CLUSTER_DISCONNECT(2, 1);
+    test_cluster_unreachable(&f->cluster_, 2, 1);
+
+    CLUSTER_TRACE(
+        "[1190] 2 > connection to server 1 was lost\n"
+        "           leader is unreachable -> resume election timer\n"
+        "[1320] 2 > timeout as follower\n"
+        "           convert to candidate, start election for term 3\n");
+
+    return MUNIT_OK;
+}
+
+/* When the leader loses its connection with a quiescent follower, it resumes
+ * sending heartbeats. */
+TEST(quiescence, FollowerUnreachable, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+
+    startCluster(f, true, true);
+
+    CLUSTER_TRACE(
+        "[ 180] 2 > recv append entries from server 1\n"
+        "           no new entries to persist\n"
+        "           leader is idle -> suspend election timer\n"
+        "[ 190] 1 > recv append entries result from server 2\n"
+        "           all servers are quiescent -> stop heartbeats\n");
+
+    CLUSTER_ELAPSE(1000);
+    test_cluster_unreachable(&f->cluster_, 1, 2);
+
+    CLUSTER_TRACE(
+        "[1190] 1 > connection to server 2 was lost\n"
+        "           leave quiescence -> resume heartbeats\n"
+        "[1190] 1 > timeout as leader\n"
+        "           server 2 is unreachable -> abort pipeline\n"
+        "           probe server 2 sending a heartbeat (no entries)\n"
+        "[1200] 2 > recv append entries from server 1\n"
+        "           no new entries to persist\n");
+
+    /* The follower is still there and confirms again that it's quiescent. */
+    CLUSTER_TRACE(
+        "[1210] 1 > recv append entries result from server 2\n"
+        "           all servers are quiescent -> stop heartbeats\n");
+
+    return MUNIT_OK;
+}
@@ -100,6 +100,10 @@ TEST(replication, InitialBarrier, setUp, tearDown, 0, NULL)
     return MUNIT_OK;
 }
 
+/* Feature flags advertised by servers, without and with LZ4 payloads. */
+#define FEATURES 11
+#define FEATURES_LZ4 15
+
 /* After receiving an AppendEntriesResult, a leader has set the feature flags of
  * a node. */
 TEST(replication, FeatureFlags, setUp, tearDown, 0, NULL)
@@ -130,7 +134,7 @@ TEST(replication, FeatureFlags, setUp, tearDown, 0, NULL)
 
     /* Features were already populated via RequestVote result. */
     raft = CLUSTER_RAFT(1);
-    munit_assert_uint(raft->leader_state.progress[1].features, ==, 1);
+    munit_assert_uint(raft->leader_state.progress[1].features, ==, FEATURES);
 
     /* Server 2 receives the heartbeat and replies. When server 1 receives the
      * response, the feature flags are set. */
@@ -139,7 +143,44 @@ TEST(replication, FeatureFlags, setUp, tearDown, 0, NULL)
         "           no new entries to persist\n"
         "[ 140] 1 > recv append entries result from server 2\n");
 
-    munit_assert_uint(raft->leader_state.progress[1].features, ==, 1);
+    munit_assert_uint(raft->leader_state.progress[1].features, ==, FEATURES);
+
+    return MUNIT_OK;
+}
+
+/* A server advertises LZ4-compressed payloads only if told that its backend can
+ * decompress them. */
+TEST(replication, FeatureFlagsCompressedPayloads, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    struct raft *raft;
+    unsigned id;
+
+    /* Bootstrap and start a cluster with 2 voters. */
+    for (id = 1; id <= 2; id++) {
+        CLUSTER_SET_TERM(id, 1 /* term */);
+        CLUSTER_ADD_ENTRY(id, RAFT_CHANGE, 2 /* servers */, 2 /* voters */);
+        CLUSTER_START(id);
+    }
+    raft_set_compressed_payloads(CLUSTER_RAFT(2), true);
+
+    /* Server 1 becomes leader and sends the initial heartbeat. */
+    CLUSTER_TRACE(
+        "[   0] 1 > term 1, 1 entry (1^1)\n"
+        "[   0] 2 > term 1, 1 entry (1^1)\n"
+        "[ 100] 1 > timeout as follower\n"
+        "           convert to candidate, start election for term 2\n"
+        "[ 110] 2 > recv request vote from server 1\n"
+        "           remote term is higher (2 vs 1) -> bump term\n"
+        "           remote log is equal (1^1) -> grant vote\n"
+        "[ 120] 1 > recv request vote result from server 2\n"
+        "           quorum reached with 2 votes out of 2 -> convert to leader\n"
+        "           probe server 2 sending a heartbeat (no entries)\n");
+
+    raft = CLUSTER_RAFT(1);
+    munit_assert_uint(raft->leader_state.progress[0].features, ==, FEATURES);
+    munit_assert_uint(raft->leader_state.progress[1].features, ==,
+                      FEATURES_LZ4);
 
     return MUNIT_OK;
 }
@@ -595,6 +636,65 @@ TEST(replication, PipelineDisconnect, setUp, tearDown, 0, NULL)
     return MUNIT_OK;
 }
 
+/* The I/O backend signals that the connection to a follower in pipeline mode
+ * is congested, and the leader stops pipelining entries to it. */
+TEST(replication, PipelineCongested, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    struct raft *raft;
+    unsigned id;
+
+    /* Bootstrap and start a cluster with 2 voters. */
+    for (id = 1; id <= 2; id++) {
+        CLUSTER_SET_TERM(id, 1 /* term */);
+        CLUSTER_ADD_ENTRY(id, RAFT_CHANGE, 2 /* servers */, 2 /* voters */);
+        CLUSTER_START(id);
+    }
+
+    /* Server 1 becomes leader and then sends a first round of heartbeats,
+     * transitioning server 2 into pipeline mode. */
+    CLUSTER_TRACE(
+        "[   0] 1 > term 1, 1 entry (1^1)\n"
+        "[   0] 2 > term 1, 1 entry (1^1)\n"
+        "[ 100] 1 > timeout as follower\n"
+        "           convert to candidate, start election for term 2\n"
+        "[ 110] 2 > recv request vote from server 1\n"
+        "           remote term is higher (2 vs 1) -> bump term\n"
+        "           remote log is equal (1^1) -> grant vote\n"
+        "[ 120] 1 > recv request vote result from server 2\n"
+        "           quorum reached with 2 votes out of 2 -> convert to leader\n"
+        "           probe server 2 sending a heartbeat (no entries)\n"
+        "[ 130] 2 > recv append entries from server 1\n"
+        "           no new entries to persist\n"
+        "[ 140] 1 > recv append entries result from server 2\n");
+
+    CLUSTER_ELAPSE(10);
+    CLUSTER_SUBMIT(1 /* ID */, COMMAND, 8 /* size */);
+
+    CLUSTER_TRACE(
+        "[ 150] 1 > submit 1 new client entry\n"
+        "           replicate 1 new command entry (2^2)\n"
+        "           pipeline server 2 sending 1 entry (2^2)\n");
+
+    raft = CLUSTER_RAFT(1);
+    munit_assert_ullong(raft->leader_state.progress[1].next_index, ==, 3);
+
+    /* The connection to server 2 can't take more entries, so server 1
+     * transitions it back to probe mode and the next entry is not sent. */
+    test_cluster_congested(&f->cluster_, 1, 2);
+    CLUSTER_SUBMIT(1 /* ID */, COMMAND, 8 /* size */);
+
+    CLUSTER_TRACE(
+        "[ 150] 1 > connection to server 2 is congested\n"
+        "           server 2 is in pipeline mode -> switch to probe\n"
+        "[ 150] 1 > submit 1 new client entry\n"
+        "           replicate 1 new command entry (3^2)\n");
+
+    munit_assert_ullong(raft->leader_state.progress[1].next_index, ==, 2);
+
+    return MUNIT_OK;
+}
+
 /* Receive the same entry a second time, before the first has been persisted. */
 TEST(replication, ReceiveSameEntryTwice, setUp, tearDown, 0, NULL)
 {
@@ -849,6 +949,65 @@ TEST(replication, PrevLogTermMismatch, setUp, tearDown, 0, NULL)
     return MUNIT_OK;
 }
 
+/* If the follower has a divergent tail of entries from an older term, it
+ * reports the conflicting term and the leader skips all entries in that term
+ * at once, instead of probing them one by one. */
+TEST(replication, ConflictTermHint, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    unsigned id;
+    unsigned i;
+
+    /* Bootstrap and start a cluster with 2 voters. Server 1 has 3 entries in
+     * term 3 from index 3 onward, server 2 has 3 entries in term 2. */
+    for (id = 1; id <= 2; id++) {
+        CLUSTER_SET_TERM(id, 3 /* term */);
+        CLUSTER_ADD_ENTRY(id, RAFT_CHANGE, 2 /* servers */, 2 /* voters */);
+        CLUSTER_ADD_ENTRY(id, RAFT_COMMAND, 2 /* term */, 0 /* payload */);
+    }
+    for (i = 0; i < 3; i++) {
+        CLUSTER_ADD_ENTRY(1, RAFT_COMMAND, 3 /* term */, 0 /* payload */);
+        CLUSTER_ADD_ENTRY(2, RAFT_COMMAND, 2 /* term */, 0 /* payload */);
+    }
+    CLUSTER_START(1);
+    CLUSTER_START(2);
+
+    /* Server 1 becomes leader because its last entry has a higher term. */
+    CLUSTER_TRACE(
+        "[   0] 1 > term 3, 5 entries (1^1..5^3)\n"
+        "[   0] 2 > term 3, 5 entries (1^1..5^2)\n"
+        "[ 100] 1 > timeout as follower\n"
+        "           convert to candidate, start election for term 4\n"
+        "[ 110] 2 > recv request vote from server 1\n"
+        "           remote term is higher (4 vs 3) -> bump term\n"
+        "           remote log is more recent (5^3 vs 5^2) -> grant vote\n"
+        "[ 120] 1 > recv request vote result from server 2\n"
+        "           quorum reached with 2 votes out of 2 -> convert to leader\n"
+        "           replicate 1 new barrier entry (6^4)\n"
+        "           probe server 2 sending 1 entry (6^4)\n");
+
+    /* Server 2 rejects the initial AppendEntries request, and server 1 skips
+     * all the entries of term 2 in one go. */
+    CLUSTER_TRACE(
+        "[ 130] 1 > persisted 1 entry (6^4)\n"
+        "           next uncommitted entry (5^3) has 1 vote out of 2\n"
+        "[ 130] 2 > recv append entries from server 1\n"
+        "           previous term mismatch -> reject\n"
+        "[ 140] 1 > recv append entries result from server 2\n"
+        "           skip conflicting term 2 -> next index 3\n"
+        "           log mismatch -> send old entries\n"
+        "           probe server 2 sending 4 entries (3^3..6^4)\n"
+        "[ 150] 2 > recv append entries from server 1\n"
+        "           log mismatch (3^2 vs 3^3) -> truncate\n"
+        "           start persisting 4 new entries (3^3..6^4)\n"
+        "[ 160] 2 > persisted 4 entry (3^3..6^4)\n"
+        "           send success result to 1\n"
+        "[ 170] 1 > recv append entries result from server 2\n"
+        "           commit 5 new entries (2^2..6^4)\n");
+
+    return MUNIT_OK;
+}
+
 /* The follower has an uncommitted log entry that conflicts with a new one sent
  * by the leader (same index but different term). The follower's conflicting log
  * entry happens to be a configuration change. In that case the follower
@@ -0,0 +1,346 @@
+#include "../../include/raft.h"
+#include "../lib/heap.h"
+#include "../lib/runner.h"
+
+/******************************************************************************
+ *
+ * Fixture with a single raft instance, acting as follower of server 1 in a
+ * cluster of two voters, driven directly via raft_step_batch().
+ *
+ *****************************************************************************/
+
+#define MAX_ENTRIES 8
+
+struct fixture
+{
+    FIXTURE_HEAP;
+    struct raft raft;
+    struct raft_message messages[MAX_ENTRIES];
+    struct raft_event events[MAX_ENTRIES];
+    unsigned n;
+    struct raft_update update;
+};
+
+static void *setUp(const MunitParameter params[], MUNIT_UNUSED void *user_data)
+{
+    struct fixture *f = munit_malloc(sizeof *f);
+    struct raft_configuration configuration;
+    struct raft_event event;
+    struct raft_entry *entries;
+    int rv;
+
+    SET_UP_HEAP;
+
+    rv = raft_init(&f->raft, NULL, NULL, 2, "2");
+    munit_assert_int(rv, ==, 0);
+
+    raft_configuration_init(&configuration);
+    rv = raft_configuration_add(&configuration, 1, "1", RAFT_VOTER);
+    munit_assert_int(rv, ==, 0);
+    rv = raft_configuration_add(&configuration, 2, "2", RAFT_VOTER);
+    munit_assert_int(rv, ==, 0);
+
+    entries = raft_malloc(sizeof *entries);
+    munit_assert_ptr_not_null(entries);
+    entries[0].term = 1;
+    entries[0].type = RAFT_CHANGE;
+    rv = raft_configuration_encode(&configuration, &entries[0].buf);
+    munit_assert_int(rv, ==, 0);
+    entries[0].batch = entries[0].buf.base;
+    raft_configuration_close(&configuration);
+
+    event.time = 0;
+    event.capacity = 0;
+    event.type = RAFT_START;
+    event.start.term = 1;
+    event.start.voted_for = 0;
+    event.start.metadata = NULL;
+    event.start.start_index = 1;
+    event.start.entries = entries;
+    event.start.n_entries = 1;
+
+    rv = raft_step(&f->raft, &event, &f->update);
+    munit_assert_int(rv, ==, 0);
+
+    raft_free(entries[0].batch);
+    raft_free(entries);
+
+    f->n = 0;
+
+    return f;
+}
+
+static void tearDown(void *data)
+{
+    struct fixture *f = data;
+    unsigned j;
+    for (j = 0; j < f->n; j++) {
+        if (f->messages[j].type == RAFT_APPEND_ENTRIES &&
+            f->messages[j].append_entries.n_entries > 0) {
+            raft_free(f->messages[j].append_entries.entries);
+        }
+    }
+    raft_close(&f->raft, NULL);
+    TEAR_DOWN_HEAP;
+    free(f);
+}
+
+/******************************************************************************
+ *
+ * Helper macros
+ *
+ *****************************************************************************/
+
+/* Queue an AppendEntries message from server 1 in the given TERM, following
+ * the entry at PREV_INDEX with term PREV_TERM and carrying N entries with term
+ * ENTRIES_TERM, all in the same batch. */
+#define APPEND_ENTRIES(TERM, PREV_INDEX, PREV_TERM, N, ENTRIES_TERM)     \
+    do {                                                                 \
+        struct raft_message *_message = &f->messages[f->n];              \
+        struct raft_append_entries *_args = &_message->append_entries;   \
+        uint64_t *_batch = NULL;                                         \
+        unsigned _n = N;                                                 \
+        unsigned _j;                                                     \
+        _message->type = RAFT_APPEND_ENTRIES;                            \
+        _message->server_id = 1;                                         \
+        _message->server_address = "1";                                  \
+        _args->version = 0;                                              \
+        _args->term = TERM;                                              \
+        _args->prev_log_index = PREV_INDEX;                              \
+        _args->prev_log_term = PREV_TERM;                                \
+        _args->leader_commit = 1;                                        \
+        _args->entries = NULL;                                           \
+        _args->n_entries = _n;                                           \
+        if (_n > 0) {                                                    \
+            _batch = raft_malloc(_n * sizeof *_batch);                   \
+            _args->entries = raft_malloc(_n * sizeof *_args->entries);   \
+        }                                                                \
+        for (_j = 0; _j < _n; _j++) {                                    \
+            _batch[_j] = PREV_INDEX + 1 + _j;                            \
+            _args->entries[_j].term = ENTRIES_TERM;                      \
+            _args->entries[_j].type = RAFT_COMMAND;                      \
+            _args->entries[_j].buf.base = &_batch[_j];                   \
+            _args->entries[_j].buf.len = sizeof *_batch;                 \
+            _args->entries[_j].batch = _batch;                           \
+        }                                                                \
+        f->events[f->n].time = 0;                                        \
+        f->events[f->n].capacity = 0;                                    \
+        f->events[f->n].type = RAFT_RECEIVE;                             \
+        f->events[f->n].receive.message = _message;                      \
+        f->n++;                                                          \
+    } while (0)
+
+/* Pass all queued events to raft_step_batch(). */
+#define STEP_BATCH                                                          \
+    do {                                                                    \
+        int _rv;                                                            \
+        _rv = raft_step_batch(&f->raft, f->events, f->n, &f->update);       \
+        munit_assert_int(_rv, ==, 0);                                       \
+    } while (0)
+
+/* Assert that the update contains N entries to persist starting at INDEX, and
+ * release their batches. */
+#define ASSERT_ENTRIES(INDEX, N)                                            \
+    do {                                                                    \
+        struct raft_entry *_entries = f->update.entries.batch;              \
+        void *_batch = NULL;                                                \
+        unsigned _j;                                                        \
+        munit_assert_true(f->update.flags & RAFT_UPDATE_ENTRIES);           \
+        munit_assert_ullong(f->update.entries.index, ==, INDEX);            \
+        munit_assert_uint(f->update.entries.n, ==, N);                      \
+        for (_j = 0; _j < N; _j++) {                                        \
+            munit_assert_ullong(*(uint64_t *)_entries[_j].buf.base, ==,     \
+                                INDEX + _j);                                \
+        }                                                                   \
+        for (_j = 0; _j < N; _j++) {                                        \
+            if (_entries[_j].batch != _batch) {                             \
+                _batch = _entries[_j].batch;                                \
+                raft_free(_batch);                                          \
+            }                                                               \
+        }                                                                   \
+    } while (0)
+
+/******************************************************************************
+ *
+ * raft_step_batch()
+ *
+ *****************************************************************************/
+
+SUITE(raft_step_batch)
+
+/* Entries received in consecutive AppendEntries messages are merged into a
+ * single range to persist. */
+TEST(raft_step_batch, mergeEntries, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    APPEND_ENTRIES(2, 1, 1, 1, 2);
+    APPEND_ENTRIES(2, 2, 2, 2, 2);
+    APPEND_ENTRIES(2, 4, 2, 1, 2);
+    STEP_BATCH;
+    ASSERT_ENTRIES(2, 4);
+    munit_assert_ullong(raft_current_term(&f->raft), ==, 2);
+    return MUNIT_OK;
+}
+
+/* If a later message in the batch conflicts with entries received earlier, the
+ * conflicting entries are replaced. */
+TEST(raft_step_batch, truncateEntries, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    APPEND_ENTRIES(2, 1, 1, 3, 2);
+    APPEND_ENTRIES(3, 2, 2, 1, 3);
+    STEP_BATCH;
+    ASSERT_ENTRIES(2, 2);
+    munit_assert_ullong(f->update.entries.batch[0].term, ==, 2);
+    munit_assert_ullong(f->update.entries.batch[1].term, ==, 3);
+    return MUNIT_OK;
+}
+
+/* If a later message in the batch replaces all entries received earlier, their
+ * memory is released. */
+TEST(raft_step_batch, replaceEntries, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    APPEND_ENTRIES(2, 1, 1, 2, 2);
+    APPEND_ENTRIES(3, 1, 1, 1, 3);
+    STEP_BATCH;
+    ASSERT_ENTRIES(2, 1);
+    munit_assert_ullong(f->update.entries.batch[0].term, ==, 3);
+    return MUNIT_OK;
+}
+
+/* Successful AppendEntries results sent to the same leader are coalesced, and
+ * only the most recent one is sent. */
+TEST(raft_step_batch, coalesceResults, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    struct raft_message *message;
+    APPEND_ENTRIES(2, 1, 1, 0, 2);
+    APPEND_ENTRIES(2, 1, 1, 0, 2);
+    APPEND_ENTRIES(2, 1, 1, 0, 2);
+    STEP_BATCH;
+    munit_assert_true(f->update.flags & RAFT_UPDATE_MESSAGES);
+    munit_assert_uint(f->update.messages.n, ==, 1);
+    message = &f->update.messages.batch[0];
+    munit_assert_int(message->type, ==, RAFT_APPEND_ENTRIES_RESULT);
+    munit_assert_ullong(message->server_id, ==, 1);
+    munit_assert_string_equal(message->server_address, "1");
+    munit_assert_ullong(message->append_entries_result.rejected, ==, 0);
+    munit_assert_ullong(message->append_entries_result.last_log_index, ==, 1);
+    return MUNIT_OK;
+}
+
+/* Rejected AppendEntries results are never dropped. */
+TEST(raft_step_batch, keepRejections, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    APPEND_ENTRIES(2, 1, 1, 0, 2);
+    APPEND_ENTRIES(2, 5, 2, 0, 2);
+    APPEND_ENTRIES(2, 1, 1, 0, 2);
+    STEP_BATCH;
+    munit_assert_uint(f->update.messages.n, ==, 2);
+    munit_assert_ullong(
+        f->update.messages.batch[0].append_entries_result.rejected, ==, 5);
+    munit_assert_ullong(
+        f->update.messages.batch[1].append_entries_result.rejected, ==, 0);
+    return MUNIT_OK;
+}
+
+/******************************************************************************
+ *
+ * raft_set_append_results_window()
+ *
+ *****************************************************************************/
+
+/* Pass the last queued event to raft_step(), setting its time to TIME. */
+#define STEP_AT(TIME)                                                  \
+    do {                                                               \
+        struct raft_event *_event = &f->events[f->n - 1];              \
+        int _rv;                                                       \
+        _event->time = TIME;                                           \
+        _rv = raft_step(&f->raft, _event, &f->update);                 \
+        munit_assert_int(_rv, ==, 0);                                  \
+    } while (0)
+
+/* Fire a timeout event at the given TIME. */
+#define TIMEOUT_AT(TIME)                                               \
+    do {                                                               \
+        struct raft_event _event;                                      \
+        int _rv;                                                       \
+        _event.time = TIME;                                            \
+        _event.capacity = 0;                                           \
+        _event.type = RAFT_TIMEOUT;                                    \
+        _rv = raft_step(&f->raft, &_event, &f->update);                \
+        munit_assert_int(_rv, ==, 0);                                  \
+    } while (0)
+
+/* Assert the number of messages in the last update. */
+#define ASSERT_N_MESSAGES(N) munit_assert_uint(f->update.messages.n, ==, N)
+
+SUITE(raft_set_append_results_window)
+
+/* Successful results generated within the window are delayed and sent as a
+ * single result once the window expires. */
+TEST(raft_set_append_results_window, delay, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    raft_set_append_results_window(&f->raft, 100);
+
+    APPEND_ENTRIES(2, 1, 1, 0, 2);
+    STEP_AT(0);
+    ASSERT_N_MESSAGES(1);
+
+    APPEND_ENTRIES(2, 1, 1, 0, 2);
+    STEP_AT(10);
+    ASSERT_N_MESSAGES(0);
+    munit_assert_true(f->update.flags & RAFT_UPDATE_TIMEOUT);
+    munit_assert_ullong(raft_timeout(&f->raft), ==, 100);
+
+    APPEND_ENTRIES(2, 1, 1, 0, 2);
+    STEP_AT(20);
+    ASSERT_N_MESSAGES(0);
+    munit_assert_ullong(raft_suppressed_append_results(&f->raft), ==, 1);
+
+    TIMEOUT_AT(100);
+    ASSERT_N_MESSAGES(1);
+    munit_assert_int(f->update.messages.batch[0].type, ==,
+                     RAFT_APPEND_ENTRIES_RESULT);
+    munit_assert_ullong(
+        f->update.messages.batch[0].append_entries_result.last_log_index, ==,
+        1);
+    munit_assert_ullong(raft_suppressed_append_results(&f->raft), ==, 1);
+
+    return MUNIT_OK;
+}
+
+/* Rejections are never delayed. */
+TEST(raft_set_append_results_window, rejection, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    raft_set_append_results_window(&f->raft, 100);
+
+    APPEND_ENTRIES(2, 1, 1, 0, 2);
+    STEP_AT(0);
+    ASSERT_N_MESSAGES(1);
+
+    APPEND_ENTRIES(2, 5, 2, 0, 2);
+    STEP_AT(10);
+    ASSERT_N_MESSAGES(1);
+    munit_assert_ullong(
+        f->update.messages.batch[0].append_entries_result.rejected, ==, 5);
+
+    return MUNIT_OK;
+}
+
+/* Results coalesced by raft_step_batch() are counted as suppressed. */
+TEST(raft_set_append_results_window, batch, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    APPEND_ENTRIES(2, 1, 1, 0, 2);
+    APPEND_ENTRIES(2, 1, 1, 0, 2);
+    APPEND_ENTRIES(2, 1, 1, 0, 2);
+    STEP_BATCH;
+    ASSERT_N_MESSAGES(1);
+    munit_assert_ullong(raft_suppressed_append_results(&f->raft), ==, 2);
+    return MUNIT_OK;
+}
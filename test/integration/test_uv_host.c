@@ -0,0 +1,550 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "../../include/raft.h"
+#include "../../include/raft/uv.h"
+#include "../lib/dir.h"
+#include "../lib/heap.h"
+#include "../lib/loop.h"
+#include "../lib/runner.h"
+
+/******************************************************************************
+ *
+ * Fixture with two hosts using Unix socket transports, each running the
+ * servers of raft groups 1 and 2.
+ *
+ *****************************************************************************/
+
+#define N_HOSTS 2
+#define N_GROUPS 2
+
+struct group
+{
+    char *dir;
+    struct raft_io io;
+    struct raft_message message; /* Last message received */
+    unsigned n_received;
+    unsigned n_ticks;
+    struct raft_message *tick_message; /* Sent twice upon the next tick */
+    struct raft_io_send tick_reqs[2];
+    raft_id unreachable_id; /* Last server reported as unreachable */
+    bool running;
+    bool closed;
+};
+
+struct host
+{
+    struct raft_uv_transport transport;
+    struct raft_uv_host host;
+    char path[256];
+    bool closed;
+    struct group groups[N_GROUPS];
+};
+
+struct fixture
+{
+    FIXTURE_DIR;
+    FIXTURE_HEAP;
+    FIXTURE_LOOP;
+    struct host hosts[N_HOSTS];
+};
+
+/******************************************************************************
+ *
+ * Helper macros
+ *
+ *****************************************************************************/
+
+struct result
+{
+    int status;
+    bool done;
+};
+
+static void tickSendCb(struct raft_io_send *req, int status)
+{
+    munit_assert_int(status, ==, 0);
+    (void)req;
+}
+
+static void tickCb(struct raft_io *io)
+{
+    struct group *g = io->data;
+    int rv;
+    g->n_ticks++;
+    if (g->tick_message != NULL) {
+        rv = io->send(io, &g->tick_reqs[0], g->tick_message, tickSendCb);
+        munit_assert_int(rv, ==, 0);
+        rv = io->send(io, &g->tick_reqs[1], g->tick_message, tickSendCb);
+        munit_assert_int(rv, ==, 0);
+        g->tick_message = NULL;
+    }
+}
+
+static void unreachableCb(struct raft_io *io, raft_id id)
+{
+    struct group *g = io->data;
+    g->unreachable_id = id;
+}
+
+static void recvCb(struct raft_io *io, struct raft_message *message)
+{
+    struct group *g = io->data;
+    g->message = *message;
+    g->n_received++;
+}
+
+static void closeCb(struct raft_io *io)
+{
+    struct group *g = io->data;
+    g->closed = true;
+}
+
+static void hostCloseCb(struct raft_uv_host *h)
+{
+    struct host *host = h->data;
+    host->closed = true;
+}
+
+static void sendCbAssertResult(struct raft_io_send *req, int status)
+{
+    struct result *result = req->data;
+    munit_assert_int(status, ==, result->status);
+    result->done = true;
+}
+
+/* Get the I'th host. */
+#define HOST(I) (&f->hosts[I])
+
+/* Get the raft_io instance of group J on the I'th host. */
+#define GROUP(I, J) (&HOST(I)->groups[J - 1])
+
+/* Initialize the I'th host, with ID I + 1, listening on a socket in the test
+ * directory. */
+#define HOST_INIT(I)                                                        \
+    do {                                                                    \
+        struct host *_h = HOST(I);                                          \
+        int _rv;                                                            \
+        sprintf(_h->path, "%s/%d.sock", f->dir, I + 1);                     \
+        _h->transport.version = 1;                                          \
+        _rv = raft_uv_unix_init(&_h->transport, &f->loop);                  \
+        munit_assert_int(_rv, ==, 0);                                       \
+        _h->host.data = _h;                                                 \
+        _rv = raft_uv_host_init(&_h->host, &f->loop, &_h->transport);       \
+        munit_assert_int(_rv, ==, 0);                                       \
+        _h->closed = false;                                                 \
+    } while (0)
+
+/* Close and release the I'th host. */
+#define HOST_CLOSE(I)                                                       \
+    do {                                                                    \
+        struct host *_h = HOST(I);                                          \
+        raft_uv_host_close(&_h->host, hostCloseCb);                         \
+        LOOP_RUN_UNTIL(&_h->closed);                                        \
+        raft_uv_tcp_close(&_h->transport);                                  \
+    } while (0)
+
+/* Initialize and start the server of group J on the I'th host. */
+#define START(I, J)                                                         \
+    do {                                                                    \
+        struct group *_g = GROUP(I, J);                                     \
+        int _rv;                                                            \
+        _g->dir = DirSetUp(params, user_data);                              \
+        _rv = raft_uv_init_group(&_g->io, &HOST(I)->host, _g->dir, J);      \
+        munit_assert_int(_rv, ==, 0);                                       \
+        _rv = _g->io.init(&_g->io, I + 1, HOST(I)->path);                   \
+        munit_assert_int(_rv, ==, 0);                                       \
+        _g->io.version = 0; /* Avoid assuming that io.data is raft */       \
+        _g->io.data = _g;                                                   \
+        _rv = _g->io.start(&_g->io, 10 * J, tickCb, recvCb);                \
+        munit_assert_int(_rv, ==, 0);                                       \
+        _g->n_received = 0;                                                 \
+        _g->n_ticks = 0;                                                    \
+        _g->tick_message = NULL;                                            \
+        _g->unreachable_id = 0;                                             \
+        _g->io.set_unreachable_cb(&_g->io, unreachableCb);                  \
+        _g->running = true;                                                 \
+        _g->closed = false;                                                 \
+    } while (0)
+
+/* Close and release the server of group J on the I'th host. */
+#define STOP(I, J)                                                          \
+    do {                                                                    \
+        struct group *_g = GROUP(I, J);                                     \
+        _g->io.close(&_g->io, closeCb);                                     \
+        LOOP_RUN_UNTIL(&_g->closed);                                        \
+        raft_uv_close(&_g->io);                                             \
+        DirTearDown(_g->dir);                                               \
+        _g->running = false;                                                \
+    } while (0)
+
+/* Submit a send request from group J of the I'th host to the server of the same
+ * group on host K. */
+#define SEND_SUBMIT(I, J, K, MESSAGE, STATUS)                               \
+    struct raft_io_send _req;                                               \
+    struct result _result = {STATUS, false};                                \
+    do {                                                                    \
+        int _rv;                                                            \
+        (MESSAGE)->server_id = K + 1;                                       \
+        (MESSAGE)->server_address = HOST(K)->path;                          \
+        _req.data = &_result;                                               \
+        _rv = GROUP(I, J)->io.send(&GROUP(I, J)->io, &_req, MESSAGE,        \
+                                   sendCbAssertResult);                     \
+        munit_assert_int(_rv, ==, 0);                                       \
+    } while (0)
+
+/* Wait for the send request to complete. */
+#define SEND_WAIT LOOP_RUN_UNTIL(&_result.done)
+
+/* Run the loop until group J of the I'th host has received N messages. */
+#define RECV_WAIT(I, J, N)                                                  \
+    do {                                                                    \
+        bool _received = false;                                             \
+        unsigned _k;                                                        \
+        for (_k = 0; _k < LOOP_MAX_RUN && !_received; _k++) {               \
+            _received = GROUP(I, J)->n_received >= N;                       \
+            if (!_received) {                                               \
+                uv_run(&f->loop, UV_RUN_ONCE);                              \
+            }                                                               \
+        }                                                                   \
+        munit_assert_uint(GROUP(I, J)->n_received, ==, N);                  \
+    } while (0)
+
+/******************************************************************************
+ *
+ * Set up and tear down.
+ *
+ *****************************************************************************/
+
+static void *setUp(const MunitParameter params[], void *user_data)
+{
+    struct fixture *f = munit_malloc(sizeof *f);
+    unsigned i;
+    unsigned j;
+    SET_UP_DIR;
+    SET_UP_HEAP;
+    SETUP_LOOP;
+    for (i = 0; i < N_HOSTS; i++) {
+        HOST_INIT(i);
+        for (j = 1; j <= N_GROUPS; j++) {
+            START(i, j);
+        }
+    }
+    return f;
+}
+
+static void tearDown(void *data)
+{
+    struct fixture *f = data;
+    unsigned i;
+    unsigned j;
+    for (i = 0; i < N_HOSTS; i++) {
+        for (j = 1; j <= N_GROUPS; j++) {
+            if (GROUP(i, j)->running) {
+                STOP(i, j);
+            }
+        }
+    }
+    for (i = 0; i < N_HOSTS; i++) {
+        if (!HOST(i)->closed) {
+            HOST_CLOSE(i);
+        }
+    }
+    TEAR_DOWN_LOOP;
+    TEAR_DOWN_HEAP;
+    TEAR_DOWN_DIR;
+}
+
+/******************************************************************************
+ *
+ * raft_uv_init_group
+ *
+ *****************************************************************************/
+
+SUITE(raft_uv_init_group)
+
+/* A host can't have two servers for the same group. */
+TEST(raft_uv_init_group, duplicate, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    struct raft_io io;
+    int rv;
+    rv = raft_uv_init_group(&io, &HOST(0)->host, f->dir, 2);
+    munit_assert_int(rv, ==, RAFT_DUPLICATEID);
+    munit_assert_string_equal(io.errmsg, "group 2 already exists");
+    return MUNIT_OK;
+}
+
+/* All groups of a host must use the host's server ID and address. */
+TEST(raft_uv_init_group, idMismatch, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    struct raft_io io;
+    char *errmsg;
+    int rv;
+    rv = raft_uv_init_group(&io, &HOST(0)->host, f->dir, 3);
+    munit_assert_int(rv, ==, 0);
+    rv = io.init(&io, 5, HOST(0)->path);
+    munit_assert_int(rv, ==, RAFT_INVALID);
+    errmsg = munit_malloc(strlen(HOST(0)->path) * 2 + 64);
+    sprintf(errmsg, "server 5 at %s doesn't match host server 1 at %s",
+            HOST(0)->path, HOST(0)->path);
+    munit_assert_string_equal(io.errmsg, errmsg);
+    free(errmsg);
+    raft_uv_close(&io);
+    return MUNIT_OK;
+}
+
+/******************************************************************************
+ *
+ * Sending and receiving over host connections
+ *
+ *****************************************************************************/
+
+SUITE(raft_uv_host)
+
+/* A message is received by the server of the same group on the peer host. */
+TEST(raft_uv_host, send, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    struct raft_message message;
+
+    memset(&message, 0, sizeof message);
+    message.type = RAFT_REQUEST_VOTE;
+    message.request_vote.term = 3;
+    message.request_vote.candidate_id = 1;
+
+    SEND_SUBMIT(0, 2, 1, &message, 0);
+    SEND_WAIT;
+    RECV_WAIT(1, 2, 1);
+
+    munit_assert_uint(GROUP(1, 1)->n_received, ==, 0);
+    munit_assert_int(GROUP(1, 2)->message.type, ==, RAFT_REQUEST_VOTE);
+    munit_assert_int(GROUP(1, 2)->message.request_vote.term, ==, 3);
+    munit_assert_int(GROUP(1, 2)->message.server_id, ==, 1);
+    munit_assert_string_equal(GROUP(1, 2)->message.server_address,
+                              HOST(0)->path);
+
+    return MUNIT_OK;
+}
+
+/* Messages of different groups sent to the same peer host are all delivered to
+ * their group, in both directions. */
+TEST(raft_uv_host, groups, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    struct raft_message message;
+    unsigned i;
+    unsigned j;
+
+    memset(&message, 0, sizeof message);
+    message.type = RAFT_TIMEOUT_NOW;
+
+    for (i = 0; i < N_HOSTS; i++) {
+        for (j = 1; j <= N_GROUPS; j++) {
+            message.timeout_now.term = j;
+            SEND_SUBMIT(i, j, 1 - i, &message, 0);
+            SEND_WAIT;
+        }
+    }
+
+    for (i = 0; i < N_HOSTS; i++) {
+        for (j = 1; j <= N_GROUPS; j++) {
+            RECV_WAIT(i, j, 1);
+            munit_assert_int(GROUP(i, j)->message.timeout_now.term, ==, j);
+            munit_assert_int(GROUP(i, j)->message.server_id, ==, 2 - i);
+        }
+    }
+
+    return MUNIT_OK;
+}
+
+/* Messages for a group that has no server on the receiving host are dropped,
+ * along with their payload, without affecting the other groups. */
+TEST(raft_uv_host, unknownGroup, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    struct raft_message message;
+    struct raft_entry entry;
+    uint64_t payload = 123;
+
+    STOP(1, 2);
+
+    entry.term = 1;
+    entry.type = RAFT_COMMAND;
+    entry.buf.base = &payload;
+    entry.buf.len = sizeof payload;
+    entry.batch = NULL;
+    memset(&message, 0, sizeof message);
+    message.type = RAFT_APPEND_ENTRIES;
+    message.append_entries.term = 1;
+    message.append_entries.entries = &entry;
+    message.append_entries.n_entries = 1;
+
+    {
+        SEND_SUBMIT(0, 2, 1, &message, 0);
+        SEND_WAIT;
+    }
+
+    memset(&message, 0, sizeof message);
+    message.type = RAFT_REQUEST_VOTE;
+    {
+        SEND_SUBMIT(0, 1, 1, &message, 0);
+        SEND_WAIT;
+    }
+    RECV_WAIT(1, 1, 1);
+    munit_assert_int(GROUP(1, 1)->message.type, ==, RAFT_REQUEST_VOTE);
+
+    return MUNIT_OK;
+}
+
+/* When a peer host goes away, all groups are told that it's unreachable. */
+TEST(raft_uv_host, unreachable, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    struct raft_message message;
+    unsigned j;
+
+    memset(&message, 0, sizeof message);
+    message.type = RAFT_REQUEST_VOTE;
+
+    SEND_SUBMIT(0, 1, 1, &message, 0);
+    SEND_WAIT;
+    RECV_WAIT(1, 1, 1);
+
+    for (j = 1; j <= N_GROUPS; j++) {
+        STOP(0, j);
+    }
+    HOST_CLOSE(0);
+
+    for (j = 1; j <= N_GROUPS; j++) {
+        unsigned i;
+        for (i = 0; i < LOOP_MAX_RUN && GROUP(1, j)->unreachable_id == 0;
+             i++) {
+            uv_run(&f->loop, UV_RUN_ONCE);
+        }
+        munit_assert_ullong(GROUP(1, j)->unreachable_id, ==, 1);
+    }
+
+    return MUNIT_OK;
+}
+
+/* Closing a group cancels its messages which are still waiting for a
+ * connection, while those of other groups stay queued. */
+TEST(raft_uv_host, cancel, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    struct raft_message message;
+    struct raft_io_send reqs[2];
+    struct result results[2] = {{RAFT_CANCELED, false},
+                                {RAFT_CANCELED, false}};
+    unsigned j;
+    int rv;
+
+    memset(&message, 0, sizeof message);
+    message.type = RAFT_REQUEST_VOTE;
+    message.server_id = 3;
+    message.server_address = "/non/existing/3.sock";
+
+    for (j = 1; j <= N_GROUPS; j++) {
+        reqs[j - 1].data = &results[j - 1];
+        rv = GROUP(0, j)->io.send(&GROUP(0, j)->io, &reqs[j - 1], &message,
+                                  sendCbAssertResult);
+        munit_assert_int(rv, ==, 0);
+    }
+    LOOP_RUN(2);
+
+    STOP(0, 1);
+    munit_assert_true(results[0].done);
+    munit_assert_false(results[1].done);
+
+    STOP(0, 2);
+    munit_assert_true(results[1].done);
+
+    return MUNIT_OK;
+}
+
+/******************************************************************************
+ *
+ * Shared tick timer
+ *
+ *****************************************************************************/
+
+SUITE(raft_uv_host_tick)
+
+/* All groups are ticked by the host, each one at its own interval. */
+TEST(raft_uv_host_tick, interval, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    unsigned i;
+
+    for (i = 0; i < LOOP_MAX_RUN && GROUP(0, 2)->n_ticks < 2; i++) {
+        uv_run(&f->loop, UV_RUN_ONCE);
+    }
+
+    munit_assert_uint(GROUP(0, 2)->n_ticks, >=, 2);
+    munit_assert_uint(GROUP(0, 1)->n_ticks, >, GROUP(0, 2)->n_ticks);
+    munit_assert_uint(GROUP(1, 1)->n_ticks, >, 0);
+
+    return MUNIT_OK;
+}
+
+/* Messages sent to a connected peer while the groups are being ticked are
+ * written out together, and all get delivered. */
+TEST(raft_uv_host_tick, coalesce, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    struct raft_message message;
+    unsigned j;
+
+    memset(&message, 0, sizeof message);
+    message.type = RAFT_TIMEOUT_NOW;
+
+    /* Connect the hubs. */
+    SEND_SUBMIT(0, 1, 1, &message, 0);
+    SEND_WAIT;
+    RECV_WAIT(1, 1, 1);
+
+    for (j = 1; j <= N_GROUPS; j++) {
+        GROUP(0, j)->tick_message = &message;
+    }
+
+    RECV_WAIT(1, 1, 3);
+    RECV_WAIT(1, 2, 2);
+
+    return MUNIT_OK;
+}
+
+/* A group that sets a deadline is ticked once when it expires, and then not
+ * anymore until a new deadline is set, while other groups keep ticking. */
+TEST(raft_uv_host_tick, deadline, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    struct group *g = GROUP(0, 1);
+    unsigned n;
+    unsigned m;
+    unsigned i;
+
+    g->io.set_deadline(&g->io, g->io.time(&g->io) + 60 * 1000);
+    n = g->n_ticks;
+    m = GROUP(0, 2)->n_ticks;
+    for (i = 0; i < LOOP_MAX_RUN && GROUP(0, 2)->n_ticks < m + 3; i++) {
+        uv_run(&f->loop, UV_RUN_ONCE);
+    }
+    munit_assert_uint(GROUP(0, 2)->n_ticks, >=, m + 3);
+    munit_assert_uint(g->n_ticks, ==, n);
+
+    g->io.set_deadline(&g->io, g->io.time(&g->io));
+    for (i = 0; i < LOOP_MAX_RUN && g->n_ticks == n; i++) {
+        uv_run(&f->loop, UV_RUN_ONCE);
+    }
+    munit_assert_uint(g->n_ticks, ==, n + 1);
+
+    m = GROUP(0, 2)->n_ticks;
+    for (i = 0; i < LOOP_MAX_RUN && GROUP(0, 2)->n_ticks < m + 3; i++) {
+        uv_run(&f->loop, UV_RUN_ONCE);
+    }
+    munit_assert_uint(g->n_ticks, ==, n + 1);
+
+    return MUNIT_OK;
+}
@@ -0,0 +1,310 @@
+#include <string.h>
+
+#include "../../include/raft.h"
+#include "../../include/raft/uv.h"
+#include "../lib/dir.h"
+#include "../lib/heap.h"
+#include "../lib/loop.h"
+#include "../lib/runner.h"
+
+/******************************************************************************
+ *
+ * Fixture with two libuv-based raft_io instances using in-process transports.
+ *
+ *****************************************************************************/
+
+struct peer
+{
+    char *dir;
+    struct raft_uv_transport transport;
+    struct raft_io io;
+    struct raft_message message; /* Last message received */
+    bool received;
+    bool closed;
+};
+
+struct fixture
+{
+    FIXTURE_HEAP;
+    FIXTURE_LOOP;
+    struct peer peers[2];
+};
+
+/******************************************************************************
+ *
+ * Helper macros
+ *
+ *****************************************************************************/
+
+struct result
+{
+    int status;
+    bool done;
+};
+
+static void tickCb(struct raft_io *io)
+{
+    (void)io;
+}
+
+static void recvCb(struct raft_io *io, struct raft_message *message)
+{
+    struct peer *p = io->data;
+    munit_assert_false(p->received);
+    p->message = *message;
+    p->received = true;
+}
+
+static void closeCb(struct raft_io *io)
+{
+    struct peer *p = io->data;
+    p->closed = true;
+}
+
+static void sendCbAssertResult(struct raft_io_send *req, int status)
+{
+    struct result *result = req->data;
+    munit_assert_int(status, ==, result->status);
+    result->done = true;
+}
+
+/* Get the I'th peer. */
+#define PEER(I) (&f->peers[I])
+
+/* Initialize and start the I'th peer, using ID I + 1 and the string version of
+ * the ID as address. */
+#define START(I)                                                            \
+    do {                                                                    \
+        struct peer *_p = PEER(I);                                          \
+        char _address[8];                                                   \
+        int _rv;                                                            \
+        sprintf(_address, "%d", I + 1);                                     \
+        _p->dir = DirSetUp(params, user_data);                              \
+        _p->transport.version = 1;                                          \
+        _rv = raft_uv_inproc_init(&_p->transport, &f->loop);                \
+        munit_assert_int(_rv, ==, 0);                                       \
+        _rv = raft_uv_init(&_p->io, &f->loop, _p->dir, &_p->transport);     \
+        munit_assert_int(_rv, ==, 0);                                       \
+        _rv = _p->io.init(&_p->io, I + 1, _address);                        \
+        munit_assert_int(_rv, ==, 0);                                       \
+        _p->io.version = 0; /* Avoid assuming that io.data is raft */       \
+        _p->io.data = _p;                                                   \
+        _rv = _p->io.start(&_p->io, 10000, tickCb, recvCb);                 \
+        munit_assert_int(_rv, ==, 0);                                       \
+        _p->received = false;                                               \
+        _p->closed = false;                                                 \
+    } while (0)
+
+/* Close and release the I'th peer. */
+#define STOP(I)                                    \
+    do {                                           \
+        struct peer *_p = PEER(I);                 \
+        _p->io.close(&_p->io, closeCb);            \
+        LOOP_RUN_UNTIL(&_p->closed);               \
+        raft_uv_close(&_p->io);                    \
+        raft_uv_inproc_close(&_p->transport);      \
+        DirTearDown(_p->dir);                      \
+    } while (0)
+
+/* Submit a send request from the I'th peer and assert that the callback has not
+ * been fired synchronously. */
+#define SEND_SUBMIT(I, MESSAGE, STATUS)                                     \
+    struct raft_io_send _req;                                               \
+    struct result _result = {STATUS, false};                                \
+    do {                                                                    \
+        int _rv;                                                            \
+        _req.data = &_result;                                               \
+        _rv = PEER(I)->io.send(&PEER(I)->io, &_req, MESSAGE,                \
+                               sendCbAssertResult);                         \
+        munit_assert_int(_rv, ==, 0);                                       \
+        munit_assert_false(_result.done);                                   \
+    } while (0)
+
+/* Wait for the send request to complete. */
+#define SEND_WAIT LOOP_RUN_UNTIL(&_result.done)
+
+/******************************************************************************
+ *
+ * Set up and tear down.
+ *
+ *****************************************************************************/
+
+static void *setUp(const MunitParameter params[], void *user_data)
+{
+    struct fixture *f = munit_malloc(sizeof *f);
+    SET_UP_HEAP;
+    SETUP_LOOP;
+    START(0);
+    START(1);
+    return f;
+}
+
+static void tearDown(void *data)
+{
+    struct fixture *f = data;
+    STOP(0);
+    STOP(1);
+    TEAR_DOWN_LOOP;
+    TEAR_DOWN_HEAP;
+    free(f);
+}
+
+/******************************************************************************
+ *
+ * In-process transport
+ *
+ *****************************************************************************/
+
+SUITE(inproc)
+
+/* An AppendEntries message is delivered to the recv callback of the receiving
+ * instance, with a copy of the entries whose data is in a single batch. */
+TEST(inproc, appendEntries, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    struct raft_message message;
+    struct raft_entry entries[2];
+    uint64_t payload[2] = {123, 456};
+    struct raft_message *received = &PEER(1)->message;
+    unsigned i;
+
+    for (i = 0; i < 2; i++) {
+        entries[i].term = 1;
+        entries[i].type = RAFT_COMMAND;
+        entries[i].buf.base = &payload[i];
+        entries[i].buf.len = sizeof payload[i];
+        entries[i].batch = NULL;
+    }
+    memset(&message, 0, sizeof message);
+    message.type = RAFT_APPEND_ENTRIES;
+    message.server_id = 2;
+    message.server_address = "2";
+    message.append_entries.term = 1;
+    message.append_entries.prev_log_index = 3;
+    message.append_entries.entries = entries;
+    message.append_entries.n_entries = 2;
+
+    SEND_SUBMIT(0, &message, 0);
+    SEND_WAIT;
+
+    munit_assert_true(PEER(1)->received);
+    munit_assert_int(received->type, ==, RAFT_APPEND_ENTRIES);
+    munit_assert_int(received->server_id, ==, 1);
+    munit_assert_string_equal(received->server_address, "1");
+    munit_assert_int(received->append_entries.prev_log_index, ==, 3);
+    munit_assert_uint(received->append_entries.n_entries, ==, 2);
+    for (i = 0; i < 2; i++) {
+        struct raft_entry *entry = &received->append_entries.entries[i];
+        munit_assert_ptr_not_equal(entry->buf.base, &payload[i]);
+        munit_assert_ptr_equal(entry->batch,
+                               received->append_entries.entries[0].batch);
+        munit_assert_int(*(uint64_t *)entry->buf.base, ==, payload[i]);
+    }
+    raft_free(received->append_entries.entries[0].batch);
+    raft_free(received->append_entries.entries);
+
+    return MUNIT_OK;
+}
+
+/* An InstallSnapshot message is delivered with a copy of its configuration
+ * and data. */
+TEST(inproc, installSnapshot, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    struct raft_message message;
+    char snapshot[] = "snapshot";
+    struct raft_message *received = &PEER(0)->message;
+    int rv;
+
+    memset(&message, 0, sizeof message);
+    message.type = RAFT_INSTALL_SNAPSHOT;
+    message.server_id = 1;
+    message.server_address = "1";
+    message.install_snapshot.term = 1;
+    message.install_snapshot.last_index = 10;
+    message.install_snapshot.last_term = 1;
+    raft_configuration_init(&message.install_snapshot.conf);
+    rv = raft_configuration_add(&message.install_snapshot.conf, 1, "1",
+                                RAFT_VOTER);
+    munit_assert_int(rv, ==, 0);
+    message.install_snapshot.conf_index = 1;
+    message.install_snapshot.data.base = snapshot;
+    message.install_snapshot.data.len = sizeof snapshot;
+
+    SEND_SUBMIT(1, &message, 0);
+    raft_configuration_close(&message.install_snapshot.conf);
+    SEND_WAIT;
+
+    munit_assert_true(PEER(0)->received);
+    munit_assert_int(received->type, ==, RAFT_INSTALL_SNAPSHOT);
+    munit_assert_int(received->server_id, ==, 2);
+    munit_assert_int(received->install_snapshot.last_index, ==, 10);
+    munit_assert_uint(received->install_snapshot.conf.n, ==, 1);
+    munit_assert_int(received->install_snapshot.conf.servers[0].id, ==, 1);
+    munit_assert_string_equal(received->install_snapshot.data.base, snapshot);
+    raft_configuration_close(&received->install_snapshot.conf);
+    raft_free(received->install_snapshot.data.base);
+
+    return MUNIT_OK;
+}
+
+/* Nobody is listening on the target address. */
+TEST(inproc, noListener, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    struct raft_message message;
+
+    memset(&message, 0, sizeof message);
+    message.type = RAFT_REQUEST_VOTE;
+    message.server_id = 3;
+    message.server_address = "3";
+
+    SEND_SUBMIT(0, &message, RAFT_NOCONNECTION);
+    SEND_WAIT;
+
+    return MUNIT_OK;
+}
+
+/* Pending messages are canceled when the sender is closed. */
+TEST(inproc, cancel, setUp, NULL, 0, NULL)
+{
+    struct fixture *f = data;
+    struct raft_message message;
+
+    memset(&message, 0, sizeof message);
+    message.type = RAFT_REQUEST_VOTE;
+    message.server_id = 2;
+    message.server_address = "2";
+
+    SEND_SUBMIT(0, &message, RAFT_CANCELED);
+    STOP(0);
+    munit_assert_true(_result.done);
+    munit_assert_false(PEER(1)->received);
+
+    STOP(1);
+    TEAR_DOWN_LOOP;
+    TEAR_DOWN_HEAP;
+    free(f);
+
+    return MUNIT_OK;
+}
+
+/* Another transport on the same loop is already listening on the address. */
+TEST(inproc, addressInUse, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    struct raft_uv_transport transport;
+    int rv;
+
+    transport.version = 1;
+    rv = raft_uv_inproc_init(&transport, &f->loop);
+    munit_assert_int(rv, ==, 0);
+    rv = transport.init(&transport, 1, "1");
+    munit_assert_int(rv, ==, 0);
+    rv = transport.listen(&transport, NULL);
+    munit_assert_int(rv, ==, RAFT_IOERR);
+    munit_assert_string_equal(transport.errmsg, "address 1 already in use");
+    raft_uv_inproc_close(&transport);
+
+    return MUNIT_OK;
+}
@@ -0,0 +1,258 @@
+#include <stdio.h>
+#include <time.h>
+
+#include "../../include/raft.h"
+#include "../../include/raft/uv.h"
+#include "../lib/dir.h"
+#include "../lib/fsm.h"
+#include "../lib/heap.h"
+#include "../lib/runner.h"
+
+/******************************************************************************
+ *
+ * Fixture with a three-server quiescent cluster using Unix socket transports,
+ * each server running on its own event loop.
+ *
+ * A server whose loop is not run anymore neither reads nor writes its sockets,
+ * like a host that lost power or that sits behind a partition dropping packets
+ * silently: its connections stay open and the other servers get no error.
+ *
+ *****************************************************************************/
+
+#define N_SERVERS 3
+#define ELECTION_TIMEOUT 100
+#define HEARTBEAT_TIMEOUT 10
+
+struct server
+{
+    char *dir;
+    char path[256];
+    struct uv_loop_s loop;
+    struct raft_uv_transport transport;
+    struct raft_io io;
+    struct raft_fsm fsm;
+    struct raft raft;
+    bool frozen; /* The loop is not run anymore */
+    bool closed;
+};
+
+struct fixture
+{
+    FIXTURE_HEAP;
+    struct server servers[N_SERVERS];
+};
+
+/******************************************************************************
+ *
+ * Helper macros
+ *
+ *****************************************************************************/
+
+static void closeCb(struct raft *r)
+{
+    struct server *s = r->data;
+    s->closed = true;
+}
+
+/* Get the I'th server. */
+#define SERVER(I) (&f->servers[I])
+
+/* Run once all loops that are not frozen, without blocking, then sleep for a
+ * millisecond. */
+static void runOnce(struct fixture *f)
+{
+    struct timespec ts = {0, 1000 * 1000};
+    unsigned i;
+    for (i = 0; i < N_SERVERS; i++) {
+        if (!SERVER(i)->frozen) {
+            uv_run(&SERVER(i)->loop, UV_RUN_NOWAIT);
+        }
+    }
+    nanosleep(&ts, NULL);
+}
+
+/* Run the loops for at most the given amount of milliseconds, until the given
+ * condition holds. */
+#define RUN_UNTIL(COND, MSECS)                                              \
+    do {                                                                    \
+        uint64_t _deadline = uv_hrtime() + (uint64_t)(MSECS)*1000 * 1000;   \
+        while (!(COND) && uv_hrtime() < _deadline) {                        \
+            runOnce(f);                                                     \
+        }                                                                   \
+    } while (0)
+
+/* Return the index of the leader that is not frozen, or N_SERVERS. */
+static unsigned leaderIndex(struct fixture *f)
+{
+    unsigned i;
+    for (i = 0; i < N_SERVERS; i++) {
+        if (!SERVER(i)->frozen &&
+            raft_state(&SERVER(i)->raft) == RAFT_LEADER) {
+            return i;
+        }
+    }
+    return N_SERVERS;
+}
+
+/* Whether there's a leader whose followers all confirmed quiescence. */
+static bool clusterQuiescent(struct fixture *f)
+{
+    unsigned i = leaderIndex(f);
+    unsigned j;
+    if (i == N_SERVERS || !SERVER(i)->raft.leader_state.quiescent) {
+        return false;
+    }
+    for (j = 0; j < N_SERVERS; j++) {
+        if (j != i && !SERVER(j)->raft.follower_state.quiescent) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Initialize the I'th server, with ID I + 1, writing keepalives every
+ * HEARTBEAT_TIMEOUT milliseconds. */
+#define SERVER_INIT(I)                                                      \
+    do {                                                                    \
+        struct server *_s = SERVER(I);                                      \
+        int _rv;                                                            \
+        _s->dir = DirSetUp(params, user_data);                              \
+        sprintf(_s->path, "%s/%d.sock", _s->dir, I + 1);                    \
+        _rv = uv_loop_init(&_s->loop);                                      \
+        munit_assert_int(_rv, ==, 0);                                       \
+        _s->transport.version = 1;                                          \
+        _rv = raft_uv_unix_init(&_s->transport, &_s->loop);                 \
+        munit_assert_int(_rv, ==, 0);                                       \
+        _rv = raft_uv_init(&_s->io, &_s->loop, _s->dir, &_s->transport);    \
+        munit_assert_int(_rv, ==, 0);                                       \
+        raft_uv_set_keepalive(&_s->io, HEARTBEAT_TIMEOUT);                  \
+        FsmInit(&_s->fsm, 2);                                               \
+        _rv = raft_init(&_s->raft, &_s->io, &_s->fsm, I + 1, _s->path);     \
+        munit_assert_int(_rv, ==, 0);                                       \
+        _s->raft.data = _s;                                                 \
+        raft_set_election_timeout(&_s->raft, ELECTION_TIMEOUT);             \
+        raft_set_heartbeat_timeout(&_s->raft, HEARTBEAT_TIMEOUT);           \
+        raft_set_quiescence(&_s->raft, true);                               \
+        _s->frozen = false;                                                 \
+        _s->closed = false;                                                 \
+    } while (0)
+
+/* Bootstrap and start all servers, then wait for the cluster to quiesce. */
+#define CLUSTER_START                                                       \
+    do {                                                                    \
+        struct raft_configuration _conf;                                    \
+        unsigned _i;                                                        \
+        int _rv;                                                            \
+        raft_configuration_init(&_conf);                                    \
+        for (_i = 0; _i < N_SERVERS; _i++) {                                \
+            _rv = raft_configuration_add(&_conf, _i + 1, SERVER(_i)->path,  \
+                                         RAFT_VOTER);                       \
+            munit_assert_int(_rv, ==, 0);                                   \
+        }                                                                   \
+        for (_i = 0; _i < N_SERVERS; _i++) {                                \
+            _rv = raft_bootstrap(&SERVER(_i)->raft, &_conf);                \
+            munit_assert_int(_rv, ==, 0);                                   \
+            _rv = raft_start(&SERVER(_i)->raft);                            \
+            munit_assert_int(_rv, ==, 0);                                   \
+        }                                                                   \
+        raft_configuration_close(&_conf);                                   \
+        RUN_UNTIL(clusterQuiescent(f), 5000);                               \
+        munit_assert_true(clusterQuiescent(f));                             \
+    } while (0)
+
+/* Stop running the loop of the current leader, and return its index. */
+#define FREEZE_LEADER(I)                                                    \
+    unsigned I = leaderIndex(f);                                            \
+    munit_assert_uint(I, <, N_SERVERS);                                     \
+    SERVER(I)->frozen = true
+
+/******************************************************************************
+ *
+ * Set up and tear down.
+ *
+ *****************************************************************************/
+
+static void *setUp(const MunitParameter params[], void *user_data)
+{
+    struct fixture *f = munit_malloc(sizeof *f);
+    unsigned i;
+    SET_UP_HEAP;
+    for (i = 0; i < N_SERVERS; i++) {
+        SERVER_INIT(i);
+    }
+    return f;
+}
+
+static void tearDown(void *data)
+{
+    struct fixture *f = data;
+    unsigned i;
+    bool closed = true;
+    for (i = 0; i < N_SERVERS; i++) {
+        SERVER(i)->frozen = false;
+        raft_close(&SERVER(i)->raft, closeCb);
+    }
+    for (i = 0; i < N_SERVERS; i++) {
+        RUN_UNTIL(SERVER(i)->closed, 5000);
+        closed = closed && SERVER(i)->closed;
+    }
+    munit_assert_true(closed);
+    for (i = 0; i < N_SERVERS; i++) {
+        struct server *s = SERVER(i);
+        int rv;
+        raft_uv_close(&s->io);
+        raft_uv_tcp_close(&s->transport);
+        FsmClose(&s->fsm);
+        while (uv_run(&s->loop, UV_RUN_NOWAIT) != 0) {
+        }
+        rv = uv_loop_close(&s->loop);
+        munit_assert_int(rv, ==, 0);
+        DirTearDown(s->dir);
+    }
+    TEAR_DOWN_HEAP;
+    free(f);
+}
+
+/******************************************************************************
+ *
+ * Keepalives
+ *
+ *****************************************************************************/
+
+SUITE(keepalive)
+
+/* A quiescent follower notices a leader that went silent and starts an
+ * election. */
+TEST(keepalive, silentLeader, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    CLUSTER_START;
+    FREEZE_LEADER(i);
+    RUN_UNTIL(leaderIndex(f) != N_SERVERS, 2000);
+    munit_assert_uint(leaderIndex(f), !=, N_SERVERS);
+    munit_assert_uint(leaderIndex(f), !=, i);
+    munit_assert_ullong(SERVER(leaderIndex(f))->raft.current_term, >,
+                        SERVER(i)->raft.current_term);
+    return MUNIT_OK;
+}
+
+/* With keepalives disabled, quiescent followers wait forever for a leader that
+ * went silent. */
+TEST(keepalive, disabled, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    unsigned j;
+    for (j = 0; j < N_SERVERS; j++) {
+        raft_uv_set_keepalive(&SERVER(j)->io, 0);
+    }
+    CLUSTER_START;
+    FREEZE_LEADER(i);
+    RUN_UNTIL(leaderIndex(f) != N_SERVERS, 10 * ELECTION_TIMEOUT);
+    munit_assert_uint(leaderIndex(f), ==, N_SERVERS);
+    for (j = 0; j < N_SERVERS; j++) {
+        if (j != i) {
+            munit_assert_int(raft_state(&SERVER(j)->raft), ==, RAFT_FOLLOWER);
+        }
+    }
+    return MUNIT_OK;
+}
@@ -1719,6 +1719,178 @@ TEST(load, closedSegmentWithCorruptedBatchData, setUp, tearDown, 0, NULL)
     return MUNIT_OK;
 }
 
+/* The data directory has many closed segments, which are loaded concurrently
+ * and stitched together in index order. */
+TEST(load, manyClosedSegments, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    unsigned i;
+    for (i = 1; i <= 9; i++) {
+        APPEND(1, i);
+    }
+    SETUP_UV;
+    raft_uv_set_segment_load_threads(&f->io, 3);
+    LOAD_NO_SETUP(0,    /* term */
+                  0,    /* voted for */
+                  NULL, /* snapshot */
+                  1,    /* start index */
+                  1,    /* data for first loaded entry */
+                  9     /* n entries */
+    );
+    return MUNIT_OK;
+}
+
+/* When loading closed segments concurrently, the error reported is the one of
+ * the first corrupted segment in index order. */
+TEST(load, manyClosedSegmentsCorrupted, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    size_t offset = WORD_SIZE /* Format version */;
+    uint64_t corrupted = 12345678;
+    unsigned i;
+    for (i = 1; i <= 4; i++) {
+        APPEND(1, i);
+    }
+    DirOverwriteFile(f->dir, CLOSED_SEGMENT_FILENAME(2, 2), &corrupted,
+                     sizeof corrupted, offset);
+    DirOverwriteFile(f->dir, CLOSED_SEGMENT_FILENAME(4, 4), &corrupted,
+                     sizeof corrupted, offset);
+    LOAD_ERROR(RAFT_CORRUPT,
+               "load closed segment 0000000000000002-0000000000000002: entries "
+               "batch 1 starting at byte 8: header checksum mismatch");
+    return MUNIT_OK;
+}
+
+/* When a trailing amount is set, closed segments whose entries are all behind
+ * it are not loaded, and the index of the segment straddling the boundary is
+ * used to skip its older batches. */
+TEST(load, trailingSkipsSnapshottedEntries, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    struct snapshot snapshot = {
+        1, /* term */
+        6, /* index */
+        1  /* data */
+    };
+    APPEND(2, 1);
+    APPEND(4, 3);
+    APPEND(2, 7);
+    SNAPSHOT_PUT(1, 6, 1);
+    munit_assert_true(
+        DirHasFile(f->dir, CLOSED_SEGMENT_FILENAME(3, 6) ".idx"));
+    SETUP_UV;
+    raft_uv_set_load_trailing(&f->io, 2);
+    LOAD_NO_SETUP(0,         /* term */
+                  0,         /* voted for */
+                  &snapshot, /* snapshot */
+                  5,         /* start index */
+                  5,         /* data for first loaded entry */
+                  4          /* n entries */
+    );
+    return MUNIT_OK;
+}
+
+/* If the index of the segment straddling the trailing boundary is corrupted,
+ * the whole segment is loaded. */
+TEST(load, trailingWithCorruptedIndex, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    struct snapshot snapshot = {
+        1, /* term */
+        6, /* index */
+        1  /* data */
+    };
+    uint64_t corrupted = 12345678;
+    APPEND(2, 1);
+    APPEND(4, 3);
+    APPEND(2, 7);
+    SNAPSHOT_PUT(1, 6, 1);
+    DirOverwriteFile(f->dir, CLOSED_SEGMENT_FILENAME(3, 6) ".idx", &corrupted,
+                     sizeof corrupted, WORD_SIZE * 3);
+    SETUP_UV;
+    raft_uv_set_load_trailing(&f->io, 2);
+    LOAD_NO_SETUP(0,         /* term */
+                  0,         /* voted for */
+                  &snapshot, /* snapshot */
+                  3,         /* start index */
+                  3,         /* data for first loaded entry */
+                  6          /* n entries */
+    );
+    return MUNIT_OK;
+}
+
+/* If the index of the segment straddling the trailing boundary is missing, the
+ * whole segment is loaded. */
+TEST(load, trailingWithMissingIndex, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    struct snapshot snapshot = {
+        1, /* term */
+        6, /* index */
+        1  /* data */
+    };
+    APPEND(2, 1);
+    APPEND(4, 3);
+    APPEND(2, 7);
+    SNAPSHOT_PUT(1, 6, 1);
+    DirRemoveFile(f->dir, CLOSED_SEGMENT_FILENAME(3, 6) ".idx");
+    SETUP_UV;
+    raft_uv_set_load_trailing(&f->io, 2);
+    LOAD_NO_SETUP(0,         /* term */
+                  0,         /* voted for */
+                  &snapshot, /* snapshot */
+                  3,         /* start index */
+                  3,         /* data for first loaded entry */
+                  6          /* n entries */
+    );
+    return MUNIT_OK;
+}
+
+/* A truncation of a closed segment was interrupted right after moving the
+ * segment out of the way, before cutting it. The truncation is completed at
+ * startup. */
+TEST(load, interruptedTruncationBeforeCut, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    APPEND(4, 1);
+    DirRenameFile(f->dir, CLOSED_SEGMENT_FILENAME(1, 4),
+                  "truncate-" CLOSED_SEGMENT_FILENAME(1, 2));
+    LOAD(0, /* term */
+         0, /* voted for */
+         NULL, /* snapshot */
+         1, /* start index */
+         1, /* data for first loaded entry */
+         2  /* n entries */
+    );
+    munit_assert_true(HAS_CLOSED_SEGMENT_FILE(1, 2));
+    munit_assert_false(
+        DirHasFile(f->dir, "truncate-" CLOSED_SEGMENT_FILENAME(1, 2)));
+    return MUNIT_OK;
+}
+
+/* A truncation of a closed segment was interrupted after writing the surviving
+ * entries to a temporary file, before removing the original segment. The
+ * truncation is completed at startup. */
+TEST(load, interruptedTruncationBeforeRemove, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    uint8_t buf[8 + 3 * 40]; /* Format and three single-entry batches */
+    APPEND(4, 1);
+    DirReadFile(f->dir, CLOSED_SEGMENT_FILENAME(1, 4), buf, sizeof buf);
+    DirWriteFile(f->dir, "truncate-" CLOSED_SEGMENT_FILENAME(1, 3), buf,
+                 sizeof buf);
+    LOAD(0, /* term */
+         0, /* voted for */
+         NULL, /* snapshot */
+         1, /* start index */
+         1, /* data for first loaded entry */
+         3  /* n entries */
+    );
+    munit_assert_true(HAS_CLOSED_SEGMENT_FILE(1, 3));
+    munit_assert_false(HAS_CLOSED_SEGMENT_FILE(1, 4));
+    return MUNIT_OK;
+}
+
 /* The data directory has a closed segment whose first index does not match what
  * we expect. */
 TEST(load, closedSegmentWithBadIndex, setUp, tearDown, 0, NULL)
@@ -1802,3 +1974,43 @@ TEST(load, openSegmentWithBadFormat, setUp, tearDown, 0, NULL)
                "load open segment open-1: unexpected format version 2");
     return MUNIT_OK;
 }
+
+static void statsEmit(struct raft_tracer *t, int type, const void *info)
+{
+    struct raft_uv_load_stats *stats = t->impl;
+    if (type == RAFT_UV_TRACER_LOAD_COMPLETE) {
+        *stats = *(const struct raft_uv_load_stats *)info;
+    }
+}
+
+/* A successful load fires a trace event with the time spent in each phase. */
+TEST(load, stats, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    struct raft_uv_load_stats stats;
+    struct snapshot snapshot = {
+        1, /* term */
+        2, /* index */
+        1  /* data */
+    };
+    APPEND(1, 1);
+    APPEND(1, 2);
+    SNAPSHOT_PUT(1, 2, 1);
+    UNFINALIZE(2, 2, 1);
+    memset(&stats, 0, sizeof stats);
+    f->tracer.impl = &stats;
+    f->tracer.emit = statsEmit;
+    LOAD(0,         /* term */
+         0,         /* voted for */
+         &snapshot, /* snapshot */
+         1,         /* start index */
+         1,         /* data for first loaded entry */
+         2          /* n entries */
+    );
+    munit_assert_uint64(stats.total, >, 0);
+    munit_assert_uint64(stats.list, >, 0);
+    munit_assert_uint64(stats.segment_read, >, 0);
+    munit_assert_uint64(stats.snapshot_read, >, 0);
+    munit_assert_uint64(stats.total, >=, stats.list + stats.snapshot_read);
+    return MUNIT_OK;
+}
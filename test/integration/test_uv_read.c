@@ -0,0 +1,282 @@
+#include "../lib/runner.h"
+#include "../lib/uv.h"
+
+/******************************************************************************
+ *
+ * Fixture with a libuv-based raft_io instance.
+ *
+ *****************************************************************************/
+
+struct fixture
+{
+    FIXTURE_UV_DEPS;
+    FIXTURE_UV;
+};
+
+/******************************************************************************
+ *
+ * Helper macros
+ *
+ *****************************************************************************/
+
+struct result
+{
+    int status;
+    bool done;
+    struct raft_entry *entries;
+    unsigned n;
+};
+
+static void appendCb(struct raft_io_append *req, int status)
+{
+    bool *done = req->data;
+    munit_assert_int(status, ==, 0);
+    *done = true;
+}
+
+static void readCb(struct raft_io_read *req,
+                   struct raft_entry entries[],
+                   unsigned n,
+                   int status)
+{
+    struct result *result = req->data;
+    munit_assert_int(status, ==, result->status);
+    result->entries = entries;
+    result->n = n;
+    result->done = true;
+}
+
+/* Load the current state of the data directory using the given raft_io
+ * instance, discarding it. */
+#define LOAD(IO)                                                              \
+    do {                                                                      \
+        raft_term _term;                                                      \
+        raft_id _voted_for;                                                   \
+        struct raft_snapshot *_snapshot;                                      \
+        raft_index _start_index;                                              \
+        struct raft_entry *_entries;                                          \
+        size_t _n;                                                            \
+        int _rv;                                                              \
+        _rv = (IO)->load(IO, &_term, &_voted_for, &_snapshot, &_start_index,  \
+                         &_entries, &_n);                                     \
+        munit_assert_int(_rv, ==, 0);                                         \
+        munit_assert_ptr_null(_snapshot);                                     \
+        if (_entries != NULL) {                                               \
+            raft_free(_entries[0].batch);                                     \
+            raft_free(_entries);                                              \
+        }                                                                     \
+    } while (0)
+
+/* Use the given raft_io instance to append a single batch of N entries, whose
+ * data is the sequence of integers starting at DATA. */
+#define APPEND_TO(IO, N, DATA)                                    \
+    do {                                                          \
+        struct raft_entry _entries[N];                            \
+        uint64_t _data[N];                                        \
+        struct raft_io_append _req;                               \
+        bool _done = false;                                       \
+        unsigned _j;                                              \
+        int _rv;                                                  \
+        for (_j = 0; _j < N; _j++) {                              \
+            _data[_j] = DATA + _j;                                \
+            _entries[_j].term = 1;                                \
+            _entries[_j].type = RAFT_COMMAND;                     \
+            _entries[_j].buf.base = &_data[_j];                   \
+            _entries[_j].buf.len = sizeof _data[_j];              \
+            _entries[_j].batch = NULL;                            \
+        }                                                         \
+        _req.data = &_done;                                       \
+        _rv = (IO)->append(IO, &_req, _entries, N, appendCb);     \
+        munit_assert_int(_rv, ==, 0);                             \
+        LOOP_RUN_UNTIL(&_done);                                   \
+    } while (0)
+
+/* Append a batch of entries using the fixture's raft_io instance. */
+#define APPEND(N, DATA) APPEND_TO(&f->io, N, DATA)
+
+/* Use a standalone raft_io instance to append a batch of N entries, whose data
+ * is the sequence of integers starting at DATA. The entries end up in a closed
+ * segment once the instance is closed. */
+#define APPEND_CLOSED(N, DATA)                                    \
+    do {                                                          \
+        struct raft_uv_transport _transport;                      \
+        struct raft_io _io;                                       \
+        bool _closed = false;                                     \
+        int _rv2;                                                  \
+        _transport.version = 1;                                   \
+        _rv2 = raft_uv_tcp_init(&_transport, &f->loop);            \
+        munit_assert_int(_rv2, ==, 0);                             \
+        _rv2 = raft_uv_init(&_io, &f->loop, f->dir, &_transport);  \
+        munit_assert_int(_rv2, ==, 0);                             \
+        _rv2 = _io.init(&_io, 1, "1");                             \
+        munit_assert_int(_rv2, ==, 0);                             \
+        LOAD(&_io);                                               \
+        APPEND_TO(&_io, N, DATA);                                 \
+        _io.data = &_closed;                                      \
+        _io.close(&_io, uvCloseCb);                               \
+        LOOP_RUN_UNTIL(&_closed);                                 \
+        raft_uv_close(&_io);                                      \
+        raft_uv_tcp_close(&_transport);                           \
+    } while (0)
+
+/* Setup the fixture's raft_io instance and load the data directory. */
+#define START \
+    SETUP_UV; \
+    LOAD(&f->io)
+
+/* Submit a read request for up to N entries starting at INDEX and wait for it
+ * to complete with the given STATUS. */
+#define READ(INDEX, N, STATUS)                                      \
+    struct raft_io_read _req;                                       \
+    struct result _result = {STATUS, false, NULL, 0};               \
+    do {                                                            \
+        int _rv;                                                    \
+        _req.data = &_result;                                       \
+        _rv = f->io.read(&f->io, &_req, INDEX, N, readCb);          \
+        munit_assert_int(_rv, ==, 0);                               \
+        LOOP_RUN_UNTIL(&_result.done);                              \
+    } while (0)
+
+/* Assert that the read request returned N entries, whose data is the sequence
+ * of integers starting at DATA, and release them. */
+#define ASSERT_READ(N, DATA)                                            \
+    do {                                                                \
+        unsigned _j;                                                    \
+        munit_assert_uint(_result.n, ==, N);                            \
+        for (_j = 0; _j < N; _j++) {                                    \
+            struct raft_entry *_entry = &_result.entries[_j];           \
+            munit_assert_int(_entry->type, ==, RAFT_COMMAND);           \
+            munit_assert_int(_entry->term, ==, 1);                      \
+            munit_assert_int(*(uint64_t *)_entry->buf.base, ==,         \
+                             DATA + _j);                                \
+        }                                                               \
+        raft_free(_result.entries[0].batch);                            \
+        raft_free(_result.entries);                                     \
+    } while (0)
+
+/******************************************************************************
+ *
+ * Set up and tear down.
+ *
+ *****************************************************************************/
+
+static void *setUp(const MunitParameter params[], void *user_data)
+{
+    struct fixture *f = munit_malloc(sizeof *f);
+    SETUP_UV_DEPS;
+    return f;
+}
+
+static void tearDown(void *data)
+{
+    struct fixture *f = data;
+    TEAR_DOWN_UV;
+    TEAR_DOWN_UV_DEPS;
+    free(f);
+}
+
+/******************************************************************************
+ *
+ * raft_io->read()
+ *
+ *****************************************************************************/
+
+SUITE(read)
+
+/* Entries that are still in an open segment are not read back, since the
+ * segment might be written concurrently. */
+TEST(read, openSegment, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    START;
+    APPEND(3, 1);
+    READ(2, 10, RAFT_NOTFOUND);
+    munit_assert_ptr_null(_result.entries);
+    return MUNIT_OK;
+}
+
+/* Read entries from a closed segment, at most the requested amount. */
+TEST(read, closedSegment, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    APPEND_CLOSED(2, 1);
+    APPEND_CLOSED(3, 3);
+    START;
+    READ(3, 2, 0);
+    ASSERT_READ(2, 3);
+    return MUNIT_OK;
+}
+
+/* Entries read from a closed segment are cached, and further reads of the same
+ * segment don't hit the disk. */
+TEST(read, cached, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    APPEND_CLOSED(4, 1);
+    START;
+    {
+        READ(1, 1, 0);
+        ASSERT_READ(1, 1);
+    }
+    DirRemoveFile(f->dir, "0000000000000001-0000000000000004");
+    {
+        READ(3, 4, 0);
+        ASSERT_READ(2, 3);
+    }
+    return MUNIT_OK;
+}
+
+/* Entries are not cached if the cache size is zero. */
+TEST(read, cacheDisabled, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    APPEND_CLOSED(4, 1);
+    START;
+    raft_uv_set_read_cache_size(&f->io, 0);
+    {
+        READ(1, 1, 0);
+        ASSERT_READ(1, 1);
+    }
+    DirRemoveFile(f->dir, "0000000000000001-0000000000000004");
+    {
+        READ(3, 4, RAFT_NOTFOUND);
+        munit_assert_uint(_result.n, ==, 0);
+    }
+    return MUNIT_OK;
+}
+
+/* Reading an entry that is not on disk fails. */
+TEST(read, notFound, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    START;
+    APPEND(2, 1);
+    READ(3, 1, RAFT_NOTFOUND);
+    munit_assert_ptr_null(_result.entries);
+    return MUNIT_OK;
+}
+
+/* Truncating the log drops the cached entries past the truncation point. */
+TEST(read, truncated, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    int rv;
+    APPEND_CLOSED(4, 1);
+    START;
+    {
+        READ(1, 1, 0);
+        ASSERT_READ(1, 1);
+    }
+    rv = f->io.truncate(&f->io, 3);
+    munit_assert_int(rv, ==, 0);
+    APPEND(1, 5);
+    {
+        READ(3, 1, RAFT_NOTFOUND);
+        munit_assert_ptr_null(_result.entries);
+    }
+    {
+        READ(1, 4, 0);
+        ASSERT_READ(2, 1);
+    }
+    return MUNIT_OK;
+}
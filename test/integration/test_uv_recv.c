@@ -85,6 +85,12 @@ static void recvCb(struct raft_io *io, struct raft_message *m1)
                              m2->append_entries_result.rejected);
             munit_assert_int(m1->append_entries_result.last_log_index, ==,
                              m2->append_entries_result.last_log_index);
+            if (m1->append_entries_result.version >= 3) {
+                munit_assert_int(m1->append_entries_result.conflict_term, ==,
+                                 m2->append_entries_result.conflict_term);
+                munit_assert_int(m1->append_entries_result.conflict_index, ==,
+                                 m2->append_entries_result.conflict_index);
+            }
             break;
         case RAFT_INSTALL_SNAPSHOT:
             munit_assert_int(m1->install_snapshot.conf.n, ==,
@@ -98,10 +104,13 @@ static void recvCb(struct raft_io *io, struct raft_message *m1)
             }
             munit_assert_int(m1->install_snapshot.data.len, ==,
                              m2->install_snapshot.data.len);
-            munit_assert_int(memcmp(m1->install_snapshot.data.base,
-                                    m2->install_snapshot.data.base,
-                                    m2->install_snapshot.data.len),
-                             ==, 0);
+            /* Streamed payloads are staged on disk. */
+            if (m1->install_snapshot.data.base != NULL) {
+                munit_assert_int(memcmp(m1->install_snapshot.data.base,
+                                        m2->install_snapshot.data.base,
+                                        m2->install_snapshot.data.len),
+                                 ==, 0);
+            }
             raft_configuration_close(&m1->install_snapshot.conf);
             raft_free(m1->install_snapshot.data.base);
             break;
@@ -347,6 +356,58 @@ TEST(recv, appendEntries, setUp, tearDown, 0, NULL)
     return MUNIT_OK;
 }
 
+#ifdef LZ4_AVAILABLE
+
+/* Receive an AppendEntries message whose payload was compressed by the
+ * sender. */
+TEST(recv, appendEntriesCompressed, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    struct raft_entry entries[3];
+    struct raft_message message;
+    uint8_t data1[4096];
+    uint8_t data2[8];
+    uint8_t data3[2048];
+    unsigned i;
+
+    for (i = 0; i < sizeof data1; i++) {
+        data1[i] = (uint8_t)(i % 7);
+    }
+    memset(data2, 9, sizeof data2);
+    for (i = 0; i < sizeof data3; i++) {
+        data3[i] = (uint8_t)(i % 13);
+    }
+
+    entries[0].type = RAFT_COMMAND;
+    entries[0].term = 1;
+    entries[0].buf.base = data1;
+    entries[0].buf.len = sizeof data1;
+
+    entries[1].type = RAFT_BARRIER;
+    entries[1].term = 2;
+    entries[1].buf.base = data2;
+    entries[1].buf.len = sizeof data2;
+
+    entries[2].type = RAFT_COMMAND;
+    entries[2].term = 2;
+    entries[2].buf.base = data3;
+    entries[2].buf.len = sizeof data3;
+
+    message.type = RAFT_APPEND_ENTRIES;
+    message.append_entries.version = 1;
+    message.append_entries.entries = entries;
+    message.append_entries.n_entries = 3;
+
+    raft_uv_set_append_compression_threshold(&f->peer.io, 1024);
+
+    PEER_SEND(&message);
+    RECV(&message);
+
+    return MUNIT_OK;
+}
+
+#endif /* LZ4_AVAILABLE */
+
 /* Receive an AppendEntries message with no entries (i.e. an heartbeat). */
 TEST(recv, heartbeat, setUp, tearDown, 0, NULL)
 {
@@ -374,6 +435,25 @@ TEST(recv, appendEntriesResult, setUp, tearDown, 0, NULL)
     return MUNIT_OK;
 }
 
+/* Receive an AppendEntries result carrying a conflict term hint. */
+TEST(recv, appendEntriesResultConflictTerm, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    struct raft_message message;
+    message.type = RAFT_APPEND_ENTRIES_RESULT;
+    message.append_entries_result.version = 3;
+    message.append_entries_result.term = 3;
+    message.append_entries_result.rejected = 12;
+    message.append_entries_result.last_log_index = 11;
+    message.append_entries_result.features = 3;
+    message.append_entries_result.capacity = 0;
+    message.append_entries_result.conflict_term = 2;
+    message.append_entries_result.conflict_index = 7;
+    PEER_SEND(&message);
+    RECV(&message);
+    return MUNIT_OK;
+}
+
 /* Receive an InstallSnapshot message. */
 TEST(recv, installSnapshot, setUp, tearDown, 0, NULL)
 {
@@ -401,6 +481,121 @@ TEST(recv, installSnapshot, setUp, tearDown, 0, NULL)
     return MUNIT_OK;
 }
 
+struct streamed
+{
+    struct raft_buffer *data;
+    bool done;
+};
+
+static void streamedPutCb(struct raft_io_snapshot_put *req, int status)
+{
+    struct streamed *streamed = req->data;
+    munit_assert_int(status, ==, 0);
+    streamed->done = true;
+}
+
+static void streamedGetCb(struct raft_io_snapshot_get *req,
+                          struct raft_snapshot *snapshot,
+                          int status)
+{
+    struct streamed *streamed = req->data;
+    munit_assert_int(status, ==, 0);
+    munit_assert_int(snapshot->index, ==, 123);
+    munit_assert_int(snapshot->n_bufs, ==, 1);
+    munit_assert_int(snapshot->bufs[0].len, ==, streamed->data->len);
+    munit_assert_int(memcmp(snapshot->bufs[0].base, streamed->data->base,
+                            streamed->data->len),
+                     ==, 0);
+    raft_configuration_close(&snapshot->configuration);
+    raft_free(snapshot->bufs[0].base);
+    raft_free(snapshot->bufs);
+    raft_free(snapshot);
+    streamed->done = true;
+}
+
+/* Receive an InstallSnapshot message whose payload is large enough to be
+ * streamed to disk in several chunks, then persist it. */
+TEST(recv, installSnapshotStreamed, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    struct raft_message message;
+    struct raft_io_send send;
+    struct raft_io_snapshot_put put;
+    struct raft_io_snapshot_get get;
+    struct raft_snapshot snapshot;
+    struct raft_buffer buf;
+    struct result result = {&message, false};
+    struct streamed streamed = {&message.install_snapshot.data, false};
+    bool sent = false;
+    uint8_t *bytes;
+    size_t i;
+    int rv;
+
+    raft_uv_set_snapshot_stream_threshold(&f->io, 1024);
+
+    /* Spans three streaming chunks. */
+    message.install_snapshot.data.len = 2 * 1024 * 1024 + 123;
+    bytes = munit_malloc(message.install_snapshot.data.len);
+    for (i = 0; i < message.install_snapshot.data.len; i++) {
+        bytes[i] = (uint8_t)(i % 251);
+    }
+    message.install_snapshot.data.base = bytes;
+
+    message.type = RAFT_INSTALL_SNAPSHOT;
+    message.server_id = 1;
+    message.server_address = "127.0.0.1:9001";
+    message.install_snapshot.term = 2;
+    message.install_snapshot.last_index = 123;
+    message.install_snapshot.last_term = 1;
+    raft_configuration_init(&message.install_snapshot.conf);
+    rv = raft_configuration_add(&message.install_snapshot.conf, 1, "1",
+                                RAFT_VOTER);
+    munit_assert_int(rv, ==, 0);
+
+    /* The payload doesn't fit in the socket buffers, so run both loops until
+     * it has been fully sent. */
+    send.data = &sent;
+    rv = f->peer.io.send(&f->peer.io, &send, &message, peerSendCb);
+    munit_assert_int(rv, ==, 0);
+    f->io.data = &result;
+    for (i = 0; i < 1000000 && !sent; i++) {
+        uv_run(&f->peer.loop, UV_RUN_NOWAIT);
+        uv_run(&f->loop, UV_RUN_NOWAIT);
+    }
+    munit_assert_true(sent);
+    LOOP_RUN_UNTIL(&result.done);
+    f->io.data = f;
+
+    /* Persist the staged payload without passing its data. */
+    snapshot.term = 1;
+    snapshot.index = 123;
+    snapshot.configuration_index = 1;
+    raft_configuration_init(&snapshot.configuration);
+    rv = raft_configuration_add(&snapshot.configuration, 1, "1", RAFT_VOTER);
+    munit_assert_int(rv, ==, 0);
+    buf.base = NULL;
+    buf.len = message.install_snapshot.data.len;
+    snapshot.bufs = &buf;
+    snapshot.n_bufs = 1;
+    put.data = &streamed;
+    rv = f->io.snapshot_put(&f->io, 0, &put, &snapshot, streamedPutCb);
+    munit_assert_int(rv, ==, 0);
+    LOOP_RUN_UNTIL(&streamed.done);
+    raft_configuration_close(&snapshot.configuration);
+
+    /* The persisted data matches what was sent. */
+    streamed.done = false;
+    get.data = &streamed;
+    rv = f->io.snapshot_get(&f->io, &get, streamedGetCb);
+    munit_assert_int(rv, ==, 0);
+    LOOP_RUN_UNTIL(&streamed.done);
+
+    raft_configuration_close(&message.install_snapshot.conf);
+    free(bytes);
+
+    return MUNIT_OK;
+}
+
 /* Receive a TimeoutNow message. */
 TEST(recv, timeoutNow, setUp, tearDown, 0, NULL)
 {
@@ -458,6 +653,31 @@ TEST(recv, badType, setUp, tearDown, 0, NULL)
     return MUNIT_OK;
 }
 
+/* An AppendEntries result whose header is too short for its version causes the
+ * connection to be aborted without the message being decoded. */
+TEST(recv, appendEntriesResultTooShort, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    uint8_t handshake[] = {
+        1, 0, 0, 0, 0, 0, 0, 0,  /* Protocol */
+        2, 0, 0, 0, 0, 0, 0, 0,  /* Server ID */
+        16, 0, 0, 0, 0, 0, 0, 0, /* Address length */
+        0, 0, 0, 0, 0, 0, 0, 0,  /* First address word */
+        0, 0, 0, 0, 0, 0, 0, 0   /* Second address word */
+    };
+    uint8_t message[16 + 32] = {
+        2, 0, 3, 0, 0, 0, 0, 0, /* Message type and version */
+        32, 0, 0, 0, 0, 0, 0, 0 /* Header size, as in version 2 */
+    };
+    sprintf((char *)&handshake[24], "127.0.0.1:9002");
+    TCP_CLIENT_CONNECT(9001);
+    TCP_CLIENT_SEND(handshake, sizeof handshake);
+    TCP_CLIENT_SEND(message, sizeof message);
+    f->io.data = NULL; /* recvCb() must not be invoked */
+    LOOP_RUN(2);
+    return MUNIT_OK;
+}
+
 /* The backend is closed just before accepting a new connection. */
 TEST(recv, closeBeforeAccept, setUp, tearDownDeps, 0, NULL)
 {
@@ -0,0 +1,213 @@
+#include "../../include/raft.h"
+#include "../../include/raft/uv.h"
+#include "../lib/fsm.h"
+#include "../lib/runner.h"
+#include "../lib/uv.h"
+
+/******************************************************************************
+ *
+ * Fixture with a follower raft instance using the libuv raft_io backend, and a
+ * bare raft_io instance acting as its leader.
+ *
+ *****************************************************************************/
+
+#define N_ENTRIES 3
+
+struct fixture
+{
+    FIXTURE_UV_DEPS;
+    FIXTURE_UV;
+    struct raft_fsm fsm;
+    struct raft raft;
+    char *leader_dir;
+    struct raft_uv_transport leader_transport;
+    struct raft_io leader;
+    uint64_t data[N_ENTRIES];
+    struct raft_entry entries[N_ENTRIES];
+    unsigned n_sent;           /* Completed send requests */
+    unsigned n_results;        /* AppendEntries results received */
+    raft_index last_log_index; /* Index in the last result received */
+    bool closed;
+};
+
+/******************************************************************************
+ *
+ * Helper macros
+ *
+ *****************************************************************************/
+
+static void closeCb(struct raft *r)
+{
+    struct fixture *f = r->data;
+    f->closed = true;
+}
+
+static void sendCb(struct raft_io_send *req, int status)
+{
+    struct fixture *f = req->data;
+    munit_assert_int(status, ==, 0);
+    f->n_sent++;
+}
+
+static void leaderRecvCb(struct raft_io *io, struct raft_message *message)
+{
+    struct fixture *f = io->data;
+    munit_assert_int(message->type, ==, RAFT_APPEND_ENTRIES_RESULT);
+    munit_assert_ullong(message->append_entries_result.rejected, ==, 0);
+    f->n_results++;
+    f->last_log_index = message->append_entries_result.last_log_index;
+}
+
+/* Make the leader send an AppendEntries message in term 2 carrying N of the
+ * fixture's entries starting at the I'th, which follow the entry at PREV_INDEX
+ * with term PREV_TERM. */
+#define SEND_APPEND_ENTRIES(REQ, PREV_INDEX, PREV_TERM, I, N)                \
+    do {                                                                     \
+        struct raft_message _message;                                        \
+        int _rv;                                                             \
+        _message.type = RAFT_APPEND_ENTRIES;                                 \
+        _message.server_id = 2;                                              \
+        _message.server_address = "127.0.0.1:9002";                          \
+        _message.append_entries.version = 0;                                 \
+        _message.append_entries.flags = 0;                                   \
+        _message.append_entries.term = 2;                                    \
+        _message.append_entries.prev_log_index = PREV_INDEX;                 \
+        _message.append_entries.prev_log_term = PREV_TERM;                   \
+        _message.append_entries.leader_commit = 1;                           \
+        _message.append_entries.entries = &f->entries[I];                    \
+        _message.append_entries.n_entries = N;                               \
+        (REQ)->data = f;                                                     \
+        _rv = f->leader.send(&f->leader, REQ, &_message, sendCb);            \
+        munit_assert_int(_rv, ==, 0);                                        \
+    } while (0)
+
+/* Run the loop until the leader receives N results overall. */
+#define RUN_UNTIL_RESULTS(N)                                                 \
+    do {                                                                     \
+        unsigned _i;                                                         \
+        for (_i = 0; _i < 1000; _i++) {                                      \
+            if (f->n_results >= N) {                                         \
+                break;                                                       \
+            }                                                                \
+            uv_run(&f->loop, UV_RUN_ONCE);                                   \
+        }                                                                    \
+        munit_assert_uint(f->n_results, ==, N);                              \
+    } while (0)
+
+/******************************************************************************
+ *
+ * Set up and tear down.
+ *
+ *****************************************************************************/
+
+static void *setUp(const MunitParameter params[], void *user_data)
+{
+    struct fixture *f = munit_malloc(sizeof *f);
+    struct raft_configuration configuration;
+    unsigned i;
+    int rv;
+
+    SETUP_UV_DEPS;
+
+    /* The leader, a bare raft_io instance which just collects results. */
+    f->leader_dir = DirSetUp(params, user_data);
+    f->leader_transport.version = 1;
+    rv = raft_uv_tcp_init(&f->leader_transport, &f->loop);
+    munit_assert_int(rv, ==, 0);
+    rv = raft_uv_init(&f->leader, &f->loop, f->leader_dir,
+                      &f->leader_transport);
+    munit_assert_int(rv, ==, 0);
+    rv = f->leader.init(&f->leader, 1, "127.0.0.1:9001");
+    munit_assert_int(rv, ==, 0);
+    f->leader.version = 0; /* Magic value to avoid assuming that data is raft */
+    f->leader.data = f;
+    rv = f->leader.start(&f->leader, 10000, NULL, leaderRecvCb);
+    munit_assert_int(rv, ==, 0);
+
+    /* The follower. */
+    rv = raft_uv_init(&f->io, &f->loop, f->dir, &f->transport);
+    munit_assert_int(rv, ==, 0);
+    FsmInit(&f->fsm, 2);
+    rv = raft_init(&f->raft, &f->io, &f->fsm, 2, "127.0.0.1:9002");
+    munit_assert_int(rv, ==, 0);
+    f->raft.data = f;
+    raft_configuration_init(&configuration);
+    rv = raft_configuration_add(&configuration, 1, "127.0.0.1:9001",
+                                RAFT_VOTER);
+    munit_assert_int(rv, ==, 0);
+    rv = raft_configuration_add(&configuration, 2, "127.0.0.1:9002",
+                                RAFT_VOTER);
+    munit_assert_int(rv, ==, 0);
+    rv = raft_bootstrap(&f->raft, &configuration);
+    munit_assert_int(rv, ==, 0);
+    raft_configuration_close(&configuration);
+    rv = raft_start(&f->raft);
+    munit_assert_int(rv, ==, 0);
+
+    for (i = 0; i < N_ENTRIES; i++) {
+        f->data[i] = i + 1;
+        f->entries[i].term = 2;
+        f->entries[i].type = RAFT_COMMAND;
+        f->entries[i].buf.base = &f->data[i];
+        f->entries[i].buf.len = sizeof f->data[i];
+        f->entries[i].batch = NULL;
+    }
+    f->n_sent = 0;
+    f->n_results = 0;
+    f->last_log_index = 0;
+    f->closed = false;
+
+    return f;
+}
+
+static void tearDown(void *data)
+{
+    struct fixture *f = data;
+    bool closed = false;
+
+    raft_close(&f->raft, closeCb);
+    LOOP_RUN_UNTIL(&f->closed);
+
+    f->leader.data = &closed;
+    f->leader.close(&f->leader, uvCloseCb);
+    LOOP_RUN_UNTIL(&closed);
+    raft_uv_close(&f->leader);
+    raft_uv_tcp_close(&f->leader_transport);
+    DirTearDown(f->leader_dir);
+
+    raft_uv_close(&f->io);
+    FsmClose(&f->fsm);
+    TEAR_DOWN_UV_DEPS;
+    free(f);
+}
+
+/******************************************************************************
+ *
+ * Messages received in the same loop iteration
+ *
+ *****************************************************************************/
+
+SUITE(recv_batch)
+
+/* AppendEntries messages received in the same loop iteration are handled with
+ * a single raft_step_batch() call: their entries are persisted at once and
+ * acknowledged with a single result. */
+TEST(recv_batch, appendEntries, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    struct raft_io_send reqs[N_ENTRIES + 1];
+
+    /* A heartbeat connects the two servers in both directions. */
+    SEND_APPEND_ENTRIES(&reqs[0], 1, 1, 0, 0);
+    RUN_UNTIL_RESULTS(1);
+    munit_assert_ullong(f->last_log_index, ==, 1);
+
+    SEND_APPEND_ENTRIES(&reqs[1], 1, 1, 0, 1);
+    SEND_APPEND_ENTRIES(&reqs[2], 2, 2, 1, 1);
+    SEND_APPEND_ENTRIES(&reqs[3], 3, 2, 2, 1);
+    RUN_UNTIL_RESULTS(2);
+    munit_assert_ullong(f->last_log_index, ==, 4);
+    munit_assert_uint(f->n_sent, ==, N_ENTRIES + 1);
+
+    return MUNIT_OK;
+}
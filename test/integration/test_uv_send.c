@@ -239,6 +239,39 @@ TEST(send, installSnapshot, setUp, tearDown, 0, NULL)
     return MUNIT_OK;
 }
 
+/* InstallSnapshot messages are sent over a dedicated connection, so other
+ * messages don't get stuck behind a large snapshot payload that can't be
+ * written out yet. */
+TEST(send, installSnapshotDoesNotBlock, setUp, tearDownDeps, 0, NULL)
+{
+    struct fixture *f = data;
+    struct raft_install_snapshot *p = &MESSAGE(0)->install_snapshot;
+    int rv;
+
+    MESSAGE(0)->type = RAFT_INSTALL_SNAPSHOT;
+
+    raft_configuration_init(&p->conf);
+    rv = raft_configuration_add(&p->conf, 1, "1", RAFT_VOTER);
+    munit_assert_int(rv, ==, 0);
+
+    /* Set a very large payload that is going to fill the socket buffer, since
+     * the server never reads from the connection. */
+    p->data.len = 1024 * 1024 * 64;
+    p->data.base = raft_calloc(1, p->data.len);
+    munit_assert_ptr_not_null(p->data.base);
+
+    SEND_SUBMIT(0 /* message */, 0 /* rv */, RAFT_CANCELED /* status */);
+    SEND(1);
+    munit_assert_false(_result0.done);
+
+    TEAR_DOWN_UV;
+
+    raft_configuration_close(&p->conf);
+    raft_free(p->data.base);
+
+    return MUNIT_OK;
+}
+
 /* A connection attempt fails asynchronously after the connect function
  * returns. */
 TEST(send, noConnection, setUp, tearDownDeps, 0, NULL)
@@ -299,20 +332,70 @@ TEST(send, badMessage, setUp, tearDown, 0, NULL)
 }
 
 /* Old send requests that have accumulated and could not yet be sent are
- * progressively evicted. */
+ * evicted once they exceed the send queue size. */
 TEST(send, evictOldPending, setUp, tearDownDeps, 0, NULL)
 {
     struct fixture *f = data;
+    raft_uv_set_send_queue_size(&f->io, 1);
     TCP_SERVER_STOP;
     SEND_SUBMIT(0 /* message */, 0 /* rv */, RAFT_NOCONNECTION /* status */);
+    SEND_SUBMIT(1 /* message */, 0 /* rv */, RAFT_NOCONNECTION /* status */);
+    SEND_SUBMIT(2 /* message */, 0 /* rv */, RAFT_NOCONNECTION /* status */);
+    SEND_SUBMIT(3 /* message */, 0 /* rv */, RAFT_CANCELED /* status */);
+    SEND_WAIT(0);
+    SEND_WAIT(1);
+    SEND_WAIT(2);
+    TEAR_DOWN_UV;
+    return MUNIT_OK;
+}
+
+/* Send requests are kept around while the peer is unreachable, as long as they
+ * fit in the send queue. */
+TEST(send, keepPending, setUp, tearDownDeps, 0, NULL)
+{
+    struct fixture *f = data;
+    TCP_SERVER_STOP;
+    SEND_SUBMIT(0 /* message */, 0 /* rv */, RAFT_CANCELED /* status */);
     SEND_SUBMIT(1 /* message */, 0 /* rv */, RAFT_CANCELED /* status */);
     SEND_SUBMIT(2 /* message */, 0 /* rv */, RAFT_CANCELED /* status */);
     SEND_SUBMIT(3 /* message */, 0 /* rv */, RAFT_CANCELED /* status */);
-    SEND_WAIT(0);
+    LOOP_RUN(10);
+    munit_assert_false(_result0.done);
     TEAR_DOWN_UV;
     return MUNIT_OK;
 }
 
+/* If the send queue is full, AppendEntries requests carrying entries are
+ * rejected, while other messages are still accepted. */
+TEST(send, queueFull, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    struct raft_entry entry;
+    entry.buf.base = raft_malloc(8);
+    entry.buf.len = 8;
+
+    raft_uv_set_send_queue_size(&f->io, 1);
+
+    MESSAGE(0)->type = RAFT_APPEND_ENTRIES;
+    MESSAGE(0)->append_entries.entries = &entry;
+    MESSAGE(0)->append_entries.n_entries = 1;
+    *MESSAGE(1) = *MESSAGE(0);
+    *MESSAGE(3) = *MESSAGE(0);
+
+    SEND_SUBMIT(0 /* message */, 0 /* rv */, 0 /* status */);
+    SEND_ERROR(1, RAFT_BUSY, "");
+    SEND_SUBMIT(2 /* message */, 0 /* rv */, 0 /* status */);
+    SEND_WAIT(0);
+    SEND_WAIT(2);
+
+    /* Once the queue is drained, entries can be sent again. */
+    SEND(3);
+
+    raft_free(entry.buf.base);
+
+    return MUNIT_OK;
+}
+
 /* After the connection is established the peer dies and then comes back a
  * little bit later. */
 TEST(send, reconnectAfterWriteError, setUp, tearDown, 0, NULL)
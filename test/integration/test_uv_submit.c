@@ -0,0 +1,310 @@
+#include <stdatomic.h>
+
+#include "../../include/raft/uv.h"
+#include "../lib/fsm.h"
+#include "../lib/runner.h"
+#include "../lib/uv.h"
+
+/******************************************************************************
+ *
+ * Fixture with a single-server raft instance and a submission queue.
+ *
+ *****************************************************************************/
+
+#define N_THREADS 4
+#define N_PER_THREAD 50
+
+struct fixture
+{
+    FIXTURE_UV_DEPS;
+    FIXTURE_UV;
+    struct raft_fsm fsm;
+    struct raft raft;
+    struct raft_uv_queue queue;
+    atomic_uint n_done;
+    bool raft_closed;
+    bool queue_closed;
+};
+
+/* A thread submitting commands and waiting for their completion. */
+struct submitter
+{
+    struct fixture *f;
+    uv_thread_t thread;
+    struct raft_uv_completion completion;
+    struct raft_uv_submit reqs[N_PER_THREAD];
+    unsigned n_completed;
+    uv_thread_t self;
+    bool same_thread; /* Whether all callbacks ran on the submitting thread */
+};
+
+/******************************************************************************
+ *
+ * Helper macros
+ *
+ *****************************************************************************/
+
+struct result
+{
+    int status;
+    bool done;
+};
+
+static void submitCbAssertResult(struct raft_uv_submit *req,
+                                 int status,
+                                 void *result)
+{
+    struct result *r = req->data;
+    (void)result;
+    munit_assert_int(status, ==, r->status);
+    r->done = true;
+}
+
+static void raftCloseCb(struct raft *r)
+{
+    struct fixture *f = r->data;
+    f->raft_closed = true;
+}
+
+static void queueCloseCb(struct raft_uv_queue *q)
+{
+    struct fixture *f = q->data;
+    f->queue_closed = true;
+}
+
+/* Close the raft instance. */
+#define RAFT_CLOSE                                                          \
+    do {                                                                    \
+        if (!f->raft_closed) {                                              \
+            raft_close(&f->raft, raftCloseCb);                              \
+            LOOP_RUN_UNTIL(&f->raft_closed);                                \
+        }                                                                   \
+    } while (0)
+
+/* Submit a command setting x to the given value. */
+#define APPLY_SUBMIT(REQ, VALUE, STATUS)                                    \
+    struct raft_uv_submit _req##REQ;                                        \
+    struct result _result##REQ = {STATUS, false};                           \
+    do {                                                                    \
+        struct raft_buffer _buf;                                            \
+        FsmEncodeSetX(VALUE, &_buf);                                        \
+        _req##REQ.data = &_result##REQ;                                     \
+        raft_uv_queue_apply(&f->queue, &_req##REQ, &_buf, NULL,             \
+                            submitCbAssertResult);                          \
+    } while (0)
+
+/* Wait for the request with the given name to complete. */
+#define SUBMIT_WAIT(REQ) LOOP_RUN_UNTIL(&_result##REQ.done)
+
+static void *setUp(const MunitParameter params[], void *user_data)
+{
+    struct fixture *f = munit_malloc(sizeof *f);
+    struct raft_configuration configuration;
+    int rv;
+
+    SETUP_UV_DEPS;
+    rv = raft_uv_init(&f->io, &f->loop, f->dir, &f->transport);
+    munit_assert_int(rv, ==, 0);
+    FsmInit(&f->fsm, 2);
+    rv = raft_init(&f->raft, &f->io, &f->fsm, 1, "127.0.0.1:9001");
+    munit_assert_int(rv, ==, 0);
+    f->raft.data = f;
+
+    raft_configuration_init(&configuration);
+    rv = raft_configuration_add(&configuration, 1, "127.0.0.1:9001",
+                                RAFT_VOTER);
+    munit_assert_int(rv, ==, 0);
+    rv = raft_bootstrap(&f->raft, &configuration);
+    munit_assert_int(rv, ==, 0);
+    raft_configuration_close(&configuration);
+
+    rv = raft_start(&f->raft);
+    munit_assert_int(rv, ==, 0);
+    munit_assert_int(raft_state(&f->raft), ==, RAFT_LEADER);
+
+    f->queue.data = f;
+    rv = raft_uv_queue_init(&f->queue, &f->loop, &f->raft);
+    munit_assert_int(rv, ==, 0);
+
+    atomic_init(&f->n_done, 0);
+    f->raft_closed = false;
+    f->queue_closed = false;
+
+    return f;
+}
+
+static void tearDown(void *data)
+{
+    struct fixture *f = data;
+    RAFT_CLOSE;
+    if (!f->queue_closed) {
+        raft_uv_queue_close(&f->queue, queueCloseCb);
+        LOOP_RUN_UNTIL(&f->queue_closed);
+    }
+    raft_uv_close(&f->io);
+    FsmClose(&f->fsm);
+    TEAR_DOWN_UV_DEPS;
+    free(f);
+}
+
+/******************************************************************************
+ *
+ * raft_uv_queue_apply
+ *
+ *****************************************************************************/
+
+SUITE(raft_uv_queue_apply)
+
+/* Submit a single command from the loop thread. */
+TEST(raft_uv_queue_apply, first, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    APPLY_SUBMIT(0, 123, 0);
+    SUBMIT_WAIT(0);
+    munit_assert_int(FsmGetX(&f->fsm), ==, 123);
+    return MUNIT_OK;
+}
+
+/* Commands submitted before the loop thread wakes up are appended together, in
+ * submission order. */
+TEST(raft_uv_queue_apply, batch, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    raft_index last = raft_last_index(&f->raft);
+    APPLY_SUBMIT(0, 1, 0);
+    APPLY_SUBMIT(1, 2, 0);
+    APPLY_SUBMIT(2, 3, 0);
+    SUBMIT_WAIT(2);
+    munit_assert_true(_result0.done);
+    munit_assert_true(_result1.done);
+    munit_assert_ullong(raft_last_index(&f->raft), ==, last + 3);
+    munit_assert_int(FsmGetX(&f->fsm), ==, 3);
+    return MUNIT_OK;
+}
+
+/* Requests that are still queued when the queue gets closed fail. */
+TEST(raft_uv_queue_apply, cancel, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    RAFT_CLOSE;
+    APPLY_SUBMIT(0, 1, RAFT_CANCELED);
+    raft_uv_queue_close(&f->queue, queueCloseCb);
+    munit_assert_true(_result0.done);
+    LOOP_RUN_UNTIL(&f->queue_closed);
+    return MUNIT_OK;
+}
+
+static void submitterCb(struct raft_uv_submit *req, int status, void *result)
+{
+    struct submitter *s = req->data;
+    uv_thread_t self = uv_thread_self();
+    (void)result;
+    munit_assert_int(status, ==, 0);
+    if (!uv_thread_equal(&self, &s->self)) {
+        s->same_thread = false;
+    }
+    s->n_completed++;
+    atomic_fetch_add(&s->f->n_done, 1);
+}
+
+static void submitterRun(void *arg)
+{
+    struct submitter *s = arg;
+    unsigned i;
+
+    s->self = uv_thread_self();
+    for (i = 0; i < N_PER_THREAD; i++) {
+        struct raft_buffer buf;
+        FsmEncodeAddX(1, &buf);
+        s->reqs[i].data = s;
+        raft_uv_queue_apply(&s->f->queue, &s->reqs[i], &buf, &s->completion,
+                            submitterCb);
+    }
+    while (s->n_completed < N_PER_THREAD) {
+        raft_uv_completion_run(&s->completion, true);
+    }
+}
+
+/* Several threads submit commands concurrently, and get their callbacks
+ * invoked on their own thread. */
+TEST(raft_uv_queue_apply, threads, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    struct submitter submitters[N_THREADS];
+    unsigned i;
+    int rv;
+
+    for (i = 0; i < N_THREADS; i++) {
+        struct submitter *s = &submitters[i];
+        s->f = f;
+        s->n_completed = 0;
+        s->same_thread = true;
+        rv = raft_uv_completion_init(&s->completion);
+        munit_assert_int(rv, ==, 0);
+        rv = uv_thread_create(&s->thread, submitterRun, s);
+        munit_assert_int(rv, ==, 0);
+    }
+
+    /* The FSM is updated on the loop thread, before the completions are
+     * handed to the submitters. */
+    while (FsmGetX(&f->fsm) < N_THREADS * N_PER_THREAD) {
+        uv_run(&f->loop, UV_RUN_ONCE);
+    }
+
+    for (i = 0; i < N_THREADS; i++) {
+        struct submitter *s = &submitters[i];
+        uv_thread_join(&s->thread);
+        munit_assert_true(s->same_thread);
+        raft_uv_completion_close(&s->completion);
+    }
+
+    munit_assert_uint(atomic_load(&f->n_done), ==, N_THREADS * N_PER_THREAD);
+
+    return MUNIT_OK;
+}
+
+/******************************************************************************
+ *
+ * raft_uv_queue_barrier
+ *
+ *****************************************************************************/
+
+SUITE(raft_uv_queue_barrier)
+
+/* A barrier submitted after a command completes after it. */
+TEST(raft_uv_queue_barrier, afterApply, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    struct raft_uv_submit req;
+    struct result result = {0, false};
+    APPLY_SUBMIT(0, 1, 0);
+    req.data = &result;
+    raft_uv_queue_barrier(&f->queue, &req, NULL, submitCbAssertResult);
+    LOOP_RUN_UNTIL(&result.done);
+    munit_assert_true(_result0.done);
+    return MUNIT_OK;
+}
+
+/* If the payload of a barrier can't be allocated, the request fails on the
+ * loop thread. */
+TEST(raft_uv_queue_barrier, oom, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    struct raft_uv_submit req;
+    struct result result = {0, false};
+
+    /* Let the queue allocate its batch arrays first. */
+    req.data = &result;
+    raft_uv_queue_barrier(&f->queue, &req, NULL, submitCbAssertResult);
+    LOOP_RUN_UNTIL(&result.done);
+
+    result.status = RAFT_NOMEM;
+    result.done = false;
+    HeapFaultConfig(&f->heap, 0 /* delay */, 1 /* repeat */);
+    HEAP_FAULT_ENABLE;
+    raft_uv_queue_barrier(&f->queue, &req, NULL, submitCbAssertResult);
+    munit_assert_false(result.done);
+    LOOP_RUN_UNTIL(&result.done);
+
+    return MUNIT_OK;
+}
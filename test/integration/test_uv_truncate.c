@@ -222,6 +222,21 @@ TEST(truncate, partialSegment, setUp, tearDownDeps, 0, NULL)
     return MUNIT_OK;
 }
 
+/* If the index to truncate is the first of a batch, the segment is cut at that
+ * batch. */
+TEST(truncate, batchBoundary, setUp, tearDownDeps, 0, NULL)
+{
+    struct fixture *f = data;
+    APPEND(2);
+    APPEND(2);
+    TRUNCATE(3);
+    APPEND(1);
+    ASSERT_ENTRIES(3,      /* n entries */
+                   1, 2, 5 /* entries data */
+    );
+    return MUNIT_OK;
+}
+
 /* The truncate request is issued while an append request is still pending. */
 TEST(truncate, pendingAppend, setUp, tearDownDeps, 0, NULL)
 {
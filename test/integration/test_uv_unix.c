@@ -0,0 +1,219 @@
+#include <stdio.h>
+#include <unistd.h>
+
+#include "../../include/raft.h"
+#include "../../include/raft/uv.h"
+#include "../lib/dir.h"
+#include "../lib/heap.h"
+#include "../lib/loop.h"
+#include "../lib/runner.h"
+
+/******************************************************************************
+ *
+ * Fixture with two Unix socket based raft_uv_transport objects.
+ *
+ *****************************************************************************/
+
+struct fixture
+{
+    FIXTURE_DIR;
+    FIXTURE_HEAP;
+    FIXTURE_LOOP;
+    struct raft_uv_transport server;
+    struct raft_uv_transport client;
+    char server_path[256];
+    char client_path[256];
+    bool server_closed;
+    bool client_closed;
+    bool accepted;
+};
+
+/******************************************************************************
+ *
+ * Helper macros
+ *
+ *****************************************************************************/
+
+struct result
+{
+    int status;
+    bool done;
+};
+
+static void closeCb(struct raft_uv_transport *transport)
+{
+    struct fixture *f = transport->data;
+    if (transport == &f->server) {
+        f->server_closed = true;
+    } else {
+        f->client_closed = true;
+    }
+}
+
+static void acceptCb(struct raft_uv_transport *t,
+                     raft_id id,
+                     const char *address,
+                     struct uv_stream_s *stream)
+{
+    struct fixture *f = t->data;
+    munit_assert_int(id, ==, 2);
+    munit_assert_string_equal(address, f->client_path);
+    f->accepted = true;
+    uv_close((struct uv_handle_s *)stream, (uv_close_cb)raft_free);
+}
+
+static void connectCbAssertResult(struct raft_uv_connect *req,
+                                  struct uv_stream_s *stream,
+                                  int status)
+{
+    struct result *result = req->data;
+    munit_assert_int(status, ==, result->status);
+    if (status == 0) {
+        uv_close((struct uv_handle_s *)stream, (uv_close_cb)raft_free);
+    }
+    result->done = true;
+}
+
+/* Initialize the given transport as server ID listening on PATH. */
+#define INIT(TRANSPORT, ID, PATH)                     \
+    do {                                              \
+        int _rv;                                      \
+        (TRANSPORT)->version = 1;                     \
+        _rv = raft_uv_unix_init(TRANSPORT, &f->loop); \
+        munit_assert_int(_rv, ==, 0);                 \
+        _rv = (TRANSPORT)->init(TRANSPORT, ID, PATH); \
+        munit_assert_int(_rv, ==, 0);                 \
+        (TRANSPORT)->data = f;                        \
+    } while (0)
+
+/* Start listening with the server transport and assert the result. */
+#define LISTEN(RV)                                    \
+    do {                                              \
+        int _rv;                                      \
+        _rv = f->server.listen(&f->server, acceptCb); \
+        munit_assert_int(_rv, ==, RV);                \
+    } while (0)
+
+/* Connect the client transport to the given path and wait for the connection
+ * attempt to complete with the given status. */
+#define CONNECT(PATH, STATUS)                               \
+    do {                                                    \
+        struct raft_uv_connect _req;                        \
+        struct result _result = {STATUS, false};            \
+        int _rv;                                            \
+        _req.data = &_result;                               \
+        _rv = f->client.connect(&f->client, &_req, 1, PATH, \
+                                connectCbAssertResult);     \
+        munit_assert_int(_rv, ==, 0);                       \
+        LOOP_RUN_UNTIL(&_result.done);                      \
+    } while (0)
+
+/******************************************************************************
+ *
+ * Set up and tear down.
+ *
+ *****************************************************************************/
+
+static void *setUp(const MunitParameter params[], void *user_data)
+{
+    struct fixture *f = munit_malloc(sizeof *f);
+    SET_UP_DIR;
+    SET_UP_HEAP;
+    SETUP_LOOP;
+    sprintf(f->server_path, "%s/1.sock", f->dir);
+    sprintf(f->client_path, "%s/2.sock", f->dir);
+    INIT(&f->server, 1, f->server_path);
+    INIT(&f->client, 2, f->client_path);
+    f->server_closed = false;
+    f->client_closed = false;
+    f->accepted = false;
+    return f;
+}
+
+static void tearDown(void *data)
+{
+    struct fixture *f = data;
+    f->server.close(&f->server, closeCb);
+    f->client.close(&f->client, closeCb);
+    LOOP_RUN_UNTIL(&f->server_closed);
+    LOOP_RUN_UNTIL(&f->client_closed);
+    raft_uv_tcp_close(&f->server);
+    raft_uv_tcp_close(&f->client);
+    TEAR_DOWN_LOOP;
+    TEAR_DOWN_HEAP;
+    TEAR_DOWN_DIR;
+    free(f);
+}
+
+/******************************************************************************
+ *
+ * Unix socket transport
+ *
+ *****************************************************************************/
+
+SUITE(unix)
+
+/* Connect to a server listening on a socket path and perform the handshake. */
+TEST(unix, handshake, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    LISTEN(0);
+    CONNECT(f->server_path, 0);
+    LOOP_RUN_UNTIL(&f->accepted);
+    return MUNIT_OK;
+}
+
+/* Nobody is listening on the given socket path. */
+TEST(unix, noListener, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    CONNECT(f->server_path, RAFT_NOCONNECTION);
+    return MUNIT_OK;
+}
+
+/* The socket path is already in use. */
+TEST(unix, alreadyBound, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    int rv;
+    LISTEN(0);
+    rv = f->client.init(&f->client, 2, f->server_path);
+    munit_assert_int(rv, ==, 0);
+    rv = f->client.listen(&f->client, acceptCb);
+    munit_assert_int(rv, ==, RAFT_IOERR);
+    return MUNIT_OK;
+}
+
+/* The socket path is too long. */
+TEST(unix, pathTooLong, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    struct raft_uv_connect req;
+    char path[256];
+    int rv;
+    memset(path, 'x', sizeof path - 1);
+    path[sizeof path - 1] = '\0';
+    rv = f->client.connect(&f->client, &req, 1, path, connectCbAssertResult);
+    munit_assert_int(rv, ==, RAFT_NOCONNECTION);
+    return MUNIT_OK;
+}
+
+/* Use a name in the abstract namespace. */
+TEST(unix, abstract, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+#if UV_VERSION_HEX >= 0x012e00
+    char path[64];
+    int rv;
+    sprintf(path, "@raft-test-%d", (int)getpid());
+    rv = f->server.init(&f->server, 1, path);
+    munit_assert_int(rv, ==, 0);
+    LISTEN(0);
+    CONNECT(path, 0);
+    LOOP_RUN_UNTIL(&f->accepted);
+    return MUNIT_OK;
+#else
+    (void)f;
+    return MUNIT_SKIP;
+#endif
+}
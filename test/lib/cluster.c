@@ -888,7 +888,11 @@ static void serverTimeout(struct test_server *s)
     struct raft_event event;
     int rv;
 
-    s->cluster->time = s->timeout;
+    /* A timeout that expired while the server wasn't stepped, for example
+     * when leaving quiescence, fires right away. */
+    if (s->timeout > s->cluster->time) {
+        s->cluster->time = s->timeout;
+    }
 
     event.time = s->cluster->time;
     event.type = RAFT_TIMEOUT;
@@ -1331,6 +1335,38 @@ void test_cluster_transfer(struct test_cluster *c,
     munit_assert_int(rv, ==, 0);
 }
 
+void test_cluster_congested(struct test_cluster *c,
+                            raft_id id,
+                            raft_id congested_id)
+{
+    struct test_server *server = clusterGetServer(c, id);
+    struct raft_event event;
+    int rv;
+
+    event.time = c->time;
+    event.type = RAFT_CONGESTED;
+    event.congested.server_id = congested_id;
+
+    rv = serverStep(server, &event);
+    munit_assert_int(rv, ==, 0);
+}
+
+void test_cluster_unreachable(struct test_cluster *c,
+                              raft_id id,
+                              raft_id unreachable_id)
+{
+    struct test_server *server = clusterGetServer(c, id);
+    struct raft_event event;
+    int rv;
+
+    event.time = c->time;
+    event.type = RAFT_UNREACHABLE;
+    event.unreachable.server_id = unreachable_id;
+
+    rv = serverStep(server, &event);
+    munit_assert_int(rv, ==, 0);
+}
+
 /* Update the PNRG seed of each server, to match the expected randomized
  * election timeout. */
 static void clusterSeed(struct test_cluster *c)
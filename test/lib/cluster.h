@@ -361,6 +361,18 @@ void test_cluster_transfer(struct test_cluster *c,
                            raft_id id,
                            raft_id transferee);
 
+/* Signal that the given server can't take more entries from the server with the
+ * given ID. */
+void test_cluster_congested(struct test_cluster *c,
+                            raft_id id,
+                            raft_id congested_id);
+
+/* Signal that the server with the given ID has lost its connection with the
+ * server with the given unreachable ID. */
+void test_cluster_unreachable(struct test_cluster *c,
+                              raft_id id,
+                              raft_id unreachable_id);
+
 /* Advance the cluster by completing a single asynchronous operation or firing a
  * timeout. */
 void test_cluster_step(struct test_cluster *c);
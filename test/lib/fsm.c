@@ -3,6 +3,17 @@
 #include "../../src/byte.h"
 #include "munit.h"
 
+/* Maximum number of queued asynchronous applies. */
+#define FSM_MAX_APPLYING 64
+
+/* Queued asynchronous apply. */
+struct fsmApplying
+{
+    struct raft_fsm_apply *req;
+    const struct raft_buffer *buf;
+    raft_fsm_apply_cb cb;
+};
+
 /* In-memory implementation of the raft_fsm interface. */
 struct fsm
 {
@@ -10,6 +21,8 @@ struct fsm
     int y;
     int lock;
     void *data;
+    struct fsmApplying applying[FSM_MAX_APPLYING];
+    unsigned n_applying;
 };
 
 /* Command codes */
@@ -53,6 +66,32 @@ static int fsmApply(struct raft_fsm *fsm,
     return 0;
 }
 
+static int fsmApplyAsync(struct raft_fsm *fsm,
+                         struct raft_fsm_apply *req,
+                         const struct raft_buffer *buf,
+                         raft_fsm_apply_cb cb)
+{
+    struct fsm *f = fsm->data;
+    munit_assert_uint(f->n_applying, <, FSM_MAX_APPLYING);
+    f->applying[f->n_applying].req = req;
+    f->applying[f->n_applying].buf = buf;
+    f->applying[f->n_applying].cb = cb;
+    f->n_applying++;
+    return 0;
+}
+
+static int fsmApplyAsyncImmediate(struct raft_fsm *fsm,
+                                  struct raft_fsm_apply *req,
+                                  const struct raft_buffer *buf,
+                                  raft_fsm_apply_cb cb)
+{
+    void *result;
+    int rv;
+    rv = fsmApply(fsm, buf, &result);
+    cb(req, rv, result);
+    return 0;
+}
+
 static int fsmRestore(struct raft_fsm *fsm, struct raft_buffer *buf)
 {
     struct fsm *f = fsm->data;
@@ -145,13 +184,14 @@ static int fsmSnapshotFinalize(struct raft_fsm *fsm,
 
 void FsmInit(struct raft_fsm *fsm, int version)
 {
-    struct fsm *f = munit_malloc(sizeof *fsm);
+    struct fsm *f = munit_malloc(sizeof *f);
     memset(fsm, 'x', sizeof(*fsm)); /* Fill  with garbage */
 
     f->x = 0;
     f->y = 0;
     f->lock = 0;
     f->data = NULL;
+    f->n_applying = 0;
 
     fsm->version = version;
     fsm->data = f;
@@ -164,6 +204,47 @@ void FsmInit(struct raft_fsm *fsm, int version)
     }
 }
 
+void FsmSetApplyAsync(struct raft_fsm *fsm)
+{
+    fsm->version = 4;
+    fsm->snapshot_async = NULL;
+    fsm->apply_async = fsmApplyAsync;
+}
+
+void FsmSetApplyAsyncImmediate(struct raft_fsm *fsm)
+{
+    fsm->version = 4;
+    fsm->snapshot_async = NULL;
+    fsm->apply_async = fsmApplyAsyncImmediate;
+}
+
+unsigned FsmApplyAsyncFlush(struct raft_fsm *fsm)
+{
+    struct fsm *f = fsm->data;
+    struct fsmApplying applying[FSM_MAX_APPLYING];
+    unsigned n = f->n_applying;
+    unsigned i;
+
+    /* Callbacks might queue more applies, so process a copy. */
+    memcpy(applying, f->applying, n * sizeof *applying);
+    f->n_applying = 0;
+
+    for (i = 0; i < n; i++) {
+        void *result;
+        int rv;
+        rv = fsmApply(fsm, applying[i].buf, &result);
+        applying[i].cb(applying[i].req, rv, result);
+    }
+
+    return n;
+}
+
+unsigned FsmApplyAsyncPending(struct raft_fsm *fsm)
+{
+    struct fsm *f = fsm->data;
+    return f->n_applying;
+}
+
 void FsmClose(struct raft_fsm *fsm)
 {
     struct fsm *f = fsm->data;
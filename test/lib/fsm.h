@@ -12,6 +12,22 @@ void FsmInit(struct raft_fsm *fsm, int version);
 /* Same as FsmInit but with asynchronous snapshots */
 void FsmInitAsync(struct raft_fsm *fsm, int version);
 
+/* Switch an FSM initialized with FsmInit to asynchronous applies: commands are
+ * queued and only applied when FsmApplyAsyncFlush() is called. */
+void FsmSetApplyAsync(struct raft_fsm *fsm);
+
+/* Switch an FSM initialized with FsmInit to asynchronous applies that complete
+ * immediately: commands are applied and their callbacks fired before
+ * apply_async() returns. */
+void FsmSetApplyAsyncImmediate(struct raft_fsm *fsm);
+
+/* Apply all queued commands in order, firing their callbacks. Return the number
+ * of commands that were applied. */
+unsigned FsmApplyAsyncFlush(struct raft_fsm *fsm);
+
+/* Return the number of queued commands. */
+unsigned FsmApplyAsyncPending(struct raft_fsm *fsm);
+
 void FsmClose(struct raft_fsm *fsm);
 
 /* Encode a command to set x to the given value. */
@@ -5,11 +5,15 @@
 #include "fault.h"
 #include "munit.h"
 
+/* The libuv raft_io implementation might allocate memory from multiple threads
+ * at once, e.g. when loading closed segments, so keep the count atomic and
+ * serialize access to the fault trigger. */
 struct heap
 {
     int n;              /* Number of outstanding allocations. */
     size_t alignment;   /* Value of last aligned alloc */
     struct Fault fault; /* Fault trigger. */
+    bool lock;          /* Spin lock protecting the fault trigger. */
 };
 
 static void heapInit(struct heap *h)
@@ -17,32 +21,44 @@ static void heapInit(struct heap *h)
     h->n = 0;
     h->alignment = 0;
     FaultInit(&h->fault);
+    h->lock = false;
+}
+
+/* Advance the fault trigger, holding the lock. */
+static bool heapFaultTick(struct heap *h)
+{
+    bool fault;
+    while (__atomic_test_and_set(&h->lock, __ATOMIC_ACQUIRE)) {
+    }
+    fault = FaultTick(&h->fault);
+    __atomic_clear(&h->lock, __ATOMIC_RELEASE);
+    return fault;
 }
 
 static void *heapMalloc(void *data, size_t size)
 {
     struct heap *h = data;
-    if (FaultTick(&h->fault)) {
+    if (heapFaultTick(h)) {
         return NULL;
     }
-    h->n++;
+    __atomic_add_fetch(&h->n, 1, __ATOMIC_RELAXED);
     return munit_malloc(size);
 }
 
 static void heapFree(void *data, void *ptr)
 {
     struct heap *h = data;
-    h->n--;
+    __atomic_sub_fetch(&h->n, 1, __ATOMIC_RELAXED);
     free(ptr);
 }
 
 static void *heapCalloc(void *data, size_t nmemb, size_t size)
 {
     struct heap *h = data;
-    if (FaultTick(&h->fault)) {
+    if (heapFaultTick(h)) {
         return NULL;
     }
-    h->n++;
+    __atomic_add_fetch(&h->n, 1, __ATOMIC_RELAXED);
     return munit_calloc(nmemb, size);
 }
 
@@ -50,14 +66,14 @@ static void *heapRealloc(void *data, void *ptr, size_t size)
 {
     struct heap *h = data;
 
-    if (FaultTick(&h->fault)) {
+    if (heapFaultTick(h)) {
         return NULL;
     }
 
     /* Increase the number of allocation only if ptr is NULL, since otherwise
      * realloc is a malloc plus a free. */
     if (ptr == NULL) {
-        h->n++;
+        __atomic_add_fetch(&h->n, 1, __ATOMIC_RELAXED);
     }
 
     ptr = realloc(ptr, size);
@@ -76,16 +92,16 @@ static void *heapAlignedAlloc(void *data, size_t alignment, size_t size)
     struct heap *h = data;
     void *p;
 
-    if (FaultTick(&h->fault)) {
+    if (heapFaultTick(h)) {
         return NULL;
     }
 
-    h->n++;
+    __atomic_add_fetch(&h->n, 1, __ATOMIC_RELAXED);
 
     p = aligned_alloc(alignment, size);
     munit_assert_ptr_not_null(p);
 
-    h->alignment = alignment;
+    __atomic_store_n(&h->alignment, alignment, __ATOMIC_RELAXED);
 
     return p;
 }
@@ -1,3 +1,9 @@
+#include <string.h>
+
+#ifdef LZ4_AVAILABLE
+#include <lz4frame.h>
+#endif
+
 #include "../../src/byte.h"
 #include "../../src/compress.h"
 #include "../lib/munit.h"
@@ -33,6 +39,114 @@ TEST(Compress, decompress, NULL, NULL, 0, NULL)
     return MUNIT_OK;
 }
 
+/* Compressing several buffers yields a single frame, holding their
+ * concatenation. */
+TEST(Compress, compressMultipleBuffers, NULL, NULL, 0, NULL)
+{
+    char errmsg[RAFT_ERRMSG_BUF_SIZE] = {0};
+    struct raft_buffer bufs[3];
+    struct raft_buffer compressed;
+    struct raft_buffer decompressed;
+    char content[1024];
+    unsigned i;
+    int rv;
+
+    for (i = 0; i < sizeof content; i++) {
+        content[i] = (char)('a' + i % 16);
+    }
+    bufs[0].base = content;
+    bufs[0].len = 512;
+    bufs[1].base = content;
+    bufs[1].len = 0;
+    bufs[2].base = content + 512;
+    bufs[2].len = 512;
+
+    rv = Compress(bufs, 3, &compressed, errmsg);
+    munit_assert_int(rv, ==, 0);
+    munit_assert_true(IsCompressed(compressed.base, compressed.len));
+    munit_assert_ulong(compressed.len, <, sizeof content);
+
+    rv = Decompress(compressed, &decompressed, errmsg);
+    munit_assert_int(rv, ==, 0);
+    munit_assert_ulong(decompressed.len, ==, sizeof content);
+    munit_assert_memory_equal(sizeof content, decompressed.base, content);
+
+    raft_free(compressed.base);
+    raft_free(decompressed.base);
+
+    return MUNIT_OK;
+}
+
+/* The frame must record the expected content size. */
+TEST(Compress, decompressExact, NULL, NULL, 0, NULL)
+{
+    char errmsg[RAFT_ERRMSG_BUF_SIZE] = {0};
+    struct raft_buffer compressed;
+    struct raft_buffer decompressed;
+    int rv;
+
+    compressed.base = lz4_data;
+    compressed.len = sizeof lz4_data;
+
+    rv = DecompressExact(compressed, strlen("hello world\n") + 1,
+                         &decompressed, errmsg);
+    munit_assert_int(rv, ==, 0);
+    munit_assert_string_equal(decompressed.base, "hello world\n");
+    raft_free(decompressed.base);
+
+    rv = DecompressExact(compressed, 1024, &decompressed, errmsg);
+    munit_assert_int(rv, ==, RAFT_MALFORMED);
+    munit_assert_string_equal(errmsg,
+                              "LZ4 frame content size is 13, expected 1024");
+
+    return MUNIT_OK;
+}
+
+/* A frame that doesn't record its content size is rejected. */
+TEST(Compress, decompressExactNoContentSize, NULL, NULL, 0, NULL)
+{
+    char errmsg[RAFT_ERRMSG_BUF_SIZE] = {0};
+    LZ4F_preferences_t prefs = LZ4F_INIT_PREFERENCES;
+    char content[64] = {0};
+    char frame[128];
+    struct raft_buffer compressed;
+    struct raft_buffer decompressed;
+    size_t n;
+    int rv;
+
+    prefs.frameInfo.contentSize = 0;
+    n = LZ4F_compressFrame(frame, sizeof frame, content, sizeof content,
+                           &prefs);
+    munit_assert_false(LZ4F_isError(n));
+
+    compressed.base = frame;
+    compressed.len = n;
+    rv = DecompressExact(compressed, sizeof content, &decompressed, errmsg);
+    munit_assert_int(rv, ==, RAFT_MALFORMED);
+    munit_assert_string_equal(errmsg,
+                              "LZ4 frame content size is 0, expected 64");
+
+    return MUNIT_OK;
+}
+
+/* A truncated frame fails instead of waiting for more input. */
+TEST(Compress, decompressTruncated, NULL, NULL, 0, NULL)
+{
+    char errmsg[RAFT_ERRMSG_BUF_SIZE] = {0};
+    struct raft_buffer compressed;
+    struct raft_buffer decompressed;
+    int rv;
+
+    compressed.base = lz4_data;
+    compressed.len = sizeof lz4_data - 8;
+
+    rv = Decompress(compressed, &decompressed, errmsg);
+    munit_assert_int(rv, ==, RAFT_IOERR);
+    munit_assert_string_equal(errmsg, "LZ4 frame is truncated");
+
+    return MUNIT_OK;
+}
+
 #else
 
 TEST(Compress, lz4Disabled, NULL, NULL, 0, NULL)
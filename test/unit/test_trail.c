@@ -152,6 +152,34 @@ TEST(trail, TermOf, setUp, tearDown, 0, NULL)
     return MUNIT_OK;
 }
 
+/* Get the first index of the term of an entry, and the last index of a term. */
+TEST(trail, TermBoundaries, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+
+    TrailAppend(&f->trail, 1); /* index 1, term 1 */
+    TrailAppend(&f->trail, 1); /* index 2, term 1 */
+    TrailAppend(&f->trail, 3); /* index 3, term 3 */
+    TrailAppend(&f->trail, 3); /* index 4, term 3 */
+    TrailAppend(&f->trail, 3); /* index 5, term 3 */
+
+    munit_assert_ullong(TrailTermStart(&f->trail, 1), ==, 1);
+    munit_assert_ullong(TrailTermStart(&f->trail, 2), ==, 1);
+    munit_assert_ullong(TrailTermStart(&f->trail, 4), ==, 3);
+    munit_assert_ullong(TrailTermStart(&f->trail, 5), ==, 3);
+
+    munit_assert_ullong(TrailTermEnd(&f->trail, 1), ==, 2);
+    munit_assert_ullong(TrailTermEnd(&f->trail, 2), ==, 0);
+    munit_assert_ullong(TrailTermEnd(&f->trail, 3), ==, 5);
+    munit_assert_ullong(TrailTermEnd(&f->trail, 4), ==, 0);
+
+    /* Entries deleted by a snapshot are not considered. */
+    TrailSnapshot(&f->trail, 4, 1);
+    munit_assert_ullong(TrailTermStart(&f->trail, 5), ==, 4);
+
+    return MUNIT_OK;
+}
+
 /* Truncate the trail removing information about all entries past the given
  * index (included). */
 TEST(trail, Truncate, setUp, tearDown, 0, NULL)
@@ -0,0 +1,438 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <uv.h>
+
+#include "../../include/raft.h"
+#include "../../include/raft/uv.h"
+
+#include "cluster.h"
+#include "cluster_parse.h"
+#include "fs.h"
+
+/* TCP port of the first server, the others use the following ones. */
+#define BASE_PORT 9001
+
+/* The first server should win the first election, the others shouldn't even
+ * try while the benchmark is running. */
+#define LEADER_ELECTION_TIMEOUT 200
+#define FOLLOWER_ELECTION_TIMEOUT 60000
+
+/* Resolution of the commit latency histogram, in nanoseconds. */
+#define HISTOGRAM_GAP 1000
+
+/* Number of buckets of the commit latency histogram, covering one second. */
+#define HISTOGRAM_BUCKETS (1000 * 1000)
+
+/* Percentiles of the commit latency to report. */
+static const struct
+{
+    const char *name;
+    double value;
+} percentiles[] = {{"p50", 0.50}, {"p99", 0.99}, {"p999", 0.999}};
+
+struct cluster;
+
+struct server
+{
+    struct cluster *cluster;
+    char *dir;
+    char *address;
+    struct raft_uv_transport transport;
+    struct raft_io io;
+    struct raft_fsm fsm;
+    struct raft raft;
+};
+
+/* Apply request for a batch of entries. */
+struct request
+{
+    struct raft_apply req;
+    unsigned long start; /* Submission time */
+    unsigned n;          /* Number of entries in the batch */
+};
+
+struct cluster
+{
+    struct uv_loop_s *loop;
+    struct uv_timer_s timer;   /* Wait for the leader, then close */
+    struct server *servers;    /* All servers, the first one is the leader */
+    unsigned n_servers;        /* Number of servers */
+    struct request *requests;  /* Apply requests */
+    struct raft_buffer *bufs;  /* Entries submitted by a single request */
+    size_t buf;                /* Size of each entry */
+    unsigned batch;            /* Entries in each apply request */
+    unsigned concurrency;      /* Apply requests in flight */
+    unsigned n;                /* Total number of entries to submit */
+    unsigned submitted;        /* Entries submitted so far */
+    unsigned committed;        /* Entries committed so far */
+    unsigned n_closed;         /* Number of raft instances closed */
+    struct histogram latency;  /* Commit latency of apply requests */
+    unsigned long start;       /* Submission time of the first request */
+    unsigned long duration;    /* Time until the last entry got committed */
+};
+
+static int fsmApply(struct raft_fsm *fsm,
+                    const struct raft_buffer *buf,
+                    void **result)
+{
+    (void)fsm;
+    (void)buf;
+    *result = NULL;
+    return 0;
+}
+
+static int serverInit(struct server *s,
+                      struct cluster *c,
+                      struct clusterOptions *opts,
+                      unsigned i)
+{
+    raft_id id = i + 1;
+    int rv;
+
+    s->cluster = c;
+
+    rv = FsCreateTempDir(opts->dir, &s->dir);
+    if (rv != 0) {
+        printf("failed to create temp dir\n");
+        return -1;
+    }
+
+    s->transport.version = 1;
+    s->transport.data = NULL;
+    if (opts->unix_socket) {
+        rv = asprintf(&s->address, "%s/raft.sock", s->dir);
+        assert(rv > 0);
+        rv = raft_uv_unix_init(&s->transport, c->loop);
+    } else {
+        rv = asprintf(&s->address, "127.0.0.1:%u", BASE_PORT + i);
+        assert(rv > 0);
+        rv = raft_uv_tcp_init(&s->transport, c->loop);
+    }
+    if (rv != 0) {
+        printf("failed to init transport\n");
+        return -1;
+    }
+
+    rv = raft_uv_init(&s->io, c->loop, s->dir, &s->transport);
+    if (rv != 0) {
+        printf("failed to init io\n");
+        return -1;
+    }
+
+    s->fsm.version = 1;
+    s->fsm.apply = fsmApply;
+    s->fsm.snapshot = NULL;
+    s->fsm.restore = NULL;
+
+    rv = raft_init(&s->raft, &s->io, &s->fsm, id, s->address);
+    if (rv != 0) {
+        printf("failed to init raft\n");
+        return -1;
+    }
+    s->raft.data = s;
+
+    if (i == 0) {
+        raft_set_election_timeout(&s->raft, LEADER_ELECTION_TIMEOUT);
+    } else {
+        raft_set_election_timeout(&s->raft, FOLLOWER_ELECTION_TIMEOUT);
+    }
+
+    /* Effectively disable snapshotting. */
+    raft_set_snapshot_threshold(&s->raft, 1024 * 1024 * 1024);
+
+    return 0;
+}
+
+static int serverBootstrap(struct server *s,
+                           struct raft_configuration *configuration)
+{
+    int rv;
+
+    rv = raft_bootstrap(&s->raft, configuration);
+    if (rv != 0) {
+        printf("failed to bootstrap\n");
+        return -1;
+    }
+
+    rv = raft_start(&s->raft);
+    if (rv != 0) {
+        printf("failed to start raft '%s'\n", raft_strerror(rv));
+        return -1;
+    }
+
+    return 0;
+}
+
+static int serverClose(struct server *s)
+{
+    int rv;
+
+    raft_uv_close(&s->io);
+    raft_uv_tcp_close(&s->transport);
+
+    rv = FsRemoveTempDir(s->dir);
+    if (rv != 0) {
+        printf("failed to remove temp dir\n");
+        return -1;
+    }
+    free(s->address);
+
+    return 0;
+}
+
+static int clusterInit(struct cluster *c,
+                       struct clusterOptions *opts,
+                       struct uv_loop_s *loop)
+{
+    struct raft_configuration configuration;
+    unsigned i;
+    int rv;
+
+    c->loop = loop;
+    c->n_servers = opts->servers;
+    c->buf = opts->buf;
+    c->batch = opts->batch;
+    c->concurrency = opts->concurrency;
+    c->n = opts->n;
+    c->submitted = 0;
+    c->committed = 0;
+    c->n_closed = 0;
+    c->start = 0;
+    c->duration = 0;
+
+    c->servers = calloc(c->n_servers, sizeof *c->servers);
+    assert(c->servers != NULL);
+    c->requests = calloc(c->concurrency, sizeof *c->requests);
+    assert(c->requests != NULL);
+    c->bufs = calloc(c->batch, sizeof *c->bufs);
+    assert(c->bufs != NULL);
+
+    HistogramInit(&c->latency, HISTOGRAM_BUCKETS, HISTOGRAM_GAP);
+
+    uv_timer_init(loop, &c->timer);
+    c->timer.data = c;
+
+    for (i = 0; i < c->n_servers; i++) {
+        rv = serverInit(&c->servers[i], c, opts, i);
+        if (rv != 0) {
+            return -1;
+        }
+    }
+
+    raft_configuration_init(&configuration);
+    for (i = 0; i < c->n_servers; i++) {
+        struct server *s = &c->servers[i];
+        rv = raft_configuration_add(&configuration, s->raft.id, s->address,
+                                    RAFT_VOTER);
+        if (rv != 0) {
+            printf("failed to populate configuration\n");
+            return -1;
+        }
+    }
+    for (i = 0; i < c->n_servers; i++) {
+        rv = serverBootstrap(&c->servers[i], &configuration);
+        if (rv != 0) {
+            return -1;
+        }
+    }
+    raft_configuration_close(&configuration);
+
+    return 0;
+}
+
+static int clusterCleanup(struct cluster *c)
+{
+    unsigned i;
+    int rv;
+
+    for (i = 0; i < c->n_servers; i++) {
+        rv = serverClose(&c->servers[i]);
+        if (rv != 0) {
+            return -1;
+        }
+    }
+
+    HistogramClose(&c->latency);
+    free(c->bufs);
+    free(c->requests);
+    free(c->servers);
+
+    return 0;
+}
+
+static void raftCloseCb(struct raft *r)
+{
+    struct server *s = r->data;
+    struct cluster *c = s->cluster;
+    c->n_closed++;
+    if (c->n_closed == c->n_servers) {
+        uv_close((struct uv_handle_s *)&c->timer, NULL);
+    }
+}
+
+static void clusterCloseTimerCb(uv_timer_t *timer)
+{
+    struct cluster *c = timer->data;
+    unsigned i;
+    for (i = 0; i < c->n_servers; i++) {
+        raft_close(&c->servers[i].raft, raftCloseCb);
+    }
+}
+
+static void applyCb(struct raft_apply *req, int status, void *result);
+
+/* Submit the next batch of entries using the given request object. */
+static void submitRequest(struct cluster *c, struct request *request)
+{
+    struct raft *r = &c->servers[0].raft;
+    unsigned n = c->batch;
+    unsigned i;
+    int rv;
+
+    if (n > c->n - c->submitted) {
+        n = c->n - c->submitted;
+    }
+    assert(n > 0);
+
+    for (i = 0; i < n; i++) {
+        c->bufs[i].len = c->buf;
+        c->bufs[i].base = raft_malloc(c->buf);
+        assert(c->bufs[i].base != NULL);
+        memset(c->bufs[i].base, 0, c->buf);
+    }
+
+    request->req.data = c;
+    request->n = n;
+    request->start = (unsigned long)uv_hrtime();
+
+    rv = raft_apply(r, &request->req, c->bufs, n, applyCb);
+    if (rv != 0) {
+        printf("failed to apply entries: %s\n", raft_strerror(rv));
+        exit(1);
+    }
+    c->submitted += n;
+}
+
+static void applyCb(struct raft_apply *req, int status, void *result)
+{
+    struct cluster *c = req->data;
+    struct request *request = (struct request *)req;
+    unsigned long now = (unsigned long)uv_hrtime();
+
+    (void)result;
+
+    if (status != 0) {
+        printf("apply failed: %s\n", raft_strerror(status));
+        exit(1);
+    }
+
+    HistogramCount(&c->latency, now - request->start);
+    c->committed += request->n;
+
+    if (c->submitted < c->n) {
+        submitRequest(c, request);
+        return;
+    }
+
+    if (c->committed == c->n) {
+        c->duration = now - c->start;
+        /* Run raft_close in the next loop iteration, to avoid calling it from
+         * this commit callback. */
+        uv_timer_start(&c->timer, clusterCloseTimerCb, 0, 0);
+    }
+}
+
+/* Wait for the first server to become leader, then start submitting. */
+static void clusterLeaderTimerCb(uv_timer_t *timer)
+{
+    struct cluster *c = timer->data;
+    unsigned i;
+
+    if (raft_state(&c->servers[0].raft) != RAFT_LEADER) {
+        return;
+    }
+    uv_timer_stop(timer);
+
+    c->start = (unsigned long)uv_hrtime();
+    for (i = 0; i < c->concurrency && c->submitted < c->n; i++) {
+        submitRequest(c, &c->requests[i]);
+    }
+}
+
+int ClusterRun(int argc, char *argv[], struct report *report)
+{
+    struct clusterOptions opts;
+    struct uv_loop_s loop;
+    struct cluster cluster;
+    struct metric *m;
+    struct benchmark *benchmark;
+    const char *transport;
+    double entries_per_second;
+    char *name;
+    unsigned i;
+    int rv;
+
+    ClusterParse(argc, argv, &opts);
+
+    rv = uv_loop_init(&loop);
+    if (rv != 0) {
+        printf("failed to init loop\n");
+        return -1;
+    }
+
+    rv = clusterInit(&cluster, &opts, &loop);
+    if (rv != 0) {
+        printf("failed to init cluster\n");
+        return -1;
+    }
+
+    uv_timer_start(&cluster.timer, clusterLeaderTimerCb, 10, 10);
+
+    rv = uv_run(&loop, UV_RUN_DEFAULT);
+    if (rv != 0) {
+        printf("failed to run loop\n");
+        return -1;
+    }
+
+    uv_loop_close(&loop);
+
+    transport = opts.unix_socket ? "unix" : "tcp";
+
+    for (i = 0; i < sizeof percentiles / sizeof *percentiles; i++) {
+        rv = asprintf(&name, "cluster:%s:%u:%zu:%u:%u:%s", transport,
+                      opts.servers, opts.buf, opts.concurrency, opts.batch,
+                      percentiles[i].name);
+        assert(rv > 0);
+        assert(name != NULL);
+        benchmark = ReportGrow(report, name);
+        m = BenchmarkGrow(benchmark, METRIC_KIND_LATENCY);
+        MetricFillPercentile(m, &cluster.latency, percentiles[i].value);
+    }
+
+    rv = asprintf(&name, "cluster:%s:%u:%zu:%u:%u:entries", transport,
+                  opts.servers, opts.buf, opts.concurrency, opts.batch);
+    assert(rv > 0);
+    assert(name != NULL);
+    benchmark = ReportGrow(report, name);
+    m = BenchmarkGrow(benchmark, METRIC_KIND_THROUGHPUT);
+    MetricFillThroughput(m, cluster.n, cluster.duration);
+    entries_per_second = m->value;
+
+    rv = asprintf(&name, "cluster:%s:%u:%zu:%u:%u:megabytes", transport,
+                  opts.servers, opts.buf, opts.concurrency, opts.batch);
+    assert(rv > 0);
+    assert(name != NULL);
+    benchmark = ReportGrow(report, name);
+    m = BenchmarkGrow(benchmark, METRIC_KIND_THROUGHPUT);
+    m->value = entries_per_second * (double)opts.buf / (1024 * 1024);
+
+    rv = clusterCleanup(&cluster);
+    if (rv != 0) {
+        printf("failed to cleanup\n");
+        return -1;
+    }
+
+    return 0;
+}
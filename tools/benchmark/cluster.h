@@ -0,0 +1,11 @@
+/* Run the cluster benchmark. */
+
+#ifndef CLUSTER_H_
+#define CLUSTER_H_
+
+#include "report.h"
+
+/* Run the cluster subcommand. */
+int ClusterRun(int argc, char *argv[], struct report *report);
+
+#endif /* CLUSTER_H_ */
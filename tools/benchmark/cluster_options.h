@@ -0,0 +1,21 @@
+/* Options for the cluster benchmark. */
+
+#ifndef CLUSTER_OPTIONS_H_
+#define CLUSTER_OPTIONS_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Options for the cluster benchmark */
+struct clusterOptions
+{
+    char *dir;            /* Directory to use for creating temporary files */
+    unsigned servers;     /* Number of voting servers in the cluster */
+    size_t buf;           /* Size of each entry to submit */
+    unsigned n;           /* Total number of entries to submit */
+    unsigned concurrency; /* Number of apply requests in flight */
+    unsigned batch;       /* Number of entries in each apply request */
+    bool unix_socket;     /* Use Unix sockets instead of loopback TCP */
+};
+
+#endif /* CLUSTER_OPTIONS_H_ */
@@ -0,0 +1,108 @@
+#include <argp.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cluster.h"
+#include "cluster_parse.h"
+
+#define MEGABYTE (1024 * 1024)
+
+static char doc[] = "Benchmark commit latency and throughput of a cluster\n";
+
+/* Order of fields: {NAME, KEY, ARG, FLAGS, DOC, GROUP}.*/
+static struct argp_option options[] = {
+    {"dir", 'd', "DIR", 0, "Directory to use for temp files (default '.')", 0},
+    {"servers", 's', "N", 0, "Number of voting servers (default 3)", 0},
+    {"buf", 'b', "BUF", 0, "Size of each entry to submit (default 1024)", 0},
+    {"n", 'n', "N", 0, "Total number of entries to submit (default 10000)", 0},
+    {"concurrency", 'c', "C", 0, "Apply requests in flight (default 1)", 0},
+    {"batch", 'B', "B", 0, "Entries in each apply request (default 1)", 0},
+    {"unix", 'u', 0, 0, "Use Unix sockets instead of loopback TCP", 0},
+    {0}};
+
+static error_t argpParser(int key, char *arg, struct argp_state *state);
+
+static struct argp argp = {
+    .options = options,
+    .parser = argpParser,
+    .doc = doc,
+};
+
+static error_t argpParser(int key, char *arg, struct argp_state *state)
+{
+    struct clusterOptions *opts = state->input;
+
+    switch (key) {
+        case 'd':
+            opts->dir = arg;
+            break;
+        case 's':
+            opts->servers = (unsigned)atoi(arg);
+            break;
+        case 'b':
+            opts->buf = (unsigned)atoi(arg);
+            break;
+        case 'n':
+            opts->n = (unsigned)atoi(arg);
+            break;
+        case 'c':
+            opts->concurrency = (unsigned)atoi(arg);
+            break;
+        case 'B':
+            opts->batch = (unsigned)atoi(arg);
+            break;
+        case 'u':
+            opts->unix_socket = true;
+            break;
+        default:
+            return ARGP_ERR_UNKNOWN;
+    }
+
+    return 0;
+}
+
+static void optionsInit(struct clusterOptions *opts)
+{
+    opts->dir = ".";
+    opts->servers = 3;
+    opts->buf = 1024;
+    opts->n = 10000;
+    opts->concurrency = 1;
+    opts->batch = 1;
+    opts->unix_socket = false;
+}
+
+static void optionsCheck(struct clusterOptions *opts)
+{
+    if (opts->servers == 0) {
+        printf("Invalid number of servers %u\n", opts->servers);
+        exit(1);
+    }
+    if (opts->buf == 0 || opts->buf > MEGABYTE) {
+        printf("Invalid entry size %zu\n", opts->buf);
+        exit(1);
+    }
+    if (opts->n == 0) {
+        printf("Invalid number of entries %u\n", opts->n);
+        exit(1);
+    }
+    if (opts->concurrency == 0) {
+        printf("Invalid concurrency %u\n", opts->concurrency);
+        exit(1);
+    }
+    if (opts->batch == 0 || opts->batch > opts->n) {
+        printf("Invalid batch size %u\n", opts->batch);
+        exit(1);
+    }
+}
+
+void ClusterParse(int argc, char *argv[], struct clusterOptions *opts)
+{
+    optionsInit(opts);
+
+    argv[0] = "benchmark/run cluster";
+    argp_parse(&argp, argc, argv, 0, 0, opts);
+
+    optionsCheck(opts);
+}
@@ -0,0 +1,11 @@
+/* Parse command line arguments for the cluster benchmark. */
+
+#ifndef CLUSTER_PARSE_H_
+#define CLUSTER_PARSE_H_
+
+#include "cluster_options.h"
+
+/* Parse the given command line arguments. */
+void ClusterParse(int argc, char *argv[], struct clusterOptions *opts);
+
+#endif /* CLUSTER_PARSE_H_ */
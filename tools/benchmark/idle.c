@@ -0,0 +1,331 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <uv.h>
+
+#include "../../include/raft.h"
+#include "../../include/raft/uv.h"
+
+#include "fs.h"
+#include "idle.h"
+#include "idle_parse.h"
+
+/* TCP port of the first server, the others use the following ones. */
+#define BASE_PORT 9101
+
+struct idle;
+
+struct server
+{
+    struct idle *idle;
+    char *dir;
+    char *address;
+    struct raft_uv_transport transport;
+    struct raft_io io;
+    struct raft_fsm fsm;
+    struct raft raft;
+};
+
+/* A cluster whose servers all run on the same loop. The time taken to elect a
+ * leader is measured, then the cluster is left idle and the loop iterations
+ * are counted: each one is a wakeup of the process. */
+struct idle
+{
+    struct idleOptions *opts;
+    struct uv_loop_s *loop;
+    struct server *servers;
+    struct uv_check_s check;   /* Watch for a leader */
+    struct uv_prepare_s count; /* Count loop iterations */
+    struct uv_timer_s timer;   /* End of the idle window */
+    unsigned long start;       /* Time the servers were started */
+    unsigned long election;    /* Time until a leader got elected */
+    unsigned long wakeups;     /* Loop iterations since the election */
+    unsigned n_closed;         /* Number of raft instances closed */
+};
+
+static int fsmApply(struct raft_fsm *fsm,
+                    const struct raft_buffer *buf,
+                    void **result)
+{
+    (void)fsm;
+    (void)buf;
+    *result = NULL;
+    return 0;
+}
+
+static int serverInit(struct server *s, struct idle *i, unsigned k)
+{
+    raft_id id = k + 1;
+    int rv;
+
+    s->idle = i;
+
+    rv = FsCreateTempDir(i->opts->dir, &s->dir);
+    if (rv != 0) {
+        printf("failed to create temp dir\n");
+        return -1;
+    }
+
+    rv = asprintf(&s->address, "127.0.0.1:%u", BASE_PORT + k);
+    assert(rv > 0);
+    s->transport.version = 1;
+    s->transport.data = NULL;
+    rv = raft_uv_tcp_init(&s->transport, i->loop);
+    if (rv != 0) {
+        printf("failed to init transport\n");
+        return -1;
+    }
+
+    rv = raft_uv_init(&s->io, i->loop, s->dir, &s->transport);
+    if (rv != 0) {
+        printf("failed to init io\n");
+        return -1;
+    }
+
+    /* Without a deadline setter raft falls back to fixed-interval ticks. */
+    if (i->opts->periodic) {
+        s->io.set_deadline = NULL;
+    }
+
+    s->fsm.version = 1;
+    s->fsm.apply = fsmApply;
+    s->fsm.snapshot = NULL;
+    s->fsm.restore = NULL;
+
+    rv = raft_init(&s->raft, &s->io, &s->fsm, id, s->address);
+    if (rv != 0) {
+        printf("failed to init raft\n");
+        return -1;
+    }
+    s->raft.data = s;
+    raft_set_election_timeout(&s->raft, i->opts->timeout);
+    raft_set_heartbeat_timeout(&s->raft, i->opts->timeout / 10);
+    raft_set_quiescence(&s->raft, i->opts->quiesce);
+
+    return 0;
+}
+
+static int serverClose(struct server *s)
+{
+    int rv;
+
+    raft_uv_close(&s->io);
+    raft_uv_tcp_close(&s->transport);
+
+    rv = FsRemoveTempDir(s->dir);
+    if (rv != 0) {
+        printf("failed to remove temp dir\n");
+        return -1;
+    }
+    free(s->address);
+
+    return 0;
+}
+
+static void countCb(uv_prepare_t *prepare)
+{
+    struct idle *i = prepare->data;
+    i->wakeups++;
+}
+
+static void raftCloseCb(struct raft *r)
+{
+    struct server *s = r->data;
+    struct idle *i = s->idle;
+    i->n_closed++;
+    if (i->n_closed == i->opts->servers) {
+        uv_close((struct uv_handle_s *)&i->timer, NULL);
+    }
+}
+
+static void idleTimerCb(uv_timer_t *timer)
+{
+    struct idle *i = timer->data;
+    unsigned k;
+
+    uv_prepare_stop(&i->count);
+    uv_close((struct uv_handle_s *)&i->count, NULL);
+    for (k = 0; k < i->opts->servers; k++) {
+        raft_close(&i->servers[k].raft, raftCloseCb);
+    }
+}
+
+/* Once a leader is elected, start counting wakeups during the idle window. */
+static void checkCb(uv_check_t *check)
+{
+    struct idle *i = check->data;
+    unsigned k;
+
+    for (k = 0; k < i->opts->servers; k++) {
+        if (raft_state(&i->servers[k].raft) == RAFT_LEADER) {
+            break;
+        }
+    }
+    if (k == i->opts->servers) {
+        return;
+    }
+
+    i->election = (unsigned long)uv_hrtime() - i->start;
+    uv_check_stop(check);
+    uv_close((struct uv_handle_s *)check, NULL);
+
+    uv_prepare_start(&i->count, countCb);
+    uv_timer_start(&i->timer, idleTimerCb, i->opts->duration, 0);
+}
+
+static int idleInit(struct idle *i,
+                    struct idleOptions *opts,
+                    struct uv_loop_s *loop)
+{
+    struct raft_configuration configuration;
+    unsigned k;
+    int rv;
+
+    i->opts = opts;
+    i->loop = loop;
+    i->election = 0;
+    i->wakeups = 0;
+    i->n_closed = 0;
+
+    i->servers = calloc(opts->servers, sizeof *i->servers);
+    assert(i->servers != NULL);
+
+    uv_check_init(loop, &i->check);
+    i->check.data = i;
+    uv_prepare_init(loop, &i->count);
+    i->count.data = i;
+    uv_timer_init(loop, &i->timer);
+    i->timer.data = i;
+
+    for (k = 0; k < opts->servers; k++) {
+        rv = serverInit(&i->servers[k], i, k);
+        if (rv != 0) {
+            return -1;
+        }
+    }
+
+    raft_configuration_init(&configuration);
+    for (k = 0; k < opts->servers; k++) {
+        struct server *s = &i->servers[k];
+        rv = raft_configuration_add(&configuration, s->raft.id, s->address,
+                                    RAFT_VOTER);
+        if (rv != 0) {
+            printf("failed to populate configuration\n");
+            return -1;
+        }
+    }
+
+    i->start = (unsigned long)uv_hrtime();
+    for (k = 0; k < opts->servers; k++) {
+        struct raft *r = &i->servers[k].raft;
+        rv = raft_bootstrap(r, &configuration);
+        if (rv != 0) {
+            printf("failed to bootstrap\n");
+            return -1;
+        }
+        rv = raft_start(r);
+        if (rv != 0) {
+            printf("failed to start raft '%s'\n", raft_strerror(rv));
+            return -1;
+        }
+    }
+    raft_configuration_close(&configuration);
+
+    uv_check_start(&i->check, checkCb);
+
+    return 0;
+}
+
+static int idleCleanup(struct idle *i)
+{
+    unsigned k;
+    int rv;
+
+    for (k = 0; k < i->opts->servers; k++) {
+        rv = serverClose(&i->servers[k]);
+        if (rv != 0) {
+            return -1;
+        }
+    }
+    free(i->servers);
+
+    return 0;
+}
+
+int IdleRun(int argc, char *argv[], struct report *report)
+{
+    struct idleOptions opts;
+    struct uv_loop_s loop;
+    struct idle idle;
+    struct benchmark *benchmark;
+    struct metric *m;
+    unsigned long *elections;
+    unsigned long *wakeups;
+    const char *ticks;
+    const char *quiesce;
+    char *name;
+    unsigned k;
+    int rv;
+
+    IdleParse(argc, argv, &opts);
+
+    elections = calloc(opts.n, sizeof *elections);
+    wakeups = calloc(opts.n, sizeof *wakeups);
+    assert(elections != NULL);
+    assert(wakeups != NULL);
+
+    for (k = 0; k < opts.n; k++) {
+        rv = uv_loop_init(&loop);
+        if (rv != 0) {
+            printf("failed to init loop\n");
+            return -1;
+        }
+
+        rv = idleInit(&idle, &opts, &loop);
+        if (rv != 0) {
+            printf("failed to init cluster\n");
+            return -1;
+        }
+
+        rv = uv_run(&loop, UV_RUN_DEFAULT);
+        if (rv != 0) {
+            printf("failed to run loop\n");
+            return -1;
+        }
+        uv_loop_close(&loop);
+
+        elections[k] = idle.election;
+        wakeups[k] = idle.wakeups * 1000 / opts.duration;
+
+        rv = idleCleanup(&idle);
+        if (rv != 0) {
+            printf("failed to cleanup\n");
+            return -1;
+        }
+    }
+
+    ticks = opts.periodic ? "periodic" : "deadline";
+    quiesce = opts.quiesce ? ":quiesce" : "";
+
+    rv = asprintf(&name, "idle:%s:%u:%u%s:election", ticks, opts.servers,
+                  opts.timeout, quiesce);
+    assert(rv > 0);
+    assert(name != NULL);
+    benchmark = ReportGrow(report, name);
+    m = BenchmarkGrow(benchmark, METRIC_KIND_LATENCY);
+    MetricFillSamples(m, elections, opts.n);
+
+    rv = asprintf(&name, "idle:%s:%u:%u%s:wakeups", ticks, opts.servers,
+                  opts.timeout, quiesce);
+    assert(rv > 0);
+    assert(name != NULL);
+    benchmark = ReportGrow(report, name);
+    m = BenchmarkGrow(benchmark, METRIC_KIND_THROUGHPUT);
+    MetricFillSamples(m, wakeups, opts.n);
+
+    free(wakeups);
+    free(elections);
+
+    return 0;
+}
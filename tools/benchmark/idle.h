@@ -0,0 +1,11 @@
+/* Run the idle benchmark. */
+
+#ifndef IDLE_H_
+#define IDLE_H_
+
+#include "report.h"
+
+/* Run the idle subcommand. */
+int IdleRun(int argc, char *argv[], struct report *report);
+
+#endif /* IDLE_H_ */
@@ -0,0 +1,20 @@
+/* Options for the idle benchmark. */
+
+#ifndef IDLE_OPTIONS_H_
+#define IDLE_OPTIONS_H_
+
+#include <stdbool.h>
+
+/* Options for the idle benchmark */
+struct idleOptions
+{
+    char *dir;         /* Directory to use for creating temporary files */
+    unsigned servers;  /* Number of voting servers in the cluster */
+    unsigned timeout;  /* Election timeout in milliseconds */
+    unsigned duration; /* Length of the idle window in milliseconds */
+    unsigned n;        /* Number of times to run the cluster */
+    bool periodic;     /* Use fixed-interval ticks instead of deadlines */
+    bool quiesce;      /* Stop heartbeating when the cluster is idle */
+};
+
+#endif /* IDLE_OPTIONS_H_ */
@@ -0,0 +1,104 @@
+#include <argp.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "idle.h"
+#include "idle_parse.h"
+
+static char doc[] = "Benchmark election latency and wakeups of an idle cluster\n";
+
+/* Order of fields: {NAME, KEY, ARG, FLAGS, DOC, GROUP}.*/
+static struct argp_option options[] = {
+    {"dir", 'd', "DIR", 0, "Directory to use for temp files (default '.')", 0},
+    {"servers", 's', "N", 0, "Number of voting servers (default 3)", 0},
+    {"timeout", 't', "MSECS", 0, "Election timeout (default 1000)", 0},
+    {"duration", 'D', "MSECS", 0, "Length of the idle window (default 5000)",
+     0},
+    {"n", 'n', "N", 0, "Number of times to run the cluster (default 5)", 0},
+    {"periodic", 'p', 0, 0, "Use fixed-interval ticks instead of deadlines",
+     0},
+    {"quiesce", 'q', 0, 0, "Let the cluster stop heartbeating when idle", 0},
+    {0}};
+
+static error_t argpParser(int key, char *arg, struct argp_state *state);
+
+static struct argp argp = {
+    .options = options,
+    .parser = argpParser,
+    .doc = doc,
+};
+
+static error_t argpParser(int key, char *arg, struct argp_state *state)
+{
+    struct idleOptions *opts = state->input;
+
+    switch (key) {
+        case 'd':
+            opts->dir = arg;
+            break;
+        case 's':
+            opts->servers = (unsigned)atoi(arg);
+            break;
+        case 't':
+            opts->timeout = (unsigned)atoi(arg);
+            break;
+        case 'D':
+            opts->duration = (unsigned)atoi(arg);
+            break;
+        case 'n':
+            opts->n = (unsigned)atoi(arg);
+            break;
+        case 'p':
+            opts->periodic = true;
+            break;
+        case 'q':
+            opts->quiesce = true;
+            break;
+        default:
+            return ARGP_ERR_UNKNOWN;
+    }
+
+    return 0;
+}
+
+static void optionsInit(struct idleOptions *opts)
+{
+    opts->dir = ".";
+    opts->servers = 3;
+    opts->timeout = 1000;
+    opts->duration = 5000;
+    opts->n = 5;
+    opts->periodic = false;
+    opts->quiesce = false;
+}
+
+static void optionsCheck(struct idleOptions *opts)
+{
+    if (opts->servers == 0) {
+        printf("Invalid number of servers %u\n", opts->servers);
+        exit(1);
+    }
+    if (opts->timeout == 0) {
+        printf("Invalid election timeout %u\n", opts->timeout);
+        exit(1);
+    }
+    if (opts->duration == 0) {
+        printf("Invalid duration %u\n", opts->duration);
+        exit(1);
+    }
+    if (opts->n == 0) {
+        printf("Invalid number of runs %u\n", opts->n);
+        exit(1);
+    }
+}
+
+void IdleParse(int argc, char *argv[], struct idleOptions *opts)
+{
+    optionsInit(opts);
+
+    argv[0] = "benchmark/run idle";
+    argp_parse(&argp, argc, argv, 0, 0, opts);
+
+    optionsCheck(opts);
+}
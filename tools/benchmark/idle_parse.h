@@ -0,0 +1,11 @@
+/* Parse command line arguments for the idle benchmark. */
+
+#ifndef IDLE_PARSE_H_
+#define IDLE_PARSE_H_
+
+#include "idle_options.h"
+
+/* Parse the given command line arguments. */
+void IdleParse(int argc, char *argv[], struct idleOptions *opts);
+
+#endif /* IDLE_PARSE_H_ */
@@ -0,0 +1,413 @@
+#include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <uv.h>
+
+#include "../../include/raft.h"
+#include "../../include/raft/uv.h"
+
+#include "fs.h"
+#include "load.h"
+#include "load_parse.h"
+#include "timer.h"
+
+/* Size of each segment. Every segment holds a single batch of entries filling
+ * three quarters of it, so that the next batch never fits and each append
+ * lands in a segment of its own. */
+#define SEGMENT_SIZE (8 * 1024 * 1024)
+
+/* Size of the header of each entry in a batch. */
+#define ENTRY_HEADER_SIZE 16
+
+/* Phases of raft_io->load() which get reported. */
+enum {
+    PHASE_TOTAL = 0,
+    PHASE_LIST,
+    PHASE_SEGMENT_READ,
+    PHASE_SEGMENT_CRC,
+    PHASE_SEGMENT_DECODE,
+    PHASE_SNAPSHOT_READ,
+    PHASE_SNAPSHOT_DECOMPRESS,
+    N_PHASES,
+};
+
+static const char *phaseNames[] = {
+    [PHASE_TOTAL] = "total",
+    [PHASE_LIST] = "list",
+    [PHASE_SEGMENT_READ] = "segment_read",
+    [PHASE_SEGMENT_CRC] = "segment_crc",
+    [PHASE_SEGMENT_DECODE] = "segment_decode",
+    [PHASE_SNAPSHOT_READ] = "snapshot_read",
+    [PHASE_SNAPSHOT_DECOMPRESS] = "snapshot_decompress",
+};
+
+/* A raft_io instance operating on the benchmark data directory. */
+struct disk
+{
+    struct uv_loop_s *loop;
+    char *dir;
+    struct raft_uv_transport transport;
+    struct raft_io io;
+    struct raft_tracer tracer;
+    struct raft_uv_load_stats stats; /* Filled when a load completes */
+    bool loaded;                     /* Whether stats was filled */
+    bool done;                       /* Whether the last request completed */
+};
+
+static void emit(struct raft_tracer *t, int type, const void *info)
+{
+    struct disk *d = t->impl;
+    if (type == RAFT_UV_TRACER_LOAD_COMPLETE) {
+        d->stats = *(const struct raft_uv_load_stats *)info;
+        d->loaded = true;
+    }
+}
+
+static void ioCloseCb(struct raft_io *io)
+{
+    struct disk *d = io->data;
+    d->done = true;
+}
+
+static void appendCb(struct raft_io_append *req, int status)
+{
+    struct disk *d = req->data;
+    if (status != 0) {
+        printf("append failed: %s\n", raft_strerror(status));
+        exit(1);
+    }
+    d->done = true;
+}
+
+static void snapshotPutCb(struct raft_io_snapshot_put *req, int status)
+{
+    struct disk *d = req->data;
+    if (status != 0) {
+        printf("snapshot put failed: %s\n", raft_strerror(status));
+        exit(1);
+    }
+    d->done = true;
+}
+
+/* Run the loop until the last request completes. */
+static void diskWait(struct disk *d)
+{
+    while (!d->done) {
+        uv_run(d->loop, UV_RUN_ONCE);
+    }
+    d->done = false;
+}
+
+static int diskOpen(struct disk *d, unsigned threads)
+{
+    int rv;
+
+    d->transport.version = 1;
+    d->transport.data = NULL;
+    rv = raft_uv_tcp_init(&d->transport, d->loop);
+    if (rv != 0) {
+        printf("failed to init transport\n");
+        return -1;
+    }
+    rv = raft_uv_init(&d->io, d->loop, d->dir, &d->transport);
+    if (rv != 0) {
+        printf("failed to init io\n");
+        return -1;
+    }
+    raft_uv_set_segment_size(&d->io, SEGMENT_SIZE);
+    if (threads > 0) {
+        raft_uv_set_segment_load_threads(&d->io, threads);
+    }
+    d->tracer.impl = d;
+    d->tracer.version = 2;
+    d->tracer.emit = emit;
+    raft_uv_set_tracer(&d->io, &d->tracer);
+    rv = d->io.init(&d->io, 1, "127.0.0.1:9001");
+    if (rv != 0) {
+        printf("failed to init io: %s\n", d->io.errmsg);
+        return -1;
+    }
+    d->io.version = 0; /* Avoid assuming that io.data is raft */
+    d->io.data = d;
+    d->loaded = false;
+    d->done = false;
+
+    return 0;
+}
+
+static void diskClose(struct disk *d)
+{
+    d->io.close(&d->io, ioCloseCb);
+    diskWait(d);
+    raft_uv_close(&d->io);
+    raft_uv_tcp_close(&d->transport);
+}
+
+/* Number of entries in each segment. */
+static unsigned entriesPerSegment(struct loadOptions *opts)
+{
+    return (unsigned)((SEGMENT_SIZE / 4 * 3) /
+                      (opts->buf + ENTRY_HEADER_SIZE));
+}
+
+/* Fill the data directory with one more closed segment than requested and the
+ * snapshot. The last closed segment gets turned into an open one before each
+ * load. */
+static int diskPopulate(struct disk *d, struct loadOptions *opts)
+{
+    struct raft_io_append append;
+    struct raft_io_snapshot_put put;
+    struct raft_snapshot snapshot;
+    struct raft_buffer buf;
+    struct raft_entry *entries;
+    void *payload;
+    unsigned n = entriesPerSegment(opts);
+    unsigned i;
+    int rv;
+
+    rv = diskOpen(d, 0);
+    if (rv != 0) {
+        return -1;
+    }
+
+    /* All entries share the same payload, which gets copied when encoding. */
+    payload = malloc(opts->buf);
+    assert(payload != NULL);
+    for (i = 0; i < opts->buf; i++) {
+        ((uint8_t *)payload)[i] = (uint8_t)i;
+    }
+    entries = malloc(n * sizeof *entries);
+    assert(entries != NULL);
+    for (i = 0; i < n; i++) {
+        entries[i].term = 1;
+        entries[i].type = RAFT_COMMAND;
+        entries[i].buf.base = payload;
+        entries[i].buf.len = opts->buf;
+        entries[i].batch = NULL;
+    }
+
+    for (i = 0; i < opts->segments + 1; i++) {
+        append.data = d;
+        rv = d->io.append(&d->io, &append, entries, n, appendCb);
+        if (rv != 0) {
+            printf("failed to append: %s\n", d->io.errmsg);
+            return -1;
+        }
+        diskWait(d);
+    }
+
+    free(entries);
+    free(payload);
+
+    if (opts->snapshot > 0) {
+        /* Use counters as content, to give compression some work to do. */
+        buf.len = opts->snapshot;
+        buf.base = malloc(buf.len);
+        assert(buf.base != NULL);
+        for (i = 0; i < buf.len / sizeof(uint64_t); i++) {
+            ((uint64_t *)buf.base)[i] = i;
+        }
+
+        snapshot.index = (raft_index)(opts->segments + 1) * n;
+        snapshot.term = 1;
+        raft_configuration_init(&snapshot.configuration);
+        rv = raft_configuration_add(&snapshot.configuration, 1,
+                                    "127.0.0.1:9001", RAFT_VOTER);
+        assert(rv == 0);
+        snapshot.configuration_index = 1;
+        snapshot.bufs = &buf;
+        snapshot.n_bufs = 1;
+
+        /* Keep all entries, so that they all get loaded. */
+        put.data = d;
+        rv = d->io.snapshot_put(&d->io, UINT_MAX, &put, &snapshot,
+                                snapshotPutCb);
+        if (rv != 0) {
+            printf("failed to put snapshot: %s\n", d->io.errmsg);
+            return -1;
+        }
+        diskWait(d);
+
+        raft_configuration_close(&snapshot.configuration);
+        free(buf.base);
+    }
+
+    /* Closing the instance finalizes the segment being written. */
+    diskClose(d);
+
+    return 0;
+}
+
+/* Rename the last closed segment to an open one and remove its index file, as
+ * if the server had been stopped while writing to it. Loading the data
+ * directory finalizes it again under the same name. */
+static int diskUnfinalize(struct disk *d, struct loadOptions *opts)
+{
+    const char *open = "open-1";
+    char closed[64];
+    char *path1;
+    char *path2;
+    unsigned long long n = entriesPerSegment(opts);
+    unsigned long long first = opts->segments * n + 1;
+    unsigned long long last = (opts->segments + 1) * n;
+    int rv;
+
+    sprintf(closed, "%016llu-%016llu", first, last);
+
+    rv = asprintf(&path1, "%s/%s", d->dir, closed);
+    assert(rv > 0);
+    rv = asprintf(&path2, "%s/%s", d->dir, open);
+    assert(rv > 0);
+    rv = rename(path1, path2);
+    if (rv != 0) {
+        printf("failed to rename %s: %s\n", closed, strerror(errno));
+        return -1;
+    }
+    free(path1);
+    free(path2);
+
+    rv = asprintf(&path1, "%s/%s.idx", d->dir, closed);
+    assert(rv > 0);
+    rv = unlink(path1);
+    if (rv != 0 && errno != ENOENT) {
+        printf("failed to remove %s.idx: %s\n", closed, strerror(errno));
+        return -1;
+    }
+    free(path1);
+
+    return 0;
+}
+
+/* Load the data directory with a fresh raft_io instance, saving the time spent
+ * in each phase in the I'th slot of the given samples. */
+static int diskLoad(struct disk *d,
+                    struct loadOptions *opts,
+                    unsigned long *samples[N_PHASES],
+                    unsigned i)
+{
+    struct timer timer;
+    struct raft_snapshot *snapshot;
+    struct raft_entry *entries;
+    raft_index start_index;
+    raft_term term;
+    raft_id voted_for;
+    size_t n;
+    size_t j;
+    void *batch = NULL;
+    int rv;
+
+    rv = diskUnfinalize(d, opts);
+    if (rv != 0) {
+        return -1;
+    }
+    rv = diskOpen(d, opts->threads);
+    if (rv != 0) {
+        return -1;
+    }
+
+    TimerStart(&timer);
+    rv = d->io.load(&d->io, &term, &voted_for, &snapshot, &start_index,
+                    &entries, &n);
+    samples[PHASE_TOTAL][i] = TimerStop(&timer);
+    if (rv != 0) {
+        printf("failed to load: %s\n", d->io.errmsg);
+        return -1;
+    }
+    assert(d->loaded);
+    assert(n == (opts->segments + 1) * entriesPerSegment(opts));
+
+    samples[PHASE_LIST][i] = d->stats.list;
+    samples[PHASE_SEGMENT_READ][i] = d->stats.segment_read;
+    samples[PHASE_SEGMENT_CRC][i] = d->stats.segment_crc;
+    samples[PHASE_SEGMENT_DECODE][i] = d->stats.segment_decode;
+    samples[PHASE_SNAPSHOT_READ][i] = d->stats.snapshot_read;
+    samples[PHASE_SNAPSHOT_DECOMPRESS][i] = d->stats.snapshot_decompress;
+
+    for (j = 0; j < n; j++) {
+        if (entries[j].batch != batch) {
+            batch = entries[j].batch;
+            raft_free(batch);
+        }
+    }
+    raft_free(entries);
+    if (snapshot != NULL) {
+        raft_configuration_close(&snapshot->configuration);
+        raft_free(snapshot->bufs[0].base);
+        raft_free(snapshot->bufs);
+        raft_free(snapshot);
+    }
+
+    diskClose(d);
+
+    return 0;
+}
+
+int LoadRun(int argc, char *argv[], struct report *report)
+{
+    struct loadOptions opts;
+    struct uv_loop_s loop;
+    struct disk disk;
+    unsigned long *samples[N_PHASES];
+    struct benchmark *benchmark;
+    struct metric *m;
+    char *name;
+    unsigned i;
+    int rv;
+
+    LoadParse(argc, argv, &opts);
+
+    rv = uv_loop_init(&loop);
+    if (rv != 0) {
+        printf("failed to init loop\n");
+        return -1;
+    }
+    disk.loop = &loop;
+
+    rv = FsCreateTempDir(opts.dir, &disk.dir);
+    if (rv != 0) {
+        printf("failed to create temp dir\n");
+        return -1;
+    }
+
+    rv = diskPopulate(&disk, &opts);
+    if (rv != 0) {
+        return -1;
+    }
+
+    for (i = 0; i < N_PHASES; i++) {
+        samples[i] = malloc(opts.n * sizeof *samples[i]);
+        assert(samples[i] != NULL);
+    }
+
+    for (i = 0; i < opts.n; i++) {
+        rv = diskLoad(&disk, &opts, samples, i);
+        if (rv != 0) {
+            return -1;
+        }
+    }
+
+    uv_loop_close(&loop);
+
+    rv = FsRemoveTempDir(disk.dir);
+    if (rv != 0) {
+        printf("failed to remove temp dir\n");
+        return -1;
+    }
+
+    for (i = 0; i < N_PHASES; i++) {
+        rv = asprintf(&name, "load:%u:%zu:%zu:%s", opts.segments, opts.buf,
+                      opts.snapshot, phaseNames[i]);
+        assert(rv > 0);
+        assert(name != NULL);
+        benchmark = ReportGrow(report, name);
+        m = BenchmarkGrow(benchmark, METRIC_KIND_LATENCY);
+        MetricFillSamples(m, samples[i], opts.n);
+        free(samples[i]);
+    }
+
+    return 0;
+}
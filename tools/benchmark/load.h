@@ -0,0 +1,11 @@
+/* Run the load benchmark. */
+
+#ifndef LOAD_H_
+#define LOAD_H_
+
+#include "report.h"
+
+/* Run the load subcommand. */
+int LoadRun(int argc, char *argv[], struct report *report);
+
+#endif /* LOAD_H_ */
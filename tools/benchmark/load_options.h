@@ -0,0 +1,19 @@
+/* Options for the load benchmark. */
+
+#ifndef LOAD_OPTIONS_H_
+#define LOAD_OPTIONS_H_
+
+#include <stddef.h>
+
+/* Options for the load benchmark */
+struct loadOptions
+{
+    char *dir;         /* Directory to use for creating temporary files */
+    unsigned segments; /* Number of closed segments to create */
+    size_t buf;        /* Size of each entry in the segments */
+    size_t snapshot;   /* Size of the snapshot, 0 for no snapshot */
+    unsigned n;        /* Number of times the data directory is loaded */
+    unsigned threads;  /* Threads loading closed segments, 0 for default */
+};
+
+#endif /* LOAD_OPTIONS_H_ */
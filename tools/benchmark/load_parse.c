@@ -0,0 +1,93 @@
+#include <argp.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "load.h"
+#include "load_parse.h"
+
+#define MEGABYTE (1024 * 1024)
+
+static char doc[] =
+    "Benchmark loading a data directory with segments and a snapshot\n";
+
+/* Order of fields: {NAME, KEY, ARG, FLAGS, DOC, GROUP}.*/
+static struct argp_option options[] = {
+    {"dir", 'd', "DIR", 0, "Directory to use for temp files (default '.')", 0},
+    {"segments", 's', "N", 0, "Number of closed segments (default 16)", 0},
+    {"buf", 'b', "BUF", 0, "Size of each entry (default 4096)", 0},
+    {"snapshot", 'S', "SIZE", 0, "Size of the snapshot in MB (default 64)", 0},
+    {"n", 'n', "N", 0, "Number of loads to time (default 5)", 0},
+    {"threads", 't', "T", 0, "Segment loading threads (default: built-in)",
+     0},
+    {0}};
+
+static error_t argpParser(int key, char *arg, struct argp_state *state);
+
+static struct argp argp = {
+    .options = options,
+    .parser = argpParser,
+    .doc = doc,
+};
+
+static error_t argpParser(int key, char *arg, struct argp_state *state)
+{
+    struct loadOptions *opts = state->input;
+
+    switch (key) {
+        case 'd':
+            opts->dir = arg;
+            break;
+        case 's':
+            opts->segments = (unsigned)atoi(arg);
+            break;
+        case 'b':
+            opts->buf = (unsigned)atoi(arg);
+            break;
+        case 'S':
+            opts->snapshot = (size_t)atoi(arg) * MEGABYTE;
+            break;
+        case 'n':
+            opts->n = (unsigned)atoi(arg);
+            break;
+        case 't':
+            opts->threads = (unsigned)atoi(arg);
+            break;
+        default:
+            return ARGP_ERR_UNKNOWN;
+    }
+
+    return 0;
+}
+
+static void optionsInit(struct loadOptions *opts)
+{
+    opts->dir = ".";
+    opts->segments = 16;
+    opts->buf = 4096;
+    opts->snapshot = 64 * MEGABYTE;
+    opts->n = 5;
+    opts->threads = 0;
+}
+
+static void optionsCheck(struct loadOptions *opts)
+{
+    if (opts->buf == 0 || opts->buf > MEGABYTE || opts->buf % 8 != 0) {
+        printf("Invalid entry size %zu\n", opts->buf);
+        exit(1);
+    }
+    if (opts->n == 0) {
+        printf("Invalid number of loads %u\n", opts->n);
+        exit(1);
+    }
+}
+
+void LoadParse(int argc, char *argv[], struct loadOptions *opts)
+{
+    optionsInit(opts);
+
+    argv[0] = "benchmark/run load";
+    argp_parse(&argp, argc, argv, 0, 0, opts);
+
+    optionsCheck(opts);
+}
@@ -0,0 +1,11 @@
+/* Parse command line arguments for the load benchmark. */
+
+#ifndef LOAD_PARSE_H_
+#define LOAD_PARSE_H_
+
+#include "load_options.h"
+
+/* Parse the given command line arguments. */
+void LoadParse(int argc, char *argv[], struct loadOptions *opts);
+
+#endif /* LOAD_PARSE_H_ */
@@ -2,22 +2,63 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "cluster.h"
 #include "disk.h"
+#include "idle.h"
+#include "load.h"
 #include "report.h"
+#ifdef FIXTURE_ENABLED
+#include "sim.h"
+#endif
+#include "snapshot.h"
 #include "submit.h"
+#include "threads.h"
+#include "transport.h"
+#include "wire.h"
 
 enum {
     BENCHMARK_DISK = 0,
     BENCHMARK_SUBMIT,
+    BENCHMARK_WIRE,
+    BENCHMARK_TRANSPORT,
+    BENCHMARK_CLUSTER,
+    BENCHMARK_LOAD,
+    BENCHMARK_SNAPSHOT,
+    BENCHMARK_IDLE,
+    BENCHMARK_THREADS,
+    /* Optional benchmarks go last: the table below ends at the first NULL. */
+    BENCHMARK_SIM,
 };
 
 static const char *doc =
     "benchmarks:\n"
     " - disk: Sequential disk writes\n"
-    " - submit: Sequential submission of entries\n";
+    " - submit: Sequential submission of entries\n"
+    " - wire: AppendEntries throughput over a throttled link\n"
+    " - transport: Round-trips over TCP, Unix and in-process transports\n"
+    " - cluster: Commit latency and throughput of a multi-node cluster\n"
+    " - load: Time spent loading segments and snapshots at startup\n"
+    " - snapshot: Storing, loading and installing snapshots\n"
+    " - idle: Election latency and loop wakeups of an idle cluster\n"
+    " - threads: Throughput of entries submitted by several threads\n"
+#ifdef FIXTURE_ENABLED
+    " - sim: CPU cost of the raft core on a simulated cluster\n"
+#endif
+    ;
 
-static const char *benchmarks[] =
-    {[BENCHMARK_DISK] = "disk", [BENCHMARK_SUBMIT] = "submit", NULL};
+static const char *benchmarks[] = {[BENCHMARK_DISK] = "disk",
+                                   [BENCHMARK_SUBMIT] = "submit",
+                                   [BENCHMARK_WIRE] = "wire",
+                                   [BENCHMARK_TRANSPORT] = "transport",
+                                   [BENCHMARK_CLUSTER] = "cluster",
+                                   [BENCHMARK_LOAD] = "load",
+                                   [BENCHMARK_SNAPSHOT] = "snapshot",
+                                   [BENCHMARK_IDLE] = "idle",
+                                   [BENCHMARK_THREADS] = "threads",
+#ifdef FIXTURE_ENABLED
+                                   [BENCHMARK_SIM] = "sim",
+#endif
+                                   NULL};
 
 int benchmarkCode(const char *name)
 {
@@ -59,6 +100,32 @@ int main(int argc, char *argv[])
         case BENCHMARK_SUBMIT:
             rv = SubmitRun(argc - 1, &argv[1], &report);
             break;
+        case BENCHMARK_WIRE:
+            rv = WireRun(argc - 1, &argv[1], &report);
+            break;
+        case BENCHMARK_TRANSPORT:
+            rv = TransportRun(argc - 1, &argv[1], &report);
+            break;
+        case BENCHMARK_CLUSTER:
+            rv = ClusterRun(argc - 1, &argv[1], &report);
+            break;
+        case BENCHMARK_LOAD:
+            rv = LoadRun(argc - 1, &argv[1], &report);
+            break;
+        case BENCHMARK_SNAPSHOT:
+            rv = SnapshotRun(argc - 1, &argv[1], &report);
+            break;
+        case BENCHMARK_IDLE:
+            rv = IdleRun(argc - 1, &argv[1], &report);
+            break;
+        case BENCHMARK_THREADS:
+            rv = ThreadsRun(argc - 1, &argv[1], &report);
+            break;
+#ifdef FIXTURE_ENABLED
+        case BENCHMARK_SIM:
+            rv = SimRun(argc - 1, &argv[1], &report);
+            break;
+#endif
         default:
             assert(0);
             rv = -1;
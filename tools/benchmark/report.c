@@ -61,6 +61,9 @@ static void metricPrint(struct metric *m)
         case METRIC_KIND_THROUGHPUT:
             kind = "throughput";
             break;
+        case METRIC_KIND_PEAK_RSS:
+            kind = "peak-rss";
+            break;
         default:
             kind = NULL;
             assert(0);
@@ -74,10 +77,10 @@ static void metricPrint(struct metric *m)
     printf("    }");
 }
 
-void MetricFillHistogram(struct metric *m, struct histogram *h)
+void MetricFillPercentile(struct metric *m, struct histogram *h, double p)
 {
     unsigned counter = 0;
-    unsigned median;
+    unsigned target;
     unsigned lower = 0;
     unsigned upper = 0;
     unsigned i;
@@ -93,16 +96,15 @@ void MetricFillHistogram(struct metric *m, struct histogram *h)
     }
 
     assert(counter >= 1);
-    if (counter == 1) {
-        median = 1;
-    } else {
-        median = counter / 2;
+    target = (unsigned)((double)counter * p);
+    if (target == 0) {
+        target = 1;
     }
 
     counter = 0;
-    for (i = 0; i <= h->n; i++) {
+    for (i = 0; i < h->n; i++) {
         counter += h->buckets[i];
-        if (counter >= median) {
+        if (counter >= target) {
             break;
         }
     }
@@ -112,6 +114,27 @@ void MetricFillHistogram(struct metric *m, struct histogram *h)
     m->upper_bound = (double)(h->first + (unsigned long)(upper * h->gap));
 }
 
+void MetricFillHistogram(struct metric *m, struct histogram *h)
+{
+    MetricFillPercentile(m, h, PERCENTILE);
+}
+
+static int compareSamples(const void *p1, const void *p2)
+{
+    unsigned long s1 = *(const unsigned long *)p1;
+    unsigned long s2 = *(const unsigned long *)p2;
+    return s1 < s2 ? -1 : s1 > s2;
+}
+
+void MetricFillSamples(struct metric *m, unsigned long *samples, unsigned n)
+{
+    assert(n >= 1);
+    qsort(samples, n, sizeof *samples, compareSamples);
+    m->value = (double)samples[n / 2];
+    m->lower_bound = (double)samples[0];
+    m->upper_bound = (double)samples[n - 1];
+}
+
 void MetricFillThroughput(struct metric *m,
                           unsigned n_ops,
                           unsigned long duration)
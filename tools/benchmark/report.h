@@ -5,7 +5,7 @@
 
 #include <time.h>
 
-enum { METRIC_KIND_LATENCY = 0, METRIC_KIND_THROUGHPUT };
+enum { METRIC_KIND_LATENCY = 0, METRIC_KIND_THROUGHPUT, METRIC_KIND_PEAK_RSS };
 
 struct histogram
 {
@@ -48,6 +48,14 @@ void HistogramCount(struct histogram *h, unsigned long value);
  * percentile over the buckets. */
 void MetricFillHistogram(struct metric *m, struct histogram *h);
 
+/* Fill a metric object with a histogram-based measurement, calculating the
+ * given percentile (between 0 and 1) over the buckets. */
+void MetricFillPercentile(struct metric *m, struct histogram *h, double p);
+
+/* Fill a metric object with the median of the given samples, bounded by the
+ * smallest and largest one. The samples get sorted in place. */
+void MetricFillSamples(struct metric *m, unsigned long *samples, unsigned n);
+
 /* Fill a metric object with a throughput measurement, given the number of total
  * operations and their total duration. */
 void MetricFillThroughput(struct metric *m,
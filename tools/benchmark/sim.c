@@ -0,0 +1,417 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../../include/raft.h"
+#include "../../include/raft/fixture.h"
+
+#include "sim.h"
+#include "sim_parse.h"
+
+/* Give up on a run if no entry gets committed for this long. */
+#define STALL_TIMEOUT (60 * 1000)
+
+/* Trivial FSM, counting applied entries. */
+struct simFsm
+{
+    unsigned long long n;
+};
+
+static int fsmApply(struct raft_fsm *fsm,
+                    const struct raft_buffer *buf,
+                    void **result)
+{
+    struct simFsm *s = fsm->data;
+    (void)buf;
+    s->n++;
+    *result = NULL;
+    return 0;
+}
+
+static int fsmSnapshot(struct raft_fsm *fsm,
+                       struct raft_buffer *bufs[],
+                       unsigned *n_bufs)
+{
+    struct simFsm *s = fsm->data;
+
+    *bufs = raft_malloc(sizeof **bufs);
+    if (*bufs == NULL) {
+        return RAFT_NOMEM;
+    }
+    (*bufs)[0].len = sizeof s->n;
+    (*bufs)[0].base = raft_malloc((*bufs)[0].len);
+    if ((*bufs)[0].base == NULL) {
+        raft_free(*bufs);
+        return RAFT_NOMEM;
+    }
+    memcpy((*bufs)[0].base, &s->n, sizeof s->n);
+    *n_bufs = 1;
+
+    return 0;
+}
+
+static int fsmRestore(struct raft_fsm *fsm, struct raft_buffer *buf)
+{
+    struct simFsm *s = fsm->data;
+    assert(buf->len == sizeof s->n);
+    memcpy(&s->n, buf->base, sizeof s->n);
+    raft_free(buf->base);
+    return 0;
+}
+
+struct sim;
+
+/* A submission slot, there are as many as the in-flight window. */
+struct simRequest
+{
+    struct raft_apply req;
+    struct sim *sim;
+    bool pending;
+};
+
+struct sim
+{
+    struct simOptions *opts;
+    struct raft_fixture fixture;
+    struct raft_fsm fsms[RAFT_FIXTURE_MAX_SERVERS];
+    struct simFsm states[RAFT_FIXTURE_MAX_SERVERS];
+    struct simRequest *requests;
+    unsigned in_flight;      /* Number of pending submissions */
+    unsigned committed;      /* Number of successfully applied entries */
+    unsigned victim;         /* Server currently faulted, or n if none */
+    raft_time next_fault;    /* Time at which the fault schedule toggles */
+    raft_time last_progress; /* Time of the last commit */
+};
+
+static int simInit(struct sim *s, struct simOptions *opts)
+{
+    struct raft_fixture *f = &s->fixture;
+    struct raft_configuration configuration;
+    unsigned i;
+    unsigned j;
+    int rv;
+
+    memset(s, 0, sizeof *s);
+    s->opts = opts;
+
+    s->requests = calloc(opts->window, sizeof *s->requests);
+    if (s->requests == NULL) {
+        printf("failed to allocate requests\n");
+        return -1;
+    }
+    for (i = 0; i < opts->window; i++) {
+        s->requests[i].sim = s;
+        s->requests[i].req.data = &s->requests[i];
+    }
+
+    for (i = 0; i < opts->servers; i++) {
+        s->fsms[i].version = 1;
+        s->fsms[i].data = &s->states[i];
+        s->fsms[i].apply = fsmApply;
+        s->fsms[i].snapshot = fsmSnapshot;
+        s->fsms[i].restore = fsmRestore;
+    }
+
+    rv = raft_fixture_init(f);
+    if (rv != 0) {
+        printf("failed to init fixture\n");
+        return -1;
+    }
+
+    for (i = 0; i < opts->servers; i++) {
+        rv = raft_fixture_grow(f, &s->fsms[i]);
+        if (rv != 0) {
+            printf("failed to grow fixture\n");
+            return -1;
+        }
+        /* The fixture tracer formats and prints diagnostic messages, which
+         * would dominate the measured CPU time. */
+        raft_fixture_get(f, i)->tracer = NULL;
+        raft_fixture_set_network_latency(f, i, opts->network);
+        raft_fixture_set_disk_latency(f, i, opts->disk);
+    }
+
+    for (i = 0; i < opts->servers; i++) {
+        for (j = 0; j < opts->servers; j++) {
+            if (i == j) {
+                continue;
+            }
+            raft_fixture_set_bandwidth(f, i, j, opts->bandwidth);
+            raft_fixture_set_jitter(f, i, j, opts->jitter);
+            raft_fixture_set_loss(f, i, j, opts->loss);
+        }
+    }
+
+    rv = raft_fixture_configuration(f, opts->servers, &configuration);
+    if (rv != 0) {
+        printf("failed to create configuration\n");
+        return -1;
+    }
+    rv = raft_fixture_bootstrap(f, &configuration);
+    raft_configuration_close(&configuration);
+    if (rv != 0) {
+        printf("failed to bootstrap\n");
+        return -1;
+    }
+
+    rv = raft_fixture_start(f);
+    if (rv != 0) {
+        printf("failed to start fixture\n");
+        return -1;
+    }
+
+    if (!raft_fixture_step_until_has_leader(f, 10000)) {
+        printf("no leader was elected\n");
+        return -1;
+    }
+
+    s->victim = opts->servers;
+    s->next_fault = raft_fixture_time(f) + opts->period;
+    s->last_progress = raft_fixture_time(f);
+
+    return 0;
+}
+
+static void simClose(struct sim *s)
+{
+    raft_fixture_close(&s->fixture);
+    free(s->requests);
+}
+
+/* Total number of messages sent so far by all servers. */
+static unsigned long long simMessages(struct sim *s)
+{
+    unsigned long long n = 0;
+    unsigned i;
+    int type;
+
+    for (i = 0; i < s->opts->servers; i++) {
+        for (type = RAFT_APPEND_ENTRIES; type <= RAFT_TIMEOUT_NOW; type++) {
+            n += raft_fixture_n_send(&s->fixture, i, type);
+        }
+    }
+
+    return n;
+}
+
+static void applyCb(struct raft_apply *req, int status, void *result)
+{
+    struct simRequest *r = req->data;
+    struct sim *s = r->sim;
+
+    (void)result;
+
+    r->pending = false;
+    s->in_flight--;
+
+    /* Entries whose leader lost leadership are simply submitted again. */
+    if (status == 0) {
+        s->committed++;
+        s->last_progress = raft_fixture_time(&s->fixture);
+    }
+}
+
+/* Fill the in-flight window with new entries submitted to the leader. */
+static void simSubmit(struct sim *s)
+{
+    struct raft_fixture *f = &s->fixture;
+    struct raft_buffer buf;
+    unsigned leader = raft_fixture_leader_index(f);
+    unsigned i;
+    int rv;
+
+    if (leader == s->opts->servers) {
+        return;
+    }
+
+    for (i = 0; i < s->opts->window; i++) {
+        struct simRequest *r = &s->requests[i];
+
+        if (s->committed + s->in_flight >= s->opts->entries) {
+            break;
+        }
+        if (r->pending) {
+            continue;
+        }
+
+        buf.len = s->opts->buf;
+        buf.base = raft_malloc(buf.len);
+        assert(buf.base != NULL);
+        memset(buf.base, 0, buf.len);
+
+        rv = raft_apply(raft_fixture_get(f, leader), &r->req, &buf, 1,
+                        applyCb);
+        if (rv != 0) {
+            raft_free(buf.base);
+            break;
+        }
+
+        r->pending = true;
+        s->in_flight++;
+    }
+}
+
+/* Isolate the given server from all the others, or rejoin it. */
+static void simPartition(struct sim *s, unsigned i, bool isolate)
+{
+    unsigned j;
+
+    for (j = 0; j < s->opts->servers; j++) {
+        if (j == i) {
+            continue;
+        }
+        if (isolate) {
+            raft_fixture_disconnect(&s->fixture, i, j);
+            raft_fixture_disconnect(&s->fixture, j, i);
+        } else {
+            raft_fixture_reconnect(&s->fixture, i, j);
+            raft_fixture_reconnect(&s->fixture, j, i);
+        }
+    }
+}
+
+/* Inject a fault if none is active, or undo the active one otherwise. */
+static void simFault(struct sim *s)
+{
+    struct raft_fixture *f = &s->fixture;
+    unsigned n = s->opts->servers;
+    unsigned leader;
+
+    if (s->victim != n) {
+        if (s->opts->fault == SIM_FAULT_PARTITION) {
+            simPartition(s, s->victim, false);
+        } else {
+            raft_fixture_revive(f, s->victim);
+        }
+        s->victim = n;
+        return;
+    }
+
+    leader = raft_fixture_leader_index(f);
+    if (leader == n) {
+        return;
+    }
+
+    switch (s->opts->fault) {
+        case SIM_FAULT_FOLLOWER:
+            s->victim = (leader + 1) % n;
+            raft_fixture_kill(f, s->victim);
+            break;
+        case SIM_FAULT_PARTITION:
+            s->victim = (leader + 1) % n;
+            simPartition(s, s->victim, true);
+            break;
+        case SIM_FAULT_LEADER:
+            s->victim = leader;
+            raft_fixture_kill(f, s->victim);
+            break;
+        default:
+            assert(0);
+            break;
+    }
+}
+
+/* Commit the configured number of entries, stepping the fixture. */
+static int simRun(struct sim *s)
+{
+    struct raft_fixture *f = &s->fixture;
+
+    while (s->committed < s->opts->entries) {
+        simSubmit(s);
+        raft_fixture_step(f);
+
+        if (s->opts->fault != SIM_FAULT_NONE &&
+            raft_fixture_time(f) >= s->next_fault) {
+            simFault(s);
+            s->next_fault += s->opts->period;
+        }
+
+        if (raft_fixture_time(f) - s->last_progress > STALL_TIMEOUT) {
+            printf("no progress after %u committed entries\n", s->committed);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static unsigned long cpuTime(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+    return (unsigned long)now.tv_sec * 1000 * 1000 * 1000 +
+           (unsigned long)now.tv_nsec;
+}
+
+int SimRun(int argc, char *argv[], struct report *report)
+{
+    struct simOptions opts;
+    struct sim *s;
+    struct benchmark *benchmark;
+    struct metric *m;
+    unsigned long *per_entry;
+    unsigned long *per_message;
+    unsigned long long messages;
+    unsigned long start;
+    unsigned long elapsed;
+    unsigned i;
+    char *name;
+    int rv;
+
+    SimParse(argc, argv, &opts);
+
+    s = malloc(sizeof *s);
+    per_entry = calloc(opts.n, sizeof *per_entry);
+    per_message = calloc(opts.n, sizeof *per_message);
+    assert(s != NULL);
+    assert(per_entry != NULL);
+    assert(per_message != NULL);
+
+    for (i = 0; i < opts.n; i++) {
+        rv = simInit(s, &opts);
+        if (rv != 0) {
+            return -1;
+        }
+
+        /* Only the steady state is timed, the election is excluded. */
+        messages = simMessages(s);
+        start = cpuTime();
+        rv = simRun(s);
+        elapsed = cpuTime() - start;
+        messages = simMessages(s) - messages;
+        if (rv != 0) {
+            return -1;
+        }
+
+        per_entry[i] = elapsed / opts.entries;
+        per_message[i] = messages > 0 ? elapsed / messages : 0;
+
+        simClose(s);
+    }
+
+    rv = asprintf(&name, "sim:%u:%zu:%s:entry", opts.servers, opts.buf,
+                  opts.fault_s);
+    assert(rv > 0);
+    assert(name != NULL);
+
+    benchmark = ReportGrow(report, name);
+    m = BenchmarkGrow(benchmark, METRIC_KIND_LATENCY);
+    MetricFillSamples(m, per_entry, opts.n);
+
+    rv = asprintf(&name, "sim:%u:%zu:%s:message", opts.servers, opts.buf,
+                  opts.fault_s);
+    assert(rv > 0);
+    assert(name != NULL);
+
+    benchmark = ReportGrow(report, name);
+    m = BenchmarkGrow(benchmark, METRIC_KIND_LATENCY);
+    MetricFillSamples(m, per_message, opts.n);
+
+    free(per_message);
+    free(per_entry);
+    free(s);
+
+    return 0;
+}
@@ -0,0 +1,11 @@
+/* Run the simulation benchmark. */
+
+#ifndef SIM_H_
+#define SIM_H_
+
+#include "report.h"
+
+/* Run the sim subcommand. */
+int SimRun(int argc, char *argv[], struct report *report);
+
+#endif /* SIM_H_ */
@@ -0,0 +1,34 @@
+/* Options for the simulation benchmark. */
+
+#ifndef SIM_OPTIONS_H_
+#define SIM_OPTIONS_H_
+
+#include <stddef.h>
+
+/* Fault schedules that can be injected while the simulation runs. */
+enum {
+    SIM_FAULT_NONE = 0,  /* No faults */
+    SIM_FAULT_FOLLOWER,  /* Periodically kill and revive a follower */
+    SIM_FAULT_PARTITION, /* Periodically isolate and rejoin a follower */
+    SIM_FAULT_LEADER     /* Periodically kill the leader and revive it */
+};
+
+/* Options for the simulation benchmark */
+struct simOptions
+{
+    unsigned servers;    /* Number of voting servers in the cluster */
+    size_t buf;          /* Size of each entry payload */
+    unsigned entries;    /* Number of entries to commit in each run */
+    unsigned window;     /* Maximum number of in-flight submissions */
+    unsigned network;    /* Network latency in milliseconds */
+    unsigned disk;       /* Disk latency in milliseconds */
+    unsigned bandwidth;  /* Link bandwidth in bytes per msec, 0 for unlimited */
+    unsigned jitter;     /* Maximum network jitter in milliseconds */
+    unsigned loss;       /* Percentage of messages lost on each link */
+    int fault;           /* Fault schedule, one of SIM_FAULT_* */
+    const char *fault_s; /* Name of the fault schedule, for reporting */
+    unsigned period;     /* Simulated milliseconds between fault toggles */
+    unsigned n;          /* Number of runs to time */
+};
+
+#endif /* SIM_OPTIONS_H_ */
@@ -0,0 +1,174 @@
+#include <argp.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../include/raft/fixture.h"
+
+#include "sim.h"
+#include "sim_parse.h"
+
+static char doc[] =
+    "Benchmark the CPU cost of the raft core on a simulated cluster\n";
+
+/* Order of fields: {NAME, KEY, ARG, FLAGS, DOC, GROUP}.*/
+static struct argp_option options[] = {
+    {"servers", 's', "N", 0, "Number of servers (default 3)", 0},
+    {"buf", 'b', "BUF", 0, "Size of each entry (default 64)", 0},
+    {"entries", 'e', "N", 0, "Entries to commit per run (default 2000)", 0},
+    {"window", 'w', "N", 0, "Maximum in-flight entries (default 32)", 0},
+    {"network", 'l', "MSECS", 0, "Network latency (default 15)", 0},
+    {"disk", 'D', "MSECS", 0, "Disk latency (default 10)", 0},
+    {"bandwidth", 'B', "BYTES", 0,
+     "Link bandwidth in bytes per msec (default unlimited)", 0},
+    {"jitter", 'j', "MSECS", 0, "Maximum network jitter (default 0)", 0},
+    {"loss", 'L', "PERCENT", 0, "Messages lost on each link (default 0)", 0},
+    {"fault", 'f', "FAULT", 0,
+     "Fault schedule: none, follower, partition or leader (default none)", 0},
+    {"period", 'p', "MSECS", 0, "Simulated time between faults (default 2000)",
+     0},
+    {"n", 'n', "N", 0, "Number of runs to time (default 5)", 0},
+    {0}};
+
+static error_t argpParser(int key, char *arg, struct argp_state *state);
+
+static struct argp argp = {
+    .options = options,
+    .parser = argpParser,
+    .doc = doc,
+};
+
+static const char *faults[] = {[SIM_FAULT_NONE] = "none",
+                               [SIM_FAULT_FOLLOWER] = "follower",
+                               [SIM_FAULT_PARTITION] = "partition",
+                               [SIM_FAULT_LEADER] = "leader",
+                               NULL};
+
+static int faultCode(const char *name)
+{
+    int i = 0;
+    while (faults[i] != NULL) {
+        if (strcmp(faults[i], name) == 0) {
+            return i;
+        }
+        i++;
+    }
+    return -1;
+}
+
+static error_t argpParser(int key, char *arg, struct argp_state *state)
+{
+    struct simOptions *opts = state->input;
+
+    switch (key) {
+        case 's':
+            opts->servers = (unsigned)atoi(arg);
+            break;
+        case 'b':
+            opts->buf = (size_t)atoi(arg);
+            break;
+        case 'e':
+            opts->entries = (unsigned)atoi(arg);
+            break;
+        case 'w':
+            opts->window = (unsigned)atoi(arg);
+            break;
+        case 'l':
+            opts->network = (unsigned)atoi(arg);
+            break;
+        case 'D':
+            opts->disk = (unsigned)atoi(arg);
+            break;
+        case 'B':
+            opts->bandwidth = (unsigned)atoi(arg);
+            break;
+        case 'j':
+            opts->jitter = (unsigned)atoi(arg);
+            break;
+        case 'L':
+            opts->loss = (unsigned)atoi(arg);
+            break;
+        case 'f':
+            opts->fault = faultCode(arg);
+            opts->fault_s = arg;
+            break;
+        case 'p':
+            opts->period = (unsigned)atoi(arg);
+            break;
+        case 'n':
+            opts->n = (unsigned)atoi(arg);
+            break;
+        default:
+            return ARGP_ERR_UNKNOWN;
+    }
+
+    return 0;
+}
+
+static void optionsInit(struct simOptions *opts)
+{
+    opts->servers = 3;
+    opts->buf = 64;
+    opts->entries = 2000;
+    opts->window = 32;
+    opts->network = 15;
+    opts->disk = 10;
+    opts->bandwidth = 0;
+    opts->jitter = 0;
+    opts->loss = 0;
+    opts->fault = SIM_FAULT_NONE;
+    opts->fault_s = faults[SIM_FAULT_NONE];
+    opts->period = 2000;
+    opts->n = 5;
+}
+
+static void optionsCheck(struct simOptions *opts)
+{
+    if (opts->servers == 0 || opts->servers > RAFT_FIXTURE_MAX_SERVERS) {
+        printf("Invalid number of servers %u\n", opts->servers);
+        exit(1);
+    }
+    if (opts->buf == 0) {
+        printf("Invalid entry size %zu\n", opts->buf);
+        exit(1);
+    }
+    if (opts->entries == 0) {
+        printf("Invalid number of entries %u\n", opts->entries);
+        exit(1);
+    }
+    if (opts->window == 0) {
+        printf("Invalid window %u\n", opts->window);
+        exit(1);
+    }
+    if (opts->loss >= 100) {
+        printf("Invalid loss percentage %u\n", opts->loss);
+        exit(1);
+    }
+    if (opts->fault == -1) {
+        printf("Invalid fault schedule '%s'\n", opts->fault_s);
+        exit(1);
+    }
+    if (opts->fault != SIM_FAULT_NONE && opts->servers < 3) {
+        printf("Fault schedule '%s' requires at least 3 servers\n",
+               opts->fault_s);
+        exit(1);
+    }
+    if (opts->period == 0) {
+        printf("Invalid fault period %u\n", opts->period);
+        exit(1);
+    }
+    if (opts->n == 0) {
+        printf("Invalid number of runs %u\n", opts->n);
+        exit(1);
+    }
+}
+
+void SimParse(int argc, char *argv[], struct simOptions *opts)
+{
+    optionsInit(opts);
+
+    argv[0] = "benchmark/run sim";
+    argp_parse(&argp, argc, argv, 0, 0, opts);
+
+    optionsCheck(opts);
+}
@@ -0,0 +1,11 @@
+/* Parse command line arguments for the simulation benchmark. */
+
+#ifndef SIM_PARSE_H_
+#define SIM_PARSE_H_
+
+#include "sim_options.h"
+
+/* Parse the given command line arguments. */
+void SimParse(int argc, char *argv[], struct simOptions *opts);
+
+#endif /* SIM_PARSE_H_ */
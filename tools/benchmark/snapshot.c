@@ -0,0 +1,555 @@
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <uv.h>
+
+#include "../../include/raft.h"
+#include "../../include/raft/uv.h"
+#include "../../src/compress.h"
+
+#include "fs.h"
+#include "snapshot.h"
+#include "snapshot_parse.h"
+#include "timer.h"
+
+#define MEGABYTE (1024 * 1024)
+
+#define LEADER_ADDRESS "127.0.0.1:9001"
+#define FOLLOWER_ADDRESS "127.0.0.1:9002"
+
+/* Number of entries to retain when the leader stores a snapshot. */
+#define TRAILING 8192
+
+enum {
+    PHASE_PUT = 0, /* Store the snapshot as is */
+    PHASE_GET,     /* Load the snapshot stored by PHASE_PUT */
+    PHASE_PUT_LZ4, /* Compress the snapshot and store it */
+    PHASE_GET_LZ4, /* Load and decompress the snapshot of PHASE_PUT_LZ4 */
+    PHASE_INSTALL, /* Send the snapshot to the follower and store it there */
+    N_PHASES,
+};
+
+static const char *phaseNames[] = {
+    [PHASE_PUT] = "put",         [PHASE_GET] = "get",
+    [PHASE_PUT_LZ4] = "put_lz4", [PHASE_GET_LZ4] = "get_lz4",
+    [PHASE_INSTALL] = "install",
+};
+
+/* A libuv-based raft_io instance with its own data directory. */
+struct node
+{
+    char *dir;
+    struct raft_uv_transport transport;
+    struct raft_io io;
+};
+
+struct bench
+{
+    struct uv_loop_s *loop;
+    struct node leader;
+    struct node follower;
+    struct raft_configuration conf; /* Configuration of all snapshots */
+    void *data;                     /* Content of the snapshot */
+    size_t size;                    /* Size of the content */
+    struct raft_buffer *bufs;       /* Slices of data */
+    unsigned n_bufs;                /* Number of slices */
+    raft_index index;               /* Index of the last snapshot */
+    struct raft_snapshot installed; /* Snapshot received by the follower */
+    struct raft_io_snapshot_put put;
+    struct raft_io_snapshot_get get;
+    struct timer timer;    /* Started when an operation begins */
+    unsigned long elapsed; /* Set when an operation completes */
+    bool done;             /* Whether the operation completed */
+};
+
+/* Reset the peak resident set size of the process, so the next reading only
+ * accounts for what follows. If the kernel does not support it, the peak of
+ * the whole process gets reported. */
+static void rssReset(void)
+{
+    ssize_t rv;
+    int fd;
+    fd = open("/proc/self/clear_refs", O_WRONLY);
+    if (fd == -1) {
+        return;
+    }
+    rv = write(fd, "5", 1);
+    (void)rv;
+    close(fd);
+}
+
+/* Return the peak resident set size of the process, in bytes. */
+static unsigned long rssPeak(void)
+{
+    char line[128];
+    unsigned long kb = 0;
+    FILE *file;
+    file = fopen("/proc/self/status", "r");
+    if (file == NULL) {
+        return 0;
+    }
+    while (fgets(line, sizeof line, file) != NULL) {
+        if (sscanf(line, "VmHWM: %lu kB", &kb) == 1) {
+            break;
+        }
+    }
+    fclose(file);
+    return kb * 1024;
+}
+
+/* Run the loop until the current operation completes. */
+static void benchWait(struct bench *b)
+{
+    while (!b->done) {
+        uv_run(b->loop, UV_RUN_ONCE);
+    }
+    b->done = false;
+}
+
+static void tickCb(struct raft_io *io)
+{
+    (void)io;
+}
+
+static void ioCloseCb(struct raft_io *io)
+{
+    struct bench *b = io->data;
+    b->done = true;
+}
+
+static void sendCb(struct raft_io_send *req, int status)
+{
+    if (status != 0) {
+        printf("send failed: %s\n", raft_strerror(status));
+        exit(1);
+    }
+    free(req);
+}
+
+static void snapshotPutCb(struct raft_io_snapshot_put *req, int status)
+{
+    struct bench *b = req->data;
+    if (status != 0) {
+        printf("snapshot put failed: %s\n", raft_strerror(status));
+        exit(1);
+    }
+    b->elapsed = TimerStop(&b->timer);
+    b->done = true;
+}
+
+static void snapshotGetCb(struct raft_io_snapshot_get *req,
+                          struct raft_snapshot *snapshot,
+                          int status)
+{
+    struct bench *b = req->data;
+    unsigned i;
+    if (status != 0) {
+        printf("snapshot get failed: %s\n", raft_strerror(status));
+        exit(1);
+    }
+    b->elapsed = TimerStop(&b->timer);
+    assert(snapshot->index == b->index);
+    raft_configuration_close(&snapshot->configuration);
+    for (i = 0; i < snapshot->n_bufs; i++) {
+        raft_free(snapshot->bufs[i].base);
+    }
+    raft_free(snapshot->bufs);
+    raft_free(snapshot);
+    b->done = true;
+}
+
+static void installCb(struct raft_io_snapshot_put *req, int status)
+{
+    struct bench *b = req->data;
+    if (status != 0) {
+        printf("snapshot install failed: %s\n", raft_strerror(status));
+        exit(1);
+    }
+    b->elapsed = TimerStop(&b->timer);
+    raft_configuration_close(&b->installed.configuration);
+    raft_free(b->installed.bufs[0].base);
+    free(b->installed.bufs);
+    b->done = true;
+}
+
+/* The follower got the snapshot: store it, like raft does upon receiving an
+ * InstallSnapshot message. */
+static void followerRecvCb(struct raft_io *io, struct raft_message *message)
+{
+    struct bench *b = io->data;
+    int rv;
+
+    assert(message->type == RAFT_INSTALL_SNAPSHOT);
+
+    b->installed.index = message->install_snapshot.last_index;
+    b->installed.term = message->install_snapshot.last_term;
+    b->installed.configuration = message->install_snapshot.conf;
+    b->installed.configuration_index = message->install_snapshot.conf_index;
+    b->installed.bufs = malloc(sizeof *b->installed.bufs);
+    assert(b->installed.bufs != NULL);
+    b->installed.bufs[0] = message->install_snapshot.data;
+    b->installed.n_bufs = 1;
+
+    b->put.data = b;
+    rv = io->snapshot_put(io, 0, &b->put, &b->installed, installCb);
+    if (rv != 0) {
+        printf("failed to install snapshot: %s\n", io->errmsg);
+        exit(1);
+    }
+}
+
+static void leaderRecvCb(struct raft_io *io, struct raft_message *message)
+{
+    (void)io;
+    (void)message;
+    assert(false);
+}
+
+static int nodeInit(struct bench *b,
+                    struct node *n,
+                    const char *dir,
+                    raft_id id,
+                    const char *address,
+                    raft_io_recv_cb recv)
+{
+    int rv;
+
+    rv = FsCreateTempDir(dir, &n->dir);
+    if (rv != 0) {
+        printf("failed to create temp dir\n");
+        return -1;
+    }
+    n->transport.version = 1;
+    n->transport.data = NULL;
+    rv = raft_uv_tcp_init(&n->transport, b->loop);
+    if (rv != 0) {
+        printf("failed to init transport\n");
+        return -1;
+    }
+    rv = raft_uv_init(&n->io, b->loop, n->dir, &n->transport);
+    if (rv != 0) {
+        printf("failed to init io\n");
+        return -1;
+    }
+    rv = n->io.init(&n->io, id, address);
+    if (rv != 0) {
+        printf("failed to init io: %s\n", n->io.errmsg);
+        return -1;
+    }
+    n->io.version = 0; /* Avoid assuming that io.data is raft */
+    n->io.data = b;
+    rv = n->io.start(&n->io, 1000, tickCb, recv);
+    if (rv != 0) {
+        printf("failed to start io: %s\n", n->io.errmsg);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int nodeClose(struct bench *b, struct node *n)
+{
+    int rv;
+
+    n->io.close(&n->io, ioCloseCb);
+    benchWait(b);
+    raft_uv_close(&n->io);
+    raft_uv_tcp_close(&n->transport);
+
+    rv = FsRemoveTempDir(n->dir);
+    if (rv != 0) {
+        printf("failed to remove temp dir\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+static int benchInit(struct bench *b,
+                     struct snapshotOptions *opts,
+                     struct uv_loop_s *loop)
+{
+    size_t len = opts->size / opts->n_bufs;
+    size_t i;
+    int rv;
+
+    b->loop = loop;
+    b->index = 0;
+    b->done = false;
+
+    /* Use counters as content, to give compression some work to do. */
+    b->size = opts->size;
+    b->data = malloc(b->size);
+    assert(b->data != NULL);
+    for (i = 0; i < b->size / sizeof(uint64_t); i++) {
+        ((uint64_t *)b->data)[i] = i;
+    }
+
+    /* The last slice also gets the remainder. */
+    b->n_bufs = opts->n_bufs;
+    b->bufs = malloc(b->n_bufs * sizeof *b->bufs);
+    assert(b->bufs != NULL);
+    for (i = 0; i < b->n_bufs; i++) {
+        b->bufs[i].base = (uint8_t *)b->data + i * len;
+        b->bufs[i].len = len;
+    }
+    b->bufs[b->n_bufs - 1].len += b->size % b->n_bufs;
+
+    raft_configuration_init(&b->conf);
+    rv = raft_configuration_add(&b->conf, 1, LEADER_ADDRESS, RAFT_VOTER);
+    assert(rv == 0);
+    rv = raft_configuration_add(&b->conf, 2, FOLLOWER_ADDRESS, RAFT_VOTER);
+    assert(rv == 0);
+
+    rv = nodeInit(b, &b->leader, opts->dir, 1, LEADER_ADDRESS, leaderRecvCb);
+    if (rv != 0) {
+        return -1;
+    }
+    rv = nodeInit(b, &b->follower, opts->dir, 2, FOLLOWER_ADDRESS,
+                  followerRecvCb);
+    if (rv != 0) {
+        return -1;
+    }
+
+    return 0;
+}
+
+static int benchClose(struct bench *b)
+{
+    int rv;
+
+    rv = nodeClose(b, &b->leader);
+    if (rv != 0) {
+        return -1;
+    }
+    rv = nodeClose(b, &b->follower);
+    if (rv != 0) {
+        return -1;
+    }
+
+    raft_configuration_close(&b->conf);
+    free(b->bufs);
+    free(b->data);
+
+    return 0;
+}
+
+/* Store a new snapshot on the leader, compressing it first if requested. */
+static int benchPut(struct bench *b, bool compress)
+{
+    struct raft_snapshot snapshot;
+    struct raft_buffer compressed;
+    char errmsg[RAFT_ERRMSG_BUF_SIZE];
+    int rv;
+
+    b->index++;
+    snapshot.index = b->index;
+    snapshot.term = 1;
+    snapshot.configuration = b->conf;
+    snapshot.configuration_index = 1;
+    snapshot.bufs = b->bufs;
+    snapshot.n_bufs = b->n_bufs;
+
+    TimerStart(&b->timer);
+    if (compress) {
+        rv = Compress(b->bufs, b->n_bufs, &compressed, errmsg);
+        if (rv != 0) {
+            printf("failed to compress snapshot: %s\n", errmsg);
+            return -1;
+        }
+        snapshot.bufs = &compressed;
+        snapshot.n_bufs = 1;
+    }
+    b->put.data = b;
+    rv = b->leader.io.snapshot_put(&b->leader.io, TRAILING, &b->put, &snapshot,
+                                   snapshotPutCb);
+    if (rv != 0) {
+        printf("failed to put snapshot: %s\n", b->leader.io.errmsg);
+        return -1;
+    }
+    benchWait(b);
+
+    if (compress) {
+        raft_free(compressed.base);
+    }
+
+    return 0;
+}
+
+/* Load the last snapshot stored by the leader. */
+static int benchGet(struct bench *b)
+{
+    int rv;
+
+    TimerStart(&b->timer);
+    b->get.data = b;
+    rv = b->leader.io.snapshot_get(&b->leader.io, &b->get, snapshotGetCb);
+    if (rv != 0) {
+        printf("failed to get snapshot: %s\n", b->leader.io.errmsg);
+        return -1;
+    }
+    benchWait(b);
+
+    return 0;
+}
+
+/* Send a new snapshot to the follower, until it's stored there. */
+static int benchInstall(struct bench *b)
+{
+    struct raft_message message;
+    struct raft_io_send *req;
+    int rv;
+
+    b->index++;
+    memset(&message, 0, sizeof message);
+    message.type = RAFT_INSTALL_SNAPSHOT;
+    message.server_id = 2;
+    message.server_address = FOLLOWER_ADDRESS;
+    message.install_snapshot.term = 1;
+    message.install_snapshot.last_index = b->index;
+    message.install_snapshot.last_term = 1;
+    message.install_snapshot.conf = b->conf;
+    message.install_snapshot.conf_index = 1;
+    message.install_snapshot.data.base = b->data;
+    message.install_snapshot.data.len = b->size;
+
+    req = malloc(sizeof *req);
+    assert(req != NULL);
+
+    TimerStart(&b->timer);
+    rv = b->leader.io.send(&b->leader.io, req, &message, sendCb);
+    if (rv != 0) {
+        printf("failed to send snapshot: %s\n", b->leader.io.errmsg);
+        return -1;
+    }
+    benchWait(b);
+
+    return 0;
+}
+
+/* Run the given phase the given number of times, saving the time each
+ * iteration took in the given samples. */
+static int benchRun(struct bench *b,
+                    int phase,
+                    unsigned long *samples,
+                    unsigned n)
+{
+    unsigned i;
+    int rv;
+
+    for (i = 0; i < n; i++) {
+        switch (phase) {
+            case PHASE_PUT:
+                rv = benchPut(b, false);
+                break;
+            case PHASE_PUT_LZ4:
+                rv = benchPut(b, true);
+                break;
+            case PHASE_GET:
+            case PHASE_GET_LZ4:
+                rv = benchGet(b);
+                break;
+            default:
+                rv = benchInstall(b);
+                break;
+        }
+        if (rv != 0) {
+            return -1;
+        }
+        samples[i] = b->elapsed;
+    }
+
+    return 0;
+}
+
+int SnapshotRun(int argc, char *argv[], struct report *report)
+{
+    struct snapshotOptions opts;
+    struct uv_loop_s loop;
+    struct bench bench;
+    unsigned long *samples;
+    unsigned long total;
+    unsigned long peak;
+    struct benchmark *benchmark;
+    struct metric *m;
+    bool lz4 = false;
+    char *name;
+    unsigned i;
+    int phase;
+    int rv;
+
+    SnapshotParse(argc, argv, &opts);
+
+    /* The compressed phases only make sense if LZ4 is available. */
+#ifdef LZ4_AVAILABLE
+    lz4 = true;
+#endif
+
+    rv = uv_loop_init(&loop);
+    if (rv != 0) {
+        printf("failed to init loop\n");
+        return -1;
+    }
+
+    rv = benchInit(&bench, &opts, &loop);
+    if (rv != 0) {
+        printf("failed to init benchmark\n");
+        return -1;
+    }
+
+    /* Establish the connection to the follower, without timing it. */
+    rv = benchInstall(&bench);
+    if (rv != 0) {
+        return -1;
+    }
+
+    samples = malloc(opts.n * sizeof *samples);
+    assert(samples != NULL);
+
+    for (phase = 0; phase < N_PHASES; phase++) {
+        if (!lz4 && (phase == PHASE_PUT_LZ4 || phase == PHASE_GET_LZ4)) {
+            continue;
+        }
+
+        rssReset();
+        rv = benchRun(&bench, phase, samples, opts.n);
+        if (rv != 0) {
+            return -1;
+        }
+        peak = rssPeak();
+
+        total = 0;
+        for (i = 0; i < opts.n; i++) {
+            total += samples[i];
+        }
+
+        rv = asprintf(&name, "snapshot:%s:%zu:%u", phaseNames[phase],
+                      opts.size, opts.n_bufs);
+        assert(rv > 0);
+        assert(name != NULL);
+
+        benchmark = ReportGrow(report, name);
+        m = BenchmarkGrow(benchmark, METRIC_KIND_LATENCY);
+        MetricFillSamples(m, samples, opts.n);
+        m = BenchmarkGrow(benchmark, METRIC_KIND_THROUGHPUT);
+        MetricFillThroughput(m, (unsigned)(opts.size / MEGABYTE) * opts.n,
+                             total);
+        m = BenchmarkGrow(benchmark, METRIC_KIND_PEAK_RSS);
+        m->value = (double)peak;
+    }
+
+    free(samples);
+
+    rv = benchClose(&bench);
+    if (rv != 0) {
+        printf("failed to cleanup\n");
+        return -1;
+    }
+
+    uv_loop_close(&loop);
+
+    return 0;
+}
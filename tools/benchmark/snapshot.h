@@ -0,0 +1,11 @@
+/* Run the snapshot benchmark. */
+
+#ifndef SNAPSHOT_H_
+#define SNAPSHOT_H_
+
+#include "report.h"
+
+/* Run the snapshot subcommand. */
+int SnapshotRun(int argc, char *argv[], struct report *report);
+
+#endif /* SNAPSHOT_H_ */
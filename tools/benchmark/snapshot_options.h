@@ -0,0 +1,17 @@
+/* Options for the snapshot benchmark. */
+
+#ifndef SNAPSHOT_OPTIONS_H_
+#define SNAPSHOT_OPTIONS_H_
+
+#include <stddef.h>
+
+/* Options for the snapshot benchmark */
+struct snapshotOptions
+{
+    char *dir;       /* Directory to use for creating temporary files */
+    size_t size;     /* Size of the snapshot */
+    unsigned n_bufs; /* Number of buffers the snapshot is split into */
+    unsigned n;      /* Number of times each operation is timed */
+};
+
+#endif /* SNAPSHOT_OPTIONS_H_ */
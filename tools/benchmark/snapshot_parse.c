@@ -0,0 +1,86 @@
+#include <argp.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "snapshot.h"
+#include "snapshot_parse.h"
+
+#define MEGABYTE (1024 * 1024)
+
+static char doc[] = "Benchmark storing, loading and installing snapshots\n";
+
+/* Order of fields: {NAME, KEY, ARG, FLAGS, DOC, GROUP}.*/
+static struct argp_option options[] = {
+    {"dir", 'd', "DIR", 0, "Directory to use for temp files (default '.')", 0},
+    {"size", 's', "SIZE", 0, "Size of the snapshot in MB (default 64)", 0},
+    {"bufs", 'b', "N", 0, "Buffers the snapshot is split into (default 1)", 0},
+    {"n", 'n', "N", 0, "Number of times to time each operation (default 5)",
+     0},
+    {0}};
+
+static error_t argpParser(int key, char *arg, struct argp_state *state);
+
+static struct argp argp = {
+    .options = options,
+    .parser = argpParser,
+    .doc = doc,
+};
+
+static error_t argpParser(int key, char *arg, struct argp_state *state)
+{
+    struct snapshotOptions *opts = state->input;
+
+    switch (key) {
+        case 'd':
+            opts->dir = arg;
+            break;
+        case 's':
+            opts->size = (size_t)atoi(arg) * MEGABYTE;
+            break;
+        case 'b':
+            opts->n_bufs = (unsigned)atoi(arg);
+            break;
+        case 'n':
+            opts->n = (unsigned)atoi(arg);
+            break;
+        default:
+            return ARGP_ERR_UNKNOWN;
+    }
+
+    return 0;
+}
+
+static void optionsInit(struct snapshotOptions *opts)
+{
+    opts->dir = ".";
+    opts->size = 64 * MEGABYTE;
+    opts->n_bufs = 1;
+    opts->n = 5;
+}
+
+static void optionsCheck(struct snapshotOptions *opts)
+{
+    if (opts->size == 0) {
+        printf("Invalid snapshot size %zu\n", opts->size);
+        exit(1);
+    }
+    if (opts->n_bufs == 0 || opts->size / opts->n_bufs == 0) {
+        printf("Invalid number of buffers %u\n", opts->n_bufs);
+        exit(1);
+    }
+    if (opts->n == 0) {
+        printf("Invalid number of iterations %u\n", opts->n);
+        exit(1);
+    }
+}
+
+void SnapshotParse(int argc, char *argv[], struct snapshotOptions *opts)
+{
+    optionsInit(opts);
+
+    argv[0] = "benchmark/run snapshot";
+    argp_parse(&argp, argc, argv, 0, 0, opts);
+
+    optionsCheck(opts);
+}
@@ -0,0 +1,11 @@
+/* Parse command line arguments for the snapshot benchmark. */
+
+#ifndef SNAPSHOT_PARSE_H_
+#define SNAPSHOT_PARSE_H_
+
+#include "snapshot_options.h"
+
+/* Parse the given command line arguments. */
+void SnapshotParse(int argc, char *argv[], struct snapshotOptions *opts);
+
+#endif /* SNAPSHOT_PARSE_H_ */
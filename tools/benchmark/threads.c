@@ -0,0 +1,498 @@
+#include <assert.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <uv.h>
+
+#include "../../include/raft.h"
+#include "../../include/raft/uv.h"
+
+#include "fs.h"
+#include "threads.h"
+#include "threads_parse.h"
+
+struct threads;
+
+/* Entry submitted by hopping through the shared locked list. */
+struct hop
+{
+    struct raft_apply req;
+    struct raft_buffer buf;
+    struct worker *w;
+    struct hop *next;
+};
+
+/* A thread submitting entries, keeping a window of them in flight. */
+struct worker
+{
+    struct threads *t;
+    uv_thread_t thread;
+    unsigned n;                           /* Entries to submit */
+    unsigned submitted;                   /* Entries submitted so far */
+    unsigned completed;                   /* Entries completed so far */
+    struct raft_uv_completion completion; /* Queue mode */
+    struct raft_uv_submit *reqs;          /* Queue mode */
+    struct hop *hops;                     /* Hop mode */
+    struct hop *done;                     /* Hop mode, completed entries */
+    uv_mutex_t mutex;                     /* Hop mode, protect done */
+    uv_cond_t cond;                       /* Hop mode, signal done */
+};
+
+/* A single-server cluster fed by a number of workers. */
+struct threads
+{
+    struct threadsOptions *opts;
+    struct uv_loop_s *loop;
+    char *dir;
+    struct raft_uv_transport transport;
+    struct raft_io io;
+    struct raft_fsm fsm;
+    struct raft raft;
+    struct raft_uv_queue queue;
+    struct worker *workers;
+    unsigned n_workers;
+    atomic_uint n_finished;     /* Number of workers done */
+    struct uv_async_s finished; /* Signaled when a worker is done */
+    struct uv_async_s hop;      /* Hop mode, signaled on submission */
+    uv_mutex_t hop_mutex;       /* Hop mode, protect the hop list */
+    struct hop *hop_head;       /* Hop mode, first entry to submit */
+    struct hop *hop_tail;       /* Hop mode, last entry to submit */
+    unsigned long start;        /* Time the workers were started */
+    unsigned long elapsed;      /* Time until all workers were done */
+};
+
+static int fsmApply(struct raft_fsm *fsm,
+                    const struct raft_buffer *buf,
+                    void **result)
+{
+    (void)fsm;
+    (void)buf;
+    *result = NULL;
+    return 0;
+}
+
+static struct raft_buffer newBuf(struct worker *w)
+{
+    struct raft_buffer buf;
+    buf.len = w->t->opts->buf;
+    buf.base = raft_malloc(buf.len);
+    assert(buf.base != NULL);
+    memset(buf.base, 0, buf.len);
+    return buf;
+}
+
+static void workerFinish(struct worker *w)
+{
+    atomic_fetch_add(&w->t->n_finished, 1);
+    uv_async_send(&w->t->finished);
+}
+
+static void submitCb(struct raft_uv_submit *req, int status, void *result);
+
+static void workerSubmit(struct worker *w, struct raft_uv_submit *req)
+{
+    struct raft_buffer buf = newBuf(w);
+    w->submitted++;
+    raft_uv_queue_apply(&w->t->queue, req, &buf, &w->completion, submitCb);
+}
+
+/* Invoked on the worker thread. */
+static void submitCb(struct raft_uv_submit *req, int status, void *result)
+{
+    struct worker *w = req->data;
+    (void)result;
+
+    if (status != 0) {
+        printf("submission failed: %s\n", raft_strerror(status));
+        exit(1);
+    }
+
+    w->completed++;
+    if (w->submitted < w->n) {
+        workerSubmit(w, req);
+    }
+}
+
+static void workerRunQueue(struct worker *w)
+{
+    unsigned i;
+
+    for (i = 0; i < w->t->opts->window && w->submitted < w->n; i++) {
+        w->reqs[i].data = w;
+        workerSubmit(w, &w->reqs[i]);
+    }
+    while (w->completed < w->n) {
+        raft_uv_completion_run(&w->completion, true);
+    }
+}
+
+/* Invoked on the loop thread. */
+static void hopApplyCb(struct raft_apply *req, int status, void *result)
+{
+    struct hop *h = req->data;
+    struct worker *w = h->w;
+    (void)result;
+
+    if (status != 0) {
+        printf("submission failed: %s\n", raft_strerror(status));
+        exit(1);
+    }
+
+    uv_mutex_lock(&w->mutex);
+    h->next = w->done;
+    w->done = h;
+    uv_cond_signal(&w->cond);
+    uv_mutex_unlock(&w->mutex);
+}
+
+/* Submit all entries on the hop list, one raft_apply() call each. */
+static void hopCb(uv_async_t *async)
+{
+    struct threads *t = async->data;
+    struct hop *h;
+    int rv;
+
+    uv_mutex_lock(&t->hop_mutex);
+    h = t->hop_head;
+    t->hop_head = NULL;
+    t->hop_tail = NULL;
+    uv_mutex_unlock(&t->hop_mutex);
+
+    while (h != NULL) {
+        struct hop *next = h->next;
+        rv = raft_apply(&t->raft, &h->req, &h->buf, 1, hopApplyCb);
+        if (rv != 0) {
+            printf("raft_apply failed: %s\n", raft_strerror(rv));
+            exit(1);
+        }
+        h = next;
+    }
+}
+
+static void workerHop(struct worker *w, struct hop *h)
+{
+    struct threads *t = w->t;
+
+    h->buf = newBuf(w);
+    h->next = NULL;
+    w->submitted++;
+
+    uv_mutex_lock(&t->hop_mutex);
+    if (t->hop_tail == NULL) {
+        t->hop_head = h;
+    } else {
+        t->hop_tail->next = h;
+    }
+    t->hop_tail = h;
+    uv_mutex_unlock(&t->hop_mutex);
+
+    uv_async_send(&t->hop);
+}
+
+static void workerRunHop(struct worker *w)
+{
+    unsigned i;
+
+    for (i = 0; i < w->t->opts->window && w->submitted < w->n; i++) {
+        w->hops[i].req.data = &w->hops[i];
+        w->hops[i].w = w;
+        workerHop(w, &w->hops[i]);
+    }
+    while (w->completed < w->n) {
+        struct hop *h;
+        uv_mutex_lock(&w->mutex);
+        while (w->done == NULL) {
+            uv_cond_wait(&w->cond, &w->mutex);
+        }
+        h = w->done;
+        w->done = NULL;
+        uv_mutex_unlock(&w->mutex);
+        while (h != NULL) {
+            struct hop *next = h->next;
+            w->completed++;
+            if (w->submitted < w->n) {
+                workerHop(w, h);
+            }
+            h = next;
+        }
+    }
+}
+
+static void workerRun(void *arg)
+{
+    struct worker *w = arg;
+
+    if (w->t->opts->hop) {
+        workerRunHop(w);
+    } else {
+        workerRunQueue(w);
+    }
+
+    workerFinish(w);
+}
+
+static int workerInit(struct worker *w, struct threads *t, unsigned n)
+{
+    int rv;
+
+    w->t = t;
+    w->n = n;
+    w->submitted = 0;
+    w->completed = 0;
+    w->done = NULL;
+
+    w->reqs = calloc(t->opts->window, sizeof *w->reqs);
+    w->hops = calloc(t->opts->window, sizeof *w->hops);
+    assert(w->reqs != NULL);
+    assert(w->hops != NULL);
+
+    rv = raft_uv_completion_init(&w->completion);
+    if (rv != 0) {
+        printf("failed to init completion queue\n");
+        return -1;
+    }
+    uv_mutex_init(&w->mutex);
+    uv_cond_init(&w->cond);
+
+    return 0;
+}
+
+static void workerClose(struct worker *w)
+{
+    uv_cond_destroy(&w->cond);
+    uv_mutex_destroy(&w->mutex);
+    raft_uv_completion_close(&w->completion);
+    free(w->hops);
+    free(w->reqs);
+}
+
+static void queueCloseCb(struct raft_uv_queue *q)
+{
+    (void)q;
+}
+
+static void raftCloseCb(struct raft *r)
+{
+    struct threads *t = r->data;
+
+    raft_uv_queue_close(&t->queue, queueCloseCb);
+    uv_close((struct uv_handle_s *)&t->hop, NULL);
+    uv_close((struct uv_handle_s *)&t->finished, NULL);
+}
+
+static void finishedCb(uv_async_t *async)
+{
+    struct threads *t = async->data;
+    unsigned i;
+
+    if (atomic_load(&t->n_finished) < t->n_workers) {
+        return;
+    }
+
+    t->elapsed = (unsigned long)uv_hrtime() - t->start;
+
+    for (i = 0; i < t->n_workers; i++) {
+        uv_thread_join(&t->workers[i].thread);
+    }
+
+    raft_close(&t->raft, raftCloseCb);
+}
+
+static int threadsInit(struct threads *t,
+                       struct threadsOptions *opts,
+                       struct uv_loop_s *loop,
+                       unsigned n_workers)
+{
+    struct raft_configuration configuration;
+    const char *address = "127.0.0.1:8080";
+    unsigned i;
+    int rv;
+
+    t->opts = opts;
+    t->loop = loop;
+    t->n_workers = n_workers;
+    atomic_init(&t->n_finished, 0);
+    t->hop_head = NULL;
+    t->hop_tail = NULL;
+
+    rv = FsCreateTempDir(opts->dir, &t->dir);
+    if (rv != 0) {
+        printf("failed to create temp dir\n");
+        return -1;
+    }
+
+    t->transport.version = 1;
+    t->transport.data = NULL;
+    rv = raft_uv_tcp_init(&t->transport, loop);
+    if (rv != 0) {
+        printf("failed to init transport\n");
+        return -1;
+    }
+
+    rv = raft_uv_init(&t->io, loop, t->dir, &t->transport);
+    if (rv != 0) {
+        printf("failed to init io\n");
+        return -1;
+    }
+
+    t->fsm.version = 1;
+    t->fsm.apply = fsmApply;
+    t->fsm.snapshot = NULL;
+    t->fsm.restore = NULL;
+
+    rv = raft_init(&t->raft, &t->io, &t->fsm, 1, address);
+    if (rv != 0) {
+        printf("failed to init raft\n");
+        return -1;
+    }
+    t->raft.data = t;
+
+    raft_configuration_init(&configuration);
+    rv = raft_configuration_add(&configuration, 1, address, RAFT_VOTER);
+    if (rv != 0) {
+        printf("failed to populate configuration\n");
+        return -1;
+    }
+    rv = raft_bootstrap(&t->raft, &configuration);
+    if (rv != 0) {
+        printf("failed to bootstrap\n");
+        return -1;
+    }
+    raft_configuration_close(&configuration);
+
+    /* Effectively disable snapshotting. */
+    raft_set_snapshot_threshold(&t->raft, 1024 * 1024);
+
+    rv = raft_start(&t->raft);
+    if (rv != 0) {
+        printf("failed to start raft '%s'\n", raft_strerror(rv));
+        return -1;
+    }
+
+    rv = raft_uv_queue_init(&t->queue, loop, &t->raft);
+    if (rv != 0) {
+        printf("failed to init queue\n");
+        return -1;
+    }
+
+    uv_async_init(loop, &t->finished, finishedCb);
+    t->finished.data = t;
+    uv_async_init(loop, &t->hop, hopCb);
+    t->hop.data = t;
+    uv_mutex_init(&t->hop_mutex);
+
+    t->workers = calloc(n_workers, sizeof *t->workers);
+    assert(t->workers != NULL);
+    for (i = 0; i < n_workers; i++) {
+        /* Spread the remainder over the first workers. */
+        unsigned n = opts->entries / n_workers;
+        if (i < opts->entries % n_workers) {
+            n++;
+        }
+        rv = workerInit(&t->workers[i], t, n);
+        if (rv != 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int threadsStart(struct threads *t)
+{
+    unsigned i;
+    int rv;
+
+    t->start = (unsigned long)uv_hrtime();
+    for (i = 0; i < t->n_workers; i++) {
+        struct worker *w = &t->workers[i];
+        rv = uv_thread_create(&w->thread, workerRun, w);
+        if (rv != 0) {
+            printf("failed to create thread\n");
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int threadsClose(struct threads *t)
+{
+    unsigned i;
+    int rv;
+
+    for (i = 0; i < t->n_workers; i++) {
+        workerClose(&t->workers[i]);
+    }
+    free(t->workers);
+    uv_mutex_destroy(&t->hop_mutex);
+
+    raft_uv_close(&t->io);
+    raft_uv_tcp_close(&t->transport);
+
+    rv = FsRemoveTempDir(t->dir);
+    if (rv != 0) {
+        printf("failed to remove temp dir\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+int ThreadsRun(int argc, char *argv[], struct report *report)
+{
+    struct threadsOptions opts;
+    struct uv_loop_s loop;
+    struct threads t;
+    struct benchmark *benchmark;
+    struct metric *m;
+    char *name;
+    unsigned n;
+    int rv;
+
+    ThreadsParse(argc, argv, &opts);
+
+    for (n = 1; n <= opts.threads; n *= 2) {
+        rv = uv_loop_init(&loop);
+        if (rv != 0) {
+            printf("failed to init loop\n");
+            return -1;
+        }
+
+        rv = threadsInit(&t, &opts, &loop, n);
+        if (rv != 0) {
+            printf("failed to init cluster\n");
+            return -1;
+        }
+
+        rv = threadsStart(&t);
+        if (rv != 0) {
+            return -1;
+        }
+
+        rv = uv_run(&loop, UV_RUN_DEFAULT);
+        if (rv != 0) {
+            printf("failed to run loop\n");
+            return -1;
+        }
+        uv_loop_close(&loop);
+
+        rv = threadsClose(&t);
+        if (rv != 0) {
+            printf("failed to cleanup\n");
+            return -1;
+        }
+
+        rv = asprintf(&name, "threads:%s:%u:%zu", opts.hop ? "hop" : "queue",
+                      n, opts.buf);
+        assert(rv > 0);
+        assert(name != NULL);
+
+        benchmark = ReportGrow(report, name);
+        m = BenchmarkGrow(benchmark, METRIC_KIND_THROUGHPUT);
+        MetricFillThroughput(m, opts.entries, t.elapsed);
+    }
+
+    return 0;
+}
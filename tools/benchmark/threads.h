@@ -0,0 +1,11 @@
+/* Run the threads benchmark. */
+
+#ifndef THREADS_H_
+#define THREADS_H_
+
+#include "report.h"
+
+/* Run the threads subcommand. */
+int ThreadsRun(int argc, char *argv[], struct report *report);
+
+#endif /* THREADS_H_ */
@@ -0,0 +1,21 @@
+/* Options for the threads benchmark. */
+
+#ifndef THREADS_OPTIONS_H_
+#define THREADS_OPTIONS_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Options for the threads benchmark */
+struct threadsOptions
+{
+    char *dir;        /* Directory to use for creating temporary files */
+    size_t buf;       /* Size of each entry to submit */
+    unsigned entries; /* Total number of entries to submit in each run */
+    unsigned window;  /* Max number of in-flight entries per thread */
+    unsigned threads; /* Max number of submitting threads */
+    bool hop;         /* Hop through a mutex-protected list, one entry at a
+                         time, instead of using the submission queue */
+};
+
+#endif /* THREADS_OPTIONS_H_ */
@@ -0,0 +1,101 @@
+#include <argp.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "threads.h"
+#include "threads_parse.h"
+
+#define MEGABYTE (1024 * 1024)
+
+static char doc[] =
+    "Benchmark throughput of entries submitted by 1, 2, 4... threads\n";
+
+/* Order of fields: {NAME, KEY, ARG, FLAGS, DOC, GROUP}.*/
+static struct argp_option options[] = {
+    {"dir", 'd', "DIR", 0, "Directory to use for temp files (default '.')", 0},
+    {"buf", 'b', "BUF", 0, "Size of each entry to submit (default 128)", 0},
+    {"entries", 'e', "N", 0, "Entries to submit in each run (default 65536)",
+     0},
+    {"window", 'w', "N", 0, "In-flight entries per thread (default 16)", 0},
+    {"threads", 't', "N", 0, "Max number of threads (default 32)", 0},
+    {"hop", 'H', 0, 0, "Hop through a locked list instead of the queue", 0},
+    {0}};
+
+static error_t argpParser(int key, char *arg, struct argp_state *state);
+
+static struct argp argp = {
+    .options = options,
+    .parser = argpParser,
+    .doc = doc,
+};
+
+static error_t argpParser(int key, char *arg, struct argp_state *state)
+{
+    struct threadsOptions *opts = state->input;
+
+    switch (key) {
+        case 'd':
+            opts->dir = arg;
+            break;
+        case 'b':
+            opts->buf = (unsigned)atoi(arg);
+            break;
+        case 'e':
+            opts->entries = (unsigned)atoi(arg);
+            break;
+        case 'w':
+            opts->window = (unsigned)atoi(arg);
+            break;
+        case 't':
+            opts->threads = (unsigned)atoi(arg);
+            break;
+        case 'H':
+            opts->hop = true;
+            break;
+        default:
+            return ARGP_ERR_UNKNOWN;
+    }
+
+    return 0;
+}
+
+static void optionsInit(struct threadsOptions *opts)
+{
+    opts->dir = ".";
+    opts->buf = 128;
+    opts->entries = 65536;
+    opts->window = 16;
+    opts->threads = 32;
+    opts->hop = false;
+}
+
+static void optionsCheck(struct threadsOptions *opts)
+{
+    if (opts->buf == 0 || opts->buf > MEGABYTE) {
+        printf("Invalid buffer entry size %zu\n", opts->buf);
+        exit(1);
+    }
+    if (opts->window == 0) {
+        printf("Invalid window %u\n", opts->window);
+        exit(1);
+    }
+    if (opts->threads == 0) {
+        printf("Invalid number of threads %u\n", opts->threads);
+        exit(1);
+    }
+    if (opts->entries < opts->threads) {
+        printf("Invalid number of entries %u\n", opts->entries);
+        exit(1);
+    }
+}
+
+void ThreadsParse(int argc, char *argv[], struct threadsOptions *opts)
+{
+    optionsInit(opts);
+
+    argv[0] = "benchmark/run threads";
+    argp_parse(&argp, argc, argv, 0, 0, opts);
+
+    optionsCheck(opts);
+}
@@ -0,0 +1,11 @@
+/* Parse command line arguments for the threads benchmark. */
+
+#ifndef THREADS_PARSE_H_
+#define THREADS_PARSE_H_
+
+#include "threads_options.h"
+
+/* Parse the given command line arguments. */
+void ThreadsParse(int argc, char *argv[], struct threadsOptions *opts);
+
+#endif /* THREADS_PARSE_H_ */
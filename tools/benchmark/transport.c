@@ -0,0 +1,456 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <uv.h>
+
+#include "../../include/raft.h"
+#include "../../include/raft/uv.h"
+
+#include "fs.h"
+#include "transport.h"
+#include "transport_parse.h"
+
+#define TCP_SENDER_ADDRESS "127.0.0.1:9001"
+#define TCP_RECEIVER_ADDRESS "127.0.0.1:9002"
+
+/* Resolution of the round-trip latency histogram, in nanoseconds. */
+#define HISTOGRAM_GAP 1000
+
+/* Number of buckets of the round-trip latency histogram. */
+#define HISTOGRAM_BUCKETS 10000
+
+enum {
+    TRANSPORT_TCP = 0,
+    TRANSPORT_UNIX,
+    TRANSPORT_INPROC,
+};
+
+static const char *transportNames[] = {[TRANSPORT_TCP] = "tcp",
+                                       [TRANSPORT_UNIX] = "unix",
+                                       [TRANSPORT_INPROC] = "inproc"};
+
+enum {
+    PHASE_WARMUP = 0, /* Establish the connections */
+    PHASE_LATENCY,    /* One message in flight at a time */
+    PHASE_THROUGHPUT, /* Up to window messages in flight */
+};
+
+/* Two raft_io instances exchanging AppendEntries messages and their results
+ * over the transport under test. */
+struct peers
+{
+    struct uv_loop_s *loop;
+    int kind;
+    struct raft_uv_transport sender_transport;
+    struct raft_io sender;
+    char *sender_dir;
+    char *sender_address;
+    struct raft_uv_transport receiver_transport;
+    struct raft_io receiver;
+    char *receiver_dir;
+    char *receiver_address;
+    struct raft_entry entry;  /* Entry sent in each message */
+    int phase;                /* Current phase */
+    unsigned n;               /* Number of messages in the current phase */
+    unsigned window;          /* Messages in flight in the current phase */
+    unsigned sent;            /* Messages sent in the current phase */
+    unsigned received;        /* Results received in the current phase */
+    unsigned long *starts;    /* Send time of each message */
+    struct histogram latency; /* Round-trip latency */
+    unsigned long start;      /* Start of the throughput phase */
+    unsigned long duration;   /* Duration of the throughput phase */
+    unsigned n_throughput;    /* Messages to send in the throughput phase */
+    unsigned max_window;      /* Messages in flight in the throughput phase */
+};
+
+static void ioCloseCb(struct raft_io *io)
+{
+    (void)io;
+}
+
+static void peersClose(struct peers *p)
+{
+    p->receiver.close(&p->receiver, ioCloseCb);
+    p->sender.close(&p->sender, ioCloseCb);
+}
+
+static void sendCb(struct raft_io_send *req, int status)
+{
+    if (status != 0 && status != RAFT_CANCELED) {
+        printf("send failed: %s\n", raft_strerror(status));
+        exit(1);
+    }
+    free(req);
+}
+
+static void sendAppendEntries(struct peers *p)
+{
+    struct raft_message message;
+    struct raft_io_send *req;
+    int rv;
+
+    req = malloc(sizeof *req);
+    assert(req != NULL);
+
+    memset(&message, 0, sizeof message);
+    message.type = RAFT_APPEND_ENTRIES;
+    message.server_id = 2;
+    message.server_address = p->receiver_address;
+    message.append_entries.version = 0; /* Never compress the payload */
+    message.append_entries.term = 1;
+    message.append_entries.prev_log_index = p->sent;
+    message.append_entries.prev_log_term = 1;
+    message.append_entries.entries = &p->entry;
+    message.append_entries.n_entries = 1;
+
+    p->starts[p->sent] = (unsigned long)uv_hrtime();
+    rv = p->sender.send(&p->sender, req, &message, sendCb);
+    if (rv != 0) {
+        printf("failed to send message: %s\n", raft_strerror(rv));
+        exit(1);
+    }
+    p->sent++;
+}
+
+static void sendAppendEntriesResult(struct peers *p, raft_index index)
+{
+    struct raft_message message;
+    struct raft_io_send *req;
+    int rv;
+
+    req = malloc(sizeof *req);
+    assert(req != NULL);
+
+    memset(&message, 0, sizeof message);
+    message.type = RAFT_APPEND_ENTRIES_RESULT;
+    message.server_id = 1;
+    message.server_address = p->sender_address;
+    message.append_entries_result.version = 1;
+    message.append_entries_result.term = 1;
+    message.append_entries_result.last_log_index = index;
+
+    rv = p->receiver.send(&p->receiver, req, &message, sendCb);
+    if (rv != 0) {
+        printf("failed to send result: %s\n", raft_strerror(rv));
+        exit(1);
+    }
+}
+
+/* Start the given phase, sending the first window of messages. */
+static void phaseStart(struct peers *p, int phase)
+{
+    unsigned i;
+
+    p->phase = phase;
+    p->sent = 0;
+    p->received = 0;
+
+    switch (phase) {
+        case PHASE_WARMUP:
+            p->n = 1;
+            p->window = 1;
+            break;
+        case PHASE_LATENCY:
+            p->n = p->n_throughput;
+            p->window = 1;
+            break;
+        case PHASE_THROUGHPUT:
+            p->n = p->n_throughput;
+            p->window = p->max_window;
+            p->start = (unsigned long)uv_hrtime();
+            break;
+    }
+
+    for (i = 0; i < p->window; i++) {
+        sendAppendEntries(p);
+    }
+}
+
+static void tickCb(struct raft_io *io)
+{
+    (void)io;
+}
+
+/* The receiver got an AppendEntries message: reply with its sequence number. */
+static void receiverRecvCb(struct raft_io *io, struct raft_message *message)
+{
+    struct peers *p = io->data;
+
+    assert(message->type == RAFT_APPEND_ENTRIES);
+    assert(message->append_entries.n_entries == 1);
+    raft_free(message->append_entries.entries[0].batch);
+    raft_free(message->append_entries.entries);
+
+    sendAppendEntriesResult(p, message->append_entries.prev_log_index);
+}
+
+/* The sender got a result: account for its round-trip and keep the window
+ * full. */
+static void senderRecvCb(struct raft_io *io, struct raft_message *message)
+{
+    struct peers *p = io->data;
+    unsigned long now = (unsigned long)uv_hrtime();
+    raft_index index;
+
+    assert(message->type == RAFT_APPEND_ENTRIES_RESULT);
+    index = message->append_entries_result.last_log_index;
+    assert(index < p->sent);
+
+    if (p->phase == PHASE_LATENCY) {
+        HistogramCount(&p->latency, now - p->starts[index]);
+    }
+    p->received++;
+
+    if (p->sent < p->n) {
+        sendAppendEntries(p);
+        return;
+    }
+    if (p->received < p->n) {
+        return;
+    }
+
+    switch (p->phase) {
+        case PHASE_WARMUP:
+            phaseStart(p, PHASE_LATENCY);
+            break;
+        case PHASE_LATENCY:
+            phaseStart(p, PHASE_THROUGHPUT);
+            break;
+        case PHASE_THROUGHPUT:
+            p->duration = now - p->start;
+            peersClose(p);
+            break;
+    }
+}
+
+/* Initialize and start a raft_io instance using the transport under test. */
+static int peerInit(struct peers *p,
+                    struct raft_uv_transport *transport,
+                    struct raft_io *io,
+                    const char *dir,
+                    raft_id id,
+                    const char *address,
+                    raft_io_recv_cb recv)
+{
+    int rv;
+
+    transport->version = 1;
+    transport->data = NULL;
+    switch (p->kind) {
+        case TRANSPORT_TCP:
+            rv = raft_uv_tcp_init(transport, p->loop);
+            break;
+        case TRANSPORT_UNIX:
+            rv = raft_uv_unix_init(transport, p->loop);
+            break;
+        default:
+            rv = raft_uv_inproc_init(transport, p->loop);
+            break;
+    }
+    if (rv != 0) {
+        printf("failed to init transport\n");
+        return -1;
+    }
+    rv = raft_uv_init(io, p->loop, dir, transport);
+    if (rv != 0) {
+        printf("failed to init io\n");
+        return -1;
+    }
+    rv = io->init(io, id, address);
+    if (rv != 0) {
+        printf("failed to init io: %s\n", io->errmsg);
+        return -1;
+    }
+    io->version = 0; /* Avoid assuming that io.data is raft */
+    io->data = p;
+    rv = io->start(io, 1000, tickCb, recv);
+    if (rv != 0) {
+        printf("failed to start io: %s\n", io->errmsg);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int peersInit(struct peers *p,
+                     struct transportOptions *opts,
+                     struct uv_loop_s *loop,
+                     int kind)
+{
+    int rv;
+
+    p->loop = loop;
+    p->kind = kind;
+    p->n_throughput = opts->n;
+    p->max_window = opts->window;
+    p->duration = 0;
+
+    p->entry.term = 1;
+    p->entry.type = RAFT_COMMAND;
+    p->entry.buf.base = malloc(opts->buf);
+    assert(p->entry.buf.base != NULL);
+    p->entry.buf.len = opts->buf;
+    memset(p->entry.buf.base, 'x', opts->buf);
+    p->entry.batch = NULL;
+
+    p->starts = malloc(opts->n * sizeof *p->starts);
+    assert(p->starts != NULL);
+
+    HistogramInit(&p->latency, HISTOGRAM_BUCKETS, HISTOGRAM_GAP);
+
+    rv = FsCreateTempDir(opts->dir, &p->sender_dir);
+    if (rv != 0) {
+        printf("failed to create temp dir\n");
+        return -1;
+    }
+    rv = FsCreateTempDir(opts->dir, &p->receiver_dir);
+    if (rv != 0) {
+        printf("failed to create temp dir\n");
+        return -1;
+    }
+
+    switch (kind) {
+        case TRANSPORT_TCP:
+            p->sender_address = strdup(TCP_SENDER_ADDRESS);
+            p->receiver_address = strdup(TCP_RECEIVER_ADDRESS);
+            break;
+        case TRANSPORT_UNIX:
+            rv = asprintf(&p->sender_address, "%s/raft.sock", p->sender_dir);
+            assert(rv > 0);
+            rv = asprintf(&p->receiver_address, "%s/raft.sock",
+                          p->receiver_dir);
+            assert(rv > 0);
+            break;
+        default:
+            p->sender_address = strdup("1");
+            p->receiver_address = strdup("2");
+            break;
+    }
+    assert(p->sender_address != NULL);
+    assert(p->receiver_address != NULL);
+
+    rv = peerInit(p, &p->sender_transport, &p->sender, p->sender_dir, 1,
+                  p->sender_address, senderRecvCb);
+    if (rv != 0) {
+        return -1;
+    }
+    rv = peerInit(p, &p->receiver_transport, &p->receiver, p->receiver_dir,
+                  2, p->receiver_address, receiverRecvCb);
+    if (rv != 0) {
+        return -1;
+    }
+
+    return 0;
+}
+
+static int peersCleanup(struct peers *p)
+{
+    int rv;
+
+    raft_uv_close(&p->sender);
+    raft_uv_close(&p->receiver);
+    if (p->kind == TRANSPORT_INPROC) {
+        raft_uv_inproc_close(&p->sender_transport);
+        raft_uv_inproc_close(&p->receiver_transport);
+    } else {
+        raft_uv_tcp_close(&p->sender_transport);
+        raft_uv_tcp_close(&p->receiver_transport);
+    }
+
+    rv = FsRemoveTempDir(p->sender_dir);
+    if (rv != 0) {
+        printf("failed to remove temp dir\n");
+        return -1;
+    }
+    rv = FsRemoveTempDir(p->receiver_dir);
+    if (rv != 0) {
+        printf("failed to remove temp dir\n");
+        return -1;
+    }
+
+    HistogramClose(&p->latency);
+    free(p->starts);
+    free(p->sender_address);
+    free(p->receiver_address);
+    free(p->entry.buf.base);
+
+    return 0;
+}
+
+/* Run the benchmark against the given kind of transport and add its metrics to
+ * the report. */
+static int transportRun(struct transportOptions *opts,
+                        int kind,
+                        struct report *report)
+{
+    struct uv_loop_s loop;
+    struct peers peers;
+    struct metric *m;
+    struct benchmark *benchmark;
+    char *name;
+    int rv;
+
+    rv = uv_loop_init(&loop);
+    if (rv != 0) {
+        printf("failed to init loop\n");
+        return -1;
+    }
+
+    rv = peersInit(&peers, opts, &loop, kind);
+    if (rv != 0) {
+        printf("failed to init benchmark\n");
+        return -1;
+    }
+
+    phaseStart(&peers, PHASE_WARMUP);
+
+    rv = uv_run(&loop, UV_RUN_DEFAULT);
+    if (rv != 0) {
+        printf("failed to run loop\n");
+        return -1;
+    }
+
+    uv_loop_close(&loop);
+
+    rv = asprintf(&name, "transport:%s:%zu", transportNames[kind], opts->buf);
+    assert(rv > 0);
+    assert(name != NULL);
+
+    benchmark = ReportGrow(report, name);
+    m = BenchmarkGrow(benchmark, METRIC_KIND_LATENCY);
+    MetricFillHistogram(m, &peers.latency);
+    m = BenchmarkGrow(benchmark, METRIC_KIND_THROUGHPUT);
+    MetricFillThroughput(m, peers.n_throughput, peers.duration);
+
+    rv = peersCleanup(&peers);
+    if (rv != 0) {
+        printf("failed to cleanup\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+int TransportRun(int argc, char *argv[], struct report *report)
+{
+    struct transportOptions opts;
+    int rv;
+
+    TransportParse(argc, argv, &opts);
+
+    rv = transportRun(&opts, TRANSPORT_TCP, report);
+    if (rv != 0) {
+        return -1;
+    }
+    rv = transportRun(&opts, TRANSPORT_UNIX, report);
+    if (rv != 0) {
+        return -1;
+    }
+    rv = transportRun(&opts, TRANSPORT_INPROC, report);
+    if (rv != 0) {
+        return -1;
+    }
+
+    return 0;
+}
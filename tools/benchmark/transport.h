@@ -0,0 +1,11 @@
+/* Run the transport benchmark. */
+
+#ifndef TRANSPORT_H_
+#define TRANSPORT_H_
+
+#include "report.h"
+
+/* Run the transport subcommand. */
+int TransportRun(int argc, char *argv[], struct report *report);
+
+#endif /* TRANSPORT_H_ */
@@ -0,0 +1,17 @@
+/* Options for the transport benchmark. */
+
+#ifndef TRANSPORT_OPTIONS_H_
+#define TRANSPORT_OPTIONS_H_
+
+#include <stddef.h>
+
+/* Options for the transport benchmark */
+struct transportOptions
+{
+    char *dir;       /* Directory to use for creating temporary files */
+    size_t buf;      /* Size of the entry sent in each message */
+    unsigned n;      /* Number of messages to send in each phase */
+    unsigned window; /* Messages in flight when measuring throughput */
+};
+
+#endif /* TRANSPORT_OPTIONS_H_ */
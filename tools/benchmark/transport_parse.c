@@ -0,0 +1,87 @@
+#include <argp.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "transport.h"
+#include "transport_parse.h"
+
+#define MEGABYTE (1024 * 1024)
+
+static char doc[] =
+    "Benchmark message round-trips over TCP, Unix and in-process transports\n";
+
+/* Order of fields: {NAME, KEY, ARG, FLAGS, DOC, GROUP}.*/
+static struct argp_option options[] = {
+    {"dir", 'd', "DIR", 0, "Directory to use for temp files (default '.')", 0},
+    {"buf", 'b', "BUF", 0, "Size of the entry in each message (default 64)", 0},
+    {"n", 'n', "N", 0, "Number of messages in each phase (default 10000)", 0},
+    {"window", 'w', "W", 0, "Messages in flight for throughput (default 16)",
+     0},
+    {0}};
+
+static error_t argpParser(int key, char *arg, struct argp_state *state);
+
+static struct argp argp = {
+    .options = options,
+    .parser = argpParser,
+    .doc = doc,
+};
+
+static error_t argpParser(int key, char *arg, struct argp_state *state)
+{
+    struct transportOptions *opts = state->input;
+
+    switch (key) {
+        case 'd':
+            opts->dir = arg;
+            break;
+        case 'b':
+            opts->buf = (unsigned)atoi(arg);
+            break;
+        case 'n':
+            opts->n = (unsigned)atoi(arg);
+            break;
+        case 'w':
+            opts->window = (unsigned)atoi(arg);
+            break;
+        default:
+            return ARGP_ERR_UNKNOWN;
+    }
+
+    return 0;
+}
+
+static void optionsInit(struct transportOptions *opts)
+{
+    opts->dir = ".";
+    opts->buf = 64;
+    opts->n = 10000;
+    opts->window = 16;
+}
+
+static void optionsCheck(struct transportOptions *opts)
+{
+    if (opts->buf == 0 || opts->buf > MEGABYTE || opts->buf % 8 != 0) {
+        printf("Invalid entry size %zu\n", opts->buf);
+        exit(1);
+    }
+    if (opts->n == 0) {
+        printf("Invalid number of messages %u\n", opts->n);
+        exit(1);
+    }
+    if (opts->window == 0 || opts->window > opts->n) {
+        printf("Invalid window %u\n", opts->window);
+        exit(1);
+    }
+}
+
+void TransportParse(int argc, char *argv[], struct transportOptions *opts)
+{
+    optionsInit(opts);
+
+    argv[0] = "benchmark/run transport";
+    argp_parse(&argp, argc, argv, 0, 0, opts);
+
+    optionsCheck(opts);
+}
@@ -0,0 +1,11 @@
+/* Parse command line arguments for the transport benchmark. */
+
+#ifndef TRANSPORT_PARSE_H_
+#define TRANSPORT_PARSE_H_
+
+#include "transport_options.h"
+
+/* Parse the given command line arguments. */
+void TransportParse(int argc, char *argv[], struct transportOptions *opts);
+
+#endif /* TRANSPORT_PARSE_H_ */
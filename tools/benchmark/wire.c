@@ -0,0 +1,517 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <uv.h>
+
+#include "../../include/raft.h"
+#include "../../include/raft/uv.h"
+
+#include "fs.h"
+#include "wire.h"
+#include "wire_parse.h"
+
+#define RECEIVER_ADDRESS "127.0.0.1:9001"
+#define LINK_ADDRESS "127.0.0.1:9002"
+#define SENDER_ADDRESS "127.0.0.1:9003"
+
+/* Maximum number of AppendEntries messages in flight. */
+#define WINDOW 16
+
+/* Stop reading from the sender when this many bytes are queued on the link. */
+#define LINK_MAX_PENDING (4 * 1024 * 1024)
+
+/* Loopback TCP proxy that forwards the data sent to it at a fixed rate. */
+struct link
+{
+    struct uv_loop_s *loop;
+    struct uv_tcp_s listener;    /* Accept connections from the sender */
+    struct uv_tcp_s inbound;     /* Connection from the sender */
+    struct uv_tcp_s outbound;    /* Connection to the receiver */
+    struct uv_connect_s connect; /* Connect to the receiver */
+    struct uv_timer_s timer;     /* Release queued data to the receiver */
+    bool accepted;               /* Whether the sender has connected */
+    bool reading;                /* Whether we're reading from the sender */
+    unsigned rate;               /* Bytes released per millisecond */
+    uint64_t last;               /* Time of the last release */
+    char *pending;               /* Data queued for the receiver */
+    size_t n_pending;            /* Number of bytes queued */
+    size_t transferred;          /* Total number of bytes forwarded */
+};
+
+struct linkWrite
+{
+    uv_write_t req;
+    uv_buf_t buf;
+};
+
+struct wire
+{
+    struct uv_loop_s *loop;
+    struct link link;
+    struct raft_uv_transport receiver_transport;
+    struct raft_io receiver;
+    char *receiver_dir;
+    struct raft_uv_transport sender_transport;
+    struct raft_io sender;
+    char *sender_dir;
+    struct raft_io_send reqs[WINDOW];
+    struct raft_entry *entries; /* Entries sent in each message */
+    unsigned batch;             /* Number of entries in each message */
+    void *data;                 /* Content of the entries */
+    unsigned n;                 /* Total number of messages to send */
+    unsigned sent;              /* Messages sent so far */
+    unsigned received;          /* Messages received so far */
+    unsigned long start;
+    unsigned long duration;
+};
+
+static void linkAllocCb(uv_handle_t *handle, size_t size, uv_buf_t *buf)
+{
+    (void)handle;
+    buf->base = malloc(size);
+    assert(buf->base != NULL);
+    buf->len = size;
+}
+
+static void linkReadCb(uv_stream_t *stream, ssize_t nread, const uv_buf_t *buf)
+{
+    struct link *l = stream->data;
+
+    if (nread > 0) {
+        l->pending = realloc(l->pending, l->n_pending + (size_t)nread);
+        assert(l->pending != NULL);
+        memcpy(l->pending + l->n_pending, buf->base, (size_t)nread);
+        l->n_pending += (size_t)nread;
+        if (l->n_pending >= LINK_MAX_PENDING) {
+            uv_read_stop(stream);
+            l->reading = false;
+        }
+    } else if (nread < 0) {
+        uv_read_stop(stream);
+        l->reading = false;
+    }
+    free(buf->base);
+}
+
+static void linkWriteCb(uv_write_t *req, int status)
+{
+    struct linkWrite *write = (struct linkWrite *)req;
+    (void)status;
+    free(write->buf.base);
+    free(write);
+}
+
+/* Forward to the receiver the data that the link bandwidth allows to send
+ * since the last release. */
+static void linkTimerCb(uv_timer_t *timer)
+{
+    struct link *l = timer->data;
+    struct linkWrite *write;
+    uint64_t now = uv_now(l->loop);
+    size_t n = (size_t)(now - l->last) * l->rate;
+    int rv;
+
+    l->last = now;
+
+    if (n > l->n_pending) {
+        n = l->n_pending;
+    }
+    if (n == 0) {
+        return;
+    }
+
+    write = malloc(sizeof *write);
+    assert(write != NULL);
+    write->buf.base = malloc(n);
+    assert(write->buf.base != NULL);
+    write->buf.len = n;
+    memcpy(write->buf.base, l->pending, n);
+    memmove(l->pending, l->pending + n, l->n_pending - n);
+    l->n_pending -= n;
+    l->transferred += n;
+
+    rv = uv_write(&write->req, (uv_stream_t *)&l->outbound, &write->buf, 1,
+                  linkWriteCb);
+    assert(rv == 0);
+
+    if (!l->reading && l->n_pending < LINK_MAX_PENDING) {
+        rv = uv_read_start((uv_stream_t *)&l->inbound, linkAllocCb, linkReadCb);
+        assert(rv == 0);
+        l->reading = true;
+    }
+}
+
+static void linkConnectCb(uv_connect_t *req, int status)
+{
+    struct link *l = req->data;
+    int rv;
+
+    assert(status == 0);
+
+    rv = uv_read_start((uv_stream_t *)&l->inbound, linkAllocCb, linkReadCb);
+    assert(rv == 0);
+    l->reading = true;
+
+    l->last = uv_now(l->loop);
+    rv = uv_timer_start(&l->timer, linkTimerCb, 1, 1);
+    assert(rv == 0);
+}
+
+static void linkConnectionCb(uv_stream_t *server, int status)
+{
+    struct link *l = server->data;
+    struct sockaddr_in addr;
+    int rv;
+
+    assert(status == 0);
+
+    /* There's only one connection from the sender. */
+    assert(!l->accepted);
+    l->accepted = true;
+
+    uv_tcp_init(l->loop, &l->inbound);
+    l->inbound.data = l;
+    rv = uv_accept(server, (uv_stream_t *)&l->inbound);
+    assert(rv == 0);
+
+    uv_tcp_init(l->loop, &l->outbound);
+    l->outbound.data = l;
+    uv_ip4_addr("127.0.0.1", 9001, &addr);
+    l->connect.data = l;
+    rv = uv_tcp_connect(&l->connect, &l->outbound,
+                        (const struct sockaddr *)&addr, linkConnectCb);
+    assert(rv == 0);
+}
+
+static int linkInit(struct link *l, struct uv_loop_s *loop, unsigned rate)
+{
+    struct sockaddr_in addr;
+    int rv;
+
+    l->loop = loop;
+    l->accepted = false;
+    l->reading = false;
+    l->rate = rate * 1024 / 1000;
+    if (l->rate == 0) {
+        l->rate = 1;
+    }
+    l->last = 0;
+    l->pending = NULL;
+    l->n_pending = 0;
+    l->transferred = 0;
+
+    uv_timer_init(loop, &l->timer);
+    l->timer.data = l;
+
+    uv_tcp_init(loop, &l->listener);
+    l->listener.data = l;
+    uv_ip4_addr("127.0.0.1", 9002, &addr);
+    rv = uv_tcp_bind(&l->listener, (const struct sockaddr *)&addr, 0);
+    if (rv != 0) {
+        return -1;
+    }
+    rv = uv_listen((uv_stream_t *)&l->listener, 1, linkConnectionCb);
+    if (rv != 0) {
+        return -1;
+    }
+
+    return 0;
+}
+
+static void linkClose(struct link *l)
+{
+    uv_close((uv_handle_t *)&l->timer, NULL);
+    uv_close((uv_handle_t *)&l->listener, NULL);
+    if (l->accepted) {
+        uv_close((uv_handle_t *)&l->inbound, NULL);
+        uv_close((uv_handle_t *)&l->outbound, NULL);
+    }
+    free(l->pending);
+}
+
+static void ioCloseCb(struct raft_io *io)
+{
+    (void)io;
+}
+
+static void wireClose(struct wire *w)
+{
+    w->receiver.close(&w->receiver, ioCloseCb);
+    w->sender.close(&w->sender, ioCloseCb);
+    linkClose(&w->link);
+}
+
+static void sendCb(struct raft_io_send *req, int status)
+{
+    (void)req;
+    if (status != 0 && status != RAFT_CANCELED) {
+        printf("send failed: %s\n", raft_strerror(status));
+        exit(1);
+    }
+}
+
+static int sendMessage(struct wire *w)
+{
+    struct raft_message message;
+    struct raft_io_send *req = &w->reqs[w->sent % WINDOW];
+    int rv;
+
+    memset(&message, 0, sizeof message);
+    message.type = RAFT_APPEND_ENTRIES;
+    message.server_id = 1;
+    message.server_address = LINK_ADDRESS;
+    message.append_entries.version = 1; /* The receiver supports LZ4 */
+    message.append_entries.term = 1;
+    message.append_entries.prev_log_index = (raft_index)w->sent * w->batch;
+    message.append_entries.prev_log_term = 1;
+    message.append_entries.entries = w->entries;
+    message.append_entries.n_entries = w->batch;
+
+    rv = w->sender.send(&w->sender, req, &message, sendCb);
+    if (rv != 0) {
+        return -1;
+    }
+    w->sent++;
+
+    return 0;
+}
+
+static void tickCb(struct raft_io *io)
+{
+    (void)io;
+}
+
+static void recvCb(struct raft_io *io, struct raft_message *message)
+{
+    struct wire *w = io->data;
+    int rv;
+
+    assert(message->type == RAFT_APPEND_ENTRIES);
+    assert(message->append_entries.n_entries == w->batch);
+    raft_free(message->append_entries.entries[0].batch);
+    raft_free(message->append_entries.entries);
+
+    w->received++;
+
+    if (w->received == w->n) {
+        w->duration = (unsigned long)uv_hrtime() - w->start;
+        wireClose(w);
+        return;
+    }
+
+    if (w->sent < w->n) {
+        rv = sendMessage(w);
+        if (rv != 0) {
+            printf("failed to send message\n");
+            exit(1);
+        }
+    }
+}
+
+/* Fill the given buffer with text-like data, as a stand-in for typical entry
+ * payloads. */
+static void fillData(char *data, size_t size)
+{
+    static const char *words[] = {"raft",   "leader", "follower", "term",
+                                  "index",  "append", "entries",  "commit",
+                                  "vote",   "log",    "snapshot", "apply",
+                                  "config", "voter",  "standby",  "spare"};
+    unsigned seed = 1;
+    size_t i = 0;
+
+    while (i < size) {
+        const char *word;
+        size_t len;
+        seed = seed * 1103515245 + 12345;
+        word = words[(seed >> 16) % 16];
+        len = strlen(word);
+        if (len > size - i - 1) {
+            len = size - i - 1;
+        }
+        memcpy(data + i, word, len);
+        i += len;
+        if (i < size) {
+            data[i] = ' ';
+            i++;
+        }
+    }
+}
+
+static int wireInit(struct wire *w,
+                    struct wireOptions *opts,
+                    struct uv_loop_s *loop)
+{
+    unsigned i;
+    int rv;
+
+    w->loop = loop;
+    w->batch = opts->batch;
+    w->n = opts->size / (unsigned)(opts->buf * opts->batch);
+    w->sent = 0;
+    w->received = 0;
+    w->duration = 0;
+
+    w->data = malloc(opts->buf * opts->batch);
+    assert(w->data != NULL);
+    fillData(w->data, opts->buf * opts->batch);
+
+    w->entries = malloc(opts->batch * sizeof *w->entries);
+    assert(w->entries != NULL);
+    for (i = 0; i < opts->batch; i++) {
+        w->entries[i].term = 1;
+        w->entries[i].type = RAFT_COMMAND;
+        w->entries[i].buf.base = (char *)w->data + i * opts->buf;
+        w->entries[i].buf.len = opts->buf;
+        w->entries[i].batch = NULL;
+    }
+
+    rv = linkInit(&w->link, loop, opts->rate);
+    if (rv != 0) {
+        printf("failed to init link\n");
+        return -1;
+    }
+
+    rv = FsCreateTempDir(opts->dir, &w->receiver_dir);
+    if (rv != 0) {
+        printf("failed to create temp dir\n");
+        return -1;
+    }
+    rv = FsCreateTempDir(opts->dir, &w->sender_dir);
+    if (rv != 0) {
+        printf("failed to create temp dir\n");
+        return -1;
+    }
+
+    w->receiver_transport.version = 1;
+    w->receiver_transport.data = NULL;
+    rv = raft_uv_tcp_init(&w->receiver_transport, loop);
+    if (rv != 0) {
+        printf("failed to init transport\n");
+        return -1;
+    }
+    rv = raft_uv_init(&w->receiver, loop, w->receiver_dir,
+                      &w->receiver_transport);
+    if (rv != 0) {
+        printf("failed to init io\n");
+        return -1;
+    }
+    rv = w->receiver.init(&w->receiver, 1, RECEIVER_ADDRESS);
+    if (rv != 0) {
+        printf("failed to init receiver\n");
+        return -1;
+    }
+    w->receiver.version = 0; /* Avoid assuming that io.data is raft */
+    w->receiver.data = w;
+    rv = w->receiver.start(&w->receiver, 1000, tickCb, recvCb);
+    if (rv != 0) {
+        printf("failed to start receiver\n");
+        return -1;
+    }
+
+    w->sender_transport.version = 1;
+    w->sender_transport.data = NULL;
+    rv = raft_uv_tcp_init(&w->sender_transport, loop);
+    if (rv != 0) {
+        printf("failed to init transport\n");
+        return -1;
+    }
+    rv = raft_uv_init(&w->sender, loop, w->sender_dir, &w->sender_transport);
+    if (rv != 0) {
+        printf("failed to init io\n");
+        return -1;
+    }
+    rv = w->sender.init(&w->sender, 2, SENDER_ADDRESS);
+    if (rv != 0) {
+        printf("failed to init sender\n");
+        return -1;
+    }
+    raft_uv_set_append_compression_threshold(&w->sender, opts->threshold);
+
+    return 0;
+}
+
+static int wireCleanup(struct wire *w)
+{
+    int rv;
+
+    raft_uv_close(&w->receiver);
+    raft_uv_tcp_close(&w->receiver_transport);
+    raft_uv_close(&w->sender);
+    raft_uv_tcp_close(&w->sender_transport);
+
+    rv = FsRemoveTempDir(w->receiver_dir);
+    if (rv != 0) {
+        printf("failed to remove temp dir\n");
+        return -1;
+    }
+    rv = FsRemoveTempDir(w->sender_dir);
+    if (rv != 0) {
+        printf("failed to remove temp dir\n");
+        return -1;
+    }
+
+    free(w->entries);
+    free(w->data);
+
+    return 0;
+}
+
+int WireRun(int argc, char *argv[], struct report *report)
+{
+    struct wireOptions opts;
+    struct uv_loop_s loop;
+    struct wire wire;
+    struct metric *m;
+    struct benchmark *benchmark;
+    char *name;
+    unsigned i;
+    int rv;
+
+    WireParse(argc, argv, &opts);
+
+    rv = uv_loop_init(&loop);
+    if (rv != 0) {
+        printf("failed to init loop\n");
+        return -1;
+    }
+
+    rv = wireInit(&wire, &opts, &loop);
+    if (rv != 0) {
+        printf("failed to init benchmark\n");
+        return -1;
+    }
+
+    wire.start = (unsigned long)uv_hrtime();
+    for (i = 0; i < WINDOW && wire.sent < wire.n; i++) {
+        rv = sendMessage(&wire);
+        if (rv != 0) {
+            printf("failed to send message\n");
+            return -1;
+        }
+    }
+
+    rv = uv_run(&loop, UV_RUN_DEFAULT);
+    if (rv != 0) {
+        printf("failed to run loop\n");
+        return -1;
+    }
+
+    uv_loop_close(&loop);
+
+    rv = asprintf(&name, "wire:%zu:%zu", opts.buf, opts.threshold);
+    assert(rv > 0);
+    assert(name != NULL);
+
+    benchmark = ReportGrow(report, name);
+    m = BenchmarkGrow(benchmark, METRIC_KIND_THROUGHPUT);
+    MetricFillThroughput(m, wire.n * wire.batch, wire.duration);
+
+    rv = wireCleanup(&wire);
+    if (rv != 0) {
+        printf("failed to cleanup\n");
+        return -1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,11 @@
+/* Run the wire benchmark. */
+
+#ifndef WIRE_H_
+#define WIRE_H_
+
+#include "report.h"
+
+/* Run the wire subcommand. */
+int WireRun(int argc, char *argv[], struct report *report);
+
+#endif /* WIRE_H_ */
@@ -0,0 +1,19 @@
+/* Options for the wire benchmark. */
+
+#ifndef WIRE_OPTIONS_H_
+#define WIRE_OPTIONS_H_
+
+#include <stddef.h>
+
+/* Options for the wire benchmark */
+struct wireOptions
+{
+    char *dir;        /* Directory to use for creating temporary files */
+    size_t buf;       /* Size of each raft entry to send */
+    unsigned batch;   /* Number of entries in each AppendEntries message */
+    unsigned size;    /* Total number of bytes to send */
+    unsigned rate;    /* Bandwidth of the link, in kilobytes per second */
+    size_t threshold; /* Minimum payload size to compress, 0 to disable */
+};
+
+#endif /* WIRE_OPTIONS_H_ */
@@ -0,0 +1,100 @@
+#include <argp.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "wire.h"
+#include "wire_parse.h"
+
+#define MEGABYTE (1024 * 1024)
+
+static char doc[] =
+    "Benchmark AppendEntries throughput over a throttled loopback link\n";
+
+/* Order of fields: {NAME, KEY, ARG, FLAGS, DOC, GROUP}.*/
+static struct argp_option options[] = {
+    {"dir", 'd', "DIR", 0, "Directory to use for temp files (default '.')", 0},
+    {"buf", 'b', "BUF", 0, "Size of each entry to send (default 4096)", 0},
+    {"batch", 'n', "N", 0, "Entries in each message (default 16)", 0},
+    {"size", 's', "S", 0, "Total number of bytes to send (default 32M)", 0},
+    {"rate", 'r', "KB", 0, "Link bandwidth in KB/s (default 16384)", 0},
+    {"threshold", 't', "T", 0, "Min. size to compress, 0 disables (4096)", 0},
+    {0}};
+
+static error_t argpParser(int key, char *arg, struct argp_state *state);
+
+static struct argp argp = {
+    .options = options,
+    .parser = argpParser,
+    .doc = doc,
+};
+
+static error_t argpParser(int key, char *arg, struct argp_state *state)
+{
+    struct wireOptions *opts = state->input;
+
+    switch (key) {
+        case 'd':
+            opts->dir = arg;
+            break;
+        case 'b':
+            opts->buf = (unsigned)atoi(arg);
+            break;
+        case 'n':
+            opts->batch = (unsigned)atoi(arg);
+            break;
+        case 's':
+            opts->size = (unsigned)atoi(arg);
+            break;
+        case 'r':
+            opts->rate = (unsigned)atoi(arg);
+            break;
+        case 't':
+            opts->threshold = (unsigned)atoi(arg);
+            break;
+        default:
+            return ARGP_ERR_UNKNOWN;
+    }
+
+    return 0;
+}
+
+static void optionsInit(struct wireOptions *opts)
+{
+    opts->dir = ".";
+    opts->buf = 4096;
+    opts->batch = 16;
+    opts->size = 32 * MEGABYTE;
+    opts->rate = 16 * 1024;
+    opts->threshold = 4096;
+}
+
+static void optionsCheck(struct wireOptions *opts)
+{
+    if (opts->buf == 0 || opts->buf > MEGABYTE || opts->buf % 8 != 0) {
+        printf("Invalid entry size %zu\n", opts->buf);
+        exit(1);
+    }
+    if (opts->batch == 0 || opts->batch > 1024) {
+        printf("Invalid batch size %u\n", opts->batch);
+        exit(1);
+    }
+    if (opts->size < opts->buf * opts->batch) {
+        printf("Invalid total size %u\n", opts->size);
+        exit(1);
+    }
+    if (opts->rate == 0) {
+        printf("Invalid link bandwidth %u\n", opts->rate);
+        exit(1);
+    }
+}
+
+void WireParse(int argc, char *argv[], struct wireOptions *opts)
+{
+    optionsInit(opts);
+
+    argv[0] = "benchmark/run wire";
+    argp_parse(&argp, argc, argv, 0, 0, opts);
+
+    optionsCheck(opts);
+}
@@ -0,0 +1,11 @@
+/* Parse command line arguments for the wire benchmark. */
+
+#ifndef WIRE_PARSE_H_
+#define WIRE_PARSE_H_
+
+#include "wire_options.h"
+
+/* Parse the given command line arguments. */
+void WireParse(int argc, char *argv[], struct wireOptions *opts);
+
+#endif /* WIRE_PARSE_H_ */